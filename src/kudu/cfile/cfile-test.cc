@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <list>
 
+#include "kudu/cfile/block_compression.h"
 #include "kudu/cfile/cfile-test-base.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_writer.h"
@@ -30,6 +31,8 @@
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/stopwatch.h"
@@ -933,5 +936,47 @@ TEST_P(TestCFileDifferentCodecs, TestUncompressible) {
   }
 }
 
+// Tests that a compressed block whose header doesn't match the size of its
+// decompressed data is rejected, rather than decompressed past the end of the
+// output buffer or returned with garbage at its end.
+TEST_P(TestCFileDifferentCodecs, TestWrongUncompressedSize) {
+  auto compression = GetParam();
+  if (compression == NO_COMPRESSION) return;
+  const CompressionCodec* codec;
+  ASSERT_OK(GetCompressionCodec(compression, &codec));
+
+  // Use compressible data, so that the block is actually compressed.
+  string data;
+  for (int i = 0; i < 4096; i++) {
+    data.push_back('a' + i % 4);
+  }
+  CompressedBlockBuilder builder(codec);
+  vector<Slice> result;
+  ASSERT_OK(builder.Compress({ Slice(data) }, &result));
+  ASSERT_EQ(1, result.size());
+  const string block = result[0].ToString();
+  ASSERT_LT(block.size(), data.size());
+
+  {
+    CompressedBlockDecoder decoder(codec, 2, Slice(block));
+    ASSERT_OK(decoder.Init());
+    ASSERT_EQ(data.size(), decoder.uncompressed_size());
+    gscoped_array<uint8_t> buf(new uint8_t[decoder.uncompressed_size()]);
+    ASSERT_OK(decoder.UncompressIntoBuffer(buf.get()));
+    ASSERT_EQ(data, Slice(buf.get(), data.size()).ToString());
+  }
+
+  for (int delta : { -100, 100 }) {
+    SCOPED_TRACE(delta);
+    string corrupt = block;
+    InlineEncodeFixed32(reinterpret_cast<uint8_t*>(&corrupt[0]), data.size() + delta);
+    CompressedBlockDecoder decoder(codec, 2, Slice(corrupt));
+    ASSERT_OK(decoder.Init());
+    gscoped_array<uint8_t> buf(new uint8_t[decoder.uncompressed_size()]);
+    Status s = decoder.UncompressIntoBuffer(buf.get());
+    ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+  }
+}
+
 } // namespace cfile
 } // namespace kudu
@@ -18,6 +18,7 @@
 #include "kudu/client/batcher.h"
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -32,6 +33,7 @@
 #include "kudu/client/callbacks.h"
 #include "kudu/client/client.h"
 #include "kudu/client/client-internal.h"
+#include "kudu/client/client_metrics.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/session-internal.h"
@@ -52,6 +54,7 @@
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/pb_util.h"
 
 using std::pair;
@@ -118,13 +121,15 @@ struct InFlightOp {
     kNew = 0,
 
     // Waiting for the MetaCache to determine which tablet ID hosts the row associated
-    // with this operation. In the case that the relevant tablet's key range was
-    // already cached, this state will be passed through immediately. Otherwise,
-    // the op may sit in this state for some amount of time while waiting on the
-    // MetaCache to perform an RPC to the master and find the correct tablet.
+    // with this operation. Ops are routed together when the batch is flushed: in the
+    // case that the relevant tablet's key range was already cached, this state will
+    // be passed through at that point. Otherwise, the op may sit in this state for
+    // some amount of time while waiting on the MetaCache to perform an RPC to the
+    // master and find the correct tablet.
     //
-    // OWNERSHIP: the op is present in the 'ops_' set, and also referenced by the
-    // in-flight callback provided to MetaCache.
+    // OWNERSHIP: the op is present in the 'ops_' set, and also either in the
+    // 'unrouted_ops_' vector or referenced by the in-flight callback provided to
+    // MetaCache.
     kLookingUpTablet,
 
     // Once the correct tablet has been determined, and the tablet locations have been
@@ -168,6 +173,9 @@ struct InFlightOp {
   // The actual operation.
   gscoped_ptr<KuduWriteOperation> write_op;
 
+  // The encoded partition key of the operation's row.
+  string partition_key;
+
   // The tablet the operation is destined for.
   // This is only filled in after passing through the kLookingUpTablet state.
   scoped_refptr<RemoteTablet> tablet;
@@ -187,6 +195,16 @@ struct InFlightOp {
   }
 };
 
+// A run of ops of one table, sorted by partition key, whose tablets weren't
+// found in the meta cache. The tablet of the first op is looked up in the
+// master, and the rest are routed again once the lookup has completed.
+struct OpsLookup {
+  vector<InFlightOp*> ops;
+
+  // The tablet hosting the first op, once looked up.
+  scoped_refptr<RemoteTablet> tablet;
+};
+
 // A Write RPC which is in-flight to a tablet. Initially, the RPC is sent
 // to the leader replica, but it may be retried with another replica if the
 // leader fails.
@@ -230,6 +248,10 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
 
   // The id of the tablet being written to.
   string tablet_id_;
+
+  // The replica the in-flight attempt was sent to, and when it was sent.
+  RemoteTabletServer* attempt_replica_;
+  MonoTime attempt_start_time_;
 };
 
 WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
@@ -243,7 +265,8 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
     : RetriableRpc(replica_picker, request_tracker, deadline, messenger),
       batcher_(batcher),
       ops_(std::move(ops)),
-      tablet_id_(tablet_id) {
+      tablet_id_(tablet_id),
+      attempt_replica_(nullptr) {
   const Schema* schema = table()->schema().schema_;
 
   req_.set_tablet_id(tablet_id_);
@@ -310,6 +333,8 @@ string WriteRpc::ToString() const {
 
 void WriteRpc::Try(RemoteTabletServer* replica, const ResponseCallback& callback) {
   VLOG(2) << "Tablet " << tablet_id_ << ": Writing batch to replica " << replica->ToString();
+  attempt_replica_ = replica;
+  attempt_start_time_ = MonoTime::Now();
   replica->proxy()->WriteAsync(req_, &resp_,
                                mutable_retrier()->mutable_controller(),
                                callback);
@@ -324,21 +349,38 @@ void WriteRpc::Finish(const Status& status) {
                    ops_.size(), tablet_id_, num_attempts()));
     KLOG_EVERY_N_SECS(WARNING, 1) << final_status.ToString();
   }
+  if (num_attempts() > 1) {
+    table()->client()->data_->metrics_->client_write_rpc_retries->IncrementBy(
+        num_attempts() - 1);
+  }
   batcher_->ProcessWriteResponse(*this, final_status);
 }
 
 RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
+  // The response is also analyzed before each attempt, once a replica is
+  // picked; 'attempt_replica_' is only set while an attempt is in flight.
+  if (attempt_replica_) {
+    RecordWriteRpcLatency(table()->client()->data_->metrics_.get(),
+                          *attempt_replica_, attempt_start_time_);
+    attempt_replica_ = nullptr;
+  }
+  return AnalyzeWriteResponse(rpc_cb_status, mutable_retrier()->controller(), resp_);
+}
+
+RetriableRpcStatus AnalyzeWriteResponse(const Status& rpc_cb_status,
+                                        const RpcController& controller,
+                                        const WriteResponsePB& resp) {
   RetriableRpcStatus result;
   result.status = rpc_cb_status;
 
   // If we didn't fail on tablet lookup/proxy initialization, check if we failed actually performing
   // the write.
   if (rpc_cb_status.ok()) {
-    result.status = mutable_retrier()->controller().status();
+    result.status = controller.status();
   }
 
   if (result.status.IsRemoteError()) {
-    const ErrorStatusPB* err = mutable_retrier()->controller().error_response();
+    const ErrorStatusPB* err = controller.error_response();
     if (err &&
         err->has_code() &&
         err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY) {
@@ -357,12 +399,12 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
   }
 
   // Prefer controller failures over response failures.
-  if (result.status.ok() && resp_.has_error()) {
-    result.status = StatusFromPB(resp_.error().status());
+  if (result.status.ok() && resp.has_error()) {
+    result.status = StatusFromPB(resp.error().status());
   }
 
   // If we get TABLET_NOT_FOUND, the replica we thought was leader has been deleted.
-  if (resp_.has_error() && resp_.error().code() == tserver::TabletServerErrorPB::TABLET_NOT_FOUND) {
+  if (resp.has_error() && resp.error().code() == tserver::TabletServerErrorPB::TABLET_NOT_FOUND) {
     result.result = RetriableRpcStatus::RESOURCE_NOT_FOUND;
     return result;
   }
@@ -389,6 +431,14 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
   return result;
 }
 
+void RecordWriteRpcLatency(ClientMetrics* metrics,
+                           const RemoteTabletServer& replica,
+                           const MonoTime& start_time) {
+  int64_t latency_us = (MonoTime::Now() - start_time).ToMicroseconds();
+  metrics->client_write_rpc_latency->Increment(latency_us);
+  replica.metrics().client_tablet_server_write_rpc_latency->Increment(latency_us);
+}
+
 Batcher::Batcher(KuduClient* client,
                  scoped_refptr<ErrorCollector> error_collector,
                  sp::weak_ptr<KuduSession> session,
@@ -423,6 +473,13 @@ void Batcher::Abort() {
     MarkInFlightOpFailedUnlocked(op, Status::Aborted("Batch aborted"));
   }
 
+  // Ops which haven't been routed yet have no lookup callback to fail them.
+  for (InFlightOp* op : unrouted_ops_) {
+    VLOG(1) << "Aborting op: " << op->ToString();
+    MarkInFlightOpFailedUnlocked(op, Status::Aborted("Batch aborted"));
+  }
+  unrouted_ops_.clear();
+
   if (flush_callback_) {
     l.unlock();
 
@@ -502,6 +559,8 @@ void Batcher::FlushAsync(KuduStatusCallback* cb) {
     deadline_ = ComputeDeadlineUnlocked();
   }
 
+  RouteUnroutedOps();
+
   // In the case that we have nothing buffered, just call the callback
   // immediately. Otherwise, the callback will be called by the last callback
   // when it sees that the ops_ list has drained.
@@ -517,29 +576,15 @@ void Batcher::FlushAsync(KuduStatusCallback* cb) {
 }
 
 Status Batcher::Add(KuduWriteOperation* write_op) {
-  // As soon as we get the op, start looking up where it belongs,
-  // so that when the user calls Flush, we are ready to go.
+  // Only the partition key is computed here: the op is routed to its tablet
+  // along with the rest of the batch when the batch is flushed.
   gscoped_ptr<InFlightOp> op(new InFlightOp());
-  string partition_key;
-  RETURN_NOT_OK(write_op->table_->partition_schema().EncodeKey(write_op->row(), &partition_key));
+  RETURN_NOT_OK(write_op->table_->partition_schema().EncodeKey(write_op->row(),
+                                                               &op->partition_key));
   op->write_op.reset(write_op);
   op->state = InFlightOp::kLookingUpTablet;
 
-  AddInFlightOp(op.get());
-  VLOG(3) << "Looking up tablet for " << op->ToString();
-  // Increment our reference count for the outstanding callback.
-  //
-  // deadline_ is set in FlushAsync(), after all Add() calls are done, so
-  // here we're forced to create a new deadline.
-  MonoTime deadline = ComputeDeadlineUnlocked();
-  base::RefCountInc(&outstanding_lookups_);
-  client_->data_->meta_cache_->LookupTabletByKey(
-      op->write_op->table(),
-      std::move(partition_key),
-      deadline,
-      &op->tablet,
-      Bind(&Batcher::TabletLookupFinished, this, op.get()));
-  IgnoreResult(op.release());
+  AddInFlightOp(op.release());
 
   buffer_bytes_used_.IncrementBy(write_op->SizeInBuffer());
 
@@ -552,6 +597,7 @@ void Batcher::AddInFlightOp(InFlightOp* op) {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK_EQ(state_, kGatheringOps);
   InsertOrDie(&ops_, op);
+  unrouted_ops_.push_back(op);
   op->sequence_number_ = next_op_sequence_number_++;
 
   // Set the time of the first operation in the batch, if not set yet.
@@ -583,6 +629,182 @@ void Batcher::MarkInFlightOpFailedUnlocked(InFlightOp* op, const Status& s) {
   delete op;
 }
 
+void Batcher::RouteUnroutedOps() {
+  vector<InFlightOp*> ops;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    ops.swap(unrouted_ops_);
+  }
+  if (ops.empty()) {
+    return;
+  }
+
+  // Hold off FlushBuffersIfReady() until every op has been routed, in case
+  // some of the lookups started below complete before we're done.
+  base::RefCountInc(&outstanding_lookups_);
+
+  // Sort the ops by table and partition key, so that the ops of each tablet
+  // are contiguous. The sort is stable, so ops on the same row stay in the
+  // order they were added.
+  std::less<const KuduTable*> table_less;
+  std::stable_sort(ops.begin(), ops.end(),
+                   [&](const InFlightOp* a, const InFlightOp* b) {
+                     const KuduTable* a_table = a->write_op->table();
+                     const KuduTable* b_table = b->write_op->table();
+                     if (a_table != b_table) {
+                       return table_less(a_table, b_table);
+                     }
+                     return a->partition_key < b->partition_key;
+                   });
+
+  auto table_begin = ops.begin();
+  while (table_begin != ops.end()) {
+    const KuduTable* table = (*table_begin)->write_op->table();
+    auto table_end = std::find_if(table_begin, ops.end(), [&](const InFlightOp* op) {
+        return op->write_op->table() != table;
+      });
+    RouteOps(vector<InFlightOp*>(table_begin, table_end));
+    table_begin = table_end;
+  }
+
+  base::RefCountDec(&outstanding_lookups_);
+}
+
+void Batcher::RouteOps(vector<InFlightOp*> ops) {
+  DCHECK(!ops.empty());
+  const KuduTable* table = ops[0]->write_op->table();
+
+  vector<const string*> partition_keys;
+  partition_keys.reserve(ops.size());
+  for (const InFlightOp* op : ops) {
+    partition_keys.push_back(&op->partition_key);
+  }
+  vector<scoped_refptr<RemoteTablet>> tablets;
+  client_->data_->meta_cache_->LookupTabletsByKeysFastPath(table, partition_keys, &tablets);
+
+  // Each run of ops whose tablets aren't cached is looked up in the master
+  // with a single lookup for its first op. The lookup caches the locations of
+  // the tablets which follow as well, so the rest of the run is then routed
+  // through the cache.
+  vector<InFlightOp*> routed;
+  routed.reserve(ops.size());
+  vector<OpsLookup*> lookups;
+  OpsLookup* current_run = nullptr;
+  for (int i = 0; i < ops.size(); i++) {
+    if (tablets[i]) {
+      ops[i]->tablet = std::move(tablets[i]);
+      routed.push_back(ops[i]);
+      current_run = nullptr;
+      continue;
+    }
+    if (current_run == nullptr) {
+      current_run = new OpsLookup();
+      lookups.push_back(current_run);
+    }
+    current_run->ops.push_back(ops[i]);
+  }
+
+  for (OpsLookup* lookup : lookups) {
+    VLOG(3) << "Looking up tablet for " << lookup->ops.size() << " ops, starting with "
+            << lookup->ops[0]->ToString();
+    base::RefCountInc(&outstanding_lookups_);
+    client_->data_->meta_cache_->LookupTabletByKey(
+        table,
+        lookup->ops[0]->partition_key,
+        deadline_,
+        &lookup->tablet,
+        Bind(&Batcher::OpsLookupFinished, this, lookup));
+  }
+
+  BufferRoutedOps(routed);
+}
+
+void Batcher::BufferRoutedOps(const vector<InFlightOp*>& ops) {
+  if (ops.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (IsAbortedUnlocked()) {
+      for (InFlightOp* op : ops) {
+        VLOG(1) << "Aborted batch: routed " << op->ToString();
+        MarkInFlightOpFailedUnlocked(op, Status::Aborted("Batch aborted"));
+      }
+    } else {
+      set<vector<InFlightOp*>*> touched;
+      for (InFlightOp* op : ops) {
+        std::lock_guard<simple_spinlock> l2(op->lock_);
+        CHECK_EQ(op->state, InFlightOp::kLookingUpTablet);
+        CHECK(op->tablet != NULL);
+        op->state = InFlightOp::kBufferedToTabletServer;
+
+        vector<InFlightOp*>& to_ts = per_tablet_ops_[op->tablet.get()];
+        to_ts.push_back(op);
+        touched.insert(&to_ts);
+      }
+      // The ops arrive in partition key order, so put each tablet's buffer
+      // back in the order the ops were added (see TabletLookupFinished()).
+      for (vector<InFlightOp*>* to_ts : touched) {
+        std::sort(to_ts->begin(), to_ts->end(), [](const InFlightOp* a, const InFlightOp* b) {
+            return a->sequence_number_ < b->sequence_number_;
+          });
+      }
+      return;
+    }
+  }
+  CheckForFinishedFlush();
+}
+
+void Batcher::OpsLookupFinished(OpsLookup* lookup, const Status& s) {
+  unique_ptr<OpsLookup> lookup_deleter(lookup);
+  vector<InFlightOp*>& ops = lookup->ops;
+  InFlightOp* first_op = ops[0];
+
+  bool aborted;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    aborted = IsAbortedUnlocked();
+    if (aborted) {
+      VLOG(1) << "Aborted batch: OpsLookupFinished for " << first_op->ToString();
+      for (InFlightOp* op : ops) {
+        MarkInFlightOpFailedUnlocked(op, Status::Aborted("Batch aborted"));
+      }
+    }
+  }
+
+  if (aborted) {
+    base::RefCountDec(&outstanding_lookups_);
+    return;
+  }
+
+  if (!s.ok()) {
+    VLOG(3) << "Lookup failed for " << first_op->ToString() << ": " << s.ToString();
+    // The failed lookup only tells us about the first op; the others may well
+    // belong to a different tablet, so fall back to looking each one up.
+    MarkInFlightOpFailed(first_op, s);
+    for (int i = 1; i < ops.size(); i++) {
+      InFlightOp* op = ops[i];
+      base::RefCountInc(&outstanding_lookups_);
+      client_->data_->meta_cache_->LookupTabletByKey(
+          op->write_op->table(),
+          op->partition_key,
+          deadline_,
+          &op->tablet,
+          Bind(&Batcher::TabletLookupFinished, this, op));
+    }
+    CheckForFinishedFlush();
+  } else {
+    first_op->tablet = lookup->tablet;
+    BufferRoutedOps({ first_op });
+    if (ops.size() > 1) {
+      RouteOps(vector<InFlightOp*>(ops.begin() + 1, ops.end()));
+    }
+  }
+
+  base::RefCountDec(&outstanding_lookups_);
+  FlushBuffersIfReady();
+}
+
 void Batcher::TabletLookupFinished(InFlightOp* op, const Status& s) {
   base::RefCountDec(&outstanding_lookups_);
 
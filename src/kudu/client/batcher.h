@@ -29,9 +29,20 @@
 #include "kudu/util/atomic.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
+
+namespace rpc {
+class RpcController;
+struct RetriableRpcStatus;
+} // namespace rpc
+
+namespace tserver {
+class WriteResponsePB;
+} // namespace tserver
+
 namespace client {
 
 class KuduClient;
@@ -42,9 +53,12 @@ class KuduWriteOperation;
 namespace internal {
 
 struct InFlightOp;
+struct OpsLookup;
 
 class ErrorCollector;
 class RemoteTablet;
+class RemoteTabletServer;
+struct ClientMetrics;
 class WriteRpc;
 
 // A Batcher is the class responsible for collecting row operations, routing them to the
@@ -161,8 +175,24 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // to the batcher.
   void ProcessWriteResponse(const WriteRpc& rpc, const Status& s);
 
+  // Routes the ops which were added since the last call to their tablets.
+  //
+  // The ops are sorted by partition key and resolved against the meta cache
+  // in a single pass per table. Runs of ops whose tablets aren't cached are
+  // looked up in the master, one lookup per run.
+  void RouteUnroutedOps();
+
+  // Routes 'ops', which all belong to the same table and are sorted by
+  // partition key. See RouteUnroutedOps().
+  void RouteOps(std::vector<InFlightOp*> ops);
+
+  // Buffers ops whose tablets have been determined into 'per_tablet_ops_',
+  // keeping each tablet's buffer in sequence order.
+  void BufferRoutedOps(const std::vector<InFlightOp*>& ops);
+
   // Async Callbacks.
   void TabletLookupFinished(InFlightOp* op, const Status& s);
+  void OpsLookupFinished(OpsLookup* lookup, const Status& s);
 
   // Compute a new deadline based on timeout_. If no timeout_ has been set,
   // uses a hard-coded default and issues periodic warnings.
@@ -202,6 +232,9 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
 
   // All buffered or in-flight ops.
   std::unordered_set<InFlightOp*> ops_;
+  // Ops which have been added but not yet routed to their tablets.
+  // Protected by lock_.
+  std::vector<InFlightOp*> unrouted_ops_;
   // Each tablet's buffered ops.
   typedef std::unordered_map<RemoteTablet*, std::vector<InFlightOp*> > OpsMap;
   OpsMap per_tablet_ops_;
@@ -232,6 +265,18 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   DISALLOW_COPY_AND_ASSIGN(Batcher);
 };
 
+// Decides whether and how a write RPC which completed with 'rpc_cb_status'
+// should be retried, given its controller and response.
+rpc::RetriableRpcStatus AnalyzeWriteResponse(const Status& rpc_cb_status,
+                                             const rpc::RpcController& controller,
+                                             const tserver::WriteResponsePB& resp);
+
+// Records in 'metrics' the round-trip time of a write RPC which was sent to
+// 'replica' at 'start_time' and just completed.
+void RecordWriteRpcLatency(ClientMetrics* metrics,
+                           const RemoteTabletServer& replica,
+                           const MonoTime& start_time);
+
 } // namespace internal
 } // namespace client
 } // namespace kudu
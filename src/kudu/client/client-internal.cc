@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/client/client_metrics.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
@@ -146,12 +147,16 @@ Status KuduClient::Data::SyncLeaderMasterRpc(
     vector<uint32_t> required_feature_flags) {
   DCHECK(deadline.Initialized());
 
+  // The backoff most recently suggested by the leader master, if any.
+  MonoDelta server_retry_after = MonoDelta::FromMilliseconds(0);
   for (int num_attempts = 0;; num_attempts++) {
     RpcController rpc;
 
     // Sleep if necessary.
     if (num_attempts > 0) {
-      SleepFor(ComputeExponentialBackoff(num_attempts));
+      MonoDelta backoff = ComputeExponentialBackoff(num_attempts);
+      SleepFor(server_retry_after > backoff ? server_retry_after : backoff);
+      server_retry_after = MonoDelta::FromMilliseconds(0);
     }
 
     // Have we already exceeded our deadline?
@@ -182,6 +187,7 @@ Status KuduClient::Data::SyncLeaderMasterRpc(
       if (err &&
           err->has_code() &&
           err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY) {
+        server_retry_after = rpc.server_retry_after();
         continue;
       }
     }
@@ -271,8 +277,22 @@ Status KuduClient::Data::SyncLeaderMasterRpc(
                                  RpcController*)>& func,
     vector<uint32_t> required_feature_flags);
 
+namespace {
+
+// The highest scan open latency which can be recorded precisely; higher
+// latencies are recorded as this value.
+const int64_t kMaxScanOpenLatencyUs = 60 * 1000 * 1000;
+
+// The number of scan open latencies to record before their percentiles are
+// used.
+const uint64_t kMinScanOpenLatencySamples = 20;
+
+} // anonymous namespace
+
 KuduClient::Data::Data()
-    : latest_observed_timestamp_(KuduClient::kNoTimestamp) {
+    : prefetch_table_locations_(false),
+      latest_observed_timestamp_(KuduClient::kNoTimestamp),
+      scan_open_latency_us_(kMaxScanOpenLatencyUs, 2) {
 }
 
 KuduClient::Data::~Data() {
@@ -327,9 +347,24 @@ RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTa
             break;
           }
         }
-        // Fallback to a random replica if none are local.
+        // Fall back to the replica with the lowest expected latency if none
+        // are local. Replicas without recent latency measurements are picked
+        // first, at random, so that every replica's latency stays known.
         if (ret == nullptr && !filtered.empty()) {
-          ret = filtered[rand() % filtered.size()];
+          vector<RemoteTabletServer*> unmeasured;
+          double best_latency_us = 0;
+          for (RemoteTabletServer* rts : filtered) {
+            double latency_us = rts->EstimatedLatencyUs();
+            if (latency_us < 0) {
+              unmeasured.push_back(rts);
+            } else if (ret == nullptr || latency_us < best_latency_us) {
+              ret = rts;
+              best_latency_us = latency_us;
+            }
+          }
+          if (!unmeasured.empty()) {
+            ret = unmeasured[rand() % unmeasured.size()];
+          }
         }
       }
       break;
@@ -343,13 +378,11 @@ RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTa
   return ret;
 }
 
-Status KuduClient::Data::GetTabletServer(KuduClient* client,
-                                         const scoped_refptr<RemoteTablet>& rt,
-                                         ReplicaSelection selection,
-                                         const set<string>& blacklist,
-                                         vector<RemoteTabletServer*>* candidates,
-                                         RemoteTabletServer** ts) {
-  // TODO: write a proper async version of this for async client.
+Status KuduClient::Data::PickTabletServer(const scoped_refptr<RemoteTablet>& rt,
+                                          ReplicaSelection selection,
+                                          const set<string>& blacklist,
+                                          vector<RemoteTabletServer*>* candidates,
+                                          RemoteTabletServer** ts) const {
   RemoteTabletServer* ret = SelectTServer(rt, selection, blacklist, candidates);
   if (PREDICT_FALSE(ret == nullptr)) {
     // Construct a blacklist string if applicable.
@@ -363,6 +396,18 @@ Status KuduClient::Data::GetTabletServer(KuduClient* client,
                    rt->tablet_id(),
                    blacklist_string));
   }
+  *ts = ret;
+  return Status::OK();
+}
+
+Status KuduClient::Data::GetTabletServer(KuduClient* client,
+                                         const scoped_refptr<RemoteTablet>& rt,
+                                         ReplicaSelection selection,
+                                         const set<string>& blacklist,
+                                         vector<RemoteTabletServer*>* candidates,
+                                         RemoteTabletServer** ts) {
+  RemoteTabletServer* ret;
+  RETURN_NOT_OK(PickTabletServer(rt, selection, blacklist, candidates, &ret));
   Synchronizer s;
   ret->InitProxy(client, s.AsStatusCallback());
   RETURN_NOT_OK(s.Wait());
@@ -701,5 +746,19 @@ void KuduClient::Data::UpdateLatestObservedTimestamp(uint64_t timestamp) {
   latest_observed_timestamp_.StoreMax(timestamp);
 }
 
+void KuduClient::Data::RecordScanOpenLatency(const MonoDelta& latency) {
+  scan_open_latency_us_.Increment(
+      std::min(std::max<int64_t>(latency.ToMicroseconds(), 0), kMaxScanOpenLatencyUs));
+}
+
+bool KuduClient::Data::GetScanOpenLatencyPercentile(double percentile,
+                                                    MonoDelta* latency) const {
+  if (scan_open_latency_us_.TotalCount() < kMinScanOpenLatencySamples) {
+    return false;
+  }
+  *latency = MonoDelta::FromMicroseconds(scan_open_latency_us_.ValueAtPercentile(percentile));
+  return true;
+}
+
 } // namespace client
 } // namespace kudu
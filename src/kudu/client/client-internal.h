@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -28,7 +29,9 @@
 
 #include "kudu/client/client.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/hdr_histogram.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 
@@ -52,6 +55,10 @@ class RpcController;
 
 namespace client {
 
+namespace internal {
+struct ClientMetrics;
+} // namespace internal
+
 class KuduClient::Data {
  public:
   Data();
@@ -72,6 +79,14 @@ class KuduClient::Data {
                          std::vector<internal::RemoteTabletServer*>* candidates,
                          internal::RemoteTabletServer** ts);
 
+  // Like GetTabletServer(), but doesn't initialize the proxy of the selected
+  // replica and therefore never blocks.
+  Status PickTabletServer(const scoped_refptr<internal::RemoteTablet>& rt,
+                          ReplicaSelection selection,
+                          const std::set<std::string>& blacklist,
+                          std::vector<internal::RemoteTabletServer*>* candidates,
+                          internal::RemoteTabletServer** ts) const;
+
   Status CreateTable(KuduClient* client,
                      const master::CreateTableRequestPB& req,
                      const KuduSchema& schema,
@@ -167,6 +182,14 @@ class KuduClient::Data {
 
   void UpdateLatestObservedTimestamp(uint64_t timestamp);
 
+  // Records the latency of a scan request which opened a tablet scan.
+  void RecordScanOpenLatency(const MonoDelta& latency);
+
+  // Sets 'latency' to the given percentile of the latencies recorded by
+  // RecordScanOpenLatency(). Returns false if too few latencies have been
+  // recorded for the percentile to be meaningful.
+  bool GetScanOpenLatencyPercentile(double percentile, MonoDelta* latency) const;
+
   // Retry 'func' until either:
   //
   // 1) Methods succeeds on a leader master.
@@ -216,6 +239,7 @@ class KuduClient::Data {
   std::vector<std::string> master_server_addrs_;
   MonoDelta default_admin_operation_timeout_;
   MonoDelta default_rpc_timeout_;
+  bool prefetch_table_locations_;
 
   // The host port of the leader master. This is set in
   // LeaderMasterDetermined, which is invoked as a callback by
@@ -240,6 +264,16 @@ class KuduClient::Data {
 
   AtomicInt<uint64_t> latest_observed_timestamp_;
 
+  // Latencies, in microseconds, of the requests which opened tablet scans.
+  // Used to pick the delay after which scan requests are hedged.
+  HdrHistogram scan_open_latency_us_;
+
+  // The client's metrics: latencies and retries of its operations, both in
+  // total and per tablet server. Exported by KuduClient::GetMetricsAsJson().
+  MetricRegistry metric_registry_;
+  scoped_refptr<MetricEntity> metric_entity_;
+  std::unique_ptr<internal::ClientMetrics> metrics_;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
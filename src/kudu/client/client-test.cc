@@ -20,6 +20,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <thread>
@@ -34,6 +35,7 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client-test-util.h"
+#include "kudu/client/client_metrics.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/row_result.h"
@@ -55,6 +57,7 @@
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/mini_tablet_server.h"
@@ -79,6 +82,7 @@ DECLARE_int32(log_inject_latency_ms_stddev);
 DECLARE_int32(master_inject_latency_on_tablet_lookups_ms);
 DECLARE_int32(max_create_tablets_per_ts);
 DECLARE_int32(raft_heartbeat_interval_ms);
+DECLARE_int32(scanner_batch_size_rows);
 DECLARE_int32(scanner_gc_check_interval_us);
 DECLARE_int32(scanner_inject_latency_on_each_batch_ms);
 DECLARE_int32(scanner_max_batch_size_bytes);
@@ -909,6 +913,88 @@ TEST_F(ClientTest, TestScanEmptyTable) {
   ASSERT_FALSE(scanner.HasMoreRows());
 }
 
+// Test scanning several tablets concurrently, with a buffer bound small
+// enough that the tablet scans are constantly blocked on the consumer.
+TEST_F(ClientTest, TestConcurrentTabletScan) {
+  static const int kTabletsNum = 8;
+  static const int kRowsPerTablet = 1000;
+
+  shared_ptr<KuduTable> table;
+  {
+    vector<unique_ptr<KuduPartialRow>> rows;
+    for (int i = 1; i < kTabletsNum; ++i) {
+      unique_ptr<KuduPartialRow> row(schema_.NewRow());
+      ASSERT_OK(row->SetInt32(0, i * kRowsPerTablet));
+      rows.emplace_back(std::move(row));
+    }
+    ASSERT_NO_FATAL_FAILURE(CreateTable("TestConcurrentTabletScan", 1,
+                                        std::move(rows), {}, &table));
+  }
+  NO_FATALS(InsertTestRows(table.get(), kTabletsNum * kRowsPerTablet));
+
+  // Scans the table with the given concurrency, optionally restricted to
+  // keys at or above 'lower_bound', and checks that every row is returned
+  // exactly once.
+  auto scan_and_check = [&](int num_tablets, int32_t lower_bound) {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetMaxConcurrentTablets(num_tablets));
+    ASSERT_OK(scanner.SetMaxBufferedBytes(1));
+    ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+    ASSERT_OK(scanner.SetProjectedColumns({ "key" }));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+        table->NewComparisonPredicate("key", KuduPredicate::GREATER_EQUAL,
+                                      KuduValue::FromInt(lower_bound))));
+    ASSERT_OK(scanner.Open());
+
+    set<int32_t> keys;
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      ASSERT_EQ(1, batch.projection_schema()->num_columns());
+      for (KuduScanBatch::RowPtr row : batch) {
+        int32_t key;
+        ASSERT_OK(row.GetInt32(0, &key));
+        ASSERT_GE(key, lower_bound);
+        ASSERT_TRUE(keys.insert(key).second) << "duplicate key " << key;
+      }
+    }
+    ASSERT_EQ(kTabletsNum * kRowsPerTablet - lower_bound, keys.size());
+
+    KuduTabletServer* ts;
+    ASSERT_TRUE(scanner.GetCurrentServer(&ts).IsNotSupported());
+  };
+  NO_FATALS(scan_and_check(4, 0));
+  NO_FATALS(scan_and_check(kTabletsNum * 2, 0));
+  NO_FATALS(scan_and_check(3, kRowsPerTablet * 5 / 2));
+
+  // Closing a scanner part-way through stops the tablet scans.
+  {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetMaxConcurrentTablets(4));
+    ASSERT_OK(scanner.SetMaxBufferedBytes(1));
+    ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+    ASSERT_OK(scanner.Open());
+    KuduScanBatch batch;
+    ASSERT_OK(scanner.NextBatch(&batch));
+    ASSERT_GT(batch.NumRows(), 0);
+    scanner.Close();
+  }
+
+  // Fault-tolerant scans must return rows in order, so they can't be mixed
+  // with concurrent tablet scans.
+  {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetFaultTolerant());
+    ASSERT_OK(scanner.SetMaxConcurrentTablets(4));
+    Status s = scanner.Open();
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+
+  KuduScanner scanner(table.get());
+  ASSERT_TRUE(scanner.SetMaxConcurrentTablets(0).IsInvalidArgument());
+  ASSERT_TRUE(scanner.SetMaxBufferedBytes(0).IsInvalidArgument());
+}
+
 // Test scanning with an empty projection. This should yield an empty
 // row block with the proper number of rows filled in. Impala issues
 // scans like this in order to implement COUNT(*).
@@ -932,6 +1018,61 @@ TEST_F(ClientTest, TestScanEmptyProjection) {
   }
 }
 
+// Test that a scanner which asks for read-ahead is served the batches that
+// the tablet server read ahead for it, and that no rows are lost or repeated.
+TEST_F(ClientTest, TestScanWithReadahead) {
+  const int kReadaheadBatches = 3;
+  shared_ptr<KuduTable> table;
+  ASSERT_NO_FATAL_FAILURE(CreateTable("TestScanWithReadahead", 1, {}, {}, &table));
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), FLAGS_test_scan_num_rows));
+
+  // Make each batch a single block of 10 rows.
+  FLAGS_scanner_batch_size_rows = 10;
+
+  KuduScanner scanner(table.get());
+  ASSERT_OK(scanner.SetBatchSizeBytes(1));
+  ASSERT_OK(scanner.SetReadaheadBatches(kReadaheadBatches));
+  ASSERT_OK(scanner.Open());
+
+  KuduScanBatch batch;
+  ASSERT_TRUE(scanner.HasMoreRows());
+  ASSERT_OK(scanner.NextBatch(&batch));
+  int count = batch.NumRows();
+
+  // Wait for the tablet server to read ahead of the next request.
+  AssertEventually([&]() {
+    size_t num_buffered = 0;
+    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+      vector<tserver::SharedScanner> scanners;
+      cluster_->mini_tablet_server(i)->server()->scanner_manager()->ListScanners(&scanners);
+      for (const auto& s : scanners) {
+        std::lock_guard<std::mutex> l(*s->scan_lock());
+        num_buffered += s->readahead_queue()->size();
+      }
+    }
+    ASSERT_EQ(kReadaheadBatches, num_buffered);
+  });
+
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    count += batch.NumRows();
+  }
+  ASSERT_EQ(FLAGS_test_scan_num_rows, count);
+
+  int64_t readahead_batches_returned = 0;
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    vector<scoped_refptr<TabletPeer>> peers;
+    cluster_->mini_tablet_server(i)->server()->tablet_manager()->GetTabletPeers(&peers);
+    for (const auto& peer : peers) {
+      if (peer->tablet_metadata()->table_name() == "TestScanWithReadahead") {
+        readahead_batches_returned +=
+            peer->tablet()->metrics()->scanner_readahead_batches_returned->value();
+      }
+    }
+  }
+  ASSERT_GE(readahead_batches_returned, kReadaheadBatches);
+}
+
 TEST_F(ClientTest, TestProjectInvalidColumn) {
   KuduScanner scanner(client_table_.get());
   Status s = scanner.SetProjectedColumns({ "column-doesnt-exist" });
@@ -1484,6 +1625,36 @@ TEST_F(ClientTest, TestMetaCacheExpiry) {
   ASSERT_FALSE(entry.stale());
 }
 
+TEST_F(ClientTest, TestPrefetchTabletLocations) {
+  // The locations are refreshed once 80% of their TTL has passed. Use a TTL
+  // long enough that the refresh completes well before they expire.
+  google::FlagSaver saver;
+  FLAGS_table_locations_ttl_ms = 5000;
+  auto& meta_cache = client_->data_->meta_cache_;
+
+  // Clear the cache.
+  meta_cache->ClearCache();
+  internal::MetaCacheEntry entry;
+  ASSERT_FALSE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
+
+  // Both tablets of the table are cached by a single prefetch.
+  ASSERT_OK(client_table_->PrefetchTabletLocations());
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
+  string split_key = entry.upper_bound_partition_key();
+  ASSERT_FALSE(split_key.empty());
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), split_key, &entry));
+  ASSERT_TRUE(entry.upper_bound_partition_key().empty());
+
+  // Lookups keep refreshing the locations ahead of their expiry, so they
+  // never go stale.
+  MonoTime deadline = MonoTime::Now() +
+      MonoDelta::FromMilliseconds(2 * FLAGS_table_locations_ttl_ms);
+  while (MonoTime::Now() < deadline) {
+    ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+}
+
 TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("blacklist",
@@ -1561,6 +1732,84 @@ TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   }
 }
 
+// Test that CLOSEST_REPLICA selection falls back to the replica with the
+// lowest measured latency when no replica is local.
+TEST_F(ClientTest, TestReplicaSelectionByLatency) {
+  const int kNumReplicas = 3;
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable("replicated", kNumReplicas, {}, {}, &table));
+  scoped_refptr<internal::RemoteTablet> rt = MetaCacheLookup(table.get(), "");
+  vector<internal::RemoteTabletServer*> servers;
+  rt->GetRemoteTabletServers(&servers);
+  ASSERT_EQ(kNumReplicas, servers.size());
+
+  // All of the mini cluster's servers are local, so pretend none are.
+  client_->data_->local_host_names_.clear();
+
+  set<string> blacklist;
+  vector<internal::RemoteTabletServer*> candidates;
+  internal::RemoteTabletServer* ts;
+
+  // A replica whose latency hasn't been measured is picked first.
+  servers[0]->RecordLatency(MonoDelta::FromMilliseconds(100), MonoDelta::FromMilliseconds(0));
+  servers[1]->RecordLatency(MonoDelta::FromMilliseconds(200), MonoDelta::FromMilliseconds(0));
+  ASSERT_OK(client_->data_->GetTabletServer(client_.get(), rt, KuduClient::CLOSEST_REPLICA,
+                                            blacklist, &candidates, &ts));
+  ASSERT_EQ(servers[2], ts);
+
+  // Otherwise, the replica with the lowest latency is picked, counting the
+  // time spent waiting in the server's queue.
+  servers[2]->RecordLatency(MonoDelta::FromMilliseconds(50), MonoDelta::FromMilliseconds(100));
+  ASSERT_OK(client_->data_->GetTabletServer(client_.get(), rt, KuduClient::CLOSEST_REPLICA,
+                                            blacklist, &candidates, &ts));
+  ASSERT_EQ(servers[0], ts);
+  blacklist.insert(servers[0]->permanent_uuid());
+  ASSERT_OK(client_->data_->GetTabletServer(client_.get(), rt, KuduClient::CLOSEST_REPLICA,
+                                            blacklist, &candidates, &ts));
+  ASSERT_EQ(servers[2], ts);
+
+  // Scans measure the latency of the replica they use.
+  CountRowsFromClient(table.get(), KuduClient::CLOSEST_REPLICA, kNoBound, kNoBound);
+  ASSERT_LT(servers[0]->EstimatedLatencyUs(), 100 * 1000);
+}
+
+// Test that the client keeps metrics of its writes, scans and master lookups,
+// and exports them as JSON.
+TEST_F(ClientTest, TestClientMetrics) {
+  NO_FATALS(InsertTestRows(client_table_.get(), 100));
+  ASSERT_EQ(100, CountRowsFromClient(client_table_.get()));
+
+  const internal::ClientMetrics& metrics = *client_->data_->metrics_;
+  ASSERT_GT(metrics.client_write_rpc_latency->TotalCount(), 0);
+  ASSERT_GT(metrics.client_scan_rpc_latency->TotalCount(), 0);
+  ASSERT_GT(metrics.client_master_lookup_latency->TotalCount(), 0);
+
+  // The latencies are also kept per tablet server.
+  scoped_refptr<internal::RemoteTablet> rt = MetaCacheLookup(client_table_.get(), "");
+  vector<internal::RemoteTabletServer*> servers;
+  rt->GetRemoteTabletServers(&servers);
+  ASSERT_EQ(1, servers.size());
+  const internal::TabletServerClientMetrics& ts_metrics = servers[0]->metrics();
+  ASSERT_GT(ts_metrics.client_tablet_server_write_rpc_latency->TotalCount(), 0);
+  ASSERT_GT(ts_metrics.client_tablet_server_scan_rpc_latency->TotalCount(), 0);
+
+  string json;
+  ASSERT_OK(client_->GetMetricsAsJson(&json));
+  ASSERT_STR_CONTAINS(json, client_->data_->client_id_);
+  ASSERT_STR_CONTAINS(json, servers[0]->permanent_uuid());
+  for (const char* name : { "client_write_rpc_latency",
+                            "client_scan_rpc_latency",
+                            "client_master_lookup_latency",
+                            "client_buffer_space_wait_time",
+                            "client_write_rpc_retries",
+                            "client_scan_rpc_retries",
+                            "client_master_lookup_retries",
+                            "client_tablet_server_write_rpc_latency",
+                            "client_tablet_server_scan_rpc_latency" }) {
+    ASSERT_STR_CONTAINS(json, name);
+  }
+}
+
 TEST_F(ClientTest, TestScanWithEncodedRangePredicate) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("split-table",
@@ -1672,6 +1921,152 @@ static void AssertScannersDisappear(const tserver::ScannerManager* manager) {
   FAIL() << "Waited too long for the scanner to close";
 }
 
+// Test that prefetching batches returns the same rows as a regular scan,
+// and that a scanner with prefetches in flight can be closed.
+TEST_F(ClientTest, TestScanPrefetch) {
+  const int kNumRows = 10000;
+  NO_FATALS(InsertTestRows(client_table_.get(), kNumRows));
+
+  for (int prefetch_batches : { 1, 4 }) {
+    SCOPED_TRACE(prefetch_batches);
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetchBatches(prefetch_batches));
+    ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+    ASSERT_OK(scanner.SetProjectedColumns({ "key", "int_val" }));
+    ASSERT_OK(scanner.Open());
+
+    set<int32_t> keys;
+    int num_batches = 0;
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      num_batches++;
+      // Give the prefetched batches a chance to arrive while we hold on to
+      // this one, to check they don't clobber it.
+      SleepFor(MonoDelta::FromMilliseconds(1));
+      for (KuduScanBatch::RowPtr row : batch) {
+        int32_t key;
+        int32_t val;
+        ASSERT_OK(row.GetInt32(0, &key));
+        ASSERT_OK(row.GetInt32(1, &val));
+        ASSERT_EQ(key * 2, val);
+        ASSERT_TRUE(keys.insert(key).second) << "duplicate key " << key;
+      }
+    }
+    ASSERT_EQ(kNumRows, keys.size());
+    ASSERT_GT(num_batches, prefetch_batches);
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetchBatches(4));
+    ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+    ASSERT_OK(scanner.Open());
+    KuduScanBatch batch;
+    ASSERT_OK(scanner.NextBatch(&batch));
+    ASSERT_OK(scanner.NextBatch(&batch));
+    scanner.Close();
+  }
+
+  // The server-side scanners were all closed.
+  NO_FATALS(AssertScannersDisappear(
+      cluster_->mini_tablet_server(0)->server()->scanner_manager()));
+}
+
+namespace {
+
+// Drives an asynchronous scan to completion from the callbacks of its calls,
+// counting the rows it returns.
+class AsyncScanDriver : public KuduStatusCallback {
+ public:
+  AsyncScanDriver(KuduScanner* scanner, CountDownLatch* done)
+      : scanner_(scanner),
+        done_(done),
+        num_rows_(0) {
+  }
+
+  void Start() {
+    scanner_->OpenAsync(this);
+  }
+
+  void Run(const Status& s) override {
+    if (!s.ok()) {
+      status_ = s;
+      done_->CountDown();
+      return;
+    }
+    num_rows_ += batch_.NumRows();
+    if (!scanner_->HasMoreRows()) {
+      done_->CountDown();
+      return;
+    }
+    scanner_->NextBatchAsync(&batch_, this);
+  }
+
+  const Status& status() const { return status_; }
+  int num_rows() const { return num_rows_; }
+
+ private:
+  KuduScanner* const scanner_;
+  CountDownLatch* const done_;
+  KuduScanBatch batch_;
+  Status status_;
+  int num_rows_;
+};
+
+} // anonymous namespace
+
+// Test that asynchronous scans return the same rows as synchronous ones, and
+// that many of them can be driven at once from a single thread.
+TEST_F(ClientTest, TestAsyncScan) {
+  const int kNumRows = 1000;
+  NO_FATALS(InsertTestRows(client_table_.get(), kNumRows));
+
+  // A scan of the whole table, over many batches.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+    CountDownLatch done(1);
+    AsyncScanDriver driver(&scanner, &done);
+    driver.Start();
+    done.Wait();
+    ASSERT_OK(driver.status());
+    ASSERT_EQ(kNumRows, driver.num_rows());
+  }
+
+  // Many concurrent point scans, all started from this thread.
+  {
+    vector<unique_ptr<KuduScanner>> scanners;
+    vector<unique_ptr<AsyncScanDriver>> drivers;
+    CountDownLatch done(kNumRows);
+    for (int i = 0; i < kNumRows; i++) {
+      scanners.emplace_back(new KuduScanner(client_table_.get()));
+      ASSERT_OK(scanners.back()->AddConjunctPredicate(
+          client_table_->NewComparisonPredicate("key", KuduPredicate::EQUAL,
+                                                KuduValue::FromInt(i))));
+      drivers.emplace_back(new AsyncScanDriver(scanners.back().get(), &done));
+    }
+    for (const auto& driver : drivers) {
+      driver->Start();
+    }
+    done.Wait();
+    for (const auto& driver : drivers) {
+      ASSERT_OK(driver->status());
+      ASSERT_EQ(1, driver->num_rows());
+    }
+  }
+
+  // Prefetching isn't supported.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetchBatches(1));
+    Synchronizer sync;
+    KuduStatusMemberCallback<Synchronizer> cb(&sync, &Synchronizer::StatusCB);
+    scanner.OpenAsync(&cb);
+    ASSERT_TRUE(sync.Wait().IsNotSupported());
+  }
+}
+
 namespace {
 
 int64_t SumResults(const KuduScanBatch& batch) {
@@ -2153,6 +2548,70 @@ TEST_F(ClientTest, TestBatchWithPartialError) {
             "int32 non_null_with_default=12345)", rows[1]);
 }
 
+// Test writing a columnar batch which spans both tablets of the table, is
+// split into several requests per tablet, and has one failing row.
+TEST_F(ClientTest, TestColumnarInsert) {
+  const int kNumRows = 1000;
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  ASSERT_OK(session->SetMutationBufferSpace(1024));
+
+  // Insert a row with key "5" ahead of the batch.
+  ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, 5, 5, "original row"));
+  FlushSessionOrDie(session);
+
+  // Lay the keys out in descending order so that rows of different tablets
+  // are interleaved with respect to partition key order, and leave every
+  // third string null.
+  vector<int32_t> keys(kNumRows);
+  vector<int32_t> int_vals(kNumRows);
+  vector<string> strings(kNumRows);
+  vector<Slice> string_vals(kNumRows);
+  vector<uint8_t> string_non_nulls((kNumRows + 7) / 8);
+  for (int i = 0; i < kNumRows; i++) {
+    keys[i] = kNumRows - 1 - i;
+    int_vals[i] = keys[i] * 2;
+    strings[i] = Substitute("hello $0", keys[i]);
+    string_vals[i] = strings[i];
+    if (keys[i] % 3 != 0) {
+      string_non_nulls[i / 8] |= 1 << (i % 8);
+    }
+  }
+
+  unique_ptr<KuduColumnarWriteBatch> batch(client_table_->NewColumnarInsert(kNumRows));
+  ASSERT_EQ(kNumRows, batch->num_rows());
+  Status s = session->ApplyColumnar(*batch);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Key not specified");
+
+  ASSERT_OK(batch->SetColumn("key", keys.data()));
+  ASSERT_OK(batch->SetColumn("int_val", int_vals.data()));
+  s = batch->SetColumn("int_val", int_vals.data(), string_non_nulls.data());
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  ASSERT_OK(batch->SetColumn("string_val", string_vals.data(), string_non_nulls.data()));
+  s = batch->SetColumn("no_such_column", int_vals.data());
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  s = session->ApplyColumnar(*batch);
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "Some errors occurred");
+
+  // The duplicate row is reported on its own.
+  gscoped_ptr<KuduError> error = GetSingleErrorFromSession(session.get());
+  ASSERT_TRUE(error->status().IsAlreadyPresent());
+  ASSERT_EQ(error->failed_op().ToString(),
+            R"(INSERT int32 key=5, int32 int_val=10, string string_val="hello 5")");
+
+  ASSERT_EQ(kNumRows, CountRowsFromClient(client_table_.get()));
+  vector<string> rows;
+  ScanTableToStrings(client_table_.get(), &rows);
+  std::sort(rows.begin(), rows.end());
+  ASSERT_EQ(R"((int32 key=0, int32 int_val=0, string string_val=NULL, )"
+            "int32 non_null_with_default=12345)", rows[0]);
+  ASSERT_EQ(R"((int32 key=1, int32 int_val=2, string string_val="hello 1", )"
+            "int32 non_null_with_default=12345)", rows[1]);
+}
+
 void ClientTest::DoTestWriteWithDeadServer(WhichServerToKill which) {
   shared_ptr<KuduSession> session = client_->NewSession();
   session->SetTimeoutMillis(1000);
@@ -2932,6 +3391,38 @@ TEST_F(ClientTest, TestMutationsWork) {
   ASSERT_EQ(0, rows.size());
 }
 
+// Test that the ops of a batch which spans both tablets, and which is added
+// out of partition key order, are routed to the right tablets and applied in
+// the order they were added, whether or not the tablets' locations are cached.
+TEST_F(ClientTest, TestBatchRoutingPreservesOrder) {
+  const int kNumRows = 20;
+  client_->data_->meta_cache_->ClearCache();
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  for (int round = 0; round < 2; round++) {
+    for (int key = kNumRows - 1; key >= 0; key--) {
+      if (round == 0) {
+        ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, key, key, "row"));
+      }
+      ASSERT_OK(ApplyUpdateToSession(session.get(), client_table_, key, key * 3 + round));
+      if (round == 1 && key % 2 == 0) {
+        ASSERT_OK(ApplyDeleteToSession(session.get(), client_table_, key));
+      }
+    }
+    FlushSessionOrDie(session);
+  }
+
+  vector<string> rows;
+  ScanTableToStrings(client_table_.get(), &rows);
+  ASSERT_EQ(kNumRows / 2, rows.size());
+  std::sort(rows.begin(), rows.end());
+  ASSERT_EQ(R"((int32 key=1, int32 int_val=4, string string_val="row", )"
+            "int32 non_null_with_default=12345)", rows[0]);
+  ASSERT_EQ(R"((int32 key=9, int32 int_val=28, string string_val="row", )"
+            "int32 non_null_with_default=12345)", rows.back());
+}
+
 TEST_F(ClientTest, TestMutateDeletedRow) {
   vector<string> rows;
   shared_ptr<KuduSession> session = client_->NewSession();
@@ -3339,6 +3830,43 @@ TEST_F(ClientTest, TestReplicatedMultiTabletTable) {
   // and ensure that the client handles refreshing the leader.
 }
 
+// Test that hedged snapshot scans return the same rows as regular scans, and
+// that the scanners opened by the requests which lose the race are closed.
+TEST_F(ClientTest, TestHedgedScans) {
+  const string kReplicatedTable = "replicated";
+  const int kNumRows = 100;
+  const int kNumReplicas = 3;
+  const int kNumScans = 50;
+
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable(kReplicatedTable, kNumReplicas, {}, {}, &table));
+  NO_FATALS(InsertTestRows(table.get(), kNumRows));
+
+  {
+    KuduScanner scanner(table.get());
+    ASSERT_TRUE(scanner.SetHedgingPercentile(0).IsInvalidArgument());
+    ASSERT_TRUE(scanner.SetHedgingPercentile(101).IsInvalidArgument());
+  }
+
+  // The first scans record the latencies from which the hedging delay is
+  // computed. With such a low percentile, most of the later scans are hedged.
+  for (int i = 0; i < kNumScans; i++) {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+    ASSERT_OK(scanner.SetHedgingPercentile(1));
+    // Keep the server-side scanners open after the first response.
+    ASSERT_OK(scanner.SetBatchSizeBytes(1));
+    vector<string> rows;
+    NO_FATALS(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(kNumRows, rows.size());
+  }
+
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    NO_FATALS(AssertScannersDisappear(
+        cluster_->mini_tablet_server(i)->server()->scanner_manager()));
+  }
+}
+
 TEST_F(ClientTest, TestReplicatedMultiTabletTableFailover) {
   const string kReplicatedTable = "replicated_failover_on_reads";
   const int kNumRowsToWrite = 100;
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <memory>
 #include <set>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -32,6 +33,8 @@
 #include "kudu/client/callbacks.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client_builder-internal.h"
+#include "kudu/client/client_metrics.h"
+#include "kudu/client/columnar_write-internal.h"
 #include "kudu/client/error-internal.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/meta_cache.h"
@@ -61,7 +64,9 @@
 #include "kudu/rpc/request_tracker.h"
 #include "kudu/rpc/sasl_common.h"
 #include "kudu/util/init.h"
+#include "kudu/util/jsonwriter.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -113,6 +118,8 @@ MAKE_ENUM_LIMITS(kudu::client::KuduScanner::OrderMode,
                  kudu::client::KuduScanner::UNORDERED,
                  kudu::client::KuduScanner::ORDERED);
 
+METRIC_DECLARE_entity(client);
+
 namespace kudu {
 namespace client {
 
@@ -228,6 +235,11 @@ KuduClientBuilder& KuduClientBuilder::default_rpc_timeout(const MonoDelta& timeo
   return *this;
 }
 
+KuduClientBuilder& KuduClientBuilder::prefetch_table_locations(bool prefetch) {
+  data_->prefetch_table_locations_ = prefetch;
+  return *this;
+}
+
 Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
   RETURN_NOT_OK(CheckCPUFlags());
 
@@ -240,6 +252,7 @@ Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
   c->data_->master_server_addrs_ = data_->master_server_addrs_;
   c->data_->default_admin_operation_timeout_ = data_->default_admin_operation_timeout_;
   c->data_->default_rpc_timeout_ = data_->default_rpc_timeout_;
+  c->data_->prefetch_table_locations_ = data_->prefetch_table_locations_;
 
   // Let's allow for plenty of time for discovering the master the first
   // time around.
@@ -264,6 +277,9 @@ KuduClient::KuduClient()
   : data_(new KuduClient::Data()) {
   static ObjectIdGenerator oid_generator;
   data_->client_id_ = oid_generator.Next();
+  data_->metric_entity_ = METRIC_ENTITY_client.Instantiate(&data_->metric_registry_,
+                                                           data_->client_id_);
+  data_->metrics_.reset(new internal::ClientMetrics(data_->metric_entity_));
 }
 
 KuduClient::~KuduClient() {
@@ -397,6 +413,13 @@ Status KuduClient::OpenTable(const string& table_name,
   table->reset(new KuduTable(shared_from_this(),
                              table_name, table_id, num_replicas,
                              schema, partition_schema));
+
+  if (data_->prefetch_table_locations_) {
+    // The locations are only an optimization: the table's operations look up
+    // any which are missing.
+    WARN_NOT_OK((*table)->PrefetchTabletLocations(),
+                Substitute("Unable to prefetch tablet locations of table $0", table_name));
+  }
   return Status::OK();
 }
 
@@ -483,6 +506,16 @@ void KuduClient::SetLatestObservedTimestamp(uint64_t ht_timestamp) {
   data_->UpdateLatestObservedTimestamp(ht_timestamp);
 }
 
+Status KuduClient::GetMetricsAsJson(string* json) const {
+  std::ostringstream out;
+  JsonWriter writer(&out, JsonWriter::PRETTY);
+  MetricJsonOptions opts;
+  opts.include_raw_histograms = true;
+  RETURN_NOT_OK(data_->metric_registry_.WriteAsJson(&writer, { "*" }, opts));
+  *json = out.str();
+  return Status::OK();
+}
+
 ////////////////////////////////////////////////////////////
 // KuduTableCreator
 ////////////////////////////////////////////////////////////
@@ -702,6 +735,14 @@ KuduDelete* KuduTable::NewDelete() {
   return new KuduDelete(shared_from_this());
 }
 
+KuduColumnarWriteBatch* KuduTable::NewColumnarInsert(int num_rows) {
+  return new KuduColumnarWriteBatch(shared_from_this(), KuduWriteOperation::INSERT, num_rows);
+}
+
+KuduColumnarWriteBatch* KuduTable::NewColumnarUpsert(int num_rows) {
+  return new KuduColumnarWriteBatch(shared_from_this(), KuduWriteOperation::UPSERT, num_rows);
+}
+
 KuduClient* KuduTable::client() const {
   return data_->client_.get();
 }
@@ -710,6 +751,16 @@ const PartitionSchema& KuduTable::partition_schema() const {
   return data_->partition_schema_;
 }
 
+Status KuduTable::PrefetchTabletLocations() {
+  KuduClient* client = data_->client_.get();
+  Synchronizer sync;
+  client->data_->meta_cache_->PrefetchTableLocations(
+      this,
+      MonoTime::Now() + client->default_admin_operation_timeout(),
+      sync.AsStatusCallback());
+  return sync.Wait();
+}
+
 KuduPredicate* KuduTable::NewComparisonPredicate(const Slice& col_name,
                                                  KuduPredicate::ComparisonOp op,
                                                  KuduValue* value) {
@@ -858,6 +909,18 @@ Status KuduSession::Apply(KuduWriteOperation* write_op) {
   return Status::OK();
 }
 
+Status KuduSession::ApplyColumnar(const KuduColumnarWriteBatch& batch) {
+  // Thread-safety note: as with Apply(), this method should not be called
+  // concurrently with other methods which modify the KuduSession::Data members.
+  MonoDelta timeout = data_->timeout_.Initialized() ?
+      data_->timeout_ : data_->client_->default_rpc_timeout();
+  return batch.data_->Write(data_->client_.get(),
+                            data_->external_consistency_mode_,
+                            timeout,
+                            data_->buffer_bytes_limit_,
+                            data_->error_collector_.get());
+}
+
 int KuduSession::CountBufferedOperations() const {
   return data_->CountBufferedOperations();
 }
@@ -1063,6 +1126,41 @@ Status KuduScanner::SetBatchSizeBytes(uint32_t batch_size) {
   return data_->mutable_configuration()->SetBatchSizeBytes(batch_size);
 }
 
+Status KuduScanner::SetReadaheadBatches(uint32_t num_batches) {
+  if (data_->open_) {
+    return Status::IllegalState("Read-ahead must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetReadaheadBatches(num_batches);
+}
+
+Status KuduScanner::SetPrefetchBatches(uint32_t num_batches) {
+  if (data_->open_) {
+    return Status::IllegalState("Prefetching must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetPrefetchBatches(num_batches);
+}
+
+Status KuduScanner::SetMaxConcurrentTablets(int num_tablets) {
+  if (data_->open_) {
+    return Status::IllegalState("Concurrent tablets must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetMaxConcurrentTablets(num_tablets);
+}
+
+Status KuduScanner::SetMaxBufferedBytes(int64_t max_bytes) {
+  if (data_->open_) {
+    return Status::IllegalState("Maximum buffered bytes must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetMaxBufferedBytes(max_bytes);
+}
+
+Status KuduScanner::SetHedgingPercentile(double percentile) {
+  if (data_->open_) {
+    return Status::IllegalState("Hedging must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetHedgingPercentile(percentile);
+}
+
 Status KuduScanner::SetReadMode(ReadMode read_mode) {
   if (data_->open_) {
     return Status::IllegalState("Read mode must be set before Open()");
@@ -1201,21 +1299,27 @@ string KuduScanner::ToString() const {
 Status KuduScanner::Open() {
   CHECK(!data_->open_) << "Scanner already open";
 
-  data_->mutable_configuration()->OptimizeScanSpec();
-  data_->partition_pruner_.Init(*data_->table_->schema().schema_,
-                                data_->table_->partition_schema(),
-                                data_->configuration().spec());
-
-  if (data_->configuration().spec().CanShortCircuit() ||
-      !data_->partition_pruner_.HasMorePartitionKeyRanges()) {
-    VLOG(2) << "Short circuiting scan " << data_->DebugString();
-    data_->open_ = true;
-    data_->short_circuit_ = true;
+  if (data_->InitScan()) {
     return Status::OK();
   }
 
   VLOG(2) << "Beginning " << data_->DebugString();
 
+  if (data_->configuration().max_concurrent_tablets() > 1) {
+    if (data_->configuration().is_fault_tolerant()) {
+      return Status::InvalidArgument(
+          "fault-tolerant scans cannot scan tablets concurrently");
+    }
+    unique_ptr<internal::ParallelTabletScan> parallel_scan(
+        new internal::ParallelTabletScan(data_->table_,
+                                         data_->mutable_configuration(),
+                                         &data_->resource_metrics_));
+    RETURN_NOT_OK(parallel_scan->Start());
+    data_->parallel_scan_ = std::move(parallel_scan);
+    data_->open_ = true;
+    return Status::OK();
+  }
+
   MonoTime deadline = MonoTime::Now() + data_->configuration().timeout();
   set<string> blacklist;
 
@@ -1225,6 +1329,26 @@ Status KuduScanner::Open() {
   return Status::OK();
 }
 
+void KuduScanner::OpenAsync(KuduStatusCallback* cb) {
+  CHECK(!data_->open_) << "Scanner already open";
+
+  if (data_->configuration().max_concurrent_tablets() > 1 ||
+      data_->configuration().prefetch_batches() > 0) {
+    cb->Run(Status::NotSupported(
+        "asynchronous scans cannot scan tablets concurrently or prefetch batches"));
+    return;
+  }
+  if (data_->InitScan()) {
+    cb->Run(Status::OK());
+    return;
+  }
+
+  VLOG(2) << "Beginning " << data_->DebugString();
+
+  data_->StartAsyncCall(nullptr, cb);
+  data_->OpenTabletAsync(data_->partition_pruner_.NextPartitionKey());
+}
+
 Status KuduScanner::KeepAlive() {
   return data_->KeepAlive();
 }
@@ -1234,6 +1358,12 @@ void KuduScanner::Close() {
 
   VLOG(2) << "Ending " << data_->DebugString();
 
+  // Stop the tablet scans, if any; each closes its own server-side scanner.
+  data_->parallel_scan_.reset();
+
+  // The close request must follow any prefetch requests in sequence.
+  data_->DiscardPrefetchedCalls();
+
   // Close the scanner on the server-side, if necessary.
   //
   // If the scan did not match any rows, the tserver will not assign a scanner ID.
@@ -1255,8 +1385,31 @@ void KuduScanner::Close() {
   return;
 }
 
+void KuduScanner::NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb) {
+  CHECK(data_->open_);
+
+  batch->data_->Clear();
+
+  if (data_->short_circuit_) {
+    cb->Run(Status::OK());
+    return;
+  }
+  if (data_->parallel_scan_ || data_->configuration().prefetch_batches() > 0) {
+    cb->Run(Status::NotSupported(
+        "asynchronous scans cannot scan tablets concurrently or prefetch batches"));
+    return;
+  }
+  CHECK(data_->proxy_);
+
+  data_->StartAsyncCall(batch, cb);
+  data_->NextBatchAsync();
+}
+
 bool KuduScanner::HasMoreRows() const {
   CHECK(data_->open_);
+  if (data_->parallel_scan_) {
+    return data_->parallel_scan_->HasMoreBatches();
+  }
   return !data_->short_circuit_ &&                 // The scan is not short circuited
       (data_->data_in_open_ ||                     // more data in hand
        data_->last_response_.has_more_results() || // more data in this tablet
@@ -1270,12 +1423,7 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
-  // TODO: do some double-buffering here -- when we return this batch
-  // we should already have fired off the RPC for the next batch, but
-  // need to do some swapping of the response objects around to avoid
-  // stomping on the memory the user is looking at.
   CHECK(data_->open_);
-  CHECK(data_->proxy_);
 
   batch->data_->Clear();
 
@@ -1283,10 +1431,16 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     return Status::OK();
   }
 
+  if (data_->parallel_scan_) {
+    return data_->parallel_scan_->NextBatch(batch);
+  }
+  CHECK(data_->proxy_);
+
   if (data_->data_in_open_) {
     // We have data from a previous scan.
     VLOG(2) << "Extracting data from " << data_->DebugString();
     data_->data_in_open_ = false;
+    data_->MaybePrefetch();
     return batch->data_->Reset(&data_->controller_,
                                data_->configuration().projection(),
                                data_->configuration().client_projection(),
@@ -1296,11 +1450,19 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     VLOG(2) << "Continuing " << data_->DebugString();
 
     MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
-    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+
+    // If the batch has been prefetched, its response is the first to handle.
+    // Should that have failed, we fall back to resending the same request.
+    unique_ptr<KuduScanner::Data::PrefetchedCall> prefetched = data_->TakePrefetchedCall();
+    if (!prefetched) {
+      data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+    }
 
     while (true) {
       bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
-      ScanRpcStatus result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
+      ScanRpcStatus result = prefetched ?
+          data_->FinishPrefetchedCall(std::move(prefetched)) :
+          data_->SendScanRpc(batch_deadline, allow_time_for_failover);
 
       // Success case.
       if (result.result == ScanRpcStatus::OK) {
@@ -1308,6 +1470,7 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
           data_->last_primary_key_ = data_->last_response_.last_primary_key();
         }
         data_->scan_attempts_ = 0;
+        data_->MaybePrefetch();
         return batch->data_->Reset(&data_->controller_,
                                    data_->configuration().projection(),
                                    data_->configuration().client_projection(),
@@ -1359,6 +1522,9 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
 
 Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
   CHECK(data_->open_);
+  if (data_->parallel_scan_) {
+    return Status::NotSupported("scanner is scanning several tablets concurrently");
+  }
   internal::RemoteTabletServer* rts = data_->ts_;
   CHECK(rts);
   vector<HostPort> host_ports;
@@ -1459,6 +1625,11 @@ Status KuduScanTokenBuilder::SetTimeoutMillis(int millis) {
   return Status::OK();
 }
 
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->set_split_size_bytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::AddConjunctPredicate(KuduPredicate* pred) {
   return data_->mutable_configuration()->AddConjunctPredicate(pred);
 }
@@ -73,6 +73,7 @@ class ErrorCollector;
 class GetTableSchemaRpc;
 class LookupRpc;
 class MetaCache;
+class ParallelTabletScan;
 class RemoteTablet;
 class RemoteTabletServer;
 class WriteRpc;
@@ -199,6 +200,18 @@ class KUDU_EXPORT KuduClientBuilder {
   /// @return Reference to the updated object.
   KuduClientBuilder& default_rpc_timeout(const MonoDelta& timeout);
 
+  /// Set whether KuduClient::OpenTable() prefetches the locations of all of
+  /// the table's tablets.
+  ///
+  /// See KuduTable::PrefetchTabletLocations() for details. If not provided,
+  /// defaults to @c false: tablet locations are looked up lazily, when
+  /// an operation first needs them.
+  ///
+  /// @param [in] prefetch
+  ///   Whether to prefetch tablet locations when opening tables.
+  /// @return Reference to the updated object.
+  KuduClientBuilder& prefetch_table_locations(bool prefetch);
+
   /// Create a client object.
   ///
   /// @note KuduClients objects are shared amongst multiple threads and,
@@ -375,8 +388,9 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   enum ReplicaSelection {
     LEADER_ONLY,      ///< Select the LEADER replica.
 
-    CLOSEST_REPLICA,  ///< Select the closest replica to the client,
-                      ///< or a random one if all replicas are equidistant.
+    CLOSEST_REPLICA,  ///< Select the closest replica to the client. If no
+                      ///< replica is local, select the one with the lowest
+                      ///< latency recently measured by the client.
 
     FIRST_REPLICA     ///< Select the first replica in the list.
   };
@@ -452,6 +466,25 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   ///   Timestamp encoded in HybridTime format.
   void SetLatestObservedTimestamp(uint64_t ht_timestamp);
 
+  /// Export the client's metrics as JSON.
+  ///
+  /// The client keeps latency histograms of the write RPCs, scan RPCs and
+  /// master lookups it sends, both in total and per tablet server, along
+  /// with counts of the retries of these operations and a histogram of the
+  /// time sessions spent waiting for mutation buffer space. The metrics are
+  /// written in the same format as a Kudu server's /metrics web page: an
+  /// array with a 'client' entity for the totals and a
+  /// 'client_tablet_server' entity for each tablet server the client has
+  /// talked to, whose id is the server's UUID.
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [out] json
+  ///   The JSON representation of the metrics.
+  /// @return Operation status.
+  Status GetMetricsAsJson(std::string* json) const WARN_UNUSED_RESULT;
+
  private:
   class KUDU_NO_EXPORT Data;
 
@@ -459,11 +492,13 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   friend class internal::GetTableSchemaRpc;
   friend class internal::LookupRpc;
   friend class internal::MetaCache;
+  friend class internal::ParallelTabletScan;
   friend class internal::RemoteTablet;
   friend class internal::RemoteTabletServer;
   friend class internal::WriteRpc;
   friend class ClientTest;
   friend class KuduClientBuilder;
+  friend class KuduColumnarWriteBatch;
   friend class KuduScanner;
   friend class KuduScanToken;
   friend class KuduScanTokenBuilder;
@@ -473,11 +508,14 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   friend class KuduTableCreator;
 
   FRIEND_TEST(kudu::ClientStressTest, TestUniqueClientIds);
+  FRIEND_TEST(ClientTest, TestClientMetrics);
   FRIEND_TEST(ClientTest, TestGetTabletServerBlacklist);
   FRIEND_TEST(ClientTest, TestMasterDown);
   FRIEND_TEST(ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(ClientTest, TestMetaCacheExpiry);
   FRIEND_TEST(ClientTest, TestNonCoveringRangePartitions);
+  FRIEND_TEST(ClientTest, TestPrefetchTabletLocations);
+  FRIEND_TEST(ClientTest, TestReplicaSelectionByLatency);
   FRIEND_TEST(ClientTest, TestReplicatedTabletWritesWithLeaderElection);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
   FRIEND_TEST(ClientTest, TestScanTimeout);
@@ -841,6 +879,18 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   ///   KuduSession::Apply().
   KuduDelete* NewDelete();
 
+  /// @param [in] num_rows
+  ///   Number of rows in the batch.
+  /// @return New columnar batch of @c INSERT operations for this table. It is
+  ///   the caller's responsibility to free the result.
+  KuduColumnarWriteBatch* NewColumnarInsert(int num_rows);
+
+  /// @param [in] num_rows
+  ///   Number of rows in the batch.
+  /// @return New columnar batch of @c UPSERT operations for this table. It is
+  ///   the caller's responsibility to free the result.
+  KuduColumnarWriteBatch* NewColumnarUpsert(int num_rows);
+
   /// Create a new comparison predicate.
   ///
   /// This method creates new instance of a comparison predicate which
@@ -925,6 +975,19 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   /// @return The partition schema for the table.
   const PartitionSchema& partition_schema() const;
 
+  /// Fetch and cache the locations of all of the table's tablets.
+  ///
+  /// The locations are fetched from the master in a few large requests,
+  /// rather than one request per range of tablets as the table's operations
+  /// first need them. This avoids a burst of lookups to the master when a
+  /// new client starts writing to many tablets at once.
+  ///
+  /// Once prefetched, the locations are refreshed in the background before
+  /// they expire, as operations on the table keep using them.
+  ///
+  /// @return Operation status.
+  Status PrefetchTabletLocations() WARN_UNUSED_RESULT;
+
  private:
   class KUDU_NO_EXPORT Data;
 
@@ -1149,6 +1212,7 @@ class KUDU_EXPORT KuduError {
 
   friend class internal::Batcher;
   friend class internal::ErrorCollector;
+  friend class KuduColumnarWriteBatch;
   friend class KuduSession;
 
   KuduError(KuduWriteOperation* failed_op, const Status& error);
@@ -1460,6 +1524,29 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   /// @return Operation result status.
   Status Apply(KuduWriteOperation* write_op) WARN_UNUSED_RESULT;
 
+  /// Write a columnar batch of rows.
+  ///
+  /// The rows of the batch are routed to their tablets and written
+  /// synchronously, regardless of the flush mode: each tablet's rows are
+  /// encoded straight from the batch's column arrays and sent in as few
+  /// write requests as the session's mutation buffer size allows. The batch
+  /// bypasses the session's mutation buffers, so it is not ordered with
+  /// respect to operations which are still buffered; call Flush() first if
+  /// that matters.
+  ///
+  /// In case of any error, a KuduError is stored in the session's error
+  /// collector for each row which failed to be written. The failed
+  /// operation of such an error is a single-row KuduInsert or KuduUpsert
+  /// holding a copy of the row.
+  ///
+  /// @param [in] batch
+  ///   The batch to write. The caller retains ownership of the batch, and
+  ///   may free it and its column arrays once this method returns.
+  /// @return Operation result status. In particular, returns a non-OK status
+  ///   if any of the rows failed to be written. Callers should then use
+  ///   GetPendingErrors to determine which specific rows failed.
+  Status ApplyColumnar(const KuduColumnarWriteBatch& batch) WARN_UNUSED_RESULT;
+
   /// Flush any pending writes.
   ///
   /// This method initiates flushing of the current batch of buffered
@@ -1811,6 +1898,25 @@ class KUDU_EXPORT KuduScanner {
   /// @return Result status of the operation (begin scanning).
   Status Open();
 
+  /// Begin scanning, asynchronously.
+  ///
+  /// This is the asynchronous counterpart of Open(): no call made on behalf
+  /// of the scanner blocks the calling thread, so that a single thread may
+  /// drive many scans. The result is reported to the callback, which may be
+  /// invoked either from an IO thread or the thread which calls OpenAsync().
+  /// The callback should not block.
+  ///
+  /// Asynchronous scans can't be combined with SetMaxConcurrentTablets()
+  /// or SetPrefetchBatches(), and don't hedge requests. Only one
+  /// asynchronous call may be in progress at a time, and the scanner must
+  /// not be used otherwise, closed or destroyed until its callback has
+  /// been invoked.
+  ///
+  /// @param [in] cb
+  ///   Callback to call once the scanner is open. The @c cb must remain
+  ///   valid until it is invoked.
+  void OpenAsync(KuduStatusCallback* cb);
+
   /// Keep the current remote scanner alive.
   ///
   /// Keep the current remote scanner alive on the Tablet server
@@ -1872,6 +1978,22 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status NextBatch(KuduScanBatch* batch);
 
+  /// Fetch the next batch of results for this scanner, asynchronously.
+  ///
+  /// This is the asynchronous counterpart of NextBatch(KuduScanBatch*),
+  /// and is subject to the same restrictions as OpenAsync(). The scanner
+  /// may have been opened with either Open() or OpenAsync(). As with
+  /// NextBatch(), the batch may be empty even though HasMoreRows() returns
+  /// @c true afterwards.
+  ///
+  /// @param [out] batch
+  ///   Placeholder for the result. It must remain valid, and must not be
+  ///   accessed, until the callback is invoked.
+  /// @param [in] cb
+  ///   Callback to call once the batch is available. The @c cb must remain
+  ///   valid until it is invoked.
+  void NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb);
+
   /// Get the KuduTabletServer that is currently handling the scan.
   ///
   /// More concretely, this is the server that handled the most recent
@@ -1893,6 +2015,85 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  /// Allow the tablet server to read ahead of this scanner.
+  ///
+  /// After responding to a scan request, the tablet server keeps scanning and
+  /// buffers up to the given number of further batches, so that subsequent
+  /// calls to NextBatch() are not held up by the server's scan work. This
+  /// helps scans over high-latency links, at the cost of server-side memory
+  /// for the buffered batches. The server may use a smaller value than the
+  /// one requested. By default, no read-ahead is done.
+  ///
+  /// @param [in] num_batches
+  ///   The maximum number of batches the server may buffer for this scanner.
+  /// @return Operation result status.
+  Status SetReadaheadBatches(uint32_t num_batches);
+
+  /// Fetch batches in the background while the caller processes earlier ones.
+  ///
+  /// When NextBatch() returns a batch, the scanner immediately requests the
+  /// following one from the tablet server, so that the caller's processing
+  /// overlaps with the server's scanning and the network round trip.
+  /// Up to the given number of batches are requested ahead of the caller;
+  /// each one holds its row data in client memory until it is returned.
+  /// By default, no batches are prefetched.
+  ///
+  /// @param [in] num_batches
+  ///   The maximum number of batches to fetch ahead of NextBatch().
+  /// @return Operation result status.
+  Status SetPrefetchBatches(uint32_t num_batches);
+
+  /// Scan several tablets concurrently.
+  ///
+  /// By default, a scanner scans the tablets of the table one after another.
+  /// If this method is called with a value greater than 1, the scanner keeps
+  /// up to the given number of tablet scans in flight on background threads
+  /// and returns their batches from NextBatch() in the order they arrive.
+  /// Rows from different tablets are therefore interleaved arbitrarily.
+  ///
+  /// Concurrent tablet scans can't be combined with SetFaultTolerant().
+  /// In @c READ_AT_SNAPSHOT mode without an explicit snapshot timestamp,
+  /// all tablets are scanned at the timestamp chosen by the first tablet
+  /// server contacted during Open(). In this mode, GetCurrentServer() is not
+  /// supported, and Close() waits for in-flight tablet scan requests.
+  ///
+  /// @param [in] num_tablets
+  ///   The maximum number of tablets to scan at the same time. Must be
+  ///   greater than 0.
+  /// @return Operation result status.
+  Status SetMaxConcurrentTablets(int num_tablets) WARN_UNUSED_RESULT;
+
+  /// Bound the memory used by batches buffered during concurrent scans.
+  ///
+  /// When scanning several tablets concurrently, the background scans stop
+  /// fetching new batches once the batches not yet returned by NextBatch()
+  /// hold at least this many bytes of row data. Has no effect unless
+  /// SetMaxConcurrentTablets() was called. The default is 64MB.
+  ///
+  /// @param [in] max_bytes
+  ///   The maximum number of bytes to buffer. Must be greater than 0.
+  /// @return Operation result status.
+  Status SetMaxBufferedBytes(int64_t max_bytes) WARN_UNUSED_RESULT;
+
+  /// Hedge the request opening each tablet scan against a slow replica.
+  ///
+  /// If a tablet server has not responded to the first request for a tablet
+  /// within the given percentile of the latencies of such requests made
+  /// earlier by this client, the request is also sent to another replica of
+  /// the tablet, and the scan continues on whichever replica responds first.
+  /// The scanner opened by the other replica, if any, is closed.
+  ///
+  /// Hedging only applies in @c READ_AT_SNAPSHOT mode, where either replica
+  /// returns the rows of a consistent snapshot, and only once the client has
+  /// recorded enough latencies to estimate the percentile. By default,
+  /// requests are not hedged.
+  ///
+  /// @param [in] percentile
+  ///   The latency percentile after which to hedge. Must be greater than 0
+  ///   and at most 100.
+  /// @return Operation result status.
+  Status SetHedgingPercentile(double percentile) WARN_UNUSED_RESULT;
+
   /// Set the replica selection policy while scanning.
   ///
   /// @param [in] selection
@@ -1974,6 +2175,7 @@ class KUDU_EXPORT KuduScanner {
   class KUDU_NO_EXPORT Data;
 
   friend class KuduScanToken;
+  friend class internal::ParallelTabletScan;
   FRIEND_TEST(ClientTest, TestScanCloseProxy);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
   FRIEND_TEST(ClientTest, TestScanNoBlockCaching);
@@ -2147,6 +2349,22 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Split large tablets into several scan tokens.
+  ///
+  /// By default, at most one token is built per tablet. With this option
+  /// set, the tablet servers are asked for approximate primary keys which
+  /// divide each tablet into key ranges of about @c split_size_bytes of
+  /// on-disk data, and one token is built per range. This reduces the time
+  /// spent waiting on the largest tablets when the tokens are scanned in
+  /// parallel. If a tablet server cannot compute split keys, the tablet is
+  /// covered by a single token.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The targeted amount of on-disk data per token, in bytes. If set to 0
+  ///   (the default), tablets are not split.
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -34,6 +34,7 @@ class KuduClientBuilder::Data {
   std::vector<std::string> master_server_addrs_;
   MonoDelta default_admin_operation_timeout_;
   MonoDelta default_rpc_timeout_;
+  bool prefetch_table_locations_;
 
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/client_metrics.h"
+
+#include "kudu/util/metrics.h"
+
+METRIC_DEFINE_entity(client);
+METRIC_DEFINE_entity(client_tablet_server);
+
+METRIC_DEFINE_histogram(client, client_write_rpc_latency,
+                        "Write RPC Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Round-trip time of the write RPCs sent by the client to "
+                        "tablet servers, including RPCs which failed after reaching "
+                        "the server or timing out",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(client, client_scan_rpc_latency,
+                        "Scan RPC Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Round-trip time of the scan RPCs sent by the client to "
+                        "tablet servers, including RPCs which failed after reaching "
+                        "the server or timing out",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(client, client_master_lookup_latency,
+                        "Master Lookup Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Round-trip time of the tablet location lookups sent by the "
+                        "client to the leader master",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(client, client_buffer_space_wait_time,
+                        "Buffer Space Wait Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent by sessions in AUTO_FLUSH_BACKGROUND mode blocked "
+                        "in Apply() waiting for mutation buffer space to be freed. "
+                        "Applies which did not block are not recorded",
+                        60000000LU, 2);
+
+METRIC_DEFINE_counter(client, client_write_rpc_retries,
+                      "Write RPC Retries",
+                      kudu::MetricUnit::kRequests,
+                      "Number of times the client retried a write RPC, whether "
+                      "on the same or on another tablet server");
+METRIC_DEFINE_counter(client, client_scan_rpc_retries,
+                      "Scan RPC Retries",
+                      kudu::MetricUnit::kRequests,
+                      "Number of times the client retried a scan RPC, whether "
+                      "on the same or on another tablet server");
+METRIC_DEFINE_counter(client, client_master_lookup_retries,
+                      "Master Lookup Retries",
+                      kudu::MetricUnit::kRequests,
+                      "Number of times the client retried a tablet location lookup");
+
+METRIC_DEFINE_histogram(client_tablet_server, client_tablet_server_write_rpc_latency,
+                        "Tablet Server Write RPC Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Round-trip time of the write RPCs sent by the client to "
+                        "this tablet server",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(client_tablet_server, client_tablet_server_scan_rpc_latency,
+                        "Tablet Server Scan RPC Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Round-trip time of the scan RPCs sent by the client to "
+                        "this tablet server",
+                        60000000LU, 2);
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+#define MINIT(x) x(METRIC_##x.Instantiate(entity))
+ClientMetrics::ClientMetrics(const scoped_refptr<MetricEntity>& entity)
+  : MINIT(client_write_rpc_latency),
+    MINIT(client_scan_rpc_latency),
+    MINIT(client_master_lookup_latency),
+    MINIT(client_buffer_space_wait_time),
+    MINIT(client_write_rpc_retries),
+    MINIT(client_scan_rpc_retries),
+    MINIT(client_master_lookup_retries) {
+}
+
+TabletServerClientMetrics::TabletServerClientMetrics(const scoped_refptr<MetricEntity>& entity)
+  : MINIT(client_tablet_server_write_rpc_latency),
+    MINIT(client_tablet_server_scan_rpc_latency) {
+}
+#undef MINIT
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,64 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_CLIENT_METRICS_H
+#define KUDU_CLIENT_CLIENT_METRICS_H
+
+#include "kudu/gutil/ref_counted.h"
+
+namespace kudu {
+
+class Counter;
+class Histogram;
+class MetricEntity;
+
+namespace client {
+namespace internal {
+
+// Container for the metrics of a client, kept in the client's own metric
+// registry under a 'client' entity.
+struct ClientMetrics {
+  explicit ClientMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+
+  // Latencies of the RPCs sent by the client, by operation.
+  scoped_refptr<Histogram> client_write_rpc_latency;
+  scoped_refptr<Histogram> client_scan_rpc_latency;
+  scoped_refptr<Histogram> client_master_lookup_latency;
+
+  // Time spent by sessions waiting for mutation buffer space.
+  scoped_refptr<Histogram> client_buffer_space_wait_time;
+
+  // Retries of operations which needed more than one attempt.
+  scoped_refptr<Counter> client_write_rpc_retries;
+  scoped_refptr<Counter> client_scan_rpc_retries;
+  scoped_refptr<Counter> client_master_lookup_retries;
+};
+
+// Container for the metrics of the RPCs a client sends to a single tablet
+// server, kept under a 'client_tablet_server' entity whose id is the server's
+// uuid.
+struct TabletServerClientMetrics {
+  explicit TabletServerClientMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+
+  scoped_refptr<Histogram> client_tablet_server_write_rpc_latency;
+  scoped_refptr<Histogram> client_tablet_server_scan_rpc_latency;
+};
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
+
+#endif
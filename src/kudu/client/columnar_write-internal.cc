@@ -0,0 +1,427 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/columnar_write-internal.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "kudu/client/batcher.h"
+#include "kudu/client/client-internal.h"
+#include "kudu/client/client_metrics.h"
+#include "kudu/client/error_collector.h"
+#include "kudu/client/meta_cache.h"
+#include "kudu/client/write_op-internal.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/partition.h"
+#include "kudu/common/row.h"
+#include "kudu/common/row_operations.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/request_tracker.h"
+#include "kudu/rpc/retriable_rpc.h"
+#include "kudu/rpc/rpc.h"
+#include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/pb_util.h"
+
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+using rpc::Messenger;
+using rpc::RequestTracker;
+using rpc::ResponseCallback;
+using rpc::RetriableRpc;
+using rpc::RetriableRpcStatus;
+using tserver::WriteRequestPB;
+using tserver::WriteResponsePB;
+using tserver::WriteResponsePB_PerRowErrorPB;
+
+namespace client {
+
+using internal::ClientMetrics;
+using internal::ErrorCollector;
+using internal::MetaCacheServerPicker;
+using internal::RemoteTablet;
+using internal::RemoteTabletServer;
+
+namespace {
+
+// The outcome of one of the write requests of a columnar batch.
+struct ColumnarWriteResult {
+  // The rows of the batch carried by the request, in request order.
+  vector<size_t> row_idxs;
+
+  Status status;
+  WriteResponsePB resp;
+};
+
+// Writes one request's worth of a columnar batch's rows to a tablet. The RPC
+// is freed when it completes, after storing its outcome in 'result' and
+// counting down 'latch'.
+class ColumnarWriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteResponsePB> {
+ public:
+  ColumnarWriteRpc(const scoped_refptr<MetaCacheServerPicker>& replica_picker,
+                   const scoped_refptr<RequestTracker>& request_tracker,
+                   const MonoTime& deadline,
+                   const shared_ptr<Messenger>& messenger,
+                   WriteRequestPB* req,
+                   ColumnarWriteResult* result,
+                   CountDownLatch* latch,
+                   ClientMetrics* metrics)
+      : RetriableRpc(replica_picker, request_tracker, deadline, messenger),
+        result_(result),
+        latch_(latch),
+        metrics_(metrics),
+        attempt_replica_(nullptr) {
+    req_.Swap(req);
+  }
+
+  string ToString() const override {
+    return Substitute("ColumnarWrite(tablet: $0, num_rows: $1, num_attempts: $2)",
+                      req_.tablet_id(), result_->row_idxs.size(), num_attempts());
+  }
+
+ protected:
+  void Try(RemoteTabletServer* replica, const ResponseCallback& callback) override {
+    VLOG(2) << "Tablet " << req_.tablet_id() << ": Writing columnar batch to replica "
+            << replica->ToString();
+    attempt_replica_ = replica;
+    attempt_start_time_ = MonoTime::Now();
+    replica->proxy()->WriteAsync(req_, &resp_,
+                                 mutable_retrier()->mutable_controller(),
+                                 callback);
+  }
+
+  RetriableRpcStatus AnalyzeResponse(const Status& rpc_cb_status) override {
+    if (attempt_replica_) {
+      internal::RecordWriteRpcLatency(metrics_, *attempt_replica_, attempt_start_time_);
+      attempt_replica_ = nullptr;
+    }
+    return internal::AnalyzeWriteResponse(rpc_cb_status, mutable_retrier()->controller(), resp_);
+  }
+
+  void Finish(const Status& status) override {
+    unique_ptr<ColumnarWriteRpc> this_instance(this);
+    result_->status = status;
+    if (!status.ok()) {
+      result_->status = status.CloneAndPrepend(
+          Substitute("Failed to write batch of $0 rows to tablet $1 after $2 attempt(s)",
+                     result_->row_idxs.size(), req_.tablet_id(), num_attempts()));
+      KLOG_EVERY_N_SECS(WARNING, 1) << result_->status.ToString();
+    }
+    if (num_attempts() > 1) {
+      metrics_->client_write_rpc_retries->IncrementBy(num_attempts() - 1);
+    }
+    result_->resp.Swap(&resp_);
+    latch_->CountDown();
+  }
+
+ private:
+  ColumnarWriteResult* const result_;
+  CountDownLatch* const latch_;
+  ClientMetrics* const metrics_;
+
+  // The replica the in-flight attempt was sent to, and when it was sent.
+  RemoteTabletServer* attempt_replica_;
+  MonoTime attempt_start_time_;
+};
+
+} // anonymous namespace
+
+KuduColumnarWriteBatch::Data::Data(sp::shared_ptr<KuduTable> table,
+                                   KuduWriteOperation::Type type,
+                                   int num_rows)
+    : table_(std::move(table)),
+      type_(type),
+      num_rows_(num_rows),
+      blocks_(table_->schema().num_columns()) {
+  DCHECK(type_ == KuduWriteOperation::INSERT || type_ == KuduWriteOperation::UPSERT);
+}
+
+KuduColumnarWriteBatch::Data::~Data() {
+}
+
+const Schema* KuduColumnarWriteBatch::Data::schema() const {
+  return table_->schema().schema_;
+}
+
+Status KuduColumnarWriteBatch::Data::SetColumn(int col_idx,
+                                               const void* data,
+                                               const uint8_t* non_null_bitmap) {
+  const Schema* schema = this->schema();
+  if (col_idx < 0 || col_idx >= schema->num_columns()) {
+    return Status::InvalidArgument(Substitute("column index $0 out of bounds", col_idx));
+  }
+  const ColumnSchema& col = schema->column(col_idx);
+  if (PREDICT_FALSE(data == nullptr)) {
+    return Status::InvalidArgument("column data must not be NULL", col.name());
+  }
+  if (non_null_bitmap != nullptr && !col.is_nullable()) {
+    return Status::InvalidArgument("column not nullable", col.ToString());
+  }
+  // The blocks are only ever read from.
+  blocks_[col_idx].reset(new ColumnBlock(col.type_info(),
+                                         const_cast<uint8_t*>(non_null_bitmap),
+                                         const_cast<void*>(data),
+                                         num_rows_,
+                                         nullptr));
+  return Status::OK();
+}
+
+Status KuduColumnarWriteBatch::Data::CheckColumnsSet() const {
+  const Schema* schema = this->schema();
+  for (int i = 0; i < schema->num_columns(); i++) {
+    if (blocks_[i]) continue;
+    const ColumnSchema& col = schema->column(i);
+    if (i < schema->num_key_columns()) {
+      return Status::IllegalState("Key not specified", col.name());
+    }
+    if (!col.is_nullable() && !col.has_write_default()) {
+      return Status::IllegalState("column not set and has no default", col.name());
+    }
+  }
+  return Status::OK();
+}
+
+size_t KuduColumnarWriteBatch::Data::EncodedRowSize(size_t row_idx) const {
+  const Schema* schema = this->schema();
+  size_t size = 1 + BitmapSize(schema->num_columns()) +
+      ContiguousRowHelper::null_bitmap_size(*schema);
+  for (const auto& block : blocks_) {
+    if (!block || (block->is_nullable() && block->is_null(row_idx))) continue;
+    size += block->stride();
+    if (block->type_info()->physical_type() == BINARY) {
+      size += reinterpret_cast<const Slice*>(block->cell_ptr(row_idx))->size();
+    }
+  }
+  return size;
+}
+
+Status KuduColumnarWriteBatch::Data::GroupRowsByTablet(
+    KuduClient* client,
+    const MonoTime& deadline,
+    vector<TabletRows>* groups,
+    vector<pair<size_t, Status>>* failed) const {
+  vector<const ColumnBlock*> columns;
+  columns.reserve(blocks_.size());
+  for (const auto& block : blocks_) {
+    columns.push_back(block.get());
+  }
+  vector<string> keys;
+  RETURN_NOT_OK(table_->partition_schema().EncodeKeys(*schema(), columns, num_rows_, &keys));
+
+  // Once sorted by partition key, the rows of each tablet are contiguous, so
+  // a single lookup resolves the tablet of a whole run of rows.
+  vector<size_t> order(num_rows_);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return keys[a] < keys[b];
+    });
+
+  size_t i = 0;
+  while (i < order.size()) {
+    const string& key = keys[order[i]];
+    scoped_refptr<RemoteTablet> tablet;
+    Synchronizer sync;
+    client->data_->meta_cache_->LookupTabletByKey(table_.get(), key, deadline, &tablet,
+                                                  sync.AsStatusCallback());
+    Status s = sync.Wait();
+
+    size_t end = i + 1;
+    if (s.ok()) {
+      const string& key_end = tablet->partition().partition_key_end();
+      while (end < order.size() && (key_end.empty() || keys[order[end]] < key_end)) {
+        end++;
+      }
+      TabletRows group;
+      group.tablet = std::move(tablet);
+      group.row_idxs.assign(order.begin() + i, order.begin() + end);
+      // Restore the order of the rows in the batch, so that several rows
+      // with the same key are applied in the order they were given.
+      std::sort(group.row_idxs.begin(), group.row_idxs.end());
+      groups->push_back(std::move(group));
+    } else {
+      while (end < order.size() && keys[order[end]] == key) {
+        end++;
+      }
+      for (size_t j = i; j < end; j++) {
+        failed->emplace_back(order[j], s);
+      }
+    }
+    i = end;
+  }
+  return Status::OK();
+}
+
+Status KuduColumnarWriteBatch::Data::Write(KuduClient* client,
+                                           KuduSession::ExternalConsistencyMode consistency_mode,
+                                           const MonoDelta& timeout,
+                                           size_t max_request_bytes,
+                                           ErrorCollector* error_collector) const {
+  RETURN_NOT_OK(CheckColumnsSet());
+
+  MonoTime deadline = MonoTime::Now() + timeout;
+  vector<TabletRows> groups;
+  vector<pair<size_t, Status>> failed;
+  RETURN_NOT_OK(GroupRowsByTablet(client, deadline, &groups, &failed));
+
+  // Cut the rows of each tablet into requests.
+  vector<RemoteTablet*> request_tablets;
+  vector<unique_ptr<ColumnarWriteResult>> results;
+  for (const TabletRows& group : groups) {
+    unique_ptr<ColumnarWriteResult> result(new ColumnarWriteResult());
+    size_t request_bytes = 0;
+    for (size_t row_idx : group.row_idxs) {
+      size_t row_bytes = EncodedRowSize(row_idx);
+      if (!result->row_idxs.empty() && request_bytes + row_bytes > max_request_bytes) {
+        request_tablets.push_back(group.tablet.get());
+        results.push_back(std::move(result));
+        result.reset(new ColumnarWriteResult());
+        request_bytes = 0;
+      }
+      result->row_idxs.push_back(row_idx);
+      request_bytes += row_bytes;
+    }
+    request_tablets.push_back(group.tablet.get());
+    results.push_back(std::move(result));
+  }
+
+  const Schema* schema = this->schema();
+  vector<const ColumnBlock*> columns;
+  columns.reserve(blocks_.size());
+  for (const auto& block : blocks_) {
+    columns.push_back(block.get());
+  }
+  RowOperationsPB_Type op_type = ToInternalWriteType(type_);
+  uint64_t propagated_timestamp = client->data_->GetLatestObservedTimestamp();
+
+  CountDownLatch latch(results.size());
+  for (int i = 0; i < results.size(); i++) {
+    RemoteTablet* tablet = request_tablets[i];
+    WriteRequestPB req;
+    req.set_tablet_id(tablet->tablet_id());
+    switch (consistency_mode) {
+      case KuduSession::CLIENT_PROPAGATED:
+        req.set_external_consistency_mode(kudu::CLIENT_PROPAGATED);
+        break;
+      case KuduSession::COMMIT_WAIT:
+        req.set_external_consistency_mode(kudu::COMMIT_WAIT);
+        break;
+      default:
+        LOG(FATAL) << "Unsupported consistency mode: " << consistency_mode;
+    }
+    if (PREDICT_TRUE(propagated_timestamp != KuduClient::kNoTimestamp)) {
+      req.set_propagated_timestamp(propagated_timestamp);
+    }
+    CHECK_OK(SchemaToPB(*schema, req.mutable_schema(),
+                        SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
+    RowOperationsPBEncoder enc(req.mutable_row_operations());
+    enc.AddColumnar(op_type, *schema, columns, results[i]->row_idxs);
+
+    scoped_refptr<MetaCacheServerPicker> server_picker(
+        new MetaCacheServerPicker(client,
+                                  client->data_->meta_cache_,
+                                  table_.get(),
+                                  tablet));
+    ColumnarWriteRpc* rpc = new ColumnarWriteRpc(server_picker,
+                                                 client->data_->request_tracker_,
+                                                 deadline,
+                                                 client->data_->messenger_,
+                                                 &req,
+                                                 results[i].get(),
+                                                 &latch,
+                                                 client->data_->metrics_.get());
+    rpc->SendRpc();
+  }
+  latch.Wait();
+
+  bool had_errors = false;
+  auto add_error = [&](size_t row_idx, const Status& s) {
+    gscoped_ptr<KuduError> error(new KuduError(NewRowOperation(row_idx), s));
+    error_collector->AddError(std::move(error));
+    had_errors = true;
+  };
+  for (const auto& row_and_status : failed) {
+    add_error(row_and_status.first, row_and_status.second);
+  }
+  for (const auto& result : results) {
+    if (!result->status.ok()) {
+      // The whole request failed, so each of its rows did.
+      for (size_t row_idx : result->row_idxs) {
+        add_error(row_idx, result->status);
+      }
+      continue;
+    }
+    if (result->resp.has_timestamp()) {
+      client->data_->UpdateLatestObservedTimestamp(result->resp.timestamp());
+    }
+    for (const WriteResponsePB_PerRowErrorPB& err_pb : result->resp.per_row_errors()) {
+      if (err_pb.row_index() >= result->row_idxs.size()) {
+        LOG(ERROR) << "Received a per_row_error for an out-of-bound row index "
+                   << err_pb.row_index() << " (sent only "
+                   << result->row_idxs.size() << " rows)";
+        continue;
+      }
+      add_error(result->row_idxs[err_pb.row_index()], StatusFromPB(err_pb.error()));
+    }
+  }
+
+  if (had_errors) {
+    return Status::IOError("Some errors occurred");
+  }
+  return Status::OK();
+}
+
+KuduWriteOperation* KuduColumnarWriteBatch::Data::NewRowOperation(size_t row_idx) const {
+  KuduWriteOperation* op;
+  if (type_ == KuduWriteOperation::UPSERT) {
+    op = table_->NewUpsert();
+  } else {
+    op = table_->NewInsert();
+  }
+  KuduPartialRow* row = op->mutable_row();
+  for (int i = 0; i < blocks_.size(); i++) {
+    const ColumnBlock* block = blocks_[i].get();
+    if (block == nullptr) continue;
+    if (block->is_nullable() && block->is_null(row_idx)) {
+      CHECK_OK(row->SetNull(i));
+    } else {
+      CHECK_OK(row->Set(i, block->cell_ptr(row_idx)));
+    }
+  }
+  return op;
+}
+
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,105 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_COLUMNAR_WRITE_INTERNAL_H
+#define KUDU_CLIENT_COLUMNAR_WRITE_INTERNAL_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/client/write_op.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnBlock;
+class Schema;
+
+namespace client {
+
+namespace internal {
+class ErrorCollector;
+class RemoteTablet;
+} // namespace internal
+
+class KuduColumnarWriteBatch::Data {
+ public:
+  Data(sp::shared_ptr<KuduTable> table,
+       KuduWriteOperation::Type type,
+       int num_rows);
+  ~Data();
+
+  // Sets the values of column 'col_idx' for all rows of the batch.
+  Status SetColumn(int col_idx, const void* data, const uint8_t* non_null_bitmap);
+
+  // Writes the rows of the batch through 'client'.
+  //
+  // The rows are grouped by tablet, and each tablet's rows are sent in
+  // requests carrying at most 'max_request_bytes' of encoded rows; all of
+  // the requests are in flight at once. Every row which fails to be written
+  // is reported to 'error_collector', in which case IOError is returned.
+  Status Write(KuduClient* client,
+               KuduSession::ExternalConsistencyMode consistency_mode,
+               const MonoDelta& timeout,
+               size_t max_request_bytes,
+               internal::ErrorCollector* error_collector) const;
+
+  // Returns a new single-row operation holding a copy of row 'row_idx' of
+  // the batch. The caller takes ownership of the result.
+  KuduWriteOperation* NewRowOperation(size_t row_idx) const;
+
+  const sp::shared_ptr<KuduTable> table_;
+  const KuduWriteOperation::Type type_;
+  const int num_rows_;
+
+ private:
+  // The rows of the batch which belong to a tablet.
+  struct TabletRows {
+    scoped_refptr<internal::RemoteTablet> tablet;
+    std::vector<size_t> row_idxs;
+  };
+
+  // Returns an error if a column which needs a value for every row is not set.
+  Status CheckColumnsSet() const;
+
+  // Computes the partition keys of the rows and groups the rows by tablet,
+  // keeping their order within each tablet. Rows whose tablet could not be
+  // looked up are added to 'failed' along with the lookup error.
+  Status GroupRowsByTablet(KuduClient* client,
+                           const MonoTime& deadline,
+                           std::vector<TabletRows>* groups,
+                           std::vector<std::pair<size_t, Status>>* failed) const;
+
+  // Returns an upper bound on the encoded size of row 'row_idx'.
+  size_t EncodedRowSize(size_t row_idx) const;
+
+  const Schema* schema() const;
+
+  // The batch's column blocks, indexed by the column's index in the table's
+  // schema. Null for columns which are not set.
+  std::vector<std::unique_ptr<ColumnBlock>> blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
@@ -34,16 +34,21 @@
 #include "kudu/rpc/rpc.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/status_callback.h"
 
 using std::map;
 using std::set;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using strings::Substitute;
 
+METRIC_DECLARE_entity(client_tablet_server);
+
 namespace kudu {
 
 using consensus::RaftPeerPB;
@@ -63,12 +68,35 @@ namespace internal {
 
 namespace {
 const int MAX_RETURNED_TABLE_LOCATIONS = 10;
+
+// The number of tablet locations fetched per request when prefetching the
+// locations of a whole table.
+const int MAX_PREFETCHED_TABLE_LOCATIONS = 1000;
+
+// The fraction of the locations' TTL after which the locations of a
+// prefetched table are refreshed in the background.
+const double REFRESH_AHEAD_TTL_FRACTION = 0.8;
+
+// How long to wait before retrying a failed background refresh.
+const int REFRESH_AHEAD_RETRY_DELAY_MS = 1000;
+
+// The weight of a new measurement in a tablet server's latency averages.
+const double LATENCY_EWMA_ALPHA = 0.3;
+
+// How long a tablet server's latency averages are used for after the last
+// measurement. Beyond this, the server is treated as unmeasured so that it
+// is tried again, rather than avoided indefinitely after a slow spell.
+const int LATENCY_EWMA_VALIDITY_MS = 30 * 1000;
 } // anonymous namespace
 
 ////////////////////////////////////////////////////////////
 
-RemoteTabletServer::RemoteTabletServer(const master::TSInfoPB& pb)
-  : uuid_(pb.permanent_uuid()) {
+RemoteTabletServer::RemoteTabletServer(const master::TSInfoPB& pb,
+                                       const scoped_refptr<MetricEntity>& metric_entity)
+  : uuid_(pb.permanent_uuid()),
+    rtt_ewma_us_(0),
+    queue_time_ewma_us_(0),
+    metrics_(metric_entity) {
 
   Update(pb);
 }
@@ -161,6 +189,36 @@ void RemoteTabletServer::GetHostPorts(vector<HostPort>* host_ports) const {
   *host_ports = rpc_hostports_;
 }
 
+void RemoteTabletServer::RecordLatency(const MonoDelta& round_trip_time,
+                                       const MonoDelta& queue_time) {
+  double rtt_us = round_trip_time.ToMicroseconds();
+  double queue_time_us = queue_time.ToMicroseconds();
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!last_latency_time_.Initialized() ||
+      now - last_latency_time_ > MonoDelta::FromMilliseconds(LATENCY_EWMA_VALIDITY_MS)) {
+    rtt_ewma_us_ = rtt_us;
+    queue_time_ewma_us_ = queue_time_us;
+  } else {
+    rtt_ewma_us_ += LATENCY_EWMA_ALPHA * (rtt_us - rtt_ewma_us_);
+    queue_time_ewma_us_ += LATENCY_EWMA_ALPHA * (queue_time_us - queue_time_ewma_us_);
+  }
+  last_latency_time_ = now;
+}
+
+double RemoteTabletServer::EstimatedLatencyUs() const {
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!last_latency_time_.Initialized() ||
+      now - last_latency_time_ > MonoDelta::FromMilliseconds(LATENCY_EWMA_VALIDITY_MS)) {
+    return -1;
+  }
+  // The round-trip time already includes the time queued, but counting the
+  // queue time again steers requests away from a server whose load is
+  // rising before that shows in the averaged round-trip time.
+  return rtt_ewma_us_ + queue_time_ewma_us_;
+}
+
 ////////////////////////////////////////////////////////////
 
 
@@ -501,7 +559,9 @@ void MetaCache::UpdateTabletServer(const TSInfoPB& pb) {
   }
 
   VLOG(1) << "Client caching new TabletServer " << pb.permanent_uuid();
-  InsertOrDie(&ts_cache_, pb.permanent_uuid(), new RemoteTabletServer(pb));
+  scoped_refptr<MetricEntity> metric_entity = METRIC_ENTITY_client_tablet_server.Instantiate(
+      &client_->data_->metric_registry_, pb.permanent_uuid());
+  InsertOrDie(&ts_cache_, pb.permanent_uuid(), new RemoteTabletServer(pb, metric_entity));
 }
 
 // A (table, partition_key) --> tablet lookup. May be in-flight to a master, or
@@ -517,7 +577,8 @@ class LookupRpc : public Rpc {
             scoped_refptr<RemoteTablet>* remote_tablet,
             const MonoTime& deadline,
             const shared_ptr<Messenger>& messenger,
-            bool is_exact_lookup);
+            bool is_exact_lookup,
+            string* next_page_key = nullptr);
   virtual ~LookupRpc();
   virtual void SendRpc() OVERRIDE;
   virtual string ToString() const OVERRIDE;
@@ -533,6 +594,8 @@ class LookupRpc : public Rpc {
  private:
   virtual void SendRpcCb(const Status& status) OVERRIDE;
 
+  bool is_prefetch() const { return next_page_key_ != nullptr; }
+
   std::shared_ptr<MasterServiceProxy> master_proxy() const {
     return table_->client()->data_->master_proxy();
   }
@@ -541,6 +604,9 @@ class LookupRpc : public Rpc {
 
   void NewLeaderMasterDeterminedCb(const Status& status);
 
+  // Moves the tablet locations the master sent in a sidecar into 'resp_'.
+  Status ParseLocationsSidecar();
+
   // Pointer back to the tablet cache. Populated with location information
   // if the lookup finishes successfully.
   //
@@ -576,6 +642,15 @@ class LookupRpc : public Rpc {
   // partition key. If false, the next tablet after the partition key should be
   // returned if the partition key falls in a non-covered partition range.
   bool is_exact_lookup_;
+
+  // If set, this lookup fetches a page of the table's tablet locations
+  // starting at the partition key, bypassing the cache. When the lookup
+  // finishes successfully, the partition key at which the next page starts
+  // is written here, or the empty string if this was the last page.
+  string* next_page_key_;
+
+  // The time at which the latest GetTableLocations RPC was sent.
+  MonoTime rpc_start_time_;
 };
 
 LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
@@ -584,7 +659,8 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
                      scoped_refptr<RemoteTablet>* remote_tablet,
                      const MonoTime& deadline,
                      const shared_ptr<Messenger>& messenger,
-                     bool is_exact_lookup)
+                     bool is_exact_lookup,
+                     string* next_page_key)
     : Rpc(deadline, messenger),
       meta_cache_(meta_cache),
       user_cb_(std::move(user_cb)),
@@ -592,7 +668,8 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
       partition_key_(std::move(partition_key)),
       remote_tablet_(remote_tablet),
       has_permit_(false),
-      is_exact_lookup_(is_exact_lookup) {
+      is_exact_lookup_(is_exact_lookup),
+      next_page_key_(next_page_key) {
   DCHECK(deadline.Initialized());
 }
 
@@ -605,7 +682,8 @@ LookupRpc::~LookupRpc() {
 void LookupRpc::SendRpc() {
   // Fast path: lookup in the cache.
   MetaCacheEntry entry;
-  while (PREDICT_TRUE(meta_cache_->LookupTabletByKeyFastPath(table_, partition_key_, &entry))
+  while (PREDICT_TRUE(!is_prefetch())
+         && PREDICT_TRUE(meta_cache_->LookupTabletByKeyFastPath(table_, partition_key_, &entry))
          && (entry.is_non_covered_range() || entry.tablet()->HasLeader())) {
     VLOG(4) << "Fast lookup: found " << entry.DebugString(table_) << " for " << ToString();
     if (!entry.is_non_covered_range()) {
@@ -642,7 +720,9 @@ void LookupRpc::SendRpc() {
   // Fill out the request.
   req_.mutable_table()->set_table_id(table_->id());
   req_.set_partition_key_start(partition_key_);
-  req_.set_max_returned_locations(MAX_RETURNED_TABLE_LOCATIONS);
+  req_.set_max_returned_locations(is_prefetch() ? MAX_PREFETCHED_TABLE_LOCATIONS
+                                                : MAX_RETURNED_TABLE_LOCATIONS);
+  req_.set_tablet_locations_in_sidecar(true);
 
   // The end partition key is left unset intentionally so that we'll prefetch
   // some additional tablets.
@@ -657,6 +737,7 @@ void LookupRpc::SendRpc() {
   mutable_retrier()->mutable_controller()->set_deadline(
       MonoTime::Earliest(rpc_deadline, retrier().deadline()));
 
+  rpc_start_time_ = MonoTime::Now();
   master_proxy()->GetTableLocationsAsync(req_, &resp_,
                                          mutable_retrier()->mutable_controller(),
                                          boost::bind(&LookupRpc::SendRpcCb, this, Status::OK()));
@@ -689,12 +770,28 @@ void LookupRpc::NewLeaderMasterDeterminedCb(const Status& status) {
   }
 }
 
+Status LookupRpc::ParseLocationsSidecar() {
+  Slice sidecar;
+  RETURN_NOT_OK(retrier().controller().GetSidecar(resp_.tablet_locations_sidecar(), &sidecar));
+  GetTableLocationsResponsePB locations;
+  if (!locations.ParseFromArray(sidecar.data(), sidecar.size())) {
+    return Status::Corruption("unable to parse tablet locations sidecar");
+  }
+  resp_.mutable_tablet_locations()->Swap(locations.mutable_tablet_locations());
+  resp_.clear_tablet_locations_sidecar();
+  return Status::OK();
+}
+
 void LookupRpc::SendRpcCb(const Status& status) {
   gscoped_ptr<LookupRpc> delete_me(this); // delete on scope exit
 
+  ClientMetrics* metrics = meta_cache_->client_->data_->metrics_.get();
   if (!status.ok()) {
     // Non-RPC failure. We only support TimedOut for LookupRpc.
     CHECK(status.IsTimedOut()) << status.ToString();
+  } else {
+    metrics->client_master_lookup_latency->Increment(
+        (MonoTime::Now() - rpc_start_time_).ToMicroseconds());
   }
 
   Status new_status = status;
@@ -704,6 +801,11 @@ void LookupRpc::SendRpcCb(const Status& status) {
     return;
   }
 
+  // The master may send back the locations it has cached in a sidecar.
+  if (new_status.ok() && resp_.has_tablet_locations_sidecar()) {
+    new_status = ParseLocationsSidecar();
+  }
+
   // Check for specific application response errors.
   if (new_status.ok() && resp_.has_error()) {
     if (resp_.error().code() == master::MasterErrorPB::NOT_THE_LEADER ||
@@ -754,7 +856,16 @@ void LookupRpc::SendRpcCb(const Status& status) {
   if (new_status.ok()) {
     MetaCacheEntry entry;
     new_status = meta_cache_->ProcessLookupResponse(*this, &entry);
-    if (entry.is_non_covered_range()) {
+    if (is_prefetch()) {
+      // A full page may be followed by more tablets.
+      const auto& tablet_locations = resp_.tablet_locations();
+      if (new_status.ok() && tablet_locations.size() == req_.max_returned_locations()) {
+        *next_page_key_ = tablet_locations.Get(tablet_locations.size() - 1)
+            .partition().partition_key_end();
+      } else {
+        next_page_key_->clear();
+      }
+    } else if (entry.is_non_covered_range()) {
       new_status = Status::NotFound("No tablet covering the requested range partition",
                                     entry.DebugString(table_));
     } else if (remote_tablet_) {
@@ -764,9 +875,68 @@ void LookupRpc::SendRpcCb(const Status& status) {
     new_status = new_status.CloneAndPrepend(Substitute("$0 failed", ToString()));
     KLOG_EVERY_N_SECS(WARNING, 1) << new_status.ToString();
   }
+  if (num_attempts() > 1) {
+    metrics->client_master_lookup_retries->IncrementBy(num_attempts() - 1);
+  }
   user_cb_.Run(new_status);
 }
 
+// Fetches the locations of all of the tablets of a table, one page at a time.
+//
+// Keeps a reference on the table, and deletes itself once finished.
+class TableLocationsPrefetch {
+ public:
+  TableLocationsPrefetch(scoped_refptr<MetaCache> meta_cache,
+                         sp::shared_ptr<const KuduTable> table,
+                         shared_ptr<Messenger> messenger,
+                         const MonoTime& deadline,
+                         StatusCallback callback)
+      : meta_cache_(std::move(meta_cache)),
+        table_(std::move(table)),
+        messenger_(std::move(messenger)),
+        deadline_(deadline),
+        callback_(std::move(callback)),
+        start_time_(MonoTime::Now()) {
+  }
+
+  void Run() {
+    VLOG(2) << "Prefetching a page of tablet locations of table " << table_->name();
+    LookupRpc* rpc = new LookupRpc(meta_cache_,
+                                   Bind(&TableLocationsPrefetch::PageFinished, Unretained(this)),
+                                   table_.get(),
+                                   next_page_key_,
+                                   nullptr,
+                                   deadline_,
+                                   messenger_,
+                                   false,
+                                   &next_page_key_);
+    rpc->SendRpc();
+  }
+
+ private:
+  void PageFinished(const Status& s) {
+    if (s.ok() && !next_page_key_.empty()) {
+      Run();
+      return;
+    }
+    unique_ptr<TableLocationsPrefetch> delete_me(this);
+    meta_cache_->PrefetchFinished(table_->id(), start_time_, s);
+    callback_.Run(s);
+  }
+
+  const scoped_refptr<MetaCache> meta_cache_;
+  const sp::shared_ptr<const KuduTable> table_;
+  const shared_ptr<Messenger> messenger_;
+  const MonoTime deadline_;
+  const StatusCallback callback_;
+
+  // When the first page was requested.
+  const MonoTime start_time_;
+
+  // The partition key at which the next page starts.
+  string next_page_key_;
+};
+
 Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
                                         MetaCacheEntry* cache_entry) {
   VLOG(2) << "Processing master response for " << rpc.ToString()
@@ -888,7 +1058,8 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
       InsertOrDie(&tablets_by_key, tablet_lower_bound, std::move(entry));
     }
 
-    if (!last_upper_bound.empty() && tablet_locations.size() < MAX_RETURNED_TABLE_LOCATIONS) {
+    if (!last_upper_bound.empty() &&
+        tablet_locations.size() < rpc.req().max_returned_locations()) {
       // There is a non-covered range between the last tablet and the end of the
       // partition key space, such as F.
 
@@ -915,30 +1086,72 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
 bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
                                           const string& partition_key,
                                           MetaCacheEntry* entry) {
-  shared_lock<rw_spinlock> l(lock_);
-  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
-  if (PREDICT_FALSE(!tablets)) {
-    // No cache available for this table.
-    return false;
+  bool refresh_due;
+  bool found = false;
+  {
+    shared_lock<rw_spinlock> l(lock_);
+    refresh_due = IsRefreshAheadDueUnlocked(table->id());
+    const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
+    const MetaCacheEntry* e = tablets ? FindFloorOrNull(*tablets, partition_key) : nullptr;
+    // Stale entries must be re-fetched.
+    if (e && !e->stale() && e->Contains(partition_key)) {
+      *entry = *e;
+      found = true;
+    }
   }
-
-  const MetaCacheEntry* e = FindFloorOrNull(*tablets, partition_key);
-  if (PREDICT_FALSE(!e)) {
-    // No tablets with a start partition key lower than 'partition_key'.
-    return false;
+  if (PREDICT_FALSE(refresh_due)) {
+    RefreshAhead(table);
   }
+  return found;
+}
 
-  // Stale entries must be re-fetched.
-  if (e->stale()) {
-    return false;
+void MetaCache::LookupTabletsByKeysFastPath(
+    const KuduTable* table,
+    const vector<const string*>& partition_keys,
+    vector<scoped_refptr<RemoteTablet>>* remote_tablets) {
+  remote_tablets->assign(partition_keys.size(), scoped_refptr<RemoteTablet>());
+
+  bool refresh_due;
+  {
+    shared_lock<rw_spinlock> l(lock_);
+    refresh_due = IsRefreshAheadDueUnlocked(table->id());
+    LookupTabletsByKeysFastPathUnlocked(table, partition_keys, remote_tablets);
   }
+  if (PREDICT_FALSE(refresh_due)) {
+    RefreshAhead(table);
+  }
+}
 
-  if (e->Contains(partition_key)) {
-    *entry = *e;
-    return true;
+void MetaCache::LookupTabletsByKeysFastPathUnlocked(
+    const KuduTable* table,
+    const vector<const string*>& partition_keys,
+    vector<scoped_refptr<RemoteTablet>>* remote_tablets) {
+  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
+  if (PREDICT_FALSE(!tablets)) {
+    // No cache available for this table.
+    return;
   }
 
-  return false;
+  // The entry covering the previous key, and whether its tablet may be used.
+  // Since the keys are sorted, the cache only needs to be searched again when
+  // a key falls past the end of the current entry.
+  const MetaCacheEntry* e = nullptr;
+  bool usable = false;
+  for (int i = 0; i < partition_keys.size(); i++) {
+    const string& partition_key = *partition_keys[i];
+    DCHECK(i == 0 || *partition_keys[i - 1] <= partition_key);
+    if (e == nullptr || !e->Contains(partition_key)) {
+      e = FindFloorOrNull(*tablets, partition_key);
+      if (e == nullptr || !e->Contains(partition_key)) {
+        e = nullptr;
+        continue;
+      }
+      usable = !e->stale() && !e->is_non_covered_range() && e->tablet()->HasLeader();
+    }
+    if (usable) {
+      (*remote_tablets)[i] = e->tablet();
+    }
+  }
 }
 
 void MetaCache::ClearCache() {
@@ -947,6 +1160,73 @@ void MetaCache::ClearCache() {
   STLDeleteValues(&ts_cache_);
   tablets_by_id_.clear();
   tablets_by_table_and_key_.clear();
+  prefetched_tables_.clear();
+}
+
+void MetaCache::PrefetchTableLocations(const KuduTable* table,
+                                       const MonoTime& deadline,
+                                       const StatusCallback& callback) {
+  auto* prefetch = new TableLocationsPrefetch(this,
+                                              table->shared_from_this(),
+                                              client_->data_->messenger_,
+                                              deadline,
+                                              callback);
+  prefetch->Run();
+}
+
+void MetaCache::PrefetchFinished(const string& table_id,
+                                 const MonoTime& start_time,
+                                 const Status& s) {
+  std::lock_guard<rw_spinlock> l(lock_);
+  PrefetchedTable& prefetched = prefetched_tables_[table_id];
+  prefetched.refreshing = false;
+  if (!s.ok()) {
+    KLOG_EVERY_N_SECS(WARNING, 1) << "Failed to prefetch tablet locations of table "
+                                  << table_id << ": " << s.ToString();
+    prefetched.refresh_time = MonoTime::Now() +
+        MonoDelta::FromMilliseconds(REFRESH_AHEAD_RETRY_DELAY_MS);
+    return;
+  }
+
+  // Refresh the locations once most of the TTL of the earliest expiring
+  // entry has elapsed, so that lookups never find them stale.
+  MonoTime earliest_expiration;
+  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table_id);
+  if (tablets) {
+    for (const auto& e : *tablets) {
+      const MonoTime& expiration_time = e.second.expiration_time();
+      if (!earliest_expiration.Initialized() || expiration_time < earliest_expiration) {
+        earliest_expiration = expiration_time;
+      }
+    }
+  }
+  if (!earliest_expiration.Initialized()) {
+    prefetched_tables_.erase(table_id);
+    return;
+  }
+  MonoDelta ttl = earliest_expiration - start_time;
+  prefetched.refresh_time = start_time + MonoDelta::FromNanoseconds(
+      static_cast<int64_t>(ttl.ToNanoseconds() * REFRESH_AHEAD_TTL_FRACTION));
+}
+
+bool MetaCache::IsRefreshAheadDueUnlocked(const string& table_id) const {
+  const PrefetchedTable* prefetched = FindOrNull(prefetched_tables_, table_id);
+  return prefetched && !prefetched->refreshing && prefetched->refresh_time < MonoTime::Now();
+}
+
+void MetaCache::RefreshAhead(const KuduTable* table) {
+  {
+    std::lock_guard<rw_spinlock> l(lock_);
+    if (!IsRefreshAheadDueUnlocked(table->id())) {
+      // Another lookup beat us to it.
+      return;
+    }
+    FindOrDie(prefetched_tables_, table->id()).refreshing = true;
+  }
+  VLOG(1) << "Refreshing tablet locations of table " << table->name() << " ahead of expiry";
+  PrefetchTableLocations(table,
+                         MonoTime::Now() + client_->default_admin_operation_timeout(),
+                         Bind(&DoNothingStatusCB));
 }
 
 void MetaCache::LookupTabletByKey(const KuduTable* table,
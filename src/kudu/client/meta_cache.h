@@ -27,6 +27,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "kudu/client/client_metrics.h"
 #include "kudu/common/partition.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/gutil/macros.h"
@@ -43,6 +44,7 @@
 namespace kudu {
 
 class KuduPartialRow;
+class MetricEntity;
 
 namespace tserver {
 class TabletServerServiceProxy;
@@ -58,6 +60,7 @@ namespace client {
 
 class ClientTest_TestMasterLookupPermits_Test;
 class ClientTest_TestMetaCacheExpiry_Test;
+class ClientTest_TestPrefetchTabletLocations_Test;
 class KuduClient;
 class KuduTable;
 
@@ -66,13 +69,16 @@ namespace internal {
 class LookupRpc;
 class MetaCache;
 class RemoteTablet;
+class TableLocationsPrefetch;
 
 // The information cached about a given tablet server in the cluster.
 //
 // This class is thread-safe.
 class RemoteTabletServer {
  public:
-  explicit RemoteTabletServer(const master::TSInfoPB& pb);
+  // The server's metrics are kept under 'metric_entity'.
+  RemoteTabletServer(const master::TSInfoPB& pb,
+                     const scoped_refptr<MetricEntity>& metric_entity);
 
   // Initialize the RPC proxy to this tablet server, if it is not already set up.
   // This will involve a DNS lookup if there is not already an active proxy.
@@ -94,6 +100,19 @@ class RemoteTabletServer {
   // Returns the remote server's uuid.
   const std::string& permanent_uuid() const;
 
+  // Records the round-trip time of an RPC to this tablet server, along with
+  // the time the server reported the RPC waited in its service queue.
+  void RecordLatency(const MonoDelta& round_trip_time, const MonoDelta& queue_time);
+
+  // Returns the expected latency of an RPC to this tablet server, in
+  // microseconds, based on exponentially weighted moving averages of recent
+  // measurements. Returns a negative value if there are no recent
+  // measurements.
+  double EstimatedLatencyUs() const;
+
+  // Returns the metrics of the RPCs sent to this tablet server.
+  const TabletServerClientMetrics& metrics() const { return metrics_; }
+
  private:
   // Internal callback for DNS resolution.
   void DnsResolutionFinished(const HostPort& hp,
@@ -108,6 +127,14 @@ class RemoteTabletServer {
   std::vector<HostPort> rpc_hostports_;
   std::shared_ptr<tserver::TabletServerServiceProxy> proxy_;
 
+  // Moving averages of the round-trip and queue times of RPCs to this server,
+  // and the time of the last measurement (uninitialized if none).
+  double rtt_ewma_us_;
+  double queue_time_ewma_us_;
+  MonoTime last_latency_time_;
+
+  const TabletServerClientMetrics metrics_;
+
   DISALLOW_COPY_AND_ASSIGN(RemoteTabletServer);
 };
 
@@ -306,6 +333,11 @@ class MetaCacheEntry {
     }
   }
 
+  const MonoTime& expiration_time() const {
+    DCHECK(Initialized());
+    return expiration_time_;
+  }
+
   void refresh_expiration_time(MonoTime expiration_time) {
     DCHECK(Initialized());
     DCHECK(expiration_time.Initialized());
@@ -380,6 +412,31 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                scoped_refptr<RemoteTablet>* remote_tablet,
                                const StatusCallback& callback);
 
+  // Resolves the tablets hosting a batch of partition keys for a table, only
+  // consulting cached information. 'partition_keys' must be sorted, so the
+  // cache is walked in a single pass under a single lock acquisition.
+  //
+  // On return, the i-th entry of 'remote_tablets' is the tablet hosting the
+  // i-th key, or null if it has to be looked up with LookupTabletByKey():
+  // when the cached entry covering the key is missing or stale, is a
+  // non-covered range, or has no known leader.
+  void LookupTabletsByKeysFastPath(
+      const KuduTable* table,
+      const std::vector<const std::string*>& partition_keys,
+      std::vector<scoped_refptr<RemoteTablet>>* remote_tablets);
+
+  // Fetches the locations of all of the tablets of a table from the master,
+  // a large page at a time, and caches them. 'callback' is fired once they
+  // have all been fetched, or on the first failure.
+  //
+  // From then on, the table's locations are refreshed in the background
+  // before they expire, when lookups of the table come along. The table
+  // is kept alive until the prefetch finishes, so it must be owned by a
+  // shared_ptr.
+  void PrefetchTableLocations(const KuduTable* table,
+                              const MonoTime& deadline,
+                              const StatusCallback& callback);
+
   // Clears the meta cache.
   void ClearCache();
 
@@ -396,9 +453,11 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
 
  private:
   friend class LookupRpc;
+  friend class TableLocationsPrefetch;
 
   FRIEND_TEST(client::ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(client::ClientTest, TestMetaCacheExpiry);
+  FRIEND_TEST(client::ClientTest, TestPrefetchTabletLocations);
 
   // Called on the slow LookupTablet path when the master responds. Populates
   // the tablet caches and returns a reference to the first one.
@@ -410,6 +469,28 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                  const std::string& partition_key,
                                  MetaCacheEntry* entry);
 
+  // LookupTabletsByKeysFastPath() with lock_ held.
+  void LookupTabletsByKeysFastPathUnlocked(
+      const KuduTable* table,
+      const std::vector<const std::string*>& partition_keys,
+      std::vector<scoped_refptr<RemoteTablet>>* remote_tablets);
+
+  // Called when a prefetch of the locations of the table with id 'table_id',
+  // which started at 'start_time', has finished. Schedules the next refresh.
+  void PrefetchFinished(const std::string& table_id,
+                        const MonoTime& start_time,
+                        const Status& s);
+
+  // Returns true if the table with id 'table_id' has been prefetched and its
+  // locations are due for a background refresh.
+  //
+  // NOTE: Must be called with lock_ held.
+  bool IsRefreshAheadDueUnlocked(const std::string& table_id) const;
+
+  // Starts refreshing the locations of a prefetched table in the background,
+  // unless a refresh is already in progress.
+  void RefreshAhead(const KuduTable* table);
+
   // Update our information about the given tablet server.
   //
   // This is called when we get some response from the master which contains
@@ -446,6 +527,22 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
   // Protected by lock_
   std::unordered_map<std::string, scoped_refptr<RemoteTablet>> tablets_by_id_;
 
+  // Refresh-ahead state of a table whose locations were prefetched.
+  struct PrefetchedTable {
+    PrefetchedTable() : refreshing(false) {}
+
+    // When to refresh the table's locations.
+    MonoTime refresh_time;
+
+    // Whether a refresh is in progress.
+    bool refreshing;
+  };
+
+  // Tables whose locations were prefetched, keyed by table id.
+  //
+  // Protected by lock_.
+  std::unordered_map<std::string, PrefetchedTable> prefetched_tables_;
+
   // Prevents master lookup "storms" by delaying master lookups when all
   // permits have been acquired.
   Semaphore master_lookup_sem_;
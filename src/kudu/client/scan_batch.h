@@ -39,6 +39,10 @@ class ReplicaDumper;
 namespace client {
 class KuduSchema;
 
+namespace internal {
+class ParallelTabletScan;
+} // namespace internal
+
 /// @brief A batch of zero or more rows returned by a scan operation.
 ///
 /// Every call to KuduScanner::NextBatch() returns a batch of zero or more rows.
@@ -119,6 +123,7 @@ class KUDU_EXPORT KuduScanBatch {
  private:
   class KUDU_NO_EXPORT Data;
   friend class KuduScanner;
+  friend class internal::ParallelTabletScan;
   friend class tools::ReplicaDumper;
 
   Data* data_;
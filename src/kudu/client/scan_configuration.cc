@@ -34,6 +34,7 @@ namespace client {
 
 const uint64_t ScanConfiguration::kNoTimestamp = KuduClient::kNoTimestamp;
 const int ScanConfiguration::kHtTimestampBitsToShift = 12;
+const int64_t ScanConfiguration::kDefaultMaxBufferedBytes = 64 * 1024 * 1024;
 
 ScanConfiguration::ScanConfiguration(KuduTable* table)
     : table_(table),
@@ -41,6 +42,11 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       client_projection_(*table->schema().schema_),
       has_batch_size_bytes_(false),
       batch_size_bytes_(0),
+      readahead_batches_(0),
+      prefetch_batches_(0),
+      max_concurrent_tablets_(1),
+      max_buffered_bytes_(kDefaultMaxBufferedBytes),
+      hedging_percentile_(0),
       selection_(KuduClient::CLOSEST_REPLICA),
       read_mode_(KuduScanner::READ_LATEST),
       is_fault_tolerant_(false),
@@ -146,6 +152,40 @@ Status ScanConfiguration::SetBatchSizeBytes(uint32_t batch_size) {
   return Status::OK();
 }
 
+Status ScanConfiguration::SetReadaheadBatches(uint32_t num_batches) {
+  readahead_batches_ = num_batches;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetPrefetchBatches(uint32_t num_batches) {
+  prefetch_batches_ = num_batches;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetMaxConcurrentTablets(int num_tablets) {
+  if (num_tablets < 1) {
+    return Status::InvalidArgument("number of concurrent tablets must be positive");
+  }
+  max_concurrent_tablets_ = num_tablets;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetMaxBufferedBytes(int64_t max_bytes) {
+  if (max_bytes < 1) {
+    return Status::InvalidArgument("maximum buffered bytes must be positive");
+  }
+  max_buffered_bytes_ = max_bytes;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetHedgingPercentile(double percentile) {
+  if (percentile <= 0 || percentile > 100) {
+    return Status::InvalidArgument("hedging percentile must be greater than 0 and at most 100");
+  }
+  hedging_percentile_ = percentile;
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetSelection(KuduClient::ReplicaSelection selection) {
   selection_ = selection;
   return Status::OK();
@@ -183,5 +223,36 @@ void ScanConfiguration::OptimizeScanSpec() {
                      /* remove_pushed_predicates */ false);
 }
 
+Status ScanConfiguration::CopyFrom(const ScanConfiguration& other) {
+  DCHECK_EQ(table_, other.table_);
+  projection_ = other.projection_;
+  client_projection_ = KuduSchema(*projection_);
+
+  for (const auto& col_pred : other.spec_.predicates()) {
+    AddConjunctPredicate(col_pred.second);
+  }
+  if (other.spec_.lower_bound_key()) {
+    RETURN_NOT_OK(AddLowerBoundRaw(other.spec_.lower_bound_key()->encoded_key()));
+  }
+  if (other.spec_.exclusive_upper_bound_key()) {
+    RETURN_NOT_OK(AddUpperBoundRaw(other.spec_.exclusive_upper_bound_key()->encoded_key()));
+  }
+  RETURN_NOT_OK(AddLowerBoundPartitionKeyRaw(other.spec_.lower_bound_partition_key()));
+  RETURN_NOT_OK(AddUpperBoundPartitionKeyRaw(other.spec_.exclusive_upper_bound_partition_key()));
+  spec_.set_cache_blocks(other.spec_.cache_blocks());
+
+  has_batch_size_bytes_ = other.has_batch_size_bytes_;
+  batch_size_bytes_ = other.batch_size_bytes_;
+  readahead_batches_ = other.readahead_batches_;
+  prefetch_batches_ = other.prefetch_batches_;
+  hedging_percentile_ = other.hedging_percentile_;
+  selection_ = other.selection_;
+  read_mode_ = other.read_mode_;
+  is_fault_tolerant_ = other.is_fault_tolerant_;
+  snapshot_timestamp_ = other.snapshot_timestamp_;
+  timeout_ = other.timeout_;
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
@@ -63,6 +63,16 @@ class ScanConfiguration {
 
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  Status SetReadaheadBatches(uint32_t num_batches);
+
+  Status SetPrefetchBatches(uint32_t num_batches);
+
+  Status SetMaxConcurrentTablets(int num_tablets) WARN_UNUSED_RESULT;
+
+  Status SetMaxBufferedBytes(int64_t max_bytes) WARN_UNUSED_RESULT;
+
+  Status SetHedgingPercentile(double percentile) WARN_UNUSED_RESULT;
+
   Status SetSelection(KuduClient::ReplicaSelection selection) WARN_UNUSED_RESULT;
 
   Status SetReadMode(KuduScanner::ReadMode read_mode) WARN_UNUSED_RESULT;
@@ -77,6 +87,14 @@ class ScanConfiguration {
 
   void OptimizeScanSpec();
 
+  // Copies the projection, predicates, bounds and scan options of 'other'
+  // into this configuration, for use by a scanner over a subset of the
+  // tablets of the same table.
+  //
+  // The projection schema and predicate values are shared rather than
+  // deep-copied, so 'other' must outlive this configuration.
+  Status CopyFrom(const ScanConfiguration& other) WARN_UNUSED_RESULT;
+
   const KuduTable& table() {
     return *table_;
   }
@@ -108,6 +126,31 @@ class ScanConfiguration {
     return batch_size_bytes_;
   }
 
+  uint32_t readahead_batches() const {
+    return readahead_batches_;
+  }
+
+  uint32_t prefetch_batches() const {
+    return prefetch_batches_;
+  }
+
+  int max_concurrent_tablets() const {
+    return max_concurrent_tablets_;
+  }
+
+  int64_t max_buffered_bytes() const {
+    return max_buffered_bytes_;
+  }
+
+  bool has_hedging_percentile() const {
+    return hedging_percentile_ > 0;
+  }
+
+  double hedging_percentile() const {
+    CHECK(has_hedging_percentile());
+    return hedging_percentile_;
+  }
+
   KuduClient::ReplicaSelection selection() const {
     return selection_;
   }
@@ -142,6 +185,7 @@ class ScanConfiguration {
 
   static const uint64_t kNoTimestamp;
   static const int kHtTimestampBitsToShift;
+  static const int64_t kDefaultMaxBufferedBytes;
 
   // Non-owned, non-null table.
   KuduTable* table_;
@@ -157,6 +201,16 @@ class ScanConfiguration {
   bool has_batch_size_bytes_;
   uint32 batch_size_bytes_;
 
+  uint32 readahead_batches_;
+
+  uint32 prefetch_batches_;
+
+  int max_concurrent_tablets_;
+  int64_t max_buffered_bytes_;
+
+  // 0 if scan requests are not hedged.
+  double hedging_percentile_;
+
   KuduClient::ReplicaSelection selection_;
 
   KuduScanner::ReadMode read_mode_;
@@ -18,9 +18,11 @@
 #include "kudu/client/scan_token-internal.h"
 
 #include <boost/optional.hpp>
-#include <vector>
-#include <string>
 #include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client.h"
@@ -35,6 +37,8 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 
+using std::pair;
+using std::set;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -162,7 +166,33 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
 }
 
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::GetTabletSplitKeys(KuduClient* client,
+                                                      const scoped_refptr<internal::RemoteTablet>& tablet,
+                                                      const MonoTime& deadline,
+                                                      vector<string>* split_keys) const {
+  set<string> blacklist;
+  vector<internal::RemoteTabletServer*> candidates;
+  internal::RemoteTabletServer* ts;
+  RETURN_NOT_OK(client->data_->GetTabletServer(client, tablet, configuration_.selection(),
+                                               blacklist, &candidates, &ts));
+
+  tserver::SplitKeyRangeRequestPB req;
+  tserver::SplitKeyRangeResponsePB resp;
+  rpc::RpcController controller;
+  req.set_tablet_id(tablet->tablet_id());
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+  controller.set_deadline(deadline);
+  controller.RequireServerFeature(tserver::TabletServerFeatures::SPLIT_KEY_RANGE);
+  RETURN_NOT_OK(ts->proxy()->SplitKeyRange(req, &resp, &controller));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  split_keys->assign(resp.split_keys().begin(), resp.split_keys().end());
+  return Status::OK();
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -253,49 +283,82 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
       continue;
     }
 
-    vector<internal::RemoteReplica> replicas;
-    tablet->GetRemoteReplicas(&replicas);
-
-    vector<const KuduReplica*> client_replicas;
-    ElementDeleter deleter(&client_replicas);
-
-    // Convert the replicas from their internal format to something appropriate
-    // for clients.
-    for (const auto& r : replicas) {
-      vector<HostPort> host_ports;
-      r.ts->GetHostPorts(&host_ports);
-      if (host_ports.empty()) {
-        return Status::IllegalState(Substitute(
-            "No host found for tablet server $0", r.ts->ToString()));
+    // Cut the tablet into chunks along its split keys, if requested. Each
+    // chunk covers [lower, upper) of the primary key space, intersected with
+    // the scan's own primary key bounds; empty bounds are unbounded.
+    vector<string> split_keys;
+    if (split_size_bytes_ > 0) {
+      s = GetTabletSplitKeys(client, tablet, deadline, &split_keys);
+      if (!s.ok()) {
+        // Splitting is only an optimization: fall back to one token
+        // covering the whole tablet.
+        LOG(WARNING) << Substitute("Unable to split tablet $0 into scan tokens: $1",
+                                   tablet->tablet_id(), s.ToString());
+        split_keys.clear();
       }
-      unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
-      client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
-                                                    host_ports[0]);
-      bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
-      unique_ptr<KuduReplica> client_replica(new KuduReplica);
-      client_replica->data_ = new KuduReplica::Data(is_leader,
-                                                    std::move(client_ts));
-      client_replicas.push_back(client_replica.release());
     }
+    vector<pair<string, string>> ranges;
+    string lower = pb.lower_bound_primary_key();
+    const string& upper = pb.upper_bound_primary_key();
+    for (const string& key : split_keys) {
+      if (key <= lower) continue;
+      if (!upper.empty() && key >= upper) break;
+      ranges.emplace_back(lower, key);
+      lower = key;
+    }
+    ranges.emplace_back(std::move(lower), upper);
+
+    for (const auto& range : ranges) {
+      vector<internal::RemoteReplica> replicas;
+      tablet->GetRemoteReplicas(&replicas);
+
+      vector<const KuduReplica*> client_replicas;
+      ElementDeleter deleter(&client_replicas);
+
+      // Convert the replicas from their internal format to something appropriate
+      // for clients.
+      for (const auto& r : replicas) {
+        vector<HostPort> host_ports;
+        r.ts->GetHostPorts(&host_ports);
+        if (host_ports.empty()) {
+          return Status::IllegalState(Substitute(
+              "No host found for tablet server $0", r.ts->ToString()));
+        }
+        unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
+        client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
+                                                      host_ports[0]);
+        bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
+        unique_ptr<KuduReplica> client_replica(new KuduReplica);
+        client_replica->data_ = new KuduReplica::Data(is_leader,
+                                                      std::move(client_ts));
+        client_replicas.push_back(client_replica.release());
+      }
 
-    unique_ptr<KuduTablet> client_tablet(new KuduTablet);
-    client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
-                                                std::move(client_replicas));
-    client_replicas.clear();
-
-    // Create the scan token itself.
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(
-        tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(
-        tablet->partition().partition_key_end());
-    unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
-    client_scan_token->data_ =
-        new KuduScanToken::Data(table,
-                                std::move(message),
-                                std::move(client_tablet));
-    tokens->push_back(client_scan_token.release());
+      unique_ptr<KuduTablet> client_tablet(new KuduTablet);
+      client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
+                                                  std::move(client_replicas));
+      client_replicas.clear();
+
+      // Create the scan token itself.
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(
+          tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(
+          tablet->partition().partition_key_end());
+      if (!range.first.empty()) {
+        message.set_lower_bound_primary_key(range.first);
+      }
+      if (!range.second.empty()) {
+        message.set_upper_bound_primary_key(range.second);
+      }
+      unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
+      client_scan_token->data_ =
+          new KuduScanToken::Data(table,
+                                  std::move(message),
+                                  std::move(client_tablet));
+      tokens->push_back(client_scan_token.release());
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
@@ -24,10 +24,16 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/scan_configuration.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/monotime.h"
 
 namespace kudu {
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -71,8 +77,23 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void set_split_size_bytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Ask a replica of 'tablet' for the primary keys which split it into
+  // chunks of about 'split_size_bytes_' each.
+  Status GetTabletSplitKeys(KuduClient* client,
+                            const scoped_refptr<internal::RemoteTablet>& tablet,
+                            const MonoTime& deadline,
+                            std::vector<std::string>* split_keys) const;
+
   ScanConfiguration configuration_;
+
+  // If non-zero, tablets are split into several tokens covering about this
+  // many bytes of on-disk data each.
+  uint64_t split_size_bytes_;
 };
 
 } // namespace client
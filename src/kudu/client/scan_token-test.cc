@@ -26,8 +26,11 @@
 #include "kudu/client/client.pb.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
@@ -40,6 +43,7 @@ using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
+using tablet::TabletPeer;
 using tserver::MiniTabletServer;
 
 class ScanTokenTest : public KuduTest {
@@ -375,6 +379,151 @@ TEST_F(ScanTokenTest, TestScanTokensWithNonCoveringRange) {
   }
 }
 
+// Verify that tablets are split into several tokens of about the requested
+// size once their data is flushed.
+TEST_F(ScanTokenTest, TestSplitSizeBytes) {
+  const int kNumRows = 10000;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("key")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    builder.AddColumn("val")->NotNull()->Type(KuduColumnSchema::STRING);
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table with a single tablet.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({ "key" })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("key", i));
+    ASSERT_OK(insert->mutable_row()->SetStringCopy("val", string(100, 'x')));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  // Split keys are only computed for data which has been flushed to disk.
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  ASSERT_EQ(1, peers.size());
+  ASSERT_OK(peers[0]->tablet()->Flush());
+  const uint64_t tablet_size = peers[0]->tablet()->EstimateOnDiskSize();
+  ASSERT_GT(tablet_size, 0);
+
+  { // no splitting requested
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(KuduScanTokenBuilder(table.get()).Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+  }
+
+  { // split size larger than the tablet
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(tablet_size * 2));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // split into about four chunks
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(tablet_size / 4));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_GE(tokens.size(), 3);
+    ASSERT_LE(tokens.size(), 5);
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // split with a primary key bound
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPartialRow> lower_bound(schema.NewRow());
+    ASSERT_OK(lower_bound->SetInt64("key", kNumRows / 2));
+    ASSERT_OK(builder.AddLowerBound(*lower_bound));
+    ASSERT_OK(builder.SetSplitSizeBytes(tablet_size / 4));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_GE(tokens.size(), 1);
+    ASSERT_LE(tokens.size(), 3);
+    ASSERT_EQ(kNumRows / 2, CountRows(tokens));
+  }
+}
+
+// Like TestSplitSizeBytes, but with a composite primary key, whose key index
+// can't be seeked by row ordinal.
+TEST_F(ScanTokenTest, TestSplitSizeBytesWithCompositeKey) {
+  const int kNumRows = 10000;
+  const int kRowsPerKey1 = 10;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("key1")->NotNull()->Type(KuduColumnSchema::INT32);
+    builder.AddColumn("key2")->NotNull()->Type(KuduColumnSchema::STRING);
+    builder.AddColumn("val")->NotNull()->Type(KuduColumnSchema::STRING);
+    builder.SetPrimaryKey({ "key1", "key2" });
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table with a single tablet.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({ "key1" })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt32("key1", i / kRowsPerKey1));
+    ASSERT_OK(insert->mutable_row()->SetStringCopy("key2",
+                                                   std::to_string(i % kRowsPerKey1)));
+    ASSERT_OK(insert->mutable_row()->SetStringCopy("val", string(100, 'x')));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  ASSERT_EQ(1, peers.size());
+  ASSERT_OK(peers[0]->tablet()->Flush());
+  const uint64_t tablet_size = peers[0]->tablet()->EstimateOnDiskSize();
+  ASSERT_GT(tablet_size, 0);
+
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  KuduScanTokenBuilder builder(table.get());
+  ASSERT_OK(builder.SetSplitSizeBytes(tablet_size / 4));
+  ASSERT_OK(builder.Build(&tokens));
+  ASSERT_GE(tokens.size(), 3);
+  ASSERT_LE(tokens.size(), 5);
+  ASSERT_EQ(kNumRows, CountRows(tokens));
+}
+
 // When building a scanner from a serialized scan token,
 // verify that the propagated timestamp from the token makes its way into the
 // latest observed timestamp of the client object.
@@ -20,24 +20,34 @@
 #include <algorithm>
 #include <boost/bind.hpp>
 #include <cmath>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/client/client-internal.h"
+#include "kudu/client/client_metrics.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/table-internal.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/hexdump.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/thread.h"
 
 using google::protobuf::FieldDescriptor;
 using google::protobuf::Reflection;
 
+using std::map;
 using std::set;
 using std::string;
+using std::unique_ptr;
 
 namespace kudu {
 
@@ -49,15 +59,42 @@ using tserver::TabletServerFeatures;
 
 namespace client {
 
+using internal::ClientMetrics;
+using internal::RemoteTablet;
 using internal::RemoteTabletServer;
 
+namespace {
+
+// Records the round-trip time of a scan RPC to 'ts' whose outcome was
+// 'rpc_status', both for replica selection and in 'metrics'. RPCs which
+// failed without reaching the server, other than by timing out, say nothing
+// about its latency and are not recorded.
+void RecordScanLatency(ClientMetrics* metrics,
+                       RemoteTabletServer* ts,
+                       const MonoDelta& round_trip_time,
+                       const Status& rpc_status,
+                       const tserver::ScanResponsePB& resp) {
+  if (!rpc_status.ok() && !rpc_status.IsRemoteError() && !rpc_status.IsTimedOut()) {
+    return;
+  }
+  ts->RecordLatency(round_trip_time, MonoDelta::FromMicroseconds(resp.queue_time_us()));
+  metrics->client_scan_rpc_latency->Increment(round_trip_time.ToMicroseconds());
+  ts->metrics().client_tablet_server_scan_rpc_latency->Increment(
+      round_trip_time.ToMicroseconds());
+}
+
+} // anonymous namespace
+
 KuduScanner::Data::Data(KuduTable* table)
   : configuration_(table),
     open_(false),
     data_in_open_(false),
     short_circuit_(false),
     table_(DCHECK_NOTNULL(table)->shared_from_this()),
-    scan_attempts_(0) {
+    scan_attempts_(0),
+    prefetch_cond_(&prefetch_lock_),
+    prefetches_in_flight_(0),
+    prefetch_stopped_(false) {
 }
 
 KuduScanner::Data::~Data() {
@@ -65,7 +102,12 @@ KuduScanner::Data::~Data() {
 
 Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
                                       const MonoTime& deadline,
-                                      set<string>* blacklist) {
+                                      set<string>* blacklist,
+                                      MonoDelta* retry_delay) {
+  if (retry_delay) {
+    *retry_delay = MonoDelta::FromNanoseconds(0);
+  }
+
   // If we timed out because of the overall deadline, we're done.
   // We didn't wait a full RPC timeout, though, so don't mark the tserver as failed.
   if (err.result == ScanRpcStatus::OVERALL_DEADLINE_EXCEEDED) {
@@ -124,6 +166,11 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
   if (backoff) {
     MonoDelta sleep =
         KuduClient::Data::ComputeExponentialBackoff(scan_attempts_);
+    // Honor the server's backoff hint, if it provided one.
+    MonoDelta server_retry_after = controller_.server_retry_after();
+    if (server_retry_after > sleep) {
+      sleep = server_retry_after;
+    }
     MonoTime now = MonoTime::Now() + sleep;
     if (deadline < now) {
       Status ret = Status::TimedOut("unable to retry before timeout",
@@ -134,9 +181,14 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
     VLOG(1) << "Error scanning on server " << ts_->ToString() << ": "
             << err.status.ToString() << ". Will retry after "
             << sleep.ToString() << "; attempt " << scan_attempts_;
-    SleepFor(sleep);
+    if (retry_delay) {
+      *retry_delay = sleep;
+    } else {
+      SleepFor(sleep);
+    }
   }
   if (can_retry) {
+    table_->client()->data_->metrics_->client_scan_rpc_retries->Increment();
     return Status::OK();
   }
   return err.status;
@@ -221,41 +273,261 @@ Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                     blacklist);
 }
 
-ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
-                                             bool allow_time_for_failover) {
+MonoTime KuduScanner::Data::ScanRpcDeadline(const MonoTime& overall_deadline,
+                                            bool allow_time_for_failover) const {
   // The user has specified a timeout which should apply to the total time for each call
   // to NextBatch(). However, for fault-tolerant scans, or for when we are first opening
   // a scanner, it's preferable to set a shorter timeout (the "default RPC timeout") for
   // each individual RPC call. This gives us time to fail over to a different server
   // if the first server we try happens to be hung.
-  MonoTime rpc_deadline;
   if (allow_time_for_failover) {
-    rpc_deadline = MonoTime::Now() + table_->client()->default_rpc_timeout();
-    rpc_deadline = MonoTime::Earliest(overall_deadline, rpc_deadline);
-  } else {
-    rpc_deadline = overall_deadline;
+    return MonoTime::Earliest(overall_deadline,
+                              MonoTime::Now() + table_->client()->default_rpc_timeout());
   }
+  return overall_deadline;
+}
+
+ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
+                                             bool allow_time_for_failover) {
+  MonoTime rpc_deadline = ScanRpcDeadline(overall_deadline, allow_time_for_failover);
 
   controller_.Reset();
   controller_.set_deadline(rpc_deadline);
   if (!configuration_.spec().predicates().empty()) {
     controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
   }
-  ScanRpcStatus scan_status = AnalyzeResponse(
-      proxy_->Scan(next_req_,
-                   &last_response_,
-                   &controller_),
-      rpc_deadline, overall_deadline);
+  MonoTime start_time = MonoTime::Now();
+  Status rpc_status = proxy_->Scan(next_req_, &last_response_, &controller_);
+  RecordScanLatency(table_->client()->data_->metrics_.get(), ts_,
+                    MonoTime::Now() - start_time, rpc_status, last_response_);
+  ScanRpcStatus scan_status = AnalyzeResponse(rpc_status, rpc_deadline, overall_deadline);
   if (scan_status.result == ScanRpcStatus::OK) {
     UpdateResourceMetrics();
   }
   return scan_status;
 }
 
-Status KuduScanner::Data::OpenTablet(const string& partition_key,
-                                     const MonoTime& deadline,
-                                     set<string>* blacklist) {
+namespace {
+
+// A request of a hedged scan, sent to one of the replicas of the tablet.
+struct HedgedScanCall {
+  RemoteTabletServer* ts = nullptr;
+  std::shared_ptr<tserver::TabletServerServiceProxy> proxy;
+  tserver::ScanResponsePB response;
+  RpcController controller;
+  MonoTime start_time;
+  MonoTime finish_time;
 
+  // Set once the RPC has completed, successfully or not.
+  bool finished = false;
+
+  bool succeeded() const {
+    return controller.status().ok() && !response.has_error();
+  }
+};
+
+// The state of a hedged scan, shared with the completion callbacks of its
+// requests. The request which loses the race may complete after the scanner
+// has moved on or been destroyed, so this outlives the scanner if need be.
+struct HedgedScan {
+  HedgedScan() : cond(&lock) {}
+
+  Mutex lock;
+  ConditionVariable cond;
+
+  HedgedScanCall calls[2];
+  int num_calls = 0;
+
+  // Set once the scanner has taken the response it uses. Requests which
+  // complete afterwards close the server-side scanner they opened.
+  bool abandoned = false;
+
+  MonoDelta close_timeout;
+};
+
+// Callback for the RPC closing a scanner opened by the losing request of
+// a hedged scan.
+struct HedgedScannerCloser {
+  tserver::ScanRequestPB request;
+  tserver::ScanResponsePB response;
+  RpcController controller;
+  void Callback() {
+    if (!controller.status().ok()) {
+      LOG(WARNING) << "Couldn't close scanner " << request.scanner_id() << ": "
+                   << controller.status().ToString();
+    }
+    delete this;
+  }
+};
+
+// Closes the server-side scanner opened by 'call', if any.
+void CloseHedgedScanner(HedgedScanCall* call, const MonoDelta& timeout) {
+  // Tablet servers don't keep a scanner open once it has returned all of
+  // its rows.
+  if (!call->succeeded() || !call->response.has_more_results()) {
+    return;
+  }
+  gscoped_ptr<HedgedScannerCloser> closer(new HedgedScannerCloser);
+  closer->request.set_scanner_id(call->response.scanner_id());
+  closer->request.set_call_seq_id(1);
+  closer->request.set_batch_size_bytes(0);
+  closer->request.set_close_scanner(true);
+  closer->controller.set_timeout(timeout);
+  call->proxy->ScanAsync(closer->request, &closer->response, &closer->controller,
+                         boost::bind(&HedgedScannerCloser::Callback, closer.get()));
+  ignore_result(closer.release());
+}
+
+// Completion callback of the RPC for the 'idx'th call of 'scan'. Runs on a
+// reactor thread.
+void HedgedScanCallDone(const std::shared_ptr<HedgedScan>& scan, int idx) {
+  HedgedScanCall* call = &scan->calls[idx];
+  bool abandoned;
+  {
+    MutexLock l(scan->lock);
+    call->finish_time = MonoTime::Now();
+    call->finished = true;
+    abandoned = scan->abandoned;
+    scan->cond.Broadcast();
+  }
+  if (abandoned) {
+    CloseHedgedScanner(call, scan->close_timeout);
+  }
+}
+
+// Sends 'req' to 'ts' as the next call of 'scan'.
+void SendHedgedScanCall(const std::shared_ptr<HedgedScan>& scan,
+                        RemoteTabletServer* ts,
+                        const tserver::ScanRequestPB& req,
+                        const MonoTime& deadline,
+                        bool require_column_predicates) {
+  int idx = scan->num_calls++;
+  HedgedScanCall* call = &scan->calls[idx];
+  call->ts = ts;
+  call->proxy = ts->proxy();
+  call->controller.set_deadline(deadline);
+  if (require_column_predicates) {
+    call->controller.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+  }
+  call->start_time = MonoTime::Now();
+  call->proxy->ScanAsync(req, &call->response, &call->controller,
+                         boost::bind(&HedgedScanCallDone, scan, idx));
+}
+
+} // anonymous namespace
+
+ScanRpcStatus KuduScanner::Data::SendNewScanRpc(const MonoTime& overall_deadline,
+                                                bool allow_time_for_failover,
+                                                const set<string>& blacklist) {
+  KuduClient* client = table_->client();
+  MonoDelta hedge_delay;
+  if (configuration_.read_mode() != KuduScanner::READ_AT_SNAPSHOT ||
+      !configuration_.has_hedging_percentile() ||
+      !client->data_->GetScanOpenLatencyPercentile(configuration_.hedging_percentile(),
+                                                   &hedge_delay)) {
+    MonoTime start_time = MonoTime::Now();
+    ScanRpcStatus scan_status = SendScanRpc(overall_deadline, allow_time_for_failover);
+    if (scan_status.result == ScanRpcStatus::OK) {
+      client->data_->RecordScanOpenLatency(MonoTime::Now() - start_time);
+    }
+    return scan_status;
+  }
+
+  MonoTime rpc_deadline = ScanRpcDeadline(overall_deadline, allow_time_for_failover);
+  bool require_column_predicates = !configuration_.spec().predicates().empty();
+  std::shared_ptr<HedgedScan> hedged_scan = std::make_shared<HedgedScan>();
+  hedged_scan->close_timeout = client->default_rpc_timeout();
+
+  SendHedgedScanCall(hedged_scan, ts_, next_req_, rpc_deadline, require_column_predicates);
+
+  // Give the first replica until the hedging delay has elapsed to respond.
+  MonoTime hedge_time = hedged_scan->calls[0].start_time + hedge_delay;
+  bool first_finished;
+  {
+    MutexLock l(hedged_scan->lock);
+    while (!hedged_scan->calls[0].finished &&
+           hedged_scan->cond.TimedWait(hedge_time - MonoTime::Now())) {
+    }
+    first_finished = hedged_scan->calls[0].finished;
+  }
+
+  if (!first_finished) {
+    set<string> hedge_blacklist(blacklist);
+    hedge_blacklist.insert(ts_->permanent_uuid());
+    vector<RemoteTabletServer*> candidates;
+    RemoteTabletServer* ts;
+    Status s = client->data_->GetTabletServer(client, remote_, KuduClient::CLOSEST_REPLICA,
+                                              hedge_blacklist, &candidates, &ts);
+    if (s.ok()) {
+      VLOG(1) << "Hedging scan of tablet " << remote_->tablet_id() << " on "
+              << ts->ToString() << " after " << hedge_delay.ToString();
+      SendHedgedScanCall(hedged_scan, ts, next_req_, rpc_deadline, require_column_predicates);
+    } else {
+      VLOG(1) << "Unable to hedge scan of tablet " << remote_->tablet_id() << ": "
+              << s.ToString();
+    }
+  }
+
+  // Take the first successful response. If every request fails, take the
+  // first replica's error so that it is handled as in SendScanRpc().
+  int winner = -1;
+  vector<HedgedScanCall*> losers;
+  {
+    MutexLock l(hedged_scan->lock);
+    while (true) {
+      bool all_finished = true;
+      for (int i = 0; i < hedged_scan->num_calls && winner == -1; i++) {
+        const HedgedScanCall& call = hedged_scan->calls[i];
+        if (!call.finished) {
+          all_finished = false;
+        } else if (call.succeeded()) {
+          winner = i;
+        }
+      }
+      if (winner != -1) break;
+      if (all_finished) {
+        winner = 0;
+        break;
+      }
+      hedged_scan->cond.Wait();
+    }
+    hedged_scan->abandoned = true;
+    for (int i = 0; i < hedged_scan->num_calls; i++) {
+      HedgedScanCall* call = &hedged_scan->calls[i];
+      if (!call->finished) {
+        continue;
+      }
+      RecordScanLatency(client->data_->metrics_.get(), call->ts,
+                        call->finish_time - call->start_time,
+                        call->controller.status(), call->response);
+      if (call->succeeded()) {
+        client->data_->RecordScanOpenLatency(call->finish_time - call->start_time);
+      }
+      if (i != winner) {
+        losers.push_back(call);
+      }
+    }
+  }
+
+  // Requests still in flight close their scanners once they complete.
+  for (HedgedScanCall* call : losers) {
+    CloseHedgedScanner(call, hedged_scan->close_timeout);
+  }
+
+  HedgedScanCall* call = &hedged_scan->calls[winner];
+  ts_ = call->ts;
+  proxy_ = call->proxy;
+  controller_.Swap(&call->controller);
+  last_response_.Swap(&call->response);
+  ScanRpcStatus scan_status = AnalyzeResponse(controller_.status(),
+                                              rpc_deadline, overall_deadline);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  return scan_status;
+}
+
+Status KuduScanner::Data::PrepareNewScanRequest() {
   PrepareRequest(KuduScanner::Data::NEW);
   next_req_.clear_scanner_id();
   NewScanRequestPB* scan = next_req_.mutable_new_scan_request();
@@ -321,6 +593,77 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   }
   RETURN_NOT_OK(SchemaToColumnPBs(*configuration_.projection(), scan->mutable_projected_columns(),
                                   SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
+  return Status::OK();
+}
+
+Status KuduScanner::Data::OnTabletLookedUp(const string& partition_key,
+                                           const Status& lookup_status,
+                                           bool* scan_tablet) {
+  *scan_tablet = false;
+  if (lookup_status.IsNotFound()) {
+    // No more tablets in the table.
+    partition_pruner_.RemovePartitionKeyRange("");
+    return Status::OK();
+  }
+  RETURN_NOT_OK(lookup_status);
+
+  // Check if the meta cache returned a tablet covering a partition key range past
+  // what we asked for. This can happen if the requested partition key falls
+  // in a non-covered range. In this case we can potentially prune the tablet.
+  if (partition_key < remote_->partition().partition_key_start() &&
+      partition_pruner_.ShouldPrune(remote_->partition())) {
+    partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
+    return Status::OK();
+  }
+
+  next_req_.mutable_new_scan_request()->set_tablet_id(remote_->tablet_id());
+  *scan_tablet = true;
+  return Status::OK();
+}
+
+void KuduScanner::Data::FinishOpenTablet() {
+  partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
+
+  next_req_.clear_new_scan_request();
+  data_in_open_ = last_response_.has_data();
+  if (last_response_.has_more_results()) {
+    next_req_.set_scanner_id(last_response_.scanner_id());
+    VLOG(2) << "Opened tablet " << remote_->tablet_id()
+            << ", scanner ID " << last_response_.scanner_id();
+  } else if (last_response_.has_data()) {
+    VLOG(2) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
+  } else {
+    VLOG(2) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
+  }
+
+  // If present in the response, set the snapshot timestamp and the encoded last
+  // primary key.  This is used when retrying the scan elsewhere.  The last
+  // primary key is also updated on each scan response.
+  if (configuration().is_fault_tolerant()) {
+    if (last_response_.has_last_primary_key()) {
+      last_primary_key_ = last_response_.last_primary_key();
+    }
+  }
+
+  if (configuration_.read_mode() == KuduScanner::READ_AT_SNAPSHOT &&
+      !configuration_.has_snapshot_timestamp()) {
+    // There must be a snapshot timestamp returned by the tablet server:
+    // it's the first response from the tablet server when scanning in the
+    // READ_AT_SNAPSHOT mode with unspecified snapshot timestamp.
+    CHECK(last_response_.has_snap_timestamp());
+    configuration_.SetSnapshotRaw(last_response_.snap_timestamp());
+  }
+
+  if (last_response_.has_propagated_timestamp()) {
+    table_->client()->data_->UpdateLatestObservedTimestamp(
+        last_response_.propagated_timestamp());
+  }
+}
+
+Status KuduScanner::Data::OpenTablet(const string& partition_key,
+                                     const MonoTime& deadline,
+                                     set<string>* blacklist) {
+  RETURN_NOT_OK(PrepareNewScanRequest());
 
   for (int attempt = 1;; attempt++) {
     Synchronizer sync;
@@ -329,26 +672,12 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
                                                                   deadline,
                                                                   &remote_,
                                                                   sync.AsStatusCallback());
-    Status s = sync.Wait();
-    if (s.IsNotFound()) {
-      // No more tablets in the table.
-      partition_pruner_.RemovePartitionKeyRange("");
+    bool scan_tablet;
+    RETURN_NOT_OK(OnTabletLookedUp(partition_key, sync.Wait(), &scan_tablet));
+    if (!scan_tablet) {
       return Status::OK();
-    } else {
-      RETURN_NOT_OK(s);
     }
 
-    // Check if the meta cache returned a tablet covering a partition key range past
-    // what we asked for. This can happen if the requested partition key falls
-    // in a non-covered range. In this case we can potentially prune the tablet.
-    if (partition_key < remote_->partition().partition_key_start() &&
-        partition_pruner_.ShouldPrune(remote_->partition())) {
-      partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
-      return Status::OK();
-    }
-
-    scan->set_tablet_id(remote_->tablet_id());
-
     RemoteTabletServer *ts;
     vector<RemoteTabletServer*> candidates;
     Status lookup_status = table_->client()->data_->GetTabletServer(
@@ -381,7 +710,7 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     proxy_ = ts_->proxy();
 
     bool allow_time_for_failover = static_cast<int>(candidates.size()) - blacklist->size() > 1;
-    ScanRpcStatus scan_status = SendScanRpc(deadline, allow_time_for_failover);
+    ScanRpcStatus scan_status = SendNewScanRpc(deadline, allow_time_for_failover, *blacklist);
     if (scan_status.result == ScanRpcStatus::OK) {
       last_error_ = Status::OK();
       scan_attempts_ = 0;
@@ -391,44 +720,252 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     RETURN_NOT_OK(HandleError(scan_status, deadline, blacklist));
   }
 
-  partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
+  FinishOpenTablet();
+  return Status::OK();
+}
 
-  next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data();
-  if (last_response_.has_more_results()) {
-    next_req_.set_scanner_id(last_response_.scanner_id());
-    VLOG(2) << "Opened tablet " << remote_->tablet_id()
-            << ", scanner ID " << last_response_.scanner_id();
-  } else if (last_response_.has_data()) {
-    VLOG(2) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
+bool KuduScanner::Data::InitScan() {
+  configuration_.OptimizeScanSpec();
+  partition_pruner_.Init(*table_->schema().schema_,
+                         table_->partition_schema(),
+                         configuration_.spec());
+
+  if (configuration_.spec().CanShortCircuit() ||
+      !partition_pruner_.HasMorePartitionKeyRanges()) {
+    VLOG(2) << "Short circuiting scan " << DebugString();
+    open_ = true;
+    short_circuit_ = true;
+    return true;
+  }
+  return false;
+}
+
+void KuduScanner::Data::StartAsyncCall(KuduScanBatch* batch, KuduStatusCallback* callback) {
+  CHECK(!async_call_.callback) << "Asynchronous scanner call already in progress";
+  async_call_ = AsyncCall();
+  async_call_.batch = batch;
+  async_call_.callback = callback;
+  async_call_.deadline = MonoTime::Now() + configuration_.timeout();
+}
+
+void KuduScanner::Data::FinishAsyncCall(const Status& s) {
+  KuduStatusCallback* callback = async_call_.callback;
+  if (s.ok() && async_call_.batch == nullptr) {
+    open_ = true;
+  }
+  async_call_ = AsyncCall();
+  // The scanner may be reused or destroyed from the callback.
+  callback->Run(s);
+}
+
+void KuduScanner::Data::ScheduleAsyncStep(const MonoDelta& delay,
+                                          const boost::function<void()>& step) {
+  if (delay.ToNanoseconds() <= 0) {
+    step();
+    return;
+  }
+  table_->client()->data_->messenger_->ScheduleOnReactor(
+      boost::bind(&KuduScanner::Data::RunScheduledAsyncStep, this, step, _1), delay);
+}
+
+void KuduScanner::Data::RunScheduledAsyncStep(const boost::function<void()>& step,
+                                              const Status& status) {
+  if (!status.ok()) {
+    FinishAsyncCall(status);
+    return;
+  }
+  step();
+}
+
+void KuduScanner::Data::OpenTabletAsync(const string& partition_key) {
+  Status s = PrepareNewScanRequest();
+  if (!s.ok()) {
+    FinishAsyncCall(s);
+    return;
+  }
+  async_call_.partition_key = partition_key;
+  async_call_.lookup_attempts = 0;
+  LookUpTabletAsync();
+}
+
+void KuduScanner::Data::LookUpTabletAsync() {
+  async_call_.lookup_attempts++;
+  table_->client()->data_->meta_cache_->LookupTabletByKeyOrNext(
+      table_.get(),
+      async_call_.partition_key,
+      async_call_.deadline,
+      &remote_,
+      Bind(&KuduScanner::Data::TabletLookedUpAsync, Unretained(this)));
+}
+
+void KuduScanner::Data::TabletLookedUpAsync(const Status& lookup_status) {
+  bool scan_tablet;
+  Status s = OnTabletLookedUp(async_call_.partition_key, lookup_status, &scan_tablet);
+  if (!s.ok() || !scan_tablet) {
+    FinishAsyncCall(s);
+    return;
+  }
+
+  RemoteTabletServer* ts;
+  vector<RemoteTabletServer*> candidates;
+  s = table_->client()->data_->PickTabletServer(remote_,
+                                                configuration_.selection(),
+                                                async_call_.blacklist,
+                                                &candidates,
+                                                &ts);
+  // As in OpenTablet(), wait for the tablet to get a leader and retry.
+  if (s.IsServiceUnavailable() && MonoTime::Now() < async_call_.deadline) {
+    async_call_.blacklist.clear();
+    MonoDelta delay = MonoDelta::FromMilliseconds(async_call_.lookup_attempts * 100);
+    VLOG(1) << "Tablet " << remote_->tablet_id() << " currently unavailable: "
+            << s.ToString() << ". Retrying in " << delay.ToString();
+    ScheduleAsyncStep(delay, boost::bind(&KuduScanner::Data::LookUpTabletAsync, this));
+    return;
+  }
+  if (!s.ok()) {
+    FinishAsyncCall(s);
+    return;
+  }
+  ts_ = ts;
+  async_call_.allow_time_for_failover =
+      static_cast<int>(candidates.size()) - async_call_.blacklist.size() > 1;
+  ts_->InitProxy(table_->client(),
+                 Bind(&KuduScanner::Data::TabletServerReadyAsync, Unretained(this)));
+}
+
+void KuduScanner::Data::TabletServerReadyAsync(const Status& s) {
+  if (!s.ok()) {
+    FinishAsyncCall(s);
+    return;
+  }
+  proxy_ = ts_->proxy();
+  SendScanAsync(boost::bind(&KuduScanner::Data::OpenScanDone, this));
+}
+
+void KuduScanner::Data::SendScanAsync(const rpc::ResponseCallback& done) {
+  async_call_.rpc_deadline = ScanRpcDeadline(async_call_.deadline,
+                                             async_call_.allow_time_for_failover);
+  controller_.Reset();
+  controller_.set_deadline(async_call_.rpc_deadline);
+  if (!configuration_.spec().predicates().empty()) {
+    controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+  }
+  async_call_.rpc_start_time = MonoTime::Now();
+  proxy_->ScanAsync(next_req_, &last_response_, &controller_, done);
+}
+
+ScanRpcStatus KuduScanner::Data::FinishScanAsync(MonoDelta* round_trip_time) {
+  *round_trip_time = MonoTime::Now() - async_call_.rpc_start_time;
+  RecordScanLatency(table_->client()->data_->metrics_.get(), ts_, *round_trip_time,
+                    controller_.status(), last_response_);
+  ScanRpcStatus scan_status = AnalyzeResponse(controller_.status(),
+                                              async_call_.rpc_deadline,
+                                              async_call_.deadline);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  return scan_status;
+}
+
+void KuduScanner::Data::OpenScanDone() {
+  MonoDelta round_trip_time;
+  ScanRpcStatus scan_status = FinishScanAsync(&round_trip_time);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    table_->client()->data_->RecordScanOpenLatency(round_trip_time);
+    last_error_ = Status::OK();
+    scan_attempts_ = 0;
+    FinishOpenTablet();
+    FinishAsyncCall(Status::OK());
+    return;
+  }
+  scan_attempts_++;
+  MonoDelta retry_delay;
+  Status s = HandleError(scan_status, async_call_.deadline, &async_call_.blacklist,
+                         &retry_delay);
+  if (!s.ok()) {
+    FinishAsyncCall(s);
+    return;
+  }
+  ScheduleAsyncStep(retry_delay, boost::bind(&KuduScanner::Data::LookUpTabletAsync, this));
+}
+
+void KuduScanner::Data::NextBatchAsync() {
+  if (data_in_open_) {
+    // We have data from a previous scan.
+    VLOG(2) << "Extracting data from " << DebugString();
+    data_in_open_ = false;
+    FinishAsyncCall(async_call_.batch->data_->Reset(
+        &controller_,
+        configuration_.projection(),
+        configuration_.client_projection(),
+        make_gscoped_ptr(last_response_.release_data())));
+  } else if (last_response_.has_more_results()) {
+    // More data is available in this tablet.
+    VLOG(2) << "Continuing " << DebugString();
+    PrepareRequest(KuduScanner::Data::CONTINUE);
+    async_call_.allow_time_for_failover = configuration_.is_fault_tolerant();
+    SendContinueScanAsync();
+  } else if (MoreTablets()) {
+    // More data may be available in other tablets. As in NextBatch(), the
+    // call completes with an empty batch once the next tablet is open.
+    VLOG(2) << "Scanning next tablet " << DebugString();
+    last_primary_key_.clear();
+    OpenTabletAsync(partition_pruner_.NextPartitionKey());
   } else {
-    VLOG(2) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
+    // No more data anywhere.
+    FinishAsyncCall(Status::OK());
   }
+}
 
-  // If present in the response, set the snapshot timestamp and the encoded last
-  // primary key.  This is used when retrying the scan elsewhere.  The last
-  // primary key is also updated on each scan response.
-  if (configuration().is_fault_tolerant()) {
+void KuduScanner::Data::SendContinueScanAsync() {
+  SendScanAsync(boost::bind(&KuduScanner::Data::ContinueScanDone, this));
+}
+
+void KuduScanner::Data::ContinueScanDone() {
+  MonoDelta round_trip_time;
+  ScanRpcStatus result = FinishScanAsync(&round_trip_time);
+  if (result.result == ScanRpcStatus::OK) {
     if (last_response_.has_last_primary_key()) {
       last_primary_key_ = last_response_.last_primary_key();
     }
+    scan_attempts_ = 0;
+    FinishAsyncCall(async_call_.batch->data_->Reset(
+        &controller_,
+        configuration_.projection(),
+        configuration_.client_projection(),
+        make_gscoped_ptr(last_response_.release_data())));
+    return;
   }
 
-  if (configuration_.read_mode() == KuduScanner::READ_AT_SNAPSHOT &&
-      !configuration_.has_snapshot_timestamp()) {
-    // There must be a snapshot timestamp returned by the tablet server:
-    // it's the first response from the tablet server when scanning in the
-    // READ_AT_SNAPSHOT mode with unspecified snapshot timestamp.
-    CHECK(last_response_.has_snap_timestamp());
-    configuration_.SetSnapshotRaw(last_response_.snap_timestamp());
+  scan_attempts_++;
+
+  // Error handling, as in NextBatch().
+  async_call_.blacklist.clear();
+  MonoDelta retry_delay;
+  Status s = HandleError(result, async_call_.deadline, &async_call_.blacklist, &retry_delay);
+  if (!s.ok()) {
+    LOG(WARNING) << "Scan at tablet server " << ts_->ToString() << " of tablet "
+                 << DebugString() << " failed: " << result.status.ToString();
+    FinishAsyncCall(s);
+    return;
   }
 
-  if (last_response_.has_propagated_timestamp()) {
-    table_->client()->data_->UpdateLatestObservedTimestamp(
-        last_response_.propagated_timestamp());
+  if (configuration_.is_fault_tolerant()) {
+    LOG(WARNING) << "Attempting to retry scan of tablet " << DebugString() << " elsewhere.";
+    ScheduleAsyncStep(retry_delay, boost::bind(&KuduScanner::Data::OpenTabletAsync, this,
+                                               remote_->partition().partition_key_start()));
+    return;
   }
 
-  return Status::OK();
+  if (async_call_.blacklist.empty()) {
+    // If we didn't blacklist the current server, we can just retry again.
+    ScheduleAsyncStep(retry_delay,
+                      boost::bind(&KuduScanner::Data::SendContinueScanAsync, this));
+    return;
+  }
+  // If we blacklisted the current server, and it's not fault-tolerant, we can't
+  // retry anywhere, so just propagate the error.
+  FinishAsyncCall(result.status);
 }
 
 Status KuduScanner::Data::KeepAlive() {
@@ -442,7 +979,11 @@ Status KuduScanner::Data::KeepAlive() {
   RpcController controller;
   controller.set_timeout(configuration_.timeout());
   tserver::ScannerKeepAliveRequestPB request;
-  request.set_scanner_id(next_req_.scanner_id());
+  {
+    // A prefetch callback may be updating the request concurrently.
+    MutexLock l(prefetch_lock_);
+    request.set_scanner_id(next_req_.scanner_id());
+  }
   tserver::ScannerKeepAliveResponsePB response;
   RETURN_NOT_OK(proxy_->ScannerKeepAlive(request, &response, &controller));
   if (response.has_error()) {
@@ -466,6 +1007,12 @@ void KuduScanner::Data::PrepareRequest(RequestType state) {
     next_req_.clear_batch_size_bytes();
   }
 
+  if (state != KuduScanner::Data::CLOSE && configuration_.readahead_batches() > 0) {
+    next_req_.set_readahead_batches(configuration_.readahead_batches());
+  } else {
+    next_req_.clear_readahead_batches();
+  }
+
   if (state == KuduScanner::Data::NEW) {
     next_req_.set_call_seq_id(0);
   } else {
@@ -479,6 +1026,395 @@ void KuduScanner::Data::UpdateLastError(const Status& error) {
   }
 }
 
+void KuduScanner::Data::MaybePrefetch() {
+  PrefetchedCall* call;
+  std::shared_ptr<tserver::TabletServerServiceProxy> proxy;
+  {
+    MutexLock l(prefetch_lock_);
+    call = PreparePrefetchLocked();
+    proxy = proxy_;
+  }
+  if (call) {
+    SendPrefetchedCall(proxy, call);
+  }
+}
+
+KuduScanner::Data::PrefetchedCall* KuduScanner::Data::PreparePrefetchLocked() {
+  prefetch_lock_.AssertAcquired();
+  if (prefetch_stopped_ ||
+      prefetched_calls_.size() >= configuration_.prefetch_batches()) {
+    return nullptr;
+  }
+
+  // Continuation requests must reach the server in sequence, so only send
+  // one once the previous one has returned with more rows to come. With
+  // nothing prefetched, we're being called from NextBatch() and the previous
+  // response is the one it just received.
+  if (prefetched_calls_.empty()) {
+    if (!last_response_.has_more_results()) {
+      return nullptr;
+    }
+  } else {
+    const PrefetchedCall& last = *prefetched_calls_.back();
+    if (!last.finished ||
+        !last.controller.status().ok() ||
+        last.response.has_error() ||
+        !last.response.has_more_results()) {
+      return nullptr;
+    }
+  }
+
+  unique_ptr<PrefetchedCall> call;
+  if (free_prefetched_calls_.empty()) {
+    call.reset(new PrefetchedCall());
+  } else {
+    call = std::move(free_prefetched_calls_.back());
+    free_prefetched_calls_.pop_back();
+    call->controller.Reset();
+    call->response.Clear();
+    call->finished = false;
+  }
+
+  PrepareRequest(KuduScanner::Data::CONTINUE);
+  call->request.CopyFrom(next_req_);
+  call->deadline = MonoTime::Now() + configuration_.timeout();
+  call->controller.set_deadline(call->deadline);
+  if (!configuration_.spec().predicates().empty()) {
+    call->controller.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+  }
+
+  PrefetchedCall* ret = call.get();
+  prefetched_calls_.emplace_back(std::move(call));
+  prefetches_in_flight_++;
+  return ret;
+}
+
+void KuduScanner::Data::SendPrefetchedCall(
+    const std::shared_ptr<tserver::TabletServerServiceProxy>& proxy,
+    PrefetchedCall* call) {
+  proxy->ScanAsync(call->request, &call->response, &call->controller,
+                   boost::bind(&KuduScanner::Data::PrefetchedCallDone, this, call));
+}
+
+void KuduScanner::Data::PrefetchedCallDone(PrefetchedCall* call) {
+  PrefetchedCall* next;
+  std::shared_ptr<tserver::TabletServerServiceProxy> proxy;
+  {
+    MutexLock l(prefetch_lock_);
+    call->finished = true;
+    next = PreparePrefetchLocked();
+    proxy = proxy_;
+    // Once this drops to zero the scanner may be destroyed, so it must not
+    // be touched past this block.
+    prefetches_in_flight_--;
+    prefetch_cond_.Broadcast();
+  }
+  if (next) {
+    SendPrefetchedCall(proxy, next);
+  }
+}
+
+unique_ptr<KuduScanner::Data::PrefetchedCall> KuduScanner::Data::TakePrefetchedCall() {
+  MutexLock l(prefetch_lock_);
+  if (prefetched_calls_.empty()) {
+    return nullptr;
+  }
+  while (!prefetched_calls_.front()->finished) {
+    prefetch_cond_.Wait();
+  }
+  unique_ptr<PrefetchedCall> call = std::move(prefetched_calls_.front());
+  prefetched_calls_.pop_front();
+  return call;
+}
+
+ScanRpcStatus KuduScanner::Data::FinishPrefetchedCall(unique_ptr<PrefetchedCall> call) {
+  // Swapping, rather than copying, hands the response buffers over to the
+  // batch and gives the call the previous ones to reuse.
+  controller_.Swap(&call->controller);
+  last_response_.Swap(&call->response);
+  ScanRpcStatus scan_status = AnalyzeResponse(controller_.status(),
+                                              call->deadline, call->deadline);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+
+  MutexLock l(prefetch_lock_);
+  free_prefetched_calls_.emplace_back(std::move(call));
+  return scan_status;
+}
+
+void KuduScanner::Data::DiscardPrefetchedCalls() {
+  MutexLock l(prefetch_lock_);
+  prefetch_stopped_ = true;
+  while (prefetches_in_flight_ > 0) {
+    prefetch_cond_.Wait();
+  }
+  prefetched_calls_.clear();
+  prefetch_stopped_ = false;
+}
+
+////////////////////////////////////////////////////////////
+// ParallelTabletScan
+////////////////////////////////////////////////////////////
+
+namespace internal {
+
+namespace {
+// How often a worker blocked on a full queue keeps its tablet server
+// scanner alive. Well below the default server-side scanner TTL.
+const int kBlockedKeepAliveIntervalSecs = 15;
+} // anonymous namespace
+
+ParallelTabletScan::ParallelTabletScan(sp::shared_ptr<KuduTable> table,
+                                       ScanConfiguration* configuration,
+                                       ResourceMetrics* resource_metrics)
+    : table_(std::move(table)),
+      configuration_(configuration),
+      resource_metrics_(resource_metrics),
+      cond_(&lock_),
+      buffered_bytes_(0),
+      active_workers_(0),
+      stopping_(false) {
+  partition_pruner_.Init(*table_->schema().schema_,
+                         table_->partition_schema(),
+                         configuration_->spec());
+}
+
+ParallelTabletScan::~ParallelTabletScan() {
+  Stop();
+}
+
+Status ParallelTabletScan::Start() {
+  unique_ptr<KuduScanner> first;
+  Status s = OpenNextTabletScanner(&first);
+  if (s.IsNotFound()) {
+    // Nothing to scan.
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+
+  // Pin the remaining tablets to the snapshot chosen for the first one.
+  if (configuration_->read_mode() == KuduScanner::READ_AT_SNAPSHOT &&
+      !configuration_->has_snapshot_timestamp() &&
+      first->data_->configuration().has_snapshot_timestamp()) {
+    configuration_->SetSnapshotRaw(first->data_->configuration().snapshot_timestamp());
+  }
+
+  for (int i = 0; i < configuration_->max_concurrent_tablets(); i++) {
+    KuduScanner* initial_scanner = i == 0 ? first.get() : nullptr;
+    {
+      MutexLock l(lock_);
+      active_workers_++;
+    }
+    scoped_refptr<Thread> thread;
+    s = Thread::Create("client", Substitute("scan-worker [$0]", i),
+                       &ParallelTabletScan::RunWorker, this, initial_scanner, &thread);
+    if (!s.ok()) {
+      {
+        MutexLock l(lock_);
+        active_workers_--;
+      }
+      if (i == 0) {
+        return s;
+      }
+      // Carry on with the workers we have.
+      LOG(WARNING) << "Could not start scan worker: " << s.ToString();
+      break;
+    }
+    if (i == 0) {
+      ignore_result(first.release());
+    }
+    threads_.push_back(std::move(thread));
+  }
+  return Status::OK();
+}
+
+void ParallelTabletScan::Stop() {
+  {
+    MutexLock l(lock_);
+    stopping_ = true;
+    cond_.Broadcast();
+  }
+  for (const auto& thread : threads_) {
+    CHECK_OK(ThreadJoiner(thread.get()).Join());
+  }
+  threads_.clear();
+
+  MutexLock l(lock_);
+  queue_.clear();
+  buffered_bytes_ = 0;
+}
+
+Status ParallelTabletScan::NextBatch(KuduScanBatch* batch) {
+  unique_ptr<KuduScanBatch> next;
+  {
+    MutexLock l(lock_);
+    while (queue_.empty() && error_.ok() && active_workers_ > 0) {
+      cond_.Wait();
+    }
+    RETURN_NOT_OK(error_);
+    if (queue_.empty()) {
+      // All the tablets have been scanned.
+      return Status::OK();
+    }
+    next = std::move(queue_.front());
+    queue_.pop_front();
+    buffered_bytes_ -= BatchBytes(*next);
+    cond_.Broadcast();
+  }
+
+  // Hand over the buffered batch wholesale. The rows point into memory owned
+  // by the batch's RPC controller, so no copying is needed; only the client
+  // projection, which belongs to the child scanner, has to be re-pointed.
+  std::swap(batch->data_, next->data_);
+  batch->data_->projection_ = configuration_->projection();
+  batch->data_->client_projection_ = configuration_->client_projection();
+  return Status::OK();
+}
+
+bool ParallelTabletScan::HasMoreBatches() const {
+  MutexLock l(lock_);
+  return !queue_.empty() || active_workers_ > 0 || !error_.ok();
+}
+
+void ParallelTabletScan::RunWorker(KuduScanner* initial_scanner) {
+  unique_ptr<KuduScanner> scanner(initial_scanner);
+  Status s;
+  while (true) {
+    if (!scanner) {
+      s = OpenNextTabletScanner(&scanner);
+      if (!s.ok()) {
+        break;
+      }
+    }
+    s = ScanTablet(scanner.get());
+    MergeResourceMetrics(*scanner);
+    // Destroying the scanner closes it on the tablet server if necessary.
+    scanner.reset();
+    if (!s.ok()) {
+      break;
+    }
+  }
+
+  MutexLock l(lock_);
+  // NotFound means we ran out of tablets, and Aborted that the scan was
+  // stopped; neither is an error.
+  if (!s.IsNotFound() && !s.IsAborted() && error_.ok()) {
+    error_ = s;
+  }
+  active_workers_--;
+  cond_.Broadcast();
+}
+
+Status ParallelTabletScan::OpenNextTabletScanner(unique_ptr<KuduScanner>* scanner) {
+  MonoTime deadline = MonoTime::Now() + configuration_->timeout();
+  scoped_refptr<RemoteTablet> tablet;
+  {
+    MutexLock pruner_l(pruner_lock_);
+    while (true) {
+      {
+        MutexLock l(lock_);
+        if (stopping_) {
+          return Status::Aborted("scan stopped");
+        }
+      }
+      if (!partition_pruner_.HasMorePartitionKeyRanges()) {
+        return Status::NotFound("no more tablets to scan");
+      }
+      const string partition_key = partition_pruner_.NextPartitionKey();
+      Synchronizer sync;
+      table_->client()->data_->meta_cache_->LookupTabletByKeyOrNext(table_.get(),
+                                                                    partition_key,
+                                                                    deadline,
+                                                                    &tablet,
+                                                                    sync.AsStatusCallback());
+      Status s = sync.Wait();
+      if (s.IsNotFound()) {
+        // No more tablets in the table.
+        partition_pruner_.RemovePartitionKeyRange("");
+        continue;
+      }
+      RETURN_NOT_OK(s);
+
+      // As in KuduScanner::Data::OpenTablet(), the tablet may cover a range
+      // past the one we asked for, in which case it may be prunable.
+      bool prune = partition_key < tablet->partition().partition_key_start() &&
+                   partition_pruner_.ShouldPrune(tablet->partition());
+      partition_pruner_.RemovePartitionKeyRange(tablet->partition().partition_key_end());
+      if (!prune) {
+        break;
+      }
+    }
+  }
+
+  unique_ptr<KuduScanner> child(new KuduScanner(table_.get()));
+  ScanConfiguration* child_config = child->data_->mutable_configuration();
+  RETURN_NOT_OK(child_config->CopyFrom(*configuration_));
+  RETURN_NOT_OK(child_config->AddLowerBoundPartitionKeyRaw(
+      tablet->partition().partition_key_start()));
+  RETURN_NOT_OK(child_config->AddUpperBoundPartitionKeyRaw(
+      tablet->partition().partition_key_end()));
+  RETURN_NOT_OK(child->Open());
+  *scanner = std::move(child);
+  return Status::OK();
+}
+
+Status ParallelTabletScan::ScanTablet(KuduScanner* scanner) {
+  while (scanner->HasMoreRows()) {
+    {
+      MutexLock l(lock_);
+      if (stopping_) {
+        return Status::Aborted("scan stopped");
+      }
+    }
+    unique_ptr<KuduScanBatch> batch(new KuduScanBatch);
+    RETURN_NOT_OK(scanner->NextBatch(batch.get()));
+    if (batch->NumRows() > 0) {
+      RETURN_NOT_OK(EnqueueBatch(scanner, std::move(batch)));
+    }
+  }
+  return Status::OK();
+}
+
+Status ParallelTabletScan::EnqueueBatch(KuduScanner* scanner,
+                                        unique_ptr<KuduScanBatch> batch) {
+  MutexLock l(lock_);
+  // Always admit a batch into an empty queue, so that a single batch
+  // larger than the bound can't stall the scan.
+  while (!stopping_ &&
+         !queue_.empty() &&
+         buffered_bytes_ >= configuration_->max_buffered_bytes()) {
+    if (!cond_.TimedWait(MonoDelta::FromSeconds(kBlockedKeepAliveIntervalSecs))) {
+      l.Unlock();
+      Status s = scanner->KeepAlive();
+      if (!s.ok()) {
+        VLOG(1) << "Unable to keep scanner alive while blocked: " << s.ToString();
+      }
+      l.Lock();
+    }
+  }
+  if (stopping_) {
+    return Status::Aborted("scan stopped");
+  }
+  buffered_bytes_ += BatchBytes(*batch);
+  queue_.emplace_back(std::move(batch));
+  cond_.Broadcast();
+  return Status::OK();
+}
+
+void ParallelTabletScan::MergeResourceMetrics(const KuduScanner& scanner) {
+  map<string, int64_t> metrics = scanner.GetResourceMetrics().Get();
+  for (const auto& entry : metrics) {
+    resource_metrics_->Increment(entry.first, entry.second);
+  }
+}
+
+int64_t ParallelTabletScan::BatchBytes(const KuduScanBatch& batch) {
+  return batch.data_->direct_data_.size() + batch.data_->indirect_data_.size();
+}
+
+} // namespace internal
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch
 ////////////////////////////////////////////////////////////
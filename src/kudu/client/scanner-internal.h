@@ -17,10 +17,15 @@
 #ifndef KUDU_CLIENT_SCANNER_INTERNAL_H
 #define KUDU_CLIENT_SCANNER_INTERNAL_H
 
+#include <deque>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include <boost/function.hpp>
+
+#include "kudu/client/callbacks.h"
 #include "kudu/client/client.h"
 #include "kudu/client/resource_metrics.h"
 #include "kudu/client/row_result.h"
@@ -28,11 +33,16 @@
 #include "kudu/common/partition_pruner.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
 
 namespace kudu {
 
+class Thread;
+
 namespace client {
 
 // The result of KuduScanner::Data::AnalyzeResponse.
@@ -77,6 +87,107 @@ struct ScanRpcStatus {
   Status status;
 };
 
+namespace internal {
+
+// Scans the tablets of a table concurrently on behalf of a KuduScanner
+// configured with more than one concurrent tablet.
+//
+// Each tablet is scanned by its own child KuduScanner, limited to the
+// tablet's partition key range, on one of a fixed set of worker threads.
+// Workers hand their batches to the parent scanner through a queue bounded
+// by the configured number of buffered bytes; once the bound is reached,
+// workers block (keeping their tablet server scanners alive) until the
+// parent consumes batches.
+//
+// This class is thread-safe.
+class ParallelTabletScan {
+ public:
+  // 'configuration' and 'resource_metrics' belong to the parent scanner and
+  // must outlive this object. The scan spec in 'configuration' must already
+  // have been optimized.
+  ParallelTabletScan(sp::shared_ptr<KuduTable> table,
+                     ScanConfiguration* configuration,
+                     ResourceMetrics* resource_metrics);
+  ~ParallelTabletScan();
+
+  // Opens the first tablet to scan on the calling thread and starts the
+  // workers. In READ_AT_SNAPSHOT mode without a snapshot timestamp, the
+  // timestamp selected by the first tablet server is recorded in the parent
+  // configuration so that all tablets are scanned at the same snapshot.
+  Status Start();
+
+  // Stops the workers and waits for them to exit, closing the scanners they
+  // have open. Batches which have not been returned are discarded.
+  void Stop();
+
+  // Moves the next buffered batch into 'batch', blocking until one is
+  // available. If the scan has completed, 'batch' is left empty. If any of
+  // the tablet scans failed, returns the first error encountered.
+  Status NextBatch(KuduScanBatch* batch);
+
+  // Returns whether there may be more batches to return: there are buffered
+  // batches, some tablets are still being scanned, or an error is pending.
+  bool HasMoreBatches() const;
+
+ private:
+  // Body of each worker thread. If 'initial_scanner' is not null, the worker
+  // takes ownership of it and scans it before looking for further tablets.
+  void RunWorker(KuduScanner* initial_scanner);
+
+  // Picks the next tablet to scan and opens a child scanner over it.
+  // Returns Status::NotFound if there are no more tablets to scan.
+  Status OpenNextTabletScanner(std::unique_ptr<KuduScanner>* scanner);
+
+  // Reads every batch from 'scanner' into the queue.
+  Status ScanTablet(KuduScanner* scanner);
+
+  // Adds 'batch' to the queue, waiting for the consumer to make space
+  // if the buffered bytes are over the bound. Returns Status::Aborted if
+  // the scan is stopped while waiting.
+  Status EnqueueBatch(KuduScanner* scanner, std::unique_ptr<KuduScanBatch> batch);
+
+  // Adds the resource metrics of a finished child scanner to the parent's.
+  void MergeResourceMetrics(const KuduScanner& scanner);
+
+  // Returns the number of bytes of row data held by 'batch'.
+  static int64_t BatchBytes(const KuduScanBatch& batch);
+
+  const sp::shared_ptr<KuduTable> table_;
+
+  // The parent scanner's configuration. Read-only once the workers start.
+  ScanConfiguration* const configuration_;
+
+  ResourceMetrics* const resource_metrics_;
+
+  // Protects 'partition_pruner_', which tracks the tablets yet to be
+  // handed out to workers. Held across meta cache lookups, so never
+  // acquired while holding 'lock_'.
+  Mutex pruner_lock_;
+  PartitionPruner partition_pruner_;
+
+  // Protects all members below.
+  mutable Mutex lock_;
+  ConditionVariable cond_;
+
+  std::deque<std::unique_ptr<KuduScanBatch>> queue_;
+  int64_t buffered_bytes_;
+
+  // The first error returned by any of the tablet scans.
+  Status error_;
+
+  // Number of workers which have not yet exited.
+  int active_workers_;
+
+  // Set by Stop() to make the workers exit.
+  bool stopping_;
+
+  std::vector<scoped_refptr<Thread>> threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelTabletScan);
+};
+
+} // namespace internal
+
 class KuduScanner::Data {
  public:
 
@@ -92,6 +203,19 @@ class KuduScanner::Data {
   // The RPC and TS proxy should already have been prepared in next_req_, proxy_, etc.
   ScanRpcStatus SendScanRpc(const MonoTime& overall_deadline, bool allow_time_for_failover);
 
+  // Sends the request opening the scan of a tablet, which should already
+  // have been prepared as for SendScanRpc(), and records its latency.
+  //
+  // If hedging is enabled and the tablet server has not responded once the
+  // hedging percentile of earlier such requests has elapsed, also sends the
+  // request to another replica which is not in 'blacklist', and takes the
+  // first successful response. 'ts_' and 'proxy_' are then set to the server
+  // which sent it; the scanner opened by the other request, if any, is closed
+  // in the background.
+  ScanRpcStatus SendNewScanRpc(const MonoTime& overall_deadline,
+                               bool allow_time_for_failover,
+                               const std::set<std::string>& blacklist);
+
   // Called when KuduScanner::NextBatch or KuduScanner::Data::OpenTablet result in an RPC or
   // server error.
   //
@@ -100,9 +224,12 @@ class KuduScanner::Data {
   // made on a different replica.
   //
   // This function may also sleep in case the error suggests that backoff is necessary.
+  // If 'retry_delay' is not null, it is set to the time to wait before retrying
+  // instead.
   Status HandleError(const ScanRpcStatus& status,
                      const MonoTime& deadline,
-                     std::set<std::string>* blacklist);
+                     std::set<std::string>* blacklist,
+                     MonoDelta* retry_delay = nullptr);
 
   // Opens the next tablet in the scan, or returns Status::NotFound if there are
   // no more tablets to scan.
@@ -121,6 +248,38 @@ class KuduScanner::Data {
                     const MonoTime& deadline,
                     std::set<std::string>* blacklist);
 
+  // Sets up 'next_req_' to open the scan of a tablet, leaving the tablet ID
+  // to be set once the tablet has been looked up.
+  Status PrepareNewScanRequest();
+
+  // Handles the result of looking up the tablet covering 'partition_key'
+  // into 'remote_'. If there is a tablet to scan, sets 'scan_tablet' and
+  // the tablet ID of 'next_req_'. Otherwise, either there are no tablets
+  // left or the tablet found can be pruned, and the partition pruner is
+  // updated accordingly.
+  Status OnTabletLookedUp(const std::string& partition_key,
+                          const Status& lookup_status,
+                          bool* scan_tablet);
+
+  // Updates the scanner's state from the successful response to the
+  // request which opened the scan of 'remote_'.
+  void FinishOpenTablet();
+
+  // Optimizes the scan spec and sets up the partition pruner ahead of
+  // opening the scanner. Returns true, marking the scanner open, if the scan
+  // is known not to return any rows.
+  bool InitScan();
+
+  // Starts an asynchronous Open() or NextBatch() call, filling 'batch' (null
+  // for Open()) and reporting its result to 'callback'.
+  void StartAsyncCall(KuduScanBatch* batch, KuduStatusCallback* callback);
+
+  // Asynchronous counterparts of OpenTablet() and NextBatch(), acting on
+  // behalf of the asynchronous call in progress. Their steps run on reactor
+  // threads, except for those which complete without waiting.
+  void OpenTabletAsync(const std::string& partition_key);
+  void NextBatchAsync();
+
   Status KeepAlive();
 
   // Returns whether there may exist more tablets to scan.
@@ -152,6 +311,38 @@ class KuduScanner::Data {
   // non-fatal (i.e. retriable) scan error is encountered.
   void UpdateLastError(const Status& error);
 
+  // A continuation scan RPC sent ahead of the NextBatch() call that will
+  // consume its response. Calls are recycled once consumed so that their
+  // request and response buffers can be reused.
+  struct PrefetchedCall {
+    tserver::ScanRequestPB request;
+    tserver::ScanResponsePB response;
+    rpc::RpcController controller;
+    MonoTime deadline;
+
+    // Set once the RPC has completed, successfully or not.
+    bool finished = false;
+  };
+
+  // Starts prefetching the batch following the most recently received one,
+  // if prefetching is enabled, fewer than the configured number of batches
+  // are already prefetched, and the tablet has more rows to return.
+  void MaybePrefetch();
+
+  // Removes the oldest prefetched call, waiting for it to complete if it is
+  // still in flight, and returns it. Returns nullptr if nothing has been
+  // prefetched.
+  std::unique_ptr<PrefetchedCall> TakePrefetchedCall();
+
+  // Makes the response of 'call', as returned by TakePrefetchedCall(), the
+  // current response of the scanner, as if it had been returned by
+  // SendScanRpc().
+  ScanRpcStatus FinishPrefetchedCall(std::unique_ptr<PrefetchedCall> call);
+
+  // Waits for all prefetched calls in flight to complete and discards all
+  // prefetched batches.
+  void DiscardPrefetchedCalls();
+
   const ScanConfiguration& configuration() const {
     return configuration_;
   }
@@ -215,6 +406,53 @@ class KuduScanner::Data {
   // The scanner's cumulative resource metrics since the scan was started.
   ResourceMetrics resource_metrics_;
 
+  // Protects 'next_req_' while prefetching is in progress, as well as the
+  // prefetching state below.
+  Mutex prefetch_lock_;
+  ConditionVariable prefetch_cond_;
+
+  // Prefetched calls, oldest first. A call is only sent once all calls
+  // before it have completed successfully, so at most one is in flight.
+  std::deque<std::unique_ptr<PrefetchedCall>> prefetched_calls_;
+
+  // Consumed calls available for reuse.
+  std::vector<std::unique_ptr<PrefetchedCall>> free_prefetched_calls_;
+
+  // Number of prefetch RPCs whose completion callback has not yet returned.
+  int prefetches_in_flight_;
+
+  // Set while DiscardPrefetchedCalls() waits, to stop further prefetching.
+  bool prefetch_stopped_;
+
+  // The state of an asynchronous Open() or NextBatch() call.
+  struct AsyncCall {
+    // The batch to fill, or null if the call opens the scanner.
+    KuduScanBatch* batch = nullptr;
+
+    // Set while the call is in progress.
+    KuduStatusCallback* callback = nullptr;
+
+    MonoTime deadline;
+    std::set<std::string> blacklist;
+
+    // The partition key of the tablet being opened.
+    std::string partition_key;
+
+    // Number of times the tablet to open has been looked up.
+    int lookup_attempts = 0;
+
+    // The scan RPC in flight.
+    bool allow_time_for_failover = false;
+    MonoTime rpc_start_time;
+    MonoTime rpc_deadline;
+  };
+  AsyncCall async_call_;
+
+  // Drives the scan when more than one tablet may be scanned concurrently.
+  // Only set by Open() in that case; the per-tablet state above is then
+  // unused.
+  std::unique_ptr<internal::ParallelTabletScan> parallel_scan_;
+
   // Returns a text description of the scan suitable for debug printing.
   //
   // This method will not return sensitive predicate information, so it's
@@ -245,6 +483,46 @@ class KuduScanner::Data {
 
   void UpdateResourceMetrics();
 
+  // Returns the deadline of a scan RPC, as described in SendScanRpc().
+  MonoTime ScanRpcDeadline(const MonoTime& overall_deadline,
+                           bool allow_time_for_failover) const;
+
+  // If a further batch should be prefetched, sets up the call to do so and
+  // returns it; the caller must send it with SendPrefetchedCall() after
+  // releasing 'prefetch_lock_'. Otherwise returns nullptr.
+  PrefetchedCall* PreparePrefetchLocked();
+
+  // Sends 'call' to 'proxy'.
+  void SendPrefetchedCall(const std::shared_ptr<tserver::TabletServerServiceProxy>& proxy,
+                          PrefetchedCall* call);
+
+  // Completion callback of the RPC for 'call'. Runs on a reactor thread.
+  void PrefetchedCallDone(PrefetchedCall* call);
+
+  // Steps of the asynchronous call in progress.
+  void LookUpTabletAsync();
+  void TabletLookedUpAsync(const Status& lookup_status);
+  void TabletServerReadyAsync(const Status& s);
+  void SendScanAsync(const rpc::ResponseCallback& done);
+  void OpenScanDone();
+  void SendContinueScanAsync();
+  void ContinueScanDone();
+
+  // Handles the response of the scan RPC sent by SendScanAsync(), setting
+  // 'round_trip_time' to the RPC's round-trip time.
+  ScanRpcStatus FinishScanAsync(MonoDelta* round_trip_time);
+
+  // Runs 'step' of the asynchronous call in progress once 'delay' has
+  // elapsed, or right away if 'delay' is zero.
+  void ScheduleAsyncStep(const MonoDelta& delay, const boost::function<void()>& step);
+
+  // Runs 'step' if 'status', as passed by the reactor, is OK; otherwise
+  // completes the asynchronous call with 'status'.
+  void RunScheduledAsyncStep(const boost::function<void()>& step, const Status& status);
+
+  // Completes the asynchronous call in progress with status 's'.
+  void FinishAsyncCall(const Status& s);
+
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
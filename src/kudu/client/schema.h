@@ -42,10 +42,12 @@ namespace internal {
 class GetTableSchemaRpc;
 class LookupRpc;
 class MetaCacheEntry;
+class ParallelTabletScan;
 class WriteRpc;
 } // namespace internal
 
 class KuduClient;
+class KuduColumnarWriteBatch;
 class KuduSchema;
 class KuduSchemaBuilder;
 class KuduWriteOperation;
@@ -485,6 +487,7 @@ class KUDU_EXPORT KuduSchema {
 
  private:
   friend class KuduClient;
+  friend class KuduColumnarWriteBatch;
   friend class KuduScanner;
   friend class KuduScanToken;
   friend class KuduScanTokenBuilder;
@@ -496,6 +499,7 @@ class KUDU_EXPORT KuduSchema {
   friend class internal::GetTableSchemaRpc;
   friend class internal::LookupRpc;
   friend class internal::MetaCacheEntry;
+  friend class internal::ParallelTabletScan;
   friend class internal::WriteRpc;
   friend class tools::RemoteKsckMaster;
   friend class tools::ReplicaDumper;
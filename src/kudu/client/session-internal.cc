@@ -21,11 +21,14 @@
 
 #include "kudu/client/batcher.h"
 #include "kudu/client/callbacks.h"
+#include "kudu/client/client-internal.h"
+#include "kudu/client/client_metrics.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/shared_ptr.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 
 namespace kudu {
 
@@ -389,8 +392,13 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
       // In AUTO_FLUSH_BACKGROUND mode Apply() blocks if total would-be-used
       // buffer space is over the limit. Once amount of buffered data drops
       // below the limit, a blocking call to Apply() is unblocked.
-      while (buffer_bytes_used_ + required_size > max_size) {
-        condition_.Wait();
+      if (buffer_bytes_used_ + required_size > max_size) {
+        MonoTime wait_start = MonoTime::Now();
+        while (buffer_bytes_used_ + required_size > max_size) {
+          condition_.Wait();
+        }
+        client_->data_->metrics_->client_buffer_space_wait_time->Increment(
+            (MonoTime::Now() - wait_start).ToMicroseconds());
       }
     } else if (PREDICT_FALSE(buffer_bytes_used_ + required_size > max_size)) {
       Status s = Status::Incomplete(strings::Substitute(
@@ -18,8 +18,10 @@
 #include "kudu/client/write_op.h"
 
 #include "kudu/client/client.h"
+#include "kudu/client/columnar_write-internal.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/row.h"
+#include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.pb.h"
 
 namespace kudu {
@@ -118,6 +120,36 @@ KuduUpsert::KuduUpsert(const shared_ptr<KuduTable>& table)
 
 KuduUpsert::~KuduUpsert() {}
 
+// ColumnarWriteBatch -----------------------------------------------------------
+
+KuduColumnarWriteBatch::KuduColumnarWriteBatch(const shared_ptr<KuduTable>& table,
+                                               KuduWriteOperation::Type type,
+                                               int num_rows)
+  : data_(new Data(table, type, num_rows)) {
+}
+
+KuduColumnarWriteBatch::~KuduColumnarWriteBatch() {
+  delete data_;
+}
+
+int KuduColumnarWriteBatch::num_rows() const {
+  return data_->num_rows_;
+}
+
+Status KuduColumnarWriteBatch::SetColumn(const Slice& col_name, const void* data,
+                                         const uint8_t* non_null_bitmap) {
+  StringPiece sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  int col_idx = data_->table_->schema().schema_->find_column(sp);
+  if (PREDICT_FALSE(col_idx == Schema::kColumnNotFound)) {
+    return Status::NotFound("No such column", col_name);
+  }
+  return data_->SetColumn(col_idx, data, non_null_bitmap);
+}
+
+Status KuduColumnarWriteBatch::SetColumn(int col_idx, const void* data,
+                                         const uint8_t* non_null_bitmap) {
+  return data_->SetColumn(col_idx, data, non_null_bitmap);
+}
 
 } // namespace client
 } // namespace kudu
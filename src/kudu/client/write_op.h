@@ -230,6 +230,86 @@ class KUDU_EXPORT KuduDelete : public KuduWriteOperation {
   explicit KuduDelete(const sp::shared_ptr<KuduTable>& table);
 };
 
+/// @brief A batch of rows to insert or upsert, laid out column by column.
+///
+/// A columnar batch is an alternative to applying one KuduInsert or
+/// KuduUpsert per row when writing many rows at once: the values of each
+/// column are passed as a single array, and the batch is routed and encoded
+/// per tablet without creating an operation object per row. Instances are
+/// created by KuduTable::NewColumnarInsert() and
+/// KuduTable::NewColumnarUpsert(), and written by
+/// KuduSession::ApplyColumnar().
+///
+/// Typical usage example:
+/// @code
+///   std::vector<int32_t> keys = ...;
+///   std::vector<Slice> names = ...;
+///   std::unique_ptr<KuduColumnarWriteBatch> batch(
+///       table->NewColumnarInsert(keys.size()));
+///   KUDU_CHECK_OK(batch->SetColumn("key", keys.data()));
+///   KUDU_CHECK_OK(batch->SetColumn("name", names.data()));
+///   KUDU_CHECK_OK(session->ApplyColumnar(*batch));
+/// @endcode
+class KUDU_EXPORT KuduColumnarWriteBatch {
+ public:
+  ~KuduColumnarWriteBatch();
+
+  /// @return Number of rows in the batch.
+  int num_rows() const;
+
+  /// Set the values of a column for all rows of the batch.
+  ///
+  /// Columns which are not set take their default values, as when a column
+  /// of a KuduPartialRow is not set. All key columns must be set.
+  ///
+  /// @param [in] col_name
+  ///   Name of the target column.
+  /// @param [in] data
+  ///   Array of num_rows() values in the column's in-memory representation:
+  ///   @c bool, @c int8_t, @c int16_t, @c int32_t, @c int64_t, @c float or
+  ///   @c double for the corresponding types, @c int64_t for
+  ///   @c UNIXTIME_MICROS, and Slice for @c STRING and @c BINARY. The array,
+  ///   and the data referenced by its slices, is not copied: it must remain
+  ///   valid and unchanged until the batch has been applied.
+  /// @param [in] non_null_bitmap
+  ///   Bitmap of num_rows() bits, least significant bit first, where a set
+  ///   bit marks a non-null value. May only be specified for nullable
+  ///   columns; if NULL, every value is non-null. The bitmap is not copied.
+  /// @return Operation result status.
+  Status SetColumn(const Slice& col_name, const void* data,
+                   const uint8_t* non_null_bitmap = NULL) WARN_UNUSED_RESULT;
+
+  /// Set the values of a column for all rows of the batch.
+  ///
+  /// This is the same as the previous method, but the column is specified
+  /// by its index in the table's schema.
+  ///
+  /// @param [in] col_idx
+  ///   Index of the target column.
+  /// @param [in] data
+  ///   Array of num_rows() values; see above.
+  /// @param [in] non_null_bitmap
+  ///   Bitmap of non-null values, or NULL; see above.
+  /// @return Operation result status.
+  Status SetColumn(int col_idx, const void* data,
+                   const uint8_t* non_null_bitmap = NULL) WARN_UNUSED_RESULT;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  friend class KuduSession;
+  friend class KuduTable;
+
+  KuduColumnarWriteBatch(const sp::shared_ptr<KuduTable>& table,
+                         KuduWriteOperation::Type type,
+                         int num_rows);
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnarWriteBatch);
+};
+
 } // namespace client
 } // namespace kudu
 
@@ -38,6 +38,7 @@
 namespace kudu {
 class ColumnSchema;
 namespace client {
+class KuduColumnarWriteBatch;
 class KuduWriteOperation;
 template<typename KeyTypeWrapper> struct SliceKeysTestSetup;
 template<typename KeyTypeWrapper> struct IntKeysTestSetup;
@@ -470,6 +471,7 @@ class KUDU_EXPORT KuduPartialRow {
   const Schema* schema() const { return schema_; }
 
  private:
+  friend class client::KuduColumnarWriteBatch;
   friend class client::KuduWriteOperation;   // for row_data_.
   friend class KeyUtilTest;
   friend class PartitionSchema;
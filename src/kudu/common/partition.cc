@@ -23,6 +23,7 @@
 #include <utility>
 #include <vector>
 
+#include "kudu/common/columnblock.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/map-util.h"
@@ -207,6 +208,73 @@ Status PartitionSchema::EncodeKey(const ConstContiguousRow& row, string* buf) co
   return EncodeColumns(row, range_schema_.column_ids, buf);
 }
 
+namespace {
+
+// A column of a batch, together with the encoder for its partition key component.
+struct EncodedColumn {
+  const ColumnBlock* block;
+  const KeyEncoder<string>* encoder;
+};
+
+// Resolves the blocks and key encoders of the columns 'column_ids' of a
+// columnar batch.
+Status ResolveColumns(const Schema& schema,
+                      const vector<const ColumnBlock*>& columns,
+                      const vector<ColumnId>& column_ids,
+                      vector<EncodedColumn>* resolved) {
+  resolved->clear();
+  for (ColumnId column_id : column_ids) {
+    int32_t column_idx = schema.find_column_by_id(column_id);
+    CHECK(column_idx != Schema::kColumnNotFound);
+    const ColumnBlock* block = columns[column_idx];
+    if (PREDICT_FALSE(block == nullptr)) {
+      return Status::InvalidArgument("partition column not set",
+                                     schema.column(column_idx).name());
+    }
+    resolved->push_back({ block, &GetKeyEncoder<string>(block->type_info()) });
+  }
+  return Status::OK();
+}
+
+// Appends the encoded columns of row 'row_idx' to 'buf'.
+void EncodeColumnsOfRow(const vector<EncodedColumn>& columns, size_t row_idx, string* buf) {
+  for (int i = 0; i < columns.size(); i++) {
+    columns[i].encoder->Encode(columns[i].block->cell_ptr(row_idx), i + 1 == columns.size(), buf);
+  }
+}
+
+} // anonymous namespace
+
+Status PartitionSchema::EncodeKeys(const Schema& schema,
+                                   const vector<const ColumnBlock*>& columns,
+                                   size_t num_rows,
+                                   vector<string>* keys) const {
+  DCHECK_EQ(schema.num_columns(), columns.size());
+  keys->resize(num_rows);
+  for (string& key : *keys) {
+    key.clear();
+  }
+
+  const KeyEncoder<string>& hash_encoder = GetKeyEncoder<string>(GetTypeInfo(UINT32));
+  vector<EncodedColumn> resolved;
+  string buf;
+  for (const HashBucketSchema& hash_bucket_schema : hash_bucket_schemas_) {
+    RETURN_NOT_OK(ResolveColumns(schema, columns, hash_bucket_schema.column_ids, &resolved));
+    for (size_t row_idx = 0; row_idx < num_rows; row_idx++) {
+      buf.clear();
+      EncodeColumnsOfRow(resolved, row_idx, &buf);
+      int32_t bucket = BucketForEncodedColumns(buf, hash_bucket_schema);
+      hash_encoder.Encode(&bucket, &(*keys)[row_idx]);
+    }
+  }
+
+  RETURN_NOT_OK(ResolveColumns(schema, columns, range_schema_.column_ids, &resolved));
+  for (size_t row_idx = 0; row_idx < num_rows; row_idx++) {
+    EncodeColumnsOfRow(resolved, row_idx, &(*keys)[row_idx]);
+  }
+  return Status::OK();
+}
+
 Status PartitionSchema::EncodeRangeKey(const KuduPartialRow& row,
                                        const Schema& schema,
                                        string* key) const {
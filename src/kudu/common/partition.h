@@ -31,6 +31,7 @@
 
 namespace kudu {
 
+class ColumnBlock;
 class ColumnRangePredicate;
 class ConstContiguousRow;
 class KuduPartialRow;
@@ -150,6 +151,18 @@ class PartitionSchema {
   Status EncodeKey(const KuduPartialRow& row, std::string* buf) const WARN_UNUSED_RESULT;
   Status EncodeKey(const ConstContiguousRow& row, std::string* buf) const WARN_UNUSED_RESULT;
 
+  // Encodes the partition keys of a batch of 'num_rows' rows which are laid
+  // out column by column, replacing the contents of 'keys'.
+  //
+  // 'columns' is indexed by the column's index in 'schema', and must hold a
+  // block of at least 'num_rows' cells for each partition column. Column
+  // lookups and key encoders are resolved once for the whole batch rather
+  // than once per row.
+  Status EncodeKeys(const Schema& schema,
+                    const std::vector<const ColumnBlock*>& columns,
+                    size_t num_rows,
+                    std::vector<std::string>* keys) const WARN_UNUSED_RESULT;
+
   // Creates the set of table partitions for a partition schema and collection
   // of split rows and split bounds.
   //
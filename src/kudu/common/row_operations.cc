@@ -17,6 +17,7 @@
 
 #include "kudu/common/row_operations.h"
 
+#include "kudu/common/columnblock.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/schema.h"
@@ -28,6 +29,7 @@
 #include "kudu/util/slice.h"
 
 using std::string;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -127,6 +129,70 @@ void RowOperationsPBEncoder::Add(RowOperationsPB::Type op_type, const KuduPartia
   dst->resize(reinterpret_cast<char*>(dst_ptr) - &(*dst)[0]);
 }
 
+void RowOperationsPBEncoder::AddColumnar(RowOperationsPB::Type op_type,
+                                         const Schema& schema,
+                                         const vector<const ColumnBlock*>& columns,
+                                         const vector<size_t>& row_idxs) {
+  DCHECK_EQ(schema.num_columns(), columns.size());
+  if (row_idxs.empty()) return;
+
+  // The same set of columns is set for every row of the batch, so the isset
+  // bitmap only needs to be computed once.
+  int isset_bitmap_size = BitmapSize(schema.num_columns());
+  int null_bitmap_size = ContiguousRowHelper::null_bitmap_size(schema);
+  faststring isset_bitmap(isset_bitmap_size);
+  isset_bitmap.resize(isset_bitmap_size);
+  BitmapChangeBits(isset_bitmap.data(), 0, schema.num_columns(), false);
+  for (int i = 0; i < schema.num_columns(); i++) {
+    if (columns[i] != nullptr) {
+      BitmapSet(isset_bitmap.data(), i);
+    }
+  }
+
+  // See Add() for why the space is reserved up front. The bound covers all
+  // of the rows at once.
+  string* dst = pb_->mutable_rows();
+  int max_size = 1 + schema.byte_size() + isset_bitmap_size + null_bitmap_size;
+  int old_size = dst->size();
+  dst->resize(old_size + max_size * row_idxs.size());
+  uint8_t* dst_ptr = reinterpret_cast<uint8_t*>(&(*dst)[old_size]);
+
+  string* indirect = pb_->mutable_indirect_data();
+  for (size_t row_idx : row_idxs) {
+    *dst_ptr++ = static_cast<uint8_t>(op_type);
+    memcpy(dst_ptr, isset_bitmap.data(), isset_bitmap_size);
+    dst_ptr += isset_bitmap_size;
+
+    uint8_t* null_bitmap = dst_ptr;
+    memset(null_bitmap, 0, null_bitmap_size);
+    dst_ptr += null_bitmap_size;
+
+    for (int i = 0; i < schema.num_columns(); i++) {
+      const ColumnBlock* block = columns[i];
+      if (block == nullptr) continue;
+      if (block->is_nullable() && block->is_null(row_idx)) {
+        BitmapSet(null_bitmap, i);
+        continue;
+      }
+
+      const TypeInfo* type = block->type_info();
+      if (type->physical_type() == BINARY) {
+        const Slice* val = reinterpret_cast<const Slice*>(block->cell_ptr(row_idx));
+        size_t indirect_offset = indirect->size();
+        indirect->append(reinterpret_cast<const char*>(val->data()), val->size());
+        Slice to_append(reinterpret_cast<const uint8_t*>(indirect_offset), val->size());
+        memcpy(dst_ptr, &to_append, sizeof(Slice));
+        dst_ptr += sizeof(Slice);
+      } else {
+        memcpy(dst_ptr, block->cell_ptr(row_idx), type->size());
+        dst_ptr += type->size();
+      }
+    }
+  }
+
+  dst->resize(reinterpret_cast<char*>(dst_ptr) - &(*dst)[0]);
+}
+
 // ------------------------------------------------------------
 // Decoder
 // ------------------------------------------------------------
@@ -29,6 +29,7 @@
 namespace kudu {
 
 class Arena;
+class ColumnBlock;
 class KuduPartialRow;
 class Schema;
 
@@ -42,6 +43,18 @@ class RowOperationsPBEncoder {
   // Append this partial row to the protobuf.
   void Add(RowOperationsPB::Type type, const KuduPartialRow& row);
 
+  // Append the rows at 'row_idxs' of a batch laid out column by column.
+  //
+  // 'columns' is indexed by the column's index in 'schema'. A null entry
+  // marks a column which is not set for any row of the batch; a block with
+  // a null bitmap marks a column which is set and non-null for every row.
+  // The space for all of the rows is reserved up front, so this is cheaper
+  // than adding the rows one at a time.
+  void AddColumnar(RowOperationsPB::Type type,
+                   const Schema& schema,
+                   const std::vector<const ColumnBlock*>& columns,
+                   const std::vector<size_t>& row_idxs);
+
  private:
   RowOperationsPB* pb_;
 
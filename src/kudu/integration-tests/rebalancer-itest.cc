@@ -0,0 +1,198 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/client/client.h"
+#include "kudu/client/client-test-util.h"
+#include "kudu/common/wire_protocol-test-util.h"
+#include "kudu/consensus/consensus.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/mini_tablet_server.h"
+#include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_bool(rebalancer_enabled);
+DECLARE_int32(rebalancer_interval_ms);
+
+using kudu::client::KuduClient;
+using kudu::client::KuduScanToken;
+using kudu::client::KuduScanTokenBuilder;
+using kudu::client::KuduSchema;
+using kudu::client::KuduTable;
+using kudu::client::KuduTableCreator;
+using kudu::client::sp::shared_ptr;
+using kudu::consensus::Consensus;
+using kudu::tablet::TabletPeer;
+using kudu::tserver::TabletServer;
+using std::map;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+
+const char* const kTableName = "test-table";
+const int kNumInitialTabletServers = 3;
+const int kNumTablets = 6;
+const int kNumReplicas = 3;
+
+class RebalancerITest : public KuduTest {
+ public:
+  void SetUp() override {
+    KuduTest::SetUp();
+
+    MiniClusterOptions opts;
+    opts.num_tablet_servers = kNumInitialTabletServers;
+    cluster_.reset(new MiniCluster(env_, opts));
+    ASSERT_OK(cluster_->Start());
+  }
+
+  void TearDown() override {
+    if (cluster_) {
+      cluster_->Shutdown();
+      cluster_.reset();
+    }
+    KuduTest::TearDown();
+  }
+
+ protected:
+  void CreateTable() {
+    shared_ptr<KuduClient> client;
+    ASSERT_OK(cluster_->CreateClient(nullptr, &client));
+    KuduSchema schema(client::KuduSchemaFromSchema(GetSimpleTestSchema()));
+    unique_ptr<KuduTableCreator> table_creator(client->NewTableCreator());
+    ASSERT_OK(table_creator->table_name(kTableName)
+              .schema(&schema)
+              .set_range_partition_columns({ "key" })
+              .num_replicas(kNumReplicas)
+              .add_hash_partitions({ "key" }, kNumTablets)
+              .Create());
+  }
+
+  // Counts the replicas hosted by each tablet server, according to the
+  // master's view of the table's tablet locations.
+  void CountReplicas(map<string, int>* replica_counts) {
+    // Use a new client each time, so that no tablet locations are cached.
+    shared_ptr<KuduClient> client;
+    ASSERT_OK(cluster_->CreateClient(nullptr, &client));
+    shared_ptr<KuduTable> table;
+    ASSERT_OK(client->OpenTable(kTableName, &table));
+
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_EQ(kNumTablets, tokens.size());
+    for (const KuduScanToken* token : tokens) {
+      for (const auto* replica : token->tablet().replicas()) {
+        (*replica_counts)[replica->ts().uuid()]++;
+      }
+    }
+  }
+
+  // Enables the rebalancer, doubles the number of tablet servers, and waits
+  // until every tablet server hosts a similar number of replicas, and every
+  // tablet has exactly kNumReplicas of them.
+  void AddTabletServersAndWaitForBalance() {
+    FLAGS_rebalancer_enabled = true;
+    FLAGS_rebalancer_interval_ms = 100;
+    const int kNumTabletServers = kNumInitialTabletServers * 2;
+    for (int i = kNumInitialTabletServers; i < kNumTabletServers; i++) {
+      ASSERT_OK(cluster_->AddTabletServer());
+    }
+    ASSERT_OK(cluster_->WaitForTabletServerCount(kNumTabletServers));
+
+    AssertEventually([&]() {
+      map<string, int> replica_counts;
+      NO_FATALS(CountReplicas(&replica_counts));
+      ASSERT_EQ(kNumTabletServers, replica_counts.size());
+      int total = 0;
+      int min_count = kNumTablets;
+      int max_count = 0;
+      for (const auto& e : replica_counts) {
+        total += e.second;
+        min_count = std::min(min_count, e.second);
+        max_count = std::max(max_count, e.second);
+      }
+      ASSERT_EQ(kNumTablets * kNumReplicas, total);
+      ASSERT_LE(max_count - min_count, 1);
+    }, MonoDelta::FromSeconds(120));
+  }
+
+  unique_ptr<MiniCluster> cluster_;
+};
+
+// Test that once tablet servers are added to a cluster, the rebalancer moves
+// replicas to them until every tablet server hosts a similar number of them.
+TEST_F(RebalancerITest, TestBalanceNewTabletServers) {
+  NO_FATALS(CreateTable());
+  NO_FATALS(AddTabletServersAndWaitForBalance());
+}
+
+// Test that replica moves finish even when the replicas being moved away
+// keep becoming leaders, which then refuse to remove themselves from their
+// configs. The moves are only allowed to finish well within their timeout.
+TEST_F(RebalancerITest, TestMoveReplicasOffLeaders) {
+  NO_FATALS(CreateTable());
+
+  // Keep making the replicas on the initial tablet servers, which are the
+  // sources of all the moves, take the leadership of their tablets.
+  vector<TabletServer*> initial_servers;
+  for (int i = 0; i < kNumInitialTabletServers; i++) {
+    initial_servers.push_back(cluster_->mini_tablet_server(i)->server());
+  }
+  std::atomic<bool> done(false);
+  std::thread election_thread([&]() {
+    while (!done) {
+      for (TabletServer* server : initial_servers) {
+        vector<scoped_refptr<TabletPeer>> peers;
+        server->tablet_manager()->GetTabletPeers(&peers);
+        for (const auto& peer : peers) {
+          Consensus* consensus = peer->consensus();
+          if (consensus) {
+            WARN_NOT_OK(consensus->StartElection(Consensus::ELECT_EVEN_IF_LEADER_IS_ALIVE,
+                                                 Consensus::EXTERNAL_REQUEST),
+                        "Could not start election");
+          }
+        }
+      }
+      SleepFor(MonoDelta::FromMilliseconds(200));
+    }
+  });
+  auto thread_joiner = MakeScopedCleanup([&]() {
+    done = true;
+    election_thread.join();
+  });
+
+  NO_FATALS(AddTabletServersAndWaitForBalance());
+}
+
+} // namespace kudu
@@ -26,17 +26,29 @@
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/consensus/consensus.h"
 #include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/catalog_manager.h"
+#include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/master.proxy.h"
 #include "kudu/master/mini_master.h"
+#include "kudu/master/ts_descriptor.h"
+#include "kudu/master/ts_manager.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/mini_tablet_server.h"
+#include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/test_util.h"
 
+using kudu::consensus::Consensus;
+using kudu::consensus::RaftPeerPB;
 using kudu::rpc::Messenger;
 using kudu::rpc::MessengerBuilder;
 using kudu::rpc::RpcController;
+using kudu::tablet::TabletPeer;
 using std::pair;
 using std::shared_ptr;
 using std::string;
@@ -83,6 +95,11 @@ class TableLocationsTest : public KuduTest {
                      const vector<KuduPartialRow>& split_rows,
                      const vector<pair<KuduPartialRow, KuduPartialRow>>& bounds);
 
+  // Fetch the locations of all of the tablets of table 'table_name' in a
+  // sidecar, and parse them into 'locations'.
+  Status GetLocationsInSidecar(const string& table_name,
+                               GetTableLocationsResponsePB* locations);
+
   shared_ptr<Messenger> client_messenger_;
   unique_ptr<MiniCluster> cluster_;
   unique_ptr<MasterServiceProxy> proxy_;
@@ -112,6 +129,25 @@ Status TableLocationsTest::CreateTable(const string& table_name,
   return proxy_->CreateTable(req, &resp, &controller);
 }
 
+Status TableLocationsTest::GetLocationsInSidecar(const string& table_name,
+                                                 GetTableLocationsResponsePB* locations) {
+  GetTableLocationsRequestPB req;
+  GetTableLocationsResponsePB resp;
+  RpcController controller;
+  req.mutable_table()->set_table_name(table_name);
+  req.set_tablet_locations_in_sidecar(true);
+  RETURN_NOT_OK(proxy_->GetTableLocations(req, &resp, &controller));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  Slice sidecar;
+  RETURN_NOT_OK(controller.GetSidecar(resp.tablet_locations_sidecar(), &sidecar));
+  if (!locations->ParseFromArray(sidecar.data(), sidecar.size())) {
+    return Status::Corruption("unable to parse locations sidecar");
+  }
+  return Status::OK();
+}
+
 // Test that when the client requests table locations for a non-covered
 // partition range, the master returns the first tablet previous to the begin
 // partition key, as specified in the non-covering range partitions design
@@ -229,6 +265,132 @@ TEST_F(TableLocationsTest, TestGetTableLocations) {
   }
 }
 
+// Test that when the client asks for the table locations in a sidecar, the
+// master returns the same locations there as it does inline, both when it
+// builds them and when it serves them from its cache.
+TEST_F(TableLocationsTest, TestGetTableLocationsInSidecar) {
+  const string table_name = "test";
+  Schema schema({ ColumnSchema("key", STRING) }, 1);
+  KuduPartialRow row(&schema);
+
+  vector<KuduPartialRow> splits(3, row);
+  ASSERT_OK(splits[0].SetStringNoCopy(0, "a"));
+  ASSERT_OK(splits[1].SetStringNoCopy(0, "b"));
+  ASSERT_OK(splits[2].SetStringNoCopy(0, "c"));
+  ASSERT_OK(CreateTable(table_name, schema, splits, {}));
+
+  GetTableLocationsRequestPB req;
+  req.mutable_table()->set_table_name(table_name);
+  GetTableLocationsResponsePB inline_resp;
+  AssertEventually([&]() {
+    RpcController controller;
+    ASSERT_OK(proxy_->GetTableLocations(req, &inline_resp, &controller));
+    ASSERT_FALSE(inline_resp.has_error()) << SecureDebugString(inline_resp);
+  });
+  ASSERT_EQ(4, inline_resp.tablet_locations().size());
+
+  req.set_tablet_locations_in_sidecar(true);
+  for (int i = 0; i < 2; i++) {
+    GetTableLocationsResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->GetTableLocations(req, &resp, &controller));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_EQ(0, resp.tablet_locations().size());
+    ASSERT_TRUE(resp.has_tablet_locations_sidecar());
+
+    Slice sidecar;
+    ASSERT_OK(controller.GetSidecar(resp.tablet_locations_sidecar(), &sidecar));
+    GetTableLocationsResponsePB locations;
+    ASSERT_TRUE(locations.ParseFromArray(sidecar.data(), sidecar.size()));
+    ASSERT_EQ(inline_resp.tablet_locations().size(), locations.tablet_locations().size());
+    for (int j = 0; j < locations.tablet_locations().size(); j++) {
+      const TabletLocationsPB& expected = inline_resp.tablet_locations(j);
+      const TabletLocationsPB& actual = locations.tablet_locations(j);
+      EXPECT_EQ(expected.tablet_id(), actual.tablet_id());
+      EXPECT_EQ(expected.partition().partition_key_start(),
+                actual.partition().partition_key_start());
+      EXPECT_EQ(expected.replicas().size(), actual.replicas().size());
+    }
+  }
+}
+
+// Test that the locations the master serves from its cache follow changes to
+// the leadership of the tablets, and are dropped when a tablet server
+// re-registers.
+TEST_F(TableLocationsTest, TestCachedLocationsFollowChanges) {
+  const string table_name = "test";
+  Schema schema({ ColumnSchema("key", STRING) }, 1);
+  ASSERT_OK(CreateTable(table_name, schema, {}, {}));
+
+  // Wait for the tablet to elect a leader, and for the master to hear of it.
+  GetTableLocationsResponsePB locations;
+  string leader_uuid;
+  AssertEventually([&]() {
+    ASSERT_OK(GetLocationsInSidecar(table_name, &locations));
+    ASSERT_EQ(1, locations.tablet_locations().size());
+    leader_uuid.clear();
+    for (const auto& replica : locations.tablet_locations(0).replicas()) {
+      if (replica.role() == RaftPeerPB::LEADER) {
+        leader_uuid = replica.ts_info().permanent_uuid();
+      }
+    }
+    ASSERT_FALSE(leader_uuid.empty());
+  });
+  const string tablet_id = locations.tablet_locations(0).tablet_id();
+
+  // Move leadership to another replica. The sidecar, now served from the
+  // cache, must name the new leader.
+  string new_leader_uuid;
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    tserver::TabletServer* server = cluster_->mini_tablet_server(i)->server();
+    if (server->instance_pb().permanent_uuid() == leader_uuid) {
+      continue;
+    }
+    scoped_refptr<TabletPeer> peer;
+    ASSERT_TRUE(server->tablet_manager()->LookupTablet(tablet_id, &peer));
+    ASSERT_OK(peer->consensus()->StartElection(Consensus::ELECT_EVEN_IF_LEADER_IS_ALIVE,
+                                               Consensus::EXTERNAL_REQUEST));
+    new_leader_uuid = server->instance_pb().permanent_uuid();
+    break;
+  }
+  AssertEventually([&]() {
+    ASSERT_OK(GetLocationsInSidecar(table_name, &locations));
+    ASSERT_EQ(1, locations.tablet_locations().size());
+    for (const auto& replica : locations.tablet_locations(0).replicas()) {
+      SCOPED_TRACE(SecureDebugString(replica));
+      ASSERT_EQ(replica.ts_info().permanent_uuid() == new_leader_uuid,
+                replica.role() == RaftPeerPB::LEADER);
+    }
+  });
+
+  // Re-register a tablet server. Its registration is part of every cached
+  // entry, so the next request must rebuild them.
+  Master* master = cluster_->mini_master()->master();
+  scoped_refptr<TableInfo> table;
+  {
+    CatalogManager::ScopedLeaderSharedLock l(master->catalog_manager());
+    ASSERT_OK(l.first_failed_status());
+    vector<scoped_refptr<TableInfo>> tables;
+    ASSERT_OK(master->catalog_manager()->GetAllTables(&tables));
+    ASSERT_EQ(1, tables.size());
+    table = tables[0];
+  }
+  int64_t version = table->locations_version();
+
+  shared_ptr<TSDescriptor> ts_desc;
+  ASSERT_TRUE(master->ts_manager()->LookupTSByUUID(new_leader_uuid, &ts_desc));
+  NodeInstancePB instance;
+  ServerRegistrationPB registration;
+  ts_desc->GetNodeInstancePB(&instance);
+  ts_desc->GetRegistration(&registration);
+  ASSERT_OK(master->ts_manager()->RegisterTS(instance, registration, &ts_desc));
+
+  ASSERT_OK(GetLocationsInSidecar(table_name, &locations));
+  ASSERT_GT(table->locations_version(), version);
+  ASSERT_EQ(1, locations.tablet_locations().size());
+  ASSERT_EQ(tablet_id, locations.tablet_locations(0).tablet_id());
+}
 
 } // namespace master
 } // namespace kudu
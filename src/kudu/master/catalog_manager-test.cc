@@ -105,5 +105,49 @@ TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
   }
 }
 
+TEST(TestTSDescriptor, TestReplicaPlacementCosts) {
+  TSDescriptor a("a");
+  TSDescriptor b("b");
+  double cost_a;
+  double cost_b;
+
+  // Without resource stats, the server hosting fewer replicas is cheaper.
+  a.set_num_live_replicas(10);
+  b.set_num_live_replicas(12);
+  ComputeReplicaPlacementCosts(&a, &b, &cost_a, &cost_b);
+  ASSERT_LT(cost_a, cost_b);
+
+  // Stats reported by only one of the servers are ignored.
+  TSResourceStatsPB stats;
+  stats.set_num_data_dirs(1);
+  stats.set_write_rows_per_sec(100000);
+  stats.set_scan_rows_per_sec(0);
+  stats.set_memory_pressure(0.9);
+  stats.set_data_dirs_free_bytes(1L << 30);
+  a.set_resource_stats(stats);
+  ComputeReplicaPlacementCosts(&a, &b, &cost_a, &cost_b);
+  ASSERT_LT(cost_a, cost_b);
+
+  // Once both report stats, the busy and nearly-full server costs more, even
+  // though it hosts fewer replicas.
+  stats.set_write_rows_per_sec(100);
+  stats.set_memory_pressure(0.1);
+  stats.set_data_dirs_free_bytes(1L << 40);
+  b.set_resource_stats(stats);
+  ComputeReplicaPlacementCosts(&a, &b, &cost_a, &cost_b);
+  ASSERT_GT(cost_a, cost_b);
+
+  // Throughput is compared per data directory.
+  stats.set_write_rows_per_sec(100000);
+  stats.set_memory_pressure(0.9);
+  stats.set_data_dirs_free_bytes(1L << 30);
+  b.set_resource_stats(stats);
+  stats.set_num_data_dirs(10);
+  a.set_resource_stats(stats);
+  a.set_num_live_replicas(12);
+  ComputeReplicaPlacementCosts(&a, &b, &cost_a, &cost_b);
+  ASSERT_LT(cost_a, cost_b);
+}
+
 } // namespace master
 } // namespace kudu
@@ -75,15 +75,19 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/master/rebalancer.h"
 #include "kudu/master/sys_catalog.h"
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/tserver/tserver_admin.proxy.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random_util.h"
@@ -193,6 +197,68 @@ DEFINE_bool(catalog_manager_delete_orphaned_tablets, false,
             "master failures!");
 TAG_FLAG(catalog_manager_delete_orphaned_tablets, advanced);
 
+DEFINE_double(replica_placement_replicas_weight, 1.0,
+              "Weight of the number of replicas hosted by a tablet server in the "
+              "cost of placing a new tablet replica on it.");
+TAG_FLAG(replica_placement_replicas_weight, advanced);
+TAG_FLAG(replica_placement_replicas_weight, experimental);
+
+DEFINE_double(replica_placement_write_weight, 0.5,
+              "Weight of the rows written per second per data directory of a "
+              "tablet server in the cost of placing a new tablet replica on it.");
+TAG_FLAG(replica_placement_write_weight, advanced);
+TAG_FLAG(replica_placement_write_weight, experimental);
+
+DEFINE_double(replica_placement_scan_weight, 0.25,
+              "Weight of the rows scanned per second per data directory of a "
+              "tablet server in the cost of placing a new tablet replica on it.");
+TAG_FLAG(replica_placement_scan_weight, advanced);
+TAG_FLAG(replica_placement_scan_weight, experimental);
+
+DEFINE_double(replica_placement_memory_weight, 0.5,
+              "Weight of the memory consumption of a tablet server, as a fraction "
+              "of its memory limit, in the cost of placing a new tablet replica on it.");
+TAG_FLAG(replica_placement_memory_weight, advanced);
+TAG_FLAG(replica_placement_memory_weight, experimental);
+
+DEFINE_double(replica_placement_disk_weight, 1.0,
+              "Weight of the lack of free space in the data directories of a "
+              "tablet server in the cost of placing a new tablet replica on it.");
+TAG_FLAG(replica_placement_disk_weight, advanced);
+TAG_FLAG(replica_placement_disk_weight, experimental);
+
+DEFINE_int32(catalog_manager_load_threads, 8,
+             "Number of threads used to parse and load the tablet metadata "
+             "of the sys catalog when the master becomes the leader.");
+TAG_FLAG(catalog_manager_load_threads, advanced);
+
+DEFINE_int32(catalog_manager_inject_latency_load_tablets_ms, 0,
+             "Number of milliseconds that the master will sleep before loading "
+             "each block of tablets of the sys catalog. For testing only!");
+TAG_FLAG(catalog_manager_inject_latency_load_tablets_ms, unsafe);
+TAG_FLAG(catalog_manager_inject_latency_load_tablets_ms, hidden);
+
+METRIC_DEFINE_histogram(server, catalog_load_tables_duration,
+                        "Catalog Tables Load Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time taken by a newly elected leader master to load the "
+                        "table metadata of the sys catalog, after which table "
+                        "schemas and table lists are served.",
+                        60 * 60 * 1000LU, 2);
+METRIC_DEFINE_histogram(server, catalog_load_duration,
+                        "Catalog Load Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time taken by a newly elected leader master to load the "
+                        "table and tablet metadata of the sys catalog.",
+                        60 * 60 * 1000LU, 2);
+METRIC_DEFINE_histogram(server, leader_failover_duration,
+                        "Leader Failover Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time from this master being elected leader until it "
+                        "serves all requests, including waiting to catch up with "
+                        "the previous leader's writes and loading the sys catalog.",
+                        60 * 60 * 1000LU, 2);
+
 using std::pair;
 using std::shared_ptr;
 using std::string;
@@ -266,49 +332,92 @@ class TableLoader : public TableVisitor {
 // Tablet Loader
 ////////////////////////////////////////////////////////////
 
+// Visits the tablets on the catalog load pool, one block of tablets per call
+// to VisitTabletBlock(), concurrently; the tables have all been loaded
+// beforehand.
 class TabletLoader : public TabletVisitor {
  public:
   explicit TabletLoader(CatalogManager *catalog_manager)
-    : catalog_manager_(catalog_manager) {
+    : catalog_manager_(catalog_manager),
+      num_loaded_(0) {
   }
 
   virtual Status VisitTablet(const std::string& table_id,
                              const std::string& tablet_id,
                              const SysTabletsEntryPB& metadata) OVERRIDE {
-    // Lookup the table.
-    scoped_refptr<TableInfo> table(FindPtrOrNull(
-        catalog_manager_->table_ids_map_, table_id));
-    if (table == nullptr) {
-      // Tables and tablets are always created/deleted in one operation, so
-      // this shouldn't be possible.
-      LOG(ERROR) << "Missing Table " << table_id << " required by tablet " << tablet_id;
-      LOG(ERROR) << "Metadata: " << SecureDebugString(metadata);
-      return Status::Corruption("Missing table for tablet: ", tablet_id);
-    }
-
-    // Set up the tablet info.
-    TabletInfo* tablet = new TabletInfo(table, tablet_id);
-    TabletMetadataLock l(tablet, TabletMetadataLock::WRITE);
-    l.mutable_data()->pb.CopyFrom(metadata);
+    return VisitTabletBlock({ TabletEntry(tablet_id, metadata) });
+  }
 
-    // Add the tablet to the tablet manager.
-    catalog_manager_->tablet_map_[tablet->tablet_id()] = tablet;
+  virtual Status VisitTabletBlock(const std::vector<TabletEntry>& entries) OVERRIDE {
+    if (PREDICT_FALSE(FLAGS_catalog_manager_inject_latency_load_tablets_ms > 0)) {
+      SleepFor(MonoDelta::FromMilliseconds(FLAGS_catalog_manager_inject_latency_load_tablets_ms));
+    }
 
-    // Add the tablet to the Tablet.
-    bool is_deleted = l.mutable_data()->is_deleted();
-    l.Commit();
-    if (!is_deleted) {
-      table->AddTablet(tablet);
+    // Lookup the tables.
+    vector<scoped_refptr<TableInfo>> tables(entries.size());
+    {
+      shared_lock<CatalogManager::LockType> l(catalog_manager_->lock_);
+      for (size_t i = 0; i < entries.size(); i++) {
+        tables[i] = FindPtrOrNull(catalog_manager_->table_ids_map_,
+                                  entries[i].second.table_id());
+      }
+    }
+
+    // Set up the tablet infos. They aren't visible to anyone else until
+    // they're added to the tablet manager below, so their metadata is
+    // committed right away.
+    vector<scoped_refptr<TabletInfo>> tablets;
+    tablets.reserve(entries.size());
+    std::map<TableInfo*, vector<TabletInfo*>> live_tablets_by_table;
+    for (size_t i = 0; i < entries.size(); i++) {
+      const string& tablet_id = entries[i].first;
+      const SysTabletsEntryPB& metadata = entries[i].second;
+      if (tables[i] == nullptr) {
+        // Tables and tablets are always created/deleted in one operation, so
+        // this shouldn't be possible.
+        LOG(ERROR) << "Missing Table " << metadata.table_id() << " required by tablet "
+                   << tablet_id;
+        LOG(ERROR) << "Metadata: " << SecureDebugString(metadata);
+        return Status::Corruption("Missing table for tablet: ", tablet_id);
+      }
+
+      scoped_refptr<TabletInfo> tablet(new TabletInfo(tables[i], tablet_id));
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::WRITE);
+      l.mutable_data()->pb.CopyFrom(metadata);
+      bool is_deleted = l.mutable_data()->is_deleted();
+      l.Commit();
+      if (!is_deleted) {
+        live_tablets_by_table[tables[i].get()].push_back(tablet.get());
+      }
+      tablets.emplace_back(std::move(tablet));
+
+      VLOG(1) << "Loaded metadata for tablet " << tablet_id
+              << " (table " << tables[i]->ToString() << ")";
+      VLOG(2) << "Metadata for tablet " << tablet_id << ": " << SecureShortDebugString(metadata);
+    }
+
+    // Add the tablets to the tablet manager.
+    {
+      std::lock_guard<CatalogManager::LockType> l(catalog_manager_->lock_);
+      for (const auto& tablet : tablets) {
+        catalog_manager_->tablet_map_[tablet->tablet_id()] = tablet;
+      }
+    }
+
+    // Add the tablets to their tables.
+    for (const auto& e : live_tablets_by_table) {
+      e.first->AddLoadedTablets(e.second);
     }
 
-    LOG(INFO) << "Loaded metadata for tablet " << tablet_id
-              << " (table " << table->ToString() << ")";
-    VLOG(2) << "Metadata for tablet " << tablet_id << ": " << SecureShortDebugString(metadata);
+    num_loaded_.IncrementBy(tablets.size());
     return Status::OK();
   }
 
+  int64_t num_loaded() const { return num_loaded_.Load(); }
+
  private:
   CatalogManager *catalog_manager_;
+  AtomicInt<int64_t> num_loaded_;
 
   DISALLOW_COPY_AND_ASSIGN(TabletLoader);
 };
@@ -416,6 +525,9 @@ void CatalogManagerBgTasks::Run() {
                        << s.ToString();
           }
         }
+
+        // Follow the rebalancer's replica moves and start new ones.
+        catalog_manager_->rebalancer_->Run();
       }
     }
 
@@ -510,6 +622,7 @@ class ScopedTabletInfoCommitter {
     if (PREDICT_TRUE(!aborted_ && state_ == LOCKED)) {
       for (const auto& t : tablets_) {
         t->mutable_metadata()->CommitMutation();
+        t->table()->InvalidateLocations();
       }
       state_ = UNLOCKED;
     }
@@ -607,13 +720,24 @@ CatalogManager::CatalogManager(Master *master)
     rng_(GetRandomSeed32()),
     state_(kConstructed),
     leader_ready_term_(-1),
-    leader_lock_(RWMutex::Priority::PREFER_WRITING) {
+    tables_ready_term_(-1),
+    leader_lock_(RWMutex::Priority::PREFER_WRITING),
+    catalog_load_tables_duration_(
+        METRIC_catalog_load_tables_duration.Instantiate(master->metric_entity())),
+    catalog_load_duration_(
+        METRIC_catalog_load_duration.Instantiate(master->metric_entity())),
+    leader_failover_duration_(
+        METRIC_leader_failover_duration.Instantiate(master->metric_entity())) {
+  rebalancer_.reset(new Rebalancer(this, master));
   CHECK_OK(ThreadPoolBuilder("leader-initialization")
            // Presently, this thread pool must contain only a single thread
            // (to correctly serialize invocations of ElectedAsLeaderCb upon
            // closely timed consecutive elections).
            .set_max_threads(1)
            .Build(&leader_election_pool_));
+  CHECK_OK(ThreadPoolBuilder("catalog-load")
+           .set_max_threads(std::max(FLAGS_catalog_manager_load_threads, 1))
+           .Build(&catalog_load_pool_));
 }
 
 CatalogManager::~CatalogManager() {
@@ -673,6 +797,7 @@ Status CatalogManager::WaitUntilCaughtUpAsLeader(const MonoDelta& timeout) {
 }
 
 void CatalogManager::VisitTablesAndTabletsTask() {
+  MonoTime start = MonoTime::Now();
   {
     // Hack to block this function until InitSysCatalogAsync() is finished.
     shared_lock<LockType> l(lock_);
@@ -716,37 +841,74 @@ void CatalogManager::VisitTablesAndTabletsTask() {
   LOG_SLOW_EXECUTION(WARNING, 1000, LogPrefix() + "Loading metadata into memory") {
     CHECK_OK(VisitTablesAndTablets());
   }
-  std::lock_guard<simple_spinlock> l(state_lock_);
-  leader_ready_term_ = term;
+  leader_failover_duration_->Increment((MonoTime::Now() - start).ToMilliseconds());
 }
 
 Status CatalogManager::VisitTablesAndTablets() {
-  // Block new catalog operations, and wait for existing operations to finish.
-  std::lock_guard<RWMutex> leader_lock_guard(leader_lock_);
-
-  // This lock is held for the entirety of the function because the calls to
-  // VisitTables and VisitTablets mutate global maps.
-  std::lock_guard<LockType> lock(lock_);
-
-  // Abort any outstanding tasks. All TableInfos are orphaned below, so
-  // it's important to end their tasks now; otherwise Shutdown() will
-  // destroy master state used by these tasks.
-  vector<scoped_refptr<TableInfo>> tables;
-  AppendValuesFromMap(table_ids_map_, &tables);
-  AbortAndWaitForAllTasks(tables);
-
-  // Clear the existing state.
-  table_names_map_.clear();
-  table_ids_map_.clear();
-  tablet_map_.clear();
-
-  // Visit tables and tablets, load them into memory.
-  TableLoader table_loader(this);
-  RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTables(&table_loader),
-                        "Failed while visiting tables in sys catalog");
+  Consensus* consensus = sys_catalog_->tablet_peer()->consensus();
+  int64_t term = consensus->ConsensusState(CONSENSUS_CONFIG_COMMITTED).current_term();
+  MonoTime start = MonoTime::Now();
+
+  {
+    // Block new catalog operations, and wait for existing operations to finish.
+    std::lock_guard<RWMutex> leader_lock_guard(leader_lock_);
+
+    // This lock is held while the tables are loaded because the call to
+    // VisitTables mutates global maps.
+    std::lock_guard<LockType> lock(lock_);
+
+    // Fence all requests until the tables are loaded below, and those which
+    // depend on the tablets until the tablets are loaded too.
+    {
+      std::lock_guard<simple_spinlock> l(state_lock_);
+      leader_ready_term_ = -1;
+      tables_ready_term_ = -1;
+    }
+
+    // Abort any outstanding tasks. All TableInfos are orphaned below, so
+    // it's important to end their tasks now; otherwise Shutdown() will
+    // destroy master state used by these tasks.
+    vector<scoped_refptr<TableInfo>> tables;
+    AppendValuesFromMap(table_ids_map_, &tables);
+    AbortAndWaitForAllTasks(tables);
+
+    // The moves of the previous leadership may have been abandoned or finished
+    // in the meantime; the rebalancer plans afresh from the reloaded configs.
+    rebalancer_->Reset();
+
+    // Clear the existing state.
+    table_names_map_.clear();
+    table_ids_map_.clear();
+    tablet_map_.clear();
+
+    // Visit tables, load them into memory.
+    TableLoader table_loader(this);
+    RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTables(&table_loader),
+                          "Failed while visiting tables in sys catalog");
+    LOG(INFO) << LogPrefix() << Substitute("Loaded metadata for $0 tables",
+                                           table_ids_map_.size());
+
+    std::lock_guard<simple_spinlock> l(state_lock_);
+    tables_ready_term_ = term;
+  }
+  catalog_load_tables_duration_->Increment((MonoTime::Now() - start).ToMilliseconds());
+
+  // Visit tablets, load them into memory. The sys catalog orders the tablets
+  // by ID rather than by table, so no table is complete before all of them
+  // are loaded. They are parsed and added to the maps on the catalog load
+  // pool without holding the leader lock, so that table reads are served
+  // meanwhile; every other request is still fenced by 'leader_ready_term_'.
   TabletLoader tablet_loader(this);
-  RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
+  RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader, catalog_load_pool_.get()),
                         "Failed while visiting tablets in sys catalog");
+  LOG(INFO) << LogPrefix() << Substitute("Loaded metadata for $0 tablets",
+                                         tablet_loader.num_loaded());
+
+  {
+    std::lock_guard<simple_spinlock> l(state_lock_);
+    leader_ready_term_ = term;
+  }
+  catalog_load_duration_->Increment((MonoTime::Now() - start).ToMilliseconds());
   return Status::OK();
 }
 
@@ -809,6 +971,7 @@ void CatalogManager::Shutdown() {
   // Must be done before shutting down the catalog, otherwise its tablet peer
   // may be destroyed while still in use by a table visitor.
   leader_election_pool_->Shutdown();
+  catalog_load_pool_->Shutdown();
 
   // Shut down the underlying storage for tables and tablets.
   if (sys_catalog_) {
@@ -823,6 +986,11 @@ static void SetupError(MasterErrorPB* error,
   error->set_code(code);
 }
 
+bool CatalogManager::IsCatalogLoaded() const {
+  std::lock_guard<simple_spinlock> l(state_lock_);
+  return leader_ready_term_ != -1;
+}
+
 Status CatalogManager::CheckOnline() const {
   if (PREDICT_FALSE(!IsInitialized())) {
     return Status::ServiceUnavailable("CatalogManager is not running");
@@ -1888,7 +2056,8 @@ Status CatalogManager::GetTableSchema(const GetTableSchemaRequestPB* req,
   resp->set_num_replicas(l.data().pb.num_replicas());
   resp->set_table_id(table->id());
   resp->mutable_partition_schema()->CopyFrom(l.data().pb.partition_schema());
-  resp->set_create_table_done(!table->IsCreateInProgress());
+  // Until the tablets are loaded, the table's tablets may be incomplete.
+  resp->set_create_table_done(IsCatalogLoaded() && !table->IsCreateInProgress());
   resp->set_table_name(l.data().pb.name());
 
   return Status::OK();
@@ -1977,11 +2146,111 @@ Status CatalogManager::ProcessTabletReport(TSDescriptor* ts_desc,
   // the server should have, compare vs the ones being reported, and somehow mark
   // any that have been "lost" (eg somehow the tablet metadata got corrupted or something).
 
-  for (const ReportedTabletPB& reported : report.updated_tablets()) {
-    ReportedTabletUpdatesPB *tablet_report = report_update->add_tablets();
-    tablet_report->set_tablet_id(reported.tablet_id());
-    RETURN_NOT_OK_PREPEND(HandleReportedTablet(ts_desc, reported, tablet_report),
-                          Substitute("Error handling $0", SecureShortDebugString(reported)));
+  // Look up the reported tablets, ordering them by tablet ID so that they may
+  // all be locked for writing (see the locking rules at the top of the file).
+  std::map<string, ReportedTablet> reported_tablets;
+  vector<const ReportedTabletPB*> unknown_tablets;
+  {
+    shared_lock<LockType> l(lock_);
+    for (const ReportedTabletPB& reported : report.updated_tablets()) {
+      ReportedTabletUpdatesPB *tablet_report = report_update->add_tablets();
+      tablet_report->set_tablet_id(reported.tablet_id());
+      scoped_refptr<TabletInfo> tablet = FindPtrOrNull(tablet_map_, reported.tablet_id());
+      if (!tablet) {
+        unknown_tablets.push_back(&reported);
+        continue;
+      }
+      ReportedTablet& reported_tablet = reported_tablets[reported.tablet_id()];
+      reported_tablet.report = &reported;
+      reported_tablet.report_updates = tablet_report;
+      reported_tablet.tablet = std::move(tablet);
+    }
+  }
+
+  for (const ReportedTabletPB* reported : unknown_tablets) {
+    // It'd be unsafe to ask the tserver to delete this tablet without first
+    // replicating something to our followers (i.e. to guarantee that we're the
+    // leader). For example, if we were a rogue master, we might be deleting a
+    // tablet created by a new master accidentally. But masters retain metadata
+    // for deleted tablets forever, so a tablet can only be truly unknown in
+    // the event of a serious misconfiguration, such as a tserver heartbeating
+    // to the wrong cluster. Therefore, it should be reasonable to ignore it
+    // and wait for an operator fix the situation.
+    if (FLAGS_catalog_manager_delete_orphaned_tablets) {
+      LOG(INFO) << "Deleting unknown tablet " << reported->tablet_id();
+      SendDeleteReplicaRequest(reported->tablet_id(), TABLET_DATA_DELETED,
+                               boost::none, nullptr, ts_desc->permanent_uuid(),
+                               "Report from unknown tablet");
+    } else {
+      LOG(WARNING) << "Ignoring report from unknown tablet: "
+                   << reported->tablet_id();
+    }
+  }
+
+  // Handle the known tablets. Their locks are held until their mutations are
+  // committed below, or released with the mutations discarded if the write
+  // fails. A tablet which fails to be handled is dropped from the report on
+  // its own, with the error passed back to the tablet server so that it
+  // reports the tablet again, rather than holding up the rest of the report.
+  for (auto it = reported_tablets.begin(); it != reported_tablets.end();) {
+    ReportedTablet* reported = &it->second;
+    reported->lock.reset(new TabletMetadataLock(reported->tablet.get(),
+                                                TabletMetadataLock::WRITE));
+    Status s = HandleReportedTablet(ts_desc, reported);
+    if (PREDICT_FALSE(!s.ok())) {
+      s = s.CloneAndPrepend(Substitute("Error handling $0",
+                                       SecureShortDebugString(*reported->report)));
+      LOG(WARNING) << Substitute("Skipping tablet reported by $0: $1",
+                                 ts_desc->ToString(), s.ToString());
+      StatusToPB(s, reported->report_updates->mutable_error());
+      reported->lock->Unlock();
+      it = reported_tablets.erase(it);
+      continue;
+    }
+    ++it;
+  }
+
+  // Write the mutations of the whole report in one go.
+  SysCatalogTable::Actions actions;
+  for (const auto& e : reported_tablets) {
+    if (e.second.modified) {
+      actions.tablets_to_update.push_back(e.second.tablet.get());
+    }
+  }
+  if (!actions.tablets_to_update.empty()) {
+    TRACE("Writing $0 reported tablets", actions.tablets_to_update.size());
+    Status s = sys_catalog_->Write(actions);
+    if (!s.ok()) {
+      LOG(WARNING) << Substitute("Error updating $0 tablets reported by $1: $2",
+                                 actions.tablets_to_update.size(), ts_desc->ToString(),
+                                 s.ToString());
+      return s;
+    }
+  }
+  for (auto& e : reported_tablets) {
+    ReportedTablet* reported = &e.second;
+    if (reported->modified) {
+      reported->lock->Commit();
+      reported->tablet->table()->InvalidateLocations();
+    } else {
+      reported->lock->Unlock();
+    }
+    if (reported->replica_running) {
+      rebalancer_->ReplicaRunning(reported->tablet->tablet_id(), ts_desc->permanent_uuid());
+    }
+  }
+
+  // Need to defer the AlterTable command to after we've committed the new tablet data,
+  // since the tablet report may also be updating the raft config, and the Alter Table
+  // request needs to know who the most recent leader is.
+  for (const auto& e : reported_tablets) {
+    const ReportedTablet& reported = e.second;
+    if (!reported.handled) continue;
+    if (reported.needs_alter) {
+      SendAlterTabletRequest(reported.tablet);
+    } else if (reported.report->has_schema_version()) {
+      HandleTabletSchemaVersionReport(reported.tablet.get(), reported.report->schema_version());
+    }
   }
 
   if (report.updated_tablets_size() > 0) {
@@ -2010,43 +2279,18 @@ bool ShouldTransitionTabletToRunning(const ReportedTabletPB& report) {
 } // anonymous namespace
 
 Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
-                                            const ReportedTabletPB& report,
-                                            ReportedTabletUpdatesPB *report_updates) {
+                                            ReportedTablet* reported) {
+  const ReportedTabletPB& report = *reported->report;
+  ReportedTabletUpdatesPB* report_updates = reported->report_updates;
+  const scoped_refptr<TabletInfo>& tablet = reported->tablet;
+  TabletMetadataLock& tablet_lock = *reported->lock;
   TRACE_EVENT1("master", "HandleReportedTablet",
                "tablet_id", report.tablet_id());
-  scoped_refptr<TabletInfo> tablet;
-  {
-    shared_lock<LockType> l(lock_);
-    tablet = FindPtrOrNull(tablet_map_, report.tablet_id());
-  }
-  if (!tablet) {
-    // It'd be unsafe to ask the tserver to delete this tablet without first
-    // replicating something to our followers (i.e. to guarantee that we're the
-    // leader). For example, if we were a rogue master, we might be deleting a
-    // tablet created by a new master accidentally. But masters retain metadata
-    // for deleted tablets forever, so a tablet can only be truly unknown in
-    // the event of a serious misconfiguration, such as a tserver heartbeating
-    // to the wrong cluster. Therefore, it should be reasonable to ignore it
-    // and wait for an operator fix the situation.
-    if (FLAGS_catalog_manager_delete_orphaned_tablets) {
-      LOG(INFO) << "Deleting unknown tablet " << report.tablet_id();
-      SendDeleteReplicaRequest(report.tablet_id(), TABLET_DATA_DELETED,
-                               boost::none, nullptr, ts_desc->permanent_uuid(),
-                               "Report from unknown tablet");
-    } else {
-      LOG(WARNING) << "Ignoring report from unknown tablet: "
-                   << report.tablet_id();
-    }
-    return Status::OK();
-  }
   DCHECK(tablet->table()); // guaranteed by TabletLoader
 
   VLOG(3) << "tablet report: " << SecureShortDebugString(report);
 
-  // TODO: we don't actually need to do the COW here until we see we're going
-  // to change the state. Can we change CowedObject to lazily do the copy?
   TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
-  TabletMetadataLock tablet_lock(tablet.get(), TabletMetadataLock::WRITE);
 
   // If the TS is reporting a tablet which has been deleted, or a tablet from
   // a table which has been deleted, send it an RPC to delete it.
@@ -2073,7 +2317,6 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
   }
 
   // Check if the tablet requires an "alter table" call
-  bool tablet_needs_alter = false;
   if (report.has_schema_version() &&
       table_lock.data().pb.version() != report.schema_version()) {
     if (report.schema_version() > table_lock.data().pb.version()) {
@@ -2092,7 +2335,7 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
     // It's possible that the tablet being reported is a laggy replica, and in fact
     // the leader has already received an AlterTable RPC. That's OK, though --
     // it'll safely ignore it if we send another.
-    tablet_needs_alter = true;
+    reported->needs_alter = true;
   }
 
 
@@ -2105,6 +2348,10 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
     return Status::OK();
   }
 
+  if (report.state() == tablet::RUNNING) {
+    reported->replica_running = true;
+  }
+
   // The report will not have a committed_consensus_state if it is in the
   // middle of starting up, such as during tablet bootstrap.
   if (report.has_committed_consensus_state()) {
@@ -2141,17 +2388,16 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
           << "Tablet in unexpected state: " << tablet->ToString()
           << ": " << SecureShortDebugString(tablet_lock.data().pb);
       // Mark the tablet as running
-      // TODO: we could batch the IO onto a background thread, or at least
-      // across multiple tablets in the same report.
       VLOG(1) << "Tablet " << tablet->ToString() << " is now online";
       tablet_lock.mutable_data()->set_state(SysTabletsEntryPB::RUNNING,
                                             "Tablet reported with an active leader");
+      reported->modified = true;
     }
 
     // The Master only accepts committed consensus configurations since it needs the committed index
     // to only cache the most up-to-date config.
     if (PREDICT_FALSE(!cstate.config().has_opid_index())) {
-      LOG(DFATAL) << "Missing opid_index in reported config:\n" << SecureDebugString(report);
+      LOG(WARNING) << "Missing opid_index in reported config:\n" << SecureDebugString(report);
       return Status::InvalidArgument("Missing opid_index in reported config");
     }
 
@@ -2210,32 +2456,11 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
 
       RETURN_NOT_OK(HandleRaftConfigChanged(*final_report, tablet,
                                             &tablet_lock, &table_lock));
-
+      reported->modified = true;
     }
   }
 
-  table_lock.Unlock();
-  // We update the tablets each time that someone reports it.
-  // This shouldn't be very frequent and should only happen when something in fact changed.
-  SysCatalogTable::Actions actions;
-  actions.tablets_to_update.push_back(tablet.get());
-  Status s = sys_catalog_->Write(actions);
-  if (!s.ok()) {
-    LOG(WARNING) << "Error updating tablets: " << s.ToString() << ". Tablet report was: "
-                 << SecureShortDebugString(report);
-    return s;
-  }
-  tablet_lock.Commit();
-
-  // Need to defer the AlterTable command to after we've committed the new tablet data,
-  // since the tablet report may also be updating the raft config, and the Alter Table
-  // request needs to know who the most recent leader is.
-  if (tablet_needs_alter) {
-    SendAlterTabletRequest(tablet);
-  } else if (report.has_schema_version()) {
-    HandleTabletSchemaVersionReport(tablet.get(), report.schema_version());
-  }
-
+  reported->handled = true;
   return Status::OK();
 }
 
@@ -2450,6 +2675,10 @@ class RetryingTSRpcTask : public MonitoredTask {
     return Substitute("$0: ", description());
   }
 
+  // Called by UnregisterAsyncTask() once the task is done, before it is
+  // unregistered. Subclasses may override it to act on the task's final state.
+  virtual void UnregisterAsyncTaskCallback() {}
+
   // Transition from running -> complete.
   void MarkComplete() {
     NoBarrier_CompareAndSwap(&state_, kStateRunning, kStateComplete);
@@ -2555,6 +2784,7 @@ class RetryingTSRpcTask : public MonitoredTask {
   // Clean up request and release resources. May call 'delete this'.
   void UnregisterAsyncTask() {
     end_ts_ = MonoTime::Now();
+    UnregisterAsyncTaskCallback();
     if (table_ != nullptr) {
       table_->RemoveTask(this);
     } else {
@@ -2995,6 +3225,189 @@ void AsyncAddServerTask::HandleResponse(int attempt) {
   }
 }
 
+// Sends a ChangeConfig() adding or removing a specific tablet server to or
+// from a tablet's config, on behalf of the rebalancer. Like AsyncAddServerTask,
+// the change is conditional on the config the rebalancer based it on.
+// 'failed_cb' is run if the task fails without being retried further.
+class AsyncChangeConfigTask : public RetryingTSRpcTask {
+ public:
+  AsyncChangeConfigTask(Master* master,
+                        const scoped_refptr<TabletInfo>& tablet,
+                        consensus::ChangeConfigType type,
+                        const string& peer_uuid,
+                        int64_t cas_config_opid_index,
+                        const MonoTime& deadline,
+                        const Closure& failed_cb)
+    : RetryingTSRpcTask(master,
+                        gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
+                        tablet->table()),
+      tablet_(tablet),
+      type_(type),
+      peer_uuid_(peer_uuid),
+      cas_config_opid_index_(cas_config_opid_index),
+      failed_cb_(failed_cb) {
+    deadline_ = deadline;
+  }
+
+  virtual string type_name() const OVERRIDE {
+    return Substitute("$0 ChangeConfig", consensus::ChangeConfigType_Name(type_));
+  }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("$0 ChangeConfig RPC for tablet $1 and peer $2 on TS $3 "
+                      "with cas_config_opid_index $4",
+                      consensus::ChangeConfigType_Name(type_),
+                      tablet_->tablet_id(),
+                      peer_uuid_,
+                      target_ts_desc_->ToString(),
+                      cas_config_opid_index_);
+  }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE;
+  virtual void HandleResponse(int attempt) OVERRIDE;
+
+  virtual void UnregisterAsyncTaskCallback() OVERRIDE {
+    if (state() == kStateFailed && !failed_cb_.is_null()) {
+      failed_cb_.Run();
+    }
+  }
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+
+  const scoped_refptr<TabletInfo> tablet_;
+  const consensus::ChangeConfigType type_;
+  const string peer_uuid_;
+  const int64_t cas_config_opid_index_;
+  const Closure failed_cb_;
+
+  consensus::ChangeConfigRequestPB req_;
+  consensus::ChangeConfigResponsePB resp_;
+};
+
+bool AsyncChangeConfigTask::SendRequest(int attempt) {
+  // Bail if the config has moved on since the change was planned.
+  int64_t latest_index;
+  {
+    TabletMetadataLock tablet_lock(tablet_.get(), TabletMetadataLock::READ);
+    latest_index = tablet_lock.data().pb.committed_consensus_state().config().opid_index();
+  }
+  if (latest_index > cas_config_opid_index_) {
+    LOG_WITH_PREFIX(INFO) << "Latest config has opid_index of " << latest_index
+                          << " while this task has opid_index of "
+                          << cas_config_opid_index_ << ". Aborting task.";
+    MarkAborted();
+    return false;
+  }
+
+  req_.set_dest_uuid(target_ts_desc_->permanent_uuid());
+  req_.set_tablet_id(tablet_->tablet_id());
+  req_.set_type(type_);
+  req_.set_cas_config_opid_index(cas_config_opid_index_);
+  RaftPeerPB* peer = req_.mutable_server();
+  peer->set_permanent_uuid(peer_uuid_);
+  if (type_ == consensus::ADD_SERVER) {
+    shared_ptr<TSDescriptor> ts_desc;
+    if (!master_->ts_manager()->LookupTSByUUID(peer_uuid_, &ts_desc)) {
+      LOG_WITH_PREFIX(WARNING) << "Could not find TS for UUID " << peer_uuid_
+                               << ". No further retry.";
+      MarkFailed();
+      return false;
+    }
+    ServerRegistrationPB peer_reg;
+    ts_desc->GetRegistration(&peer_reg);
+    CHECK_GT(peer_reg.rpc_addresses_size(), 0);
+    *peer->mutable_last_known_addr() = peer_reg.rpc_addresses(0);
+    peer->set_member_type(RaftPeerPB::VOTER);
+  }
+  VLOG(1) << "Sending " << type_name() << " request to "
+          << target_ts_desc_->ToString() << ":\n"
+          << SecureDebugString(req_);
+  consensus_proxy_->ChangeConfigAsync(req_, &resp_, &rpc_,
+                                      boost::bind(&AsyncChangeConfigTask::RpcCallback, this));
+  return true;
+}
+
+void AsyncChangeConfigTask::HandleResponse(int attempt) {
+  if (!resp_.has_error()) {
+    MarkComplete();
+    LOG_WITH_PREFIX(INFO) << "Change config succeeded";
+    return;
+  }
+
+  Status status = StatusFromPB(resp_.error().status());
+
+  // Do not retry on a CAS error, otherwise retry until the deadline.
+  switch (resp_.error().code()) {
+    case TabletServerErrorPB::CAS_FAILED:
+      LOG_WITH_PREFIX(WARNING) << "ChangeConfig() failed with leader "
+                               << target_ts_desc_->ToString()
+                               << " due to CAS failure. No further retry: "
+                               << status.ToString();
+      MarkFailed();
+      break;
+    default:
+      LOG_WITH_PREFIX(INFO) << "ChangeConfig() failed with leader "
+                            << target_ts_desc_->ToString()
+                            << " due to error "
+                            << TabletServerErrorPB::Code_Name(resp_.error().code())
+                            << ". This operation will be retried. Error detail: "
+                            << status.ToString();
+      break;
+  }
+}
+
+// Asks a specific replica of a tablet to start a leader election, on behalf
+// of the rebalancer.
+class AsyncRunLeaderElection : public RetrySpecificTSRpcTask {
+ public:
+  AsyncRunLeaderElection(Master* master,
+                         const scoped_refptr<TabletInfo>& tablet,
+                         const string& permanent_uuid,
+                         const MonoTime& deadline)
+    : RetrySpecificTSRpcTask(master, permanent_uuid, tablet->table()),
+      tablet_(tablet) {
+    deadline_ = deadline;
+  }
+
+  virtual string type_name() const OVERRIDE { return "RunLeaderElection"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("RunLeaderElection RPC for tablet $0 on TS $1",
+                      tablet_->tablet_id(), permanent_uuid_);
+  }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    req_.set_dest_uuid(permanent_uuid_);
+    req_.set_tablet_id(tablet_->tablet_id());
+    consensus_proxy_->RunLeaderElectionAsync(
+        req_, &resp_, &rpc_, boost::bind(&AsyncRunLeaderElection::RpcCallback, this));
+    return true;
+  }
+
+  // An election which can't be started now is not retried: the rebalancer
+  // picks its leader transfers afresh each round.
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (!resp_.has_error()) {
+      MarkComplete();
+      return;
+    }
+    LOG_WITH_PREFIX(WARNING) << "RunLeaderElection() failed: "
+                             << StatusFromPB(resp_.error().status()).ToString();
+    MarkFailed();
+  }
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+
+  const scoped_refptr<TabletInfo> tablet_;
+
+  consensus::RunLeaderElectionRequestPB req_;
+  consensus::RunLeaderElectionResponsePB resp_;
+};
+
 void CatalogManager::SendAlterTableRequest(const scoped_refptr<TableInfo>& table) {
   vector<scoped_refptr<TabletInfo> > tablets;
   table->GetAllTablets(&tablets);
@@ -3074,6 +3487,26 @@ void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& table
   LOG(INFO) << "Started AddServer task for tablet " << tablet->tablet_id();
 }
 
+void CatalogManager::SendChangeConfigRequest(const scoped_refptr<TabletInfo>& tablet,
+                                             consensus::ChangeConfigType type,
+                                             const string& peer_uuid,
+                                             int64_t cas_config_opid_index,
+                                             const MonoTime& deadline,
+                                             const Closure& failed_cb) {
+  auto task = new AsyncChangeConfigTask(master_, tablet, type, peer_uuid,
+                                        cas_config_opid_index, deadline, failed_cb);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send new ChangeConfig request");
+}
+
+void CatalogManager::SendLeaderElectionRequest(const scoped_refptr<TabletInfo>& tablet,
+                                               const string& ts_uuid,
+                                               const MonoTime& deadline) {
+  auto task = new AsyncRunLeaderElection(master_, tablet, ts_uuid, deadline);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send new RunLeaderElection request");
+}
+
 void CatalogManager::ExtractTabletsToProcess(
     vector<scoped_refptr<TabletInfo>>* tablets_to_process) {
 
@@ -3371,14 +3804,29 @@ void CatalogManager::SendCreateTabletRequest(const scoped_refptr<TabletInfo>& ta
   }
 }
 
-shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
-    const TSDescriptorVector& two_choices) {
-  DCHECK_EQ(two_choices.size(), 2);
+namespace {
 
-  const auto& a = two_choices[0];
-  const auto& b = two_choices[1];
+// Adds 'weight' times 'value_a' and 'value_b', scaled by the larger of the
+// two, to 'cost_a' and 'cost_b' respectively. Nothing is added if neither
+// value is positive.
+void AddRelativeCost(double weight, double value_a, double value_b,
+                     double* cost_a, double* cost_b) {
+  double max_value = std::max(value_a, value_b);
+  if (max_value <= 0) {
+    return;
+  }
+  *cost_a += weight * value_a / max_value;
+  *cost_b += weight * value_b / max_value;
+}
 
-  // When creating replicas, we consider two aspects of load:
+} // anonymous namespace
+
+void ComputeReplicaPlacementCosts(TSDescriptor* a, TSDescriptor* b,
+                                  double* cost_a, double* cost_b) {
+  *cost_a = 0;
+  *cost_b = 0;
+
+  // We consider two aspects of the replica load:
   //   (1) how many tablet replicas are already on the server, and
   //   (2) how often we've chosen this server recently.
   //
@@ -3391,17 +3839,70 @@ shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
   // not yet reported by the server). This is important because, while creating a table,
   // we batch the selection process before sending any creation commands to the
   // servers themselves.
-  //
-  // TODO: in the future we may want to factor in other items such as available disk space,
-  // actual request load, etc.
-  double load_a = a->RecentReplicaCreations() + a->num_live_replicas();
-  double load_b = b->RecentReplicaCreations() + b->num_live_replicas();
-  if (load_a < load_b) {
+  AddRelativeCost(FLAGS_replica_placement_replicas_weight,
+                  a->RecentReplicaCreations() + a->num_live_replicas(),
+                  b->RecentReplicaCreations() + b->num_live_replicas(),
+                  cost_a, cost_b);
+
+  // Then the resource usage the servers last heartbeated, so that new replicas
+  // avoid busy or nearly-full servers. Each stat is only considered if both
+  // servers reported it.
+  TSResourceStatsPB stats_a;
+  TSResourceStatsPB stats_b;
+  a->GetResourceStats(&stats_a);
+  b->GetResourceStats(&stats_b);
+
+  // Throughput is compared per data directory, since servers with more
+  // directories can sustain more I/O.
+  int dirs_a = std::max(stats_a.num_data_dirs(), 1);
+  int dirs_b = std::max(stats_b.num_data_dirs(), 1);
+  if (stats_a.has_write_rows_per_sec() && stats_b.has_write_rows_per_sec()) {
+    AddRelativeCost(FLAGS_replica_placement_write_weight,
+                    stats_a.write_rows_per_sec() / dirs_a,
+                    stats_b.write_rows_per_sec() / dirs_b,
+                    cost_a, cost_b);
+  }
+  if (stats_a.has_scan_rows_per_sec() && stats_b.has_scan_rows_per_sec()) {
+    AddRelativeCost(FLAGS_replica_placement_scan_weight,
+                    stats_a.scan_rows_per_sec() / dirs_a,
+                    stats_b.scan_rows_per_sec() / dirs_b,
+                    cost_a, cost_b);
+  }
+
+  if (stats_a.has_memory_pressure() && stats_b.has_memory_pressure()) {
+    *cost_a += FLAGS_replica_placement_memory_weight * stats_a.memory_pressure();
+    *cost_b += FLAGS_replica_placement_memory_weight * stats_b.memory_pressure();
+  }
+
+  // The server with less free space costs more, in proportion to how much
+  // less it has than the other.
+  if (stats_a.has_data_dirs_free_bytes() && stats_b.has_data_dirs_free_bytes()) {
+    double max_free = std::max(stats_a.data_dirs_free_bytes(), stats_b.data_dirs_free_bytes());
+    if (max_free > 0) {
+      *cost_a += FLAGS_replica_placement_disk_weight *
+          (1 - stats_a.data_dirs_free_bytes() / max_free);
+      *cost_b += FLAGS_replica_placement_disk_weight *
+          (1 - stats_b.data_dirs_free_bytes() / max_free);
+    }
+  }
+}
+
+shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
+    const TSDescriptorVector& two_choices) {
+  DCHECK_EQ(two_choices.size(), 2);
+
+  const auto& a = two_choices[0];
+  const auto& b = two_choices[1];
+
+  double cost_a;
+  double cost_b;
+  ComputeReplicaPlacementCosts(a.get(), b.get(), &cost_a, &cost_b);
+  if (cost_a < cost_b) {
     return a;
-  } else if (load_b < load_a) {
+  } else if (cost_b < cost_a) {
     return b;
   } else {
-    // If the load is the same, we can just pick randomly.
+    // If the cost is the same, we can just pick randomly.
     return two_choices[rng_.Uniform(2)];
   }
 }
@@ -3483,7 +3984,8 @@ void CatalogManager::SelectReplicas(const TSDescriptorVector& ts_descs,
 }
 
 Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
-                                               TabletLocationsPB* locs_pb) {
+                                               TabletLocationsPB* locs_pb,
+                                               bool* all_ts_registered) {
   TabletMetadataLock l_tablet(tablet.get(), TabletMetadataLock::READ);
   if (PREDICT_FALSE(l_tablet.data().is_deleted())) {
     return Status::NotFound("Tablet deleted", l_tablet.data().pb.state_msg());
@@ -3496,6 +3998,9 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   // Guaranteed because the tablet is RUNNING.
   DCHECK(l_tablet.data().pb.has_committed_consensus_state());
 
+  if (all_ts_registered) {
+    *all_ts_registered = true;
+  }
   const ConsensusStatePB& cstate = l_tablet.data().pb.committed_consensus_state();
   for (const consensus::RaftPeerPB& peer : cstate.config().peers()) {
     // TODO: GetConsensusRole() iterates over all of the peers, making this an
@@ -3517,6 +4022,9 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
       //
       // TODO: We should track these RPC addresses in the master table itself.
       tsinfo_pb->add_rpc_addresses()->CopyFrom(peer.last_known_addr());
+      if (all_ts_registered) {
+        *all_ts_registered = false;
+      }
     }
   }
 
@@ -3529,6 +4037,28 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   return Status::OK();
 }
 
+Status CatalogManager::AppendSerializedLocationsForTablet(
+    const scoped_refptr<TabletInfo>& tablet,
+    int64_t version,
+    faststring* out) {
+  const scoped_refptr<TableInfo>& table = tablet->table();
+  shared_ptr<const string> serialized = table->GetCachedLocations(tablet->tablet_id(), version);
+  if (!serialized) {
+    GetTableLocationsResponsePB entry;
+    bool all_ts_registered;
+    RETURN_NOT_OK(BuildLocationsForTablet(tablet, entry.add_tablet_locations(),
+                                          &all_ts_registered));
+    serialized = std::make_shared<const string>(entry.SerializeAsString());
+    // Addresses taken from the config are replaced by the registered ones once
+    // the tablet server registers, which doesn't invalidate the cache.
+    if (all_ts_registered) {
+      table->CacheLocations(tablet->tablet_id(), version, serialized);
+    }
+  }
+  out->append(*serialized);
+  return Status::OK();
+}
+
 Status CatalogManager::GetTabletLocations(const std::string& tablet_id,
                                           TabletLocationsPB* locs_pb) {
   leader_lock_.AssertAcquiredForReading();
@@ -3547,7 +4077,8 @@ Status CatalogManager::GetTabletLocations(const std::string& tablet_id,
 }
 
 Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
-                                         GetTableLocationsResponsePB* resp) {
+                                         GetTableLocationsResponsePB* resp,
+                                         faststring* locations_sidecar) {
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
 
@@ -3573,14 +4104,31 @@ Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
   TableMetadataLock l(table.get(), TableMetadataLock::READ);
   RETURN_NOT_OK(CheckIfTableDeletedOrNotRunning(&l, resp));
 
+  // Cached locations hold the addresses the tablet servers registered with,
+  // so drop them if any server has re-registered since they were built.
+  table->InvalidateLocationsIfRegistrationChanged(
+      master_->ts_manager()->registration_version());
+
+  // Read the version before the tablets, so that locations built from tablet
+  // metadata which changes concurrently are cached under a stale version.
+  int64_t locations_version = table->locations_version();
   vector<scoped_refptr<TabletInfo> > tablets_in_range;
   table->GetTabletsInRange(req, &tablets_in_range);
 
   for (const scoped_refptr<TabletInfo>& tablet : tablets_in_range) {
-    Status s = BuildLocationsForTablet(tablet, resp->add_tablet_locations());
+    Status s;
+    if (locations_sidecar) {
+      s = AppendSerializedLocationsForTablet(tablet, locations_version, locations_sidecar);
+    } else {
+      s = BuildLocationsForTablet(tablet, resp->add_tablet_locations());
+    }
     if (s.ok()) {
       continue;
-    } else if (s.IsNotFound()) {
+    }
+    if (locations_sidecar) {
+      locations_sidecar->clear();
+    }
+    if (s.IsNotFound()) {
       // The tablet has been deleted; force the client to retry. This is a
       // transient state that only happens with a concurrent drop range
       // partition alter table operation.
@@ -3688,7 +4236,8 @@ void CatalogManager::AbortAndWaitForAllTasks(
 CatalogManager::ScopedLeaderSharedLock::ScopedLeaderSharedLock(
     CatalogManager* catalog)
     : catalog_(DCHECK_NOTNULL(catalog)),
-      leader_shared_lock_(catalog->leader_lock_, std::try_to_lock) {
+      leader_shared_lock_(catalog->leader_lock_, std::try_to_lock),
+      is_ready_for_table_reads_(false) {
 
   // Check if the catalog manager is running.
   std::lock_guard<simple_spinlock> l(catalog_->state_lock_);
@@ -3709,8 +4258,14 @@ CatalogManager::ScopedLeaderSharedLock::ScopedLeaderSharedLock(
                    uuid, SecureShortDebugString(cstate)));
     return;
   }
-  if (PREDICT_FALSE(catalog_->leader_ready_term_ != cstate.current_term() ||
-                    !leader_shared_lock_.owns_lock())) {
+  if (PREDICT_FALSE(!leader_shared_lock_.owns_lock())) {
+    leader_status_ = Status::ServiceUnavailable(
+        "Leader not yet ready to serve requests");
+    return;
+  }
+  is_ready_for_table_reads_ = catalog_->leader_ready_term_ == cstate.current_term() ||
+                              catalog_->tables_ready_term_ == cstate.current_term();
+  if (PREDICT_FALSE(catalog_->leader_ready_term_ != cstate.current_term())) {
     leader_status_ = Status::ServiceUnavailable(
         "Leader not yet ready to serve requests");
     return;
@@ -3744,6 +4299,15 @@ bool CatalogManager::ScopedLeaderSharedLock::CheckIsInitializedAndIsLeaderOrResp
   return false;
 }
 
+template<typename RespClass>
+bool CatalogManager::ScopedLeaderSharedLock::CheckIsInitializedAndIsReadyForTableReadsOrRespond(
+    RespClass* resp, RpcContext* rpc) {
+  if (PREDICT_TRUE(catalog_status_.ok() && is_ready_for_table_reads_)) {
+    return true;
+  }
+  return CheckIsInitializedAndIsLeaderOrRespond(resp, rpc);
+}
+
 // Explicit specialization for callers outside this compilation unit.
 #define INITTED_OR_RESPOND(RespClass) \
   template bool \
@@ -3753,6 +4317,10 @@ bool CatalogManager::ScopedLeaderSharedLock::CheckIsInitializedAndIsLeaderOrResp
   template bool \
   CatalogManager::ScopedLeaderSharedLock::CheckIsInitializedAndIsLeaderOrRespond( \
       RespClass* resp, RpcContext* rpc)
+#define INITTED_AND_READY_FOR_TABLE_READS_OR_RESPOND(RespClass) \
+  template bool \
+  CatalogManager::ScopedLeaderSharedLock::CheckIsInitializedAndIsReadyForTableReadsOrRespond( \
+      RespClass* resp, RpcContext* rpc)
 
 INITTED_OR_RESPOND(GetMasterRegistrationResponsePB);
 INITTED_OR_RESPOND(TSHeartbeatResponsePB);
@@ -3766,9 +4334,12 @@ INITTED_AND_LEADER_OR_RESPOND(ListTabletServersResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(GetTableLocationsResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(GetTableSchemaResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(GetTabletLocationsResponsePB);
+INITTED_AND_READY_FOR_TABLE_READS_OR_RESPOND(GetTableSchemaResponsePB);
+INITTED_AND_READY_FOR_TABLE_READS_OR_RESPOND(ListTablesResponsePB);
 
 #undef INITTED_OR_RESPOND
 #undef INITTED_AND_LEADER_OR_RESPOND
+#undef INITTED_AND_READY_FOR_TABLE_READS_OR_RESPOND
 
 ////////////////////////////////////////////////////////////
 // TabletInfo
@@ -3822,7 +4393,11 @@ void PersistentTabletInfo::set_state(SysTabletsEntryPB::State state, const strin
 // TableInfo
 ////////////////////////////////////////////////////////////
 
-TableInfo::TableInfo(std::string table_id) : table_id_(std::move(table_id)) {}
+TableInfo::TableInfo(std::string table_id)
+    : table_id_(std::move(table_id)),
+      locations_version_(0),
+      ts_registration_version_(0) {
+}
 
 TableInfo::~TableInfo() {
 }
@@ -3833,16 +4408,34 @@ std::string TableInfo::ToString() const {
 }
 
 bool TableInfo::RemoveTablet(const std::string& partition_key_start) {
-  std::lock_guard<rw_spinlock> l(lock_);
-  return EraseKeyReturnValuePtr(&tablet_map_, partition_key_start) != nullptr;
+  bool removed;
+  {
+    std::lock_guard<rw_spinlock> l(lock_);
+    removed = EraseKeyReturnValuePtr(&tablet_map_, partition_key_start) != nullptr;
+  }
+  InvalidateLocations();
+  return removed;
 }
 
 void TableInfo::AddTablet(TabletInfo *tablet) {
-  std::lock_guard<rw_spinlock> l(lock_);
-  AddTabletUnlocked(tablet);
+  {
+    std::lock_guard<rw_spinlock> l(lock_);
+    AddTabletUnlocked(tablet);
+  }
+  InvalidateLocations();
 }
 
 void TableInfo::AddTablets(const vector<TabletInfo*>& tablets) {
+  {
+    std::lock_guard<rw_spinlock> l(lock_);
+    for (TabletInfo *tablet : tablets) {
+      AddTabletUnlocked(tablet);
+    }
+  }
+  InvalidateLocations();
+}
+
+void TableInfo::AddLoadedTablets(const vector<TabletInfo*>& tablets) {
   std::lock_guard<rw_spinlock> l(lock_);
   for (TabletInfo *tablet : tablets) {
     AddTabletUnlocked(tablet);
@@ -3851,13 +4444,55 @@ void TableInfo::AddTablets(const vector<TabletInfo*>& tablets) {
 
 void TableInfo::AddRemoveTablets(const vector<scoped_refptr<TabletInfo>>& tablets_to_add,
                                  const vector<scoped_refptr<TabletInfo>>& tablets_to_drop) {
-  std::lock_guard<rw_spinlock> l(lock_);
-  for (const auto& tablet : tablets_to_drop) {
-    const auto& lower_bound = tablet->metadata().state().pb.partition().partition_key_start();
-    CHECK(EraseKeyReturnValuePtr(&tablet_map_, lower_bound) != nullptr);
+  {
+    std::lock_guard<rw_spinlock> l(lock_);
+    for (const auto& tablet : tablets_to_drop) {
+      const auto& lower_bound = tablet->metadata().state().pb.partition().partition_key_start();
+      CHECK(EraseKeyReturnValuePtr(&tablet_map_, lower_bound) != nullptr);
+    }
+    for (const auto& tablet : tablets_to_add) {
+      AddTabletUnlocked(tablet.get());
+    }
   }
-  for (const auto& tablet : tablets_to_add) {
-    AddTabletUnlocked(tablet.get());
+  InvalidateLocations();
+}
+
+int64_t TableInfo::locations_version() const {
+  std::lock_guard<simple_spinlock> l(locations_lock_);
+  return locations_version_;
+}
+
+void TableInfo::InvalidateLocations() {
+  std::lock_guard<simple_spinlock> l(locations_lock_);
+  locations_version_++;
+  cached_locations_.clear();
+}
+
+void TableInfo::InvalidateLocationsIfRegistrationChanged(int64_t ts_registration_version) {
+  std::lock_guard<simple_spinlock> l(locations_lock_);
+  if (ts_registration_version != ts_registration_version_) {
+    ts_registration_version_ = ts_registration_version;
+    locations_version_++;
+    cached_locations_.clear();
+  }
+}
+
+shared_ptr<const string> TableInfo::GetCachedLocations(const string& tablet_id,
+                                                       int64_t version) const {
+  std::lock_guard<simple_spinlock> l(locations_lock_);
+  if (version != locations_version_) {
+    return nullptr;
+  }
+  const auto* serialized = FindOrNull(cached_locations_, tablet_id);
+  return serialized ? *serialized : nullptr;
+}
+
+void TableInfo::CacheLocations(const string& tablet_id,
+                               int64_t version,
+                               shared_ptr<const string> serialized) {
+  std::lock_guard<simple_spinlock> l(locations_lock_);
+  if (version == locations_version_) {
+    cached_locations_[tablet_id] = std::move(serialized);
   }
 }
 
@@ -19,6 +19,7 @@
 
 #include <boost/optional/optional_fwd.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -26,6 +27,8 @@
 #include <vector>
 
 #include "kudu/common/partition.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/callback.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/master/master.pb.h"
@@ -43,6 +46,8 @@
 
 namespace kudu {
 
+class faststring;
+class Histogram;
 class Schema;
 class ThreadPool;
 class CreateTableStressTest_TestConcurrentCreateTableAndReloadMetadata_Test;
@@ -55,12 +60,20 @@ namespace master {
 
 class CatalogManagerBgTasks;
 class Master;
+class Rebalancer;
 class SysCatalogTable;
 class TableInfo;
 class TSDescriptor;
 
 struct DeferredAssignmentActions;
 
+// Computes the costs of placing a new tablet replica on each of the tablet
+// servers 'a' and 'b', from the replicas they host or were recently chosen
+// for and from the resource usage they last heartbeated. Only the comparison
+// of the two costs is meaningful: each factor is scaled relative to the pair.
+void ComputeReplicaPlacementCosts(TSDescriptor* a, TSDescriptor* b,
+                                  double* cost_a, double* cost_b);
+
 // The data related to a tablet which is persisted on disk.
 // This portion of TableInfo is managed via CowObject.
 // It wraps the underlying protobuf to add useful accessors.
@@ -192,6 +205,10 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   void AddTablet(TabletInfo *tablet);
   // Add multiple tablets to this table.
   void AddTablets(const std::vector<TabletInfo*>& tablets);
+  // Add multiple tablets loaded from the sys catalog to this table. Unlike
+  // AddTablets(), doesn't invalidate the cached locations: the table is new
+  // to the load and none of its locations are served until it's done.
+  void AddLoadedTablets(const std::vector<TabletInfo*>& tablets);
 
   // Atomically add and remove multiple tablets from this table.
   void AddRemoveTablets(const vector<scoped_refptr<TabletInfo>>& tablets_to_add,
@@ -239,6 +256,34 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
     return tablet_map_.size();
   }
 
+  // Returns the current version of the locations of the table's tablets.
+  // Cached serialized locations are only valid for the version they were
+  // built at.
+  int64_t locations_version() const;
+
+  // Drops the cached serialized locations and bumps the locations version.
+  // Must be called after any change to the table's tablets, or to their
+  // committed metadata, which may change their locations.
+  void InvalidateLocations();
+
+  // Invalidates the cached serialized locations if they were cached before
+  // the tablet servers' registration version last changed, since they hold
+  // the servers' registered addresses. See
+  // TSManager::registration_version().
+  void InvalidateLocationsIfRegistrationChanged(int64_t ts_registration_version);
+
+  // Returns the cached serialized locations of tablet 'tablet_id', if they
+  // were cached at locations version 'version' and it is still current.
+  // Otherwise returns null.
+  std::shared_ptr<const std::string> GetCachedLocations(const std::string& tablet_id,
+                                                        int64_t version) const;
+
+  // Caches the serialized locations of tablet 'tablet_id', built at locations
+  // version 'version'. Does nothing if the version is no longer current.
+  void CacheLocations(const std::string& tablet_id,
+                      int64_t version,
+                      std::shared_ptr<const std::string> serialized);
+
  private:
   friend class RefCountedThreadSafe<TableInfo>;
   ~TableInfo();
@@ -259,6 +304,22 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   // List of pending tasks (e.g. create/alter tablet requests)
   std::unordered_set<MonitoredTask*> pending_tasks_;
 
+  // Protects locations_version_ and cached_locations_.
+  mutable simple_spinlock locations_lock_;
+
+  // Bumped whenever the locations of the table's tablets may have changed.
+  int64_t locations_version_;
+
+  // The tablet server registration version that 'cached_locations_' were
+  // built at.
+  int64_t ts_registration_version_;
+
+  // The locations of the table's tablets, keyed by tablet ID. Each entry is a
+  // GetTableLocationsResponsePB holding only that tablet's locations,
+  // serialized, so that a response is built by concatenating entries. Valid
+  // for 'locations_version_'.
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> cached_locations_;
+
   DISALLOW_COPY_AND_ASSIGN(TableInfo);
 };
 
@@ -356,11 +417,20 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
     template<typename RespClass>
     bool CheckIsInitializedAndIsLeaderOrRespond(RespClass* resp, rpc::RpcContext* rpc);
 
+    // Like CheckIsInitializedAndIsLeaderOrRespond(), but also succeeds if
+    // the catalog manager is the leader and has loaded the tables while it
+    // is still loading the tablets. Only for requests which read tables
+    // (e.g. their schemas) without depending on their tablets.
+    template<typename RespClass>
+    bool CheckIsInitializedAndIsReadyForTableReadsOrRespond(RespClass* resp,
+                                                            rpc::RpcContext* rpc);
+
    private:
     CatalogManager* catalog_;
     shared_lock<RWMutex> leader_shared_lock_;
     Status catalog_status_;
     Status leader_status_;
+    bool is_ready_for_table_reads_;
 
     DISALLOW_COPY_AND_ASSIGN(ScopedLeaderSharedLock);
   };
@@ -371,17 +441,21 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
 
     explicit ScopedLeaderDisablerForTests(CatalogManager* catalog)
         : catalog_(catalog),
-        old_leader_ready_term_(catalog->leader_ready_term_) {
+        old_leader_ready_term_(catalog->leader_ready_term_),
+        old_tables_ready_term_(catalog->tables_ready_term_) {
       catalog_->leader_ready_term_ = -1;
+      catalog_->tables_ready_term_ = -1;
     }
 
     ~ScopedLeaderDisablerForTests() {
       catalog_->leader_ready_term_ = old_leader_ready_term_;
+      catalog_->tables_ready_term_ = old_tables_ready_term_;
     }
 
    private:
     CatalogManager* catalog_;
     int64_t old_leader_ready_term_;
+    int64_t old_tables_ready_term_;
 
     DISALLOW_COPY_AND_ASSIGN(ScopedLeaderDisablerForTests);
   };
@@ -394,6 +468,10 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   void Shutdown();
   Status CheckOnline() const;
 
+  // Returns true if both the tables and the tablets of the sys catalog have
+  // been loaded since this master last became the leader.
+  bool IsCatalogLoaded() const;
+
   // Create a new Table with the specified attributes
   //
   // The RPC context is provided for logging/tracing purposes,
@@ -440,8 +518,14 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
 
   // Lookup the tablets contained in the partition range of the request.
   // Returns an error if any of the tablets are not running.
+  //
+  // If 'locations_sidecar' is not null, the locations are appended to it as a
+  // serialized GetTableLocationsResponsePB holding only 'tablet_locations',
+  // instead of being added to 'resp'. Those are served from the table's cache
+  // of serialized locations where possible.
   Status GetTableLocations(const GetTableLocationsRequestPB* req,
-                           GetTableLocationsResponsePB* resp);
+                           GetTableLocationsResponsePB* resp,
+                           faststring* locations_sidecar = nullptr);
 
   // Look up the locations of the given tablet. The locations
   // vector is overwritten (not appended to).
@@ -454,6 +538,11 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
 
   // Handle a tablet report from the given tablet server.
   //
+  // The metadata mutations of all of the reported tablets are written to the
+  // sys catalog at once. Reports from different tablet servers are handled
+  // concurrently; those reporting the same tablets serialize on the tablets'
+  // locks.
+  //
   // The RPC context is provided for logging/tracing purposes,
   // but this function does not itself respond to the RPC.
   Status ProcessTabletReport(TSDescriptor* ts_desc,
@@ -545,7 +634,10 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
 
   // Clears out the existing metadata ('table_names_map_', 'table_ids_map_',
   // and 'tablet_map_'), loads tables metadata into memory and if successful
-  // loads the tablets metadata.
+  // loads the tablets metadata on 'catalog_load_pool_'.
+  //
+  // Table reads are served as of the current term once the tables are
+  // loaded, and all requests once the tablets are loaded too.
   Status VisitTablesAndTablets();
 
   // Helper for initializing 'sys_catalog_'. After calling this
@@ -572,17 +664,61 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // Builds the TabletLocationsPB for a tablet based on the provided TabletInfo.
   // Populates locs_pb and returns true on success.
   // Returns Status::ServiceUnavailable if tablet is not running.
+  //
+  // If 'all_ts_registered' is not null, it is set to whether the addresses of
+  // all of the replicas came from tablet server registrations, rather than
+  // from the tablet's config.
   Status BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
-                                 TabletLocationsPB* locs_pb);
+                                 TabletLocationsPB* locs_pb,
+                                 bool* all_ts_registered = nullptr);
+
+  // Appends the serialized locations of a tablet to 'out', as in
+  // GetTableLocations(). The locations are taken from the table's cache if
+  // they were cached at locations version 'version', and otherwise built and
+  // cached. Returns the same errors as BuildLocationsForTablet().
+  Status AppendSerializedLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
+                                            int64_t version,
+                                            faststring* out);
 
   Status FindTable(const TableIdentifierPB& table_identifier,
                    scoped_refptr<TableInfo>* table_info);
 
-  // Handle one of the tablets in a tablet reported.
-  // Requires that the lock is already held.
-  Status HandleReportedTablet(TSDescriptor* ts_desc,
-                              const ReportedTabletPB& report,
-                              ReportedTabletUpdatesPB *report_updates);
+  // A known tablet of a tablet report. The tablet's metadata stays locked
+  // for writing until the mutations of the whole report are written to the
+  // sys catalog.
+  struct ReportedTablet {
+    ReportedTablet()
+        : report(nullptr),
+          report_updates(nullptr),
+          modified(false),
+          handled(false),
+          needs_alter(false),
+          replica_running(false) {
+    }
+
+    const ReportedTabletPB* report;
+    ReportedTabletUpdatesPB* report_updates;
+    scoped_refptr<TabletInfo> tablet;
+    std::unique_ptr<TabletMetadataLock> lock;
+
+    // Whether the tablet's metadata was mutated and must be written.
+    bool modified;
+
+    // Whether the report was fully handled, as opposed to being ignored
+    // (e.g. because the tablet was deleted).
+    bool handled;
+
+    // Whether the tablet's replicas must be sent the table's latest schema.
+    bool needs_alter;
+
+    // Whether the reporting replica is running, to be passed on to the
+    // rebalancer once the report is committed.
+    bool replica_running;
+  };
+
+  // Handle one of the tablets in a tablet report.
+  // Requires that 'reported->lock' is held for writing.
+  Status HandleReportedTablet(TSDescriptor* ts_desc, ReportedTablet* reported);
 
   Status HandleRaftConfigChanged(const ReportedTabletPB& report,
                                  const scoped_refptr<TabletInfo>& tablet,
@@ -697,6 +833,25 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   void SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
                             const consensus::ConsensusStatePB& cstate);
 
+  // Start a task to add the tablet server 'peer_uuid' to, or remove it from,
+  // the config of the specified tablet, as part of a replica move by the
+  // rebalancer. The change is only made if the committed config still has
+  // opid index 'cas_config_opid_index', and is retried until 'deadline'.
+  // 'failed_cb' is run, on a reactor thread, if the task gives up.
+  void SendChangeConfigRequest(const scoped_refptr<TabletInfo>& tablet,
+                               consensus::ChangeConfigType type,
+                               const std::string& peer_uuid,
+                               int64_t cas_config_opid_index,
+                               const MonoTime& deadline,
+                               const Closure& failed_cb);
+
+  // Start a task asking the replica of the specified tablet on tablet server
+  // 'ts_uuid' to run a leader election, in order to move the tablet's
+  // leadership to it.
+  void SendLeaderElectionRequest(const scoped_refptr<TabletInfo>& tablet,
+                                 const std::string& ts_uuid,
+                                 const MonoTime& deadline);
+
   std::string GenerateId() { return oid_generator_.Next(); }
 
   // Conventional "T xxx P yyy: " prefix for logging.
@@ -747,6 +902,11 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   friend class CatalogManagerBgTasks;
   gscoped_ptr<CatalogManagerBgTasks> background_tasks_;
 
+  // Moves replicas and leadership between tablet servers; driven by the
+  // background thread.
+  friend class Rebalancer;
+  gscoped_ptr<Rebalancer> rebalancer_;
+
   enum State {
     kConstructed,
     kStarting,
@@ -754,7 +914,7 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
     kClosing
   };
 
-  // Lock protecting state_, leader_ready_term_
+  // Lock protecting state_, leader_ready_term_, tables_ready_term_
   mutable simple_spinlock state_lock_;
   State state_;
 
@@ -769,6 +929,11 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // correctly.
   int64_t leader_ready_term_;
 
+  // Like 'leader_ready_term_', but updated as soon as the tables metadata is
+  // loaded, before the tablets metadata. Fences the requests which only read
+  // tables.
+  int64_t tables_ready_term_;
+
   // Lock used to fence operations and leader elections. All logical operations
   // (i.e. create table, alter table, etc.) should acquire this lock for
   // reading. Following an election where this master is elected leader, it
@@ -780,6 +945,14 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // Always acquire this lock before state_lock_.
   RWMutex leader_lock_;
 
+  // Parses and loads the tablets metadata when this master becomes the
+  // leader.
+  gscoped_ptr<ThreadPool> catalog_load_pool_;
+
+  scoped_refptr<Histogram> catalog_load_tables_duration_;
+  scoped_refptr<Histogram> catalog_load_duration_;
+  scoped_refptr<Histogram> leader_failover_duration_;
+
   // Async operations are accessing some private methods
   // (TODO: this stuff should be deferred and done in the background thread)
   friend class AsyncAlterTable;
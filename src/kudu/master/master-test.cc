@@ -36,6 +36,7 @@
 #include "kudu/master/ts_manager.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/server/rpc_server.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_util.h"
@@ -50,7 +51,12 @@ using std::thread;
 using strings::Substitute;
 
 DECLARE_bool(catalog_manager_check_ts_count_for_create_table);
+DECLARE_bool(master_add_server_when_underreplicated);
 DECLARE_double(sys_catalog_fail_during_write);
+DECLARE_int32(catalog_manager_inject_latency_load_tablets_ms);
+DECLARE_int32(catalog_manager_load_threads);
+
+METRIC_DECLARE_histogram(catalog_load_duration);
 
 namespace kudu {
 namespace master {
@@ -448,6 +454,189 @@ TEST_F(MasterTest, TestCatalog) {
   }
 }
 
+// Tests that the tablets of the sys catalog, which are loaded on several
+// threads, are all loaded back when the master restarts, and that the tables
+// are read meanwhile.
+TEST_F(MasterTest, TestReloadCatalogInParallel) {
+  const char *kTableName = "testtb";
+  const int kNumSplits = 1200;
+  const Schema kTableSchema({ ColumnSchema("key", INT32) }, 1);
+
+  // Use enough tablets to span several blocks of the sys catalog scan.
+  vector<KuduPartialRow> split_rows;
+  for (int i = 0; i < kNumSplits; i++) {
+    KuduPartialRow split(&kTableSchema);
+    ASSERT_OK(split.SetInt32("key", i));
+    split_rows.push_back(split);
+  }
+  ASSERT_OK(CreateTable(kTableName, kTableSchema, split_rows, {}));
+
+  // Slow down the tablets' load so that the table reads below are served
+  // while it's still going on.
+  FLAGS_catalog_manager_load_threads = 4;
+  FLAGS_catalog_manager_inject_latency_load_tablets_ms = 3000;
+  mini_master_->Shutdown();
+  ASSERT_OK(mini_master_->Restart());
+  master_ = mini_master_->master();
+
+  AssertEventually([&]() {
+    ListTablesRequestPB req;
+    ListTablesResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->ListTables(req, &resp, &controller));
+    ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp);
+    ASSERT_EQ(1, resp.tables_size());
+  });
+  {
+    GetTableSchemaRequestPB req;
+    GetTableSchemaResponsePB resp;
+    RpcController controller;
+    req.mutable_table()->set_table_name(kTableName);
+    ASSERT_OK(proxy_->GetTableSchema(req, &resp, &controller));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    Schema schema;
+    ASSERT_OK(SchemaFromPB(resp.schema(), &schema));
+    ASSERT_TRUE(kTableSchema.Equals(schema));
+  }
+  {
+    CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+    ASSERT_TRUE(l.first_failed_status().IsServiceUnavailable())
+        << l.first_failed_status().ToString();
+  }
+
+  ASSERT_OK(master_->WaitUntilCatalogManagerIsLeaderAndReadyForTests(MonoDelta::FromSeconds(30)));
+
+  ListTablesResponsePB tables;
+  ASSERT_NO_FATAL_FAILURE(DoListAllTables(&tables));
+  ASSERT_EQ(1, tables.tables_size());
+
+  {
+    CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+    ASSERT_OK(l.first_failed_status());
+    scoped_refptr<TableInfo> table;
+    ASSERT_OK(master_->catalog_manager()->GetTableInfo(tables.tables(0).id(), &table));
+    ASSERT_TRUE(table != nullptr);
+    vector<scoped_refptr<TabletInfo>> tablets;
+    table->GetAllTablets(&tablets);
+    ASSERT_EQ(kNumSplits + 1, tablets.size());
+  }
+
+  scoped_refptr<Histogram> load_duration =
+      METRIC_catalog_load_duration.Instantiate(master_->metric_entity());
+  ASSERT_EQ(1, load_duration->TotalCount());
+}
+
+// Tests that the state changes of all of the tablets of a tablet report are
+// written to the sys catalog, including when the report also contains
+// tablets unknown to the master, or a tablet which fails to be handled.
+TEST_F(MasterTest, TestProcessTabletReportWithManyTablets) {
+  const char *kTsUUID = "my-ts-uuid";
+  const char *kTableName = "testtb";
+  const int kNumSplits = 9;
+  const Schema kTableSchema({ ColumnSchema("key", INT32) }, 1);
+
+  // The fake TS can't host any new replicas.
+  FLAGS_master_add_server_when_underreplicated = false;
+
+  TSToMasterCommonPB common;
+  common.mutable_ts_instance()->set_permanent_uuid(kTsUUID);
+  common.mutable_ts_instance()->set_instance_seqno(1);
+  {
+    TSHeartbeatRequestPB req;
+    TSHeartbeatResponsePB resp;
+    RpcController rpc;
+    req.mutable_common()->CopyFrom(common);
+    MakeHostPortPB("localhost", 1000, req.mutable_registration()->add_rpc_addresses());
+    MakeHostPortPB("localhost", 2000, req.mutable_registration()->add_http_addresses());
+    ASSERT_OK(proxy_->TSHeartbeat(req, &resp, &rpc));
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  vector<KuduPartialRow> split_rows;
+  for (int i = 0; i < kNumSplits; i++) {
+    KuduPartialRow split(&kTableSchema);
+    ASSERT_OK(split.SetInt32("key", i * 10));
+    split_rows.push_back(split);
+  }
+  ASSERT_OK(CreateTable(kTableName, kTableSchema, split_rows, {}));
+
+  ListTablesResponsePB tables;
+  ASSERT_NO_FATAL_FAILURE(DoListAllTables(&tables));
+  ASSERT_EQ(1, tables.tables_size());
+  const string table_id = tables.tables(0).id();
+
+  auto get_tablets = [&](vector<scoped_refptr<TabletInfo>>* tablets) {
+    CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+    ASSERT_OK(l.first_failed_status());
+    scoped_refptr<TableInfo> table;
+    ASSERT_OK(master_->catalog_manager()->GetTableInfo(table_id, &table));
+    ASSERT_TRUE(table != nullptr);
+    table->GetAllTablets(tablets);
+  };
+  vector<scoped_refptr<TabletInfo>> tablets;
+  ASSERT_NO_FATAL_FAILURE(get_tablets(&tablets));
+  ASSERT_EQ(kNumSplits + 1, tablets.size());
+
+  // Report every tablet as running with the fake TS as its leader. The report
+  // of the first tablet is malformed, which only fails that tablet.
+  const string bad_tablet_id = tablets[0]->tablet_id();
+  {
+    TSHeartbeatRequestPB req;
+    TSHeartbeatResponsePB resp;
+    RpcController rpc;
+    req.mutable_common()->CopyFrom(common);
+    TabletReportPB* report = req.mutable_tablet_report();
+    report->set_is_incremental(false);
+    report->set_sequence_number(0);
+    for (const auto& tablet : tablets) {
+      ReportedTabletPB* reported = report->add_updated_tablets();
+      reported->set_tablet_id(tablet->tablet_id());
+      reported->set_state(tablet::RUNNING);
+      consensus::ConsensusStatePB* cstate = reported->mutable_committed_consensus_state();
+      cstate->set_current_term(1);
+      cstate->set_leader_uuid(kTsUUID);
+      cstate->mutable_config()->set_opid_index(1);
+      consensus::RaftPeerPB* peer = cstate->mutable_config()->add_peers();
+      peer->set_permanent_uuid(kTsUUID);
+      peer->set_member_type(consensus::RaftPeerPB::VOTER);
+      if (tablet->tablet_id() == bad_tablet_id) {
+        cstate->mutable_config()->clear_opid_index();
+      }
+    }
+    report->add_updated_tablets()->set_tablet_id("unknown-tablet");
+    ASSERT_OK(proxy_->TSHeartbeat(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_EQ(kNumSplits + 2, resp.tablet_report().tablets_size());
+    for (const auto& update : resp.tablet_report().tablets()) {
+      ASSERT_EQ(update.tablet_id() == bad_tablet_id, update.has_error());
+    }
+  }
+
+  // The other tablets are running, also after the master reloads them.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_NO_FATAL_FAILURE(get_tablets(&tablets));
+    ASSERT_EQ(kNumSplits + 1, tablets.size());
+    for (const auto& tablet : tablets) {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      if (tablet->tablet_id() == bad_tablet_id) {
+        ASSERT_FALSE(l.data().is_running()) << tablet->ToString();
+        continue;
+      }
+      ASSERT_TRUE(l.data().is_running()) << tablet->ToString();
+      ASSERT_EQ(kTsUUID, l.data().pb.committed_consensus_state().leader_uuid());
+    }
+    if (i == 0) {
+      mini_master_->Shutdown();
+      ASSERT_OK(mini_master_->Restart());
+      master_ = mini_master_->master();
+      ASSERT_OK(master_->WaitUntilCatalogManagerIsLeaderAndReadyForTests(
+          MonoDelta::FromSeconds(5)));
+    }
+  }
+}
+
 TEST_F(MasterTest, TestCreateTableCheckRangeInvariants) {
   const char *kTableName = "testtb";
   const Schema kTableSchema({ ColumnSchema("key", INT32), ColumnSchema("val", INT32) }, 1);
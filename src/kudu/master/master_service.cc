@@ -29,7 +29,9 @@
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/rpc/rpc_context.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/webserver.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/pb_util.h"
 
@@ -130,6 +132,9 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 4. Update tserver soft state based on the heartbeat contents.
   ts_desc->UpdateHeartbeatTime();
   ts_desc->set_num_live_replicas(req->num_live_tablets());
+  if (req->has_resource_stats()) {
+    ts_desc->set_resource_stats(req->resource_stats());
+  }
 
   // 5. Only leaders handle tablet reports.
   if (is_leader_master && req->has_tablet_report()) {
@@ -258,7 +263,7 @@ void MasterServiceImpl::ListTables(const ListTablesRequestPB* req,
                                    ListTablesResponsePB* resp,
                                    rpc::RpcContext* rpc) {
   CatalogManager::ScopedLeaderSharedLock l(server_->catalog_manager());
-  if (!l.CheckIsInitializedAndIsLeaderOrRespond(resp, rpc)) {
+  if (!l.CheckIsInitializedAndIsReadyForTableReadsOrRespond(resp, rpc)) {
     return;
   }
 
@@ -278,7 +283,17 @@ void MasterServiceImpl::GetTableLocations(const GetTableLocationsRequestPB* req,
   if (PREDICT_FALSE(FLAGS_master_inject_latency_on_tablet_lookups_ms > 0)) {
     SleepFor(MonoDelta::FromMilliseconds(FLAGS_master_inject_latency_on_tablet_lookups_ms));
   }
-  Status s = server_->catalog_manager()->GetTableLocations(req, resp);
+  gscoped_ptr<faststring> locations_sidecar;
+  if (req->tablet_locations_in_sidecar()) {
+    locations_sidecar.reset(new faststring);
+  }
+  Status s = server_->catalog_manager()->GetTableLocations(req, resp, locations_sidecar.get());
+  if (s.ok() && !resp->has_error() && locations_sidecar) {
+    int idx;
+    CHECK_OK(rpc->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(locations_sidecar))), &idx));
+    resp->set_tablet_locations_sidecar(idx);
+  }
   CheckRespErrorOrSetUnknown(s, resp);
   rpc->RespondSuccess();
 }
@@ -287,7 +302,7 @@ void MasterServiceImpl::GetTableSchema(const GetTableSchemaRequestPB* req,
                                        GetTableSchemaResponsePB* resp,
                                        rpc::RpcContext* rpc) {
   CatalogManager::ScopedLeaderSharedLock l(server_->catalog_manager());
-  if (!l.CheckIsInitializedAndIsLeaderOrRespond(resp, rpc)) {
+  if (!l.CheckIsInitializedAndIsReadyForTableReadsOrRespond(resp, rpc)) {
     return;
   }
 
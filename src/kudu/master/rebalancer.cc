@@ -0,0 +1,531 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/rebalancer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/quorum_util.h"
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/catalog_manager.h"
+#include "kudu/master/master.h"
+#include "kudu/master/ts_descriptor.h"
+#include "kudu/master/ts_manager.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/metrics.h"
+
+DEFINE_bool(rebalancer_enabled, false,
+            "Whether the leader master moves tablet replicas and leadership between "
+            "tablet servers to even out the numbers of replicas and leaders they host.");
+TAG_FLAG(rebalancer_enabled, experimental);
+TAG_FLAG(rebalancer_enabled, runtime);
+
+DEFINE_int32(rebalancer_interval_ms, 10 * 1000,
+             "Interval at which the rebalancer plans new replica moves and leader "
+             "transfers. In-flight replica moves are followed more frequently.");
+TAG_FLAG(rebalancer_interval_ms, advanced);
+TAG_FLAG(rebalancer_interval_ms, runtime);
+
+DEFINE_int32(rebalancer_max_concurrent_moves, 2,
+             "Maximum number of replica moves the rebalancer keeps in flight. "
+             "Each move copies a tablet replica to its destination tablet server.");
+TAG_FLAG(rebalancer_max_concurrent_moves, advanced);
+TAG_FLAG(rebalancer_max_concurrent_moves, runtime);
+
+DEFINE_int32(rebalancer_max_leader_transfers, 2,
+             "Maximum number of leader transfers the rebalancer starts each time it "
+             "plans.");
+TAG_FLAG(rebalancer_max_leader_transfers, advanced);
+TAG_FLAG(rebalancer_max_leader_transfers, runtime);
+
+DEFINE_int32(rebalancer_max_skew, 1,
+             "Largest difference between the numbers of replicas, or of leaders, "
+             "hosted by two live tablet servers which the rebalancer leaves as is.");
+TAG_FLAG(rebalancer_max_skew, advanced);
+TAG_FLAG(rebalancer_max_skew, runtime);
+
+DEFINE_int32(rebalancer_move_timeout_ms, 10 * 60 * 1000, // 10 minutes
+             "Time after which the rebalancer abandons a replica move which has not "
+             "finished. The tablet's config is left as the move left it.");
+TAG_FLAG(rebalancer_move_timeout_ms, advanced);
+
+DECLARE_int32(master_ts_rpc_timeout_ms);
+
+METRIC_DEFINE_counter(server, rebalancer_replica_moves_started,
+                      "Rebalancer Replica Moves Started",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet replica moves started by the rebalancer");
+METRIC_DEFINE_counter(server, rebalancer_replica_moves_completed,
+                      "Rebalancer Replica Moves Completed",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet replica moves completed by the rebalancer");
+METRIC_DEFINE_counter(server, rebalancer_replica_moves_failed,
+                      "Rebalancer Replica Moves Failed",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet replica moves abandoned by the rebalancer, "
+                      "because they timed out, their tablet's config changed "
+                      "concurrently, or the destination server could not be added");
+METRIC_DEFINE_counter(server, rebalancer_leader_transfers_started,
+                      "Rebalancer Leader Transfers Started",
+                      kudu::MetricUnit::kOperations,
+                      "Number of tablet leader elections requested by the rebalancer, "
+                      "including those which move leadership off replicas being removed");
+
+using std::string;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+using consensus::ConsensusStatePB;
+using consensus::RaftConfigPB;
+using consensus::RaftPeerPB;
+
+namespace master {
+
+namespace {
+
+bool IsVoter(const string& uuid, const vector<string>& voter_uuids) {
+  return std::find(voter_uuids.begin(), voter_uuids.end(), uuid) != voter_uuids.end();
+}
+
+bool CompareLoad(const std::pair<const string, int>& a, const std::pair<const string, int>& b) {
+  return a.second < b.second;
+}
+
+} // anonymous namespace
+
+Rebalancer::Rebalancer(CatalogManager* catalog_manager, Master* master)
+    : catalog_manager_(catalog_manager),
+      master_(master),
+      replica_moves_started_(
+          METRIC_rebalancer_replica_moves_started.Instantiate(master->metric_entity())),
+      replica_moves_completed_(
+          METRIC_rebalancer_replica_moves_completed.Instantiate(master->metric_entity())),
+      replica_moves_failed_(
+          METRIC_rebalancer_replica_moves_failed.Instantiate(master->metric_entity())),
+      leader_transfers_started_(
+          METRIC_rebalancer_leader_transfers_started.Instantiate(master->metric_entity())) {
+}
+
+Rebalancer::~Rebalancer() {
+}
+
+void Rebalancer::Run() {
+  UpdateMoves();
+  if (!FLAGS_rebalancer_enabled) {
+    return;
+  }
+  MonoTime now = MonoTime::Now();
+  if (last_round_time_.Initialized() &&
+      now - last_round_time_ < MonoDelta::FromMilliseconds(FLAGS_rebalancer_interval_ms)) {
+    return;
+  }
+  last_round_time_ = now;
+  PlanRound();
+}
+
+void Rebalancer::Reset() {
+  std::lock_guard<simple_spinlock> l(lock_);
+  moves_.clear();
+}
+
+void Rebalancer::ReplicaRunning(const string& tablet_id, const string& ts_uuid) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  ReplicaMove* move = FindOrNull(moves_, tablet_id);
+  if (move && move->dest_uuid == ts_uuid) {
+    move->dest_running = true;
+  }
+}
+
+void Rebalancer::UpdateMoves() {
+  vector<scoped_refptr<TabletInfo>> tablets;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (const auto& e : moves_) {
+      tablets.push_back(e.second.tablet);
+    }
+  }
+  if (tablets.empty()) {
+    return;
+  }
+
+  // Read the committed configs without holding 'lock_': it is taken by
+  // ReplicaRunning() while the reported tablet's metadata is locked.
+  std::unordered_map<string, ConsensusStatePB> cstates;
+  for (const auto& tablet : tablets) {
+    TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+    if (!l.data().is_deleted()) {
+      InsertOrDie(&cstates, tablet->tablet_id(), l.data().pb.committed_consensus_state());
+    }
+  }
+
+  MonoTime now = MonoTime::Now();
+  MonoDelta leader_transfer_interval =
+      MonoDelta::FromMilliseconds(FLAGS_master_ts_rpc_timeout_ms);
+  vector<ReplicaMove> to_send;
+  vector<ReplicaMove> to_transfer_leadership;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (auto it = moves_.begin(); it != moves_.end();) {
+      ReplicaMove& move = it->second;
+      const ConsensusStatePB* cstate = FindOrNull(cstates, it->first);
+      string abandon_reason;
+      bool finished = false;
+      if (!cstate) {
+        abandon_reason = "the tablet was deleted";
+      } else if (now > move.deadline) {
+        abandon_reason = "the move timed out";
+      } else {
+        const RaftConfigPB& config = cstate->config();
+        if (move.state == ReplicaMove::kAdding) {
+          if (IsRaftConfigVoter(move.dest_uuid, config)) {
+            move.state = ReplicaMove::kCopying;
+          } else if (config.opid_index() > move.cas_config_opid_index) {
+            abandon_reason = "the tablet's config changed concurrently";
+          } else if (move.change_config_failed) {
+            abandon_reason = "adding the destination server failed";
+          }
+        }
+        if (move.state == ReplicaMove::kCopying && move.dest_running) {
+          move.state = ReplicaMove::kRemoving;
+          move.cas_config_opid_index = config.opid_index();
+          move.change_config_failed = false;
+          to_send.push_back(move);
+        } else if (move.state == ReplicaMove::kRemoving) {
+          if (!IsRaftConfigMember(move.src_uuid, config)) {
+            finished = true;
+          } else if (config.opid_index() > move.cas_config_opid_index) {
+            abandon_reason = "the tablet's config changed concurrently";
+          } else if (move.change_config_failed) {
+            // Try again until the move times out rather than leave the
+            // tablet with an extra replica.
+            move.change_config_failed = false;
+            to_send.push_back(move);
+          }
+        }
+
+        // The leader rejects its own removal, so the source replica has to
+        // hand its leadership over before it can be removed.
+        if (move.state == ReplicaMove::kRemoving && !finished && abandon_reason.empty() &&
+            cstate->leader_uuid() == move.src_uuid &&
+            (!move.leader_transfer_time.Initialized() ||
+             now - move.leader_transfer_time > leader_transfer_interval)) {
+          move.leader_transfer_time = now;
+          to_transfer_leadership.push_back(move);
+        }
+      }
+
+      if (finished) {
+        LOG(INFO) << Substitute("Rebalancer: moved replica of tablet $0 from $1 to $2",
+                                it->first, move.src_uuid, move.dest_uuid);
+        replica_moves_completed_->Increment();
+        it = moves_.erase(it);
+      } else if (!abandon_reason.empty()) {
+        LOG(WARNING) << Substitute("Rebalancer: abandoning move of replica of tablet $0 "
+                                   "from $1 to $2: $3", it->first, move.src_uuid,
+                                   move.dest_uuid, abandon_reason);
+        replica_moves_failed_->Increment();
+        it = moves_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  for (const ReplicaMove& move : to_transfer_leadership) {
+    LOG(INFO) << Substitute("Rebalancer: transferring leadership of tablet $0 from $1 to $2 "
+                            "in order to remove the replica on $1",
+                            move.tablet->tablet_id(), move.src_uuid, move.dest_uuid);
+    catalog_manager_->SendLeaderElectionRequest(move.tablet, move.dest_uuid,
+                                                now + leader_transfer_interval);
+    leader_transfers_started_->Increment();
+  }
+  for (const ReplicaMove& move : to_send) {
+    SendChangeConfig(move);
+  }
+}
+
+void Rebalancer::PlanRound() {
+  DescriptorMap ts_descs;
+  vector<TabletReplicas> tablets;
+  LoadMap replica_counts;
+  LoadMap leader_counts;
+  CollectLoad(&ts_descs, &tablets, &replica_counts, &leader_counts);
+  if (replica_counts.size() < 2) {
+    return;
+  }
+  PlanReplicaMoves(ts_descs, &tablets, &replica_counts);
+  PlanLeaderTransfers(ts_descs, tablets, &leader_counts);
+}
+
+void Rebalancer::CollectLoad(DescriptorMap* ts_descs,
+                             vector<TabletReplicas>* tablets,
+                             LoadMap* replica_counts,
+                             LoadMap* leader_counts) {
+  TSDescriptorVector live_descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&live_descs);
+  for (const auto& ts_desc : live_descs) {
+    InsertOrDie(ts_descs, ts_desc->permanent_uuid(), ts_desc);
+    InsertOrDie(replica_counts, ts_desc->permanent_uuid(), 0);
+    InsertOrDie(leader_counts, ts_desc->permanent_uuid(), 0);
+  }
+
+  vector<ReplicaMove> moves;
+  unordered_set<string> moving_tablet_ids;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (const auto& e : moves_) {
+      moves.push_back(e.second);
+      moving_tablet_ids.insert(e.first);
+    }
+  }
+
+  vector<scoped_refptr<TableInfo>> tables;
+  Status s = catalog_manager_->GetAllTables(&tables);
+  if (!s.ok()) {
+    LOG(WARNING) << "Rebalancer: unable to list tables: " << s.ToString();
+    return;
+  }
+  for (const auto& table : tables) {
+    int num_replicas;
+    {
+      TableMetadataLock l(table.get(), TableMetadataLock::READ);
+      if (!l.data().is_running()) {
+        continue;
+      }
+      num_replicas = l.data().pb.num_replicas();
+    }
+
+    vector<scoped_refptr<TabletInfo>> table_tablets;
+    table->GetAllTablets(&table_tablets);
+    for (const auto& tablet : table_tablets) {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      if (!l.data().is_running() || !l.data().pb.has_committed_consensus_state()) {
+        continue;
+      }
+      const ConsensusStatePB& cstate = l.data().pb.committed_consensus_state();
+      TabletReplicas replicas;
+      replicas.tablet = tablet;
+      replicas.config_opid_index = cstate.config().opid_index();
+      bool all_voters_live = true;
+      for (const RaftPeerPB& peer : cstate.config().peers()) {
+        if (peer.member_type() != RaftPeerPB::VOTER) {
+          continue;
+        }
+        int* count = FindOrNull(*replica_counts, peer.permanent_uuid());
+        if (count) {
+          (*count)++;
+        } else {
+          all_voters_live = false;
+        }
+        replicas.voter_uuids.push_back(peer.permanent_uuid());
+      }
+      if (cstate.has_leader_uuid()) {
+        replicas.leader_uuid = cstate.leader_uuid();
+        int* count = FindOrNull(*leader_counts, replicas.leader_uuid);
+        if (count) {
+          (*count)++;
+        }
+      }
+      if (all_voters_live &&
+          replicas.voter_uuids.size() == static_cast<size_t>(num_replicas) &&
+          !ContainsKey(moving_tablet_ids, tablet->tablet_id())) {
+        tablets->push_back(std::move(replicas));
+      }
+    }
+  }
+
+  // Count the replicas of the in-flight moves where they will end up.
+  for (const ReplicaMove& move : moves) {
+    int* src_count = FindOrNull(*replica_counts, move.src_uuid);
+    if (src_count) {
+      (*src_count)--;
+    }
+    int* dest_count = FindOrNull(*replica_counts, move.dest_uuid);
+    if (dest_count && move.state == ReplicaMove::kAdding) {
+      (*dest_count)++;
+    }
+  }
+}
+
+const string& Rebalancer::PickLeastCostly(const DescriptorMap& ts_descs,
+                                          const std::map<string, int>& candidates) {
+  DCHECK(!candidates.empty());
+  auto best = candidates.begin();
+  for (auto it = std::next(best); it != candidates.end(); ++it) {
+    double best_cost;
+    double cost;
+    ComputeReplicaPlacementCosts(FindOrDie(ts_descs, best->first).get(),
+                                 FindOrDie(ts_descs, it->first).get(),
+                                 &best_cost, &cost);
+    if (cost < best_cost) {
+      best = it;
+    }
+  }
+  return best->first;
+}
+
+void Rebalancer::PlanReplicaMoves(const DescriptorMap& ts_descs,
+                                  vector<TabletReplicas>* tablets,
+                                  LoadMap* replica_counts) {
+  int num_moves;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    num_moves = moves_.size();
+  }
+
+  for (; num_moves < FLAGS_rebalancer_max_concurrent_moves; num_moves++) {
+    // Move a follower replica away from the most loaded tablet server to one
+    // which isn't already part of the tablet's config and hosts enough fewer
+    // replicas for the move to reduce the skew. Leader replicas are left in
+    // place; once leadership is rebalanced they may be moved in later rounds.
+    //
+    // Each such destination is mapped to the first tablet it could take a
+    // replica of, and the least costly of them is picked.
+    auto src = std::max_element(replica_counts->begin(), replica_counts->end(), CompareLoad);
+    std::map<string, int> dest_tablet_idxs;
+    for (int i = 0; i < static_cast<int>(tablets->size()); i++) {
+      const TabletReplicas& replicas = (*tablets)[i];
+      if (replicas.leader_uuid == src->first || !IsVoter(src->first, replicas.voter_uuids)) {
+        continue;
+      }
+      for (const auto& e : *replica_counts) {
+        if (src->second - e.second > FLAGS_rebalancer_max_skew &&
+            !IsVoter(e.first, replicas.voter_uuids)) {
+          dest_tablet_idxs.emplace(e.first, i);
+        }
+      }
+    }
+    if (dest_tablet_idxs.empty()) {
+      return;
+    }
+    const string& dest_uuid = PickLeastCostly(ts_descs, dest_tablet_idxs);
+    int best_idx = FindOrDie(dest_tablet_idxs, dest_uuid);
+    int dest_count = FindOrDie(*replica_counts, dest_uuid);
+
+    const TabletReplicas& replicas = (*tablets)[best_idx];
+    ReplicaMove move;
+    move.tablet = replicas.tablet;
+    move.src_uuid = src->first;
+    move.dest_uuid = dest_uuid;
+    move.state = ReplicaMove::kAdding;
+    move.dest_running = false;
+    move.cas_config_opid_index = replicas.config_opid_index;
+    move.change_config_failed = false;
+    move.deadline = MonoTime::Now() +
+        MonoDelta::FromMilliseconds(FLAGS_rebalancer_move_timeout_ms);
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      InsertOrDie(&moves_, move.tablet->tablet_id(), move);
+    }
+    LOG(INFO) << Substitute("Rebalancer: moving replica of tablet $0 from $1 ($2 replicas) "
+                            "to $3 ($4 replicas)", move.tablet->tablet_id(),
+                            move.src_uuid, src->second, move.dest_uuid, dest_count);
+    replica_moves_started_->Increment();
+    SendChangeConfig(move);
+
+    src->second--;
+    (*replica_counts)[move.dest_uuid]++;
+    tablets->erase(tablets->begin() + best_idx);
+  }
+}
+
+void Rebalancer::PlanLeaderTransfers(const DescriptorMap& ts_descs,
+                                     const vector<TabletReplicas>& tablets,
+                                     LoadMap* leader_counts) {
+  unordered_set<string> transferred_tablet_ids;
+  for (int i = 0; i < FLAGS_rebalancer_max_leader_transfers; i++) {
+    // Hand the leadership of a tablet led by the tablet server with the most
+    // leaders to a follower with enough fewer leaders for the transfer to
+    // reduce the skew. As with replica moves, the least costly such follower
+    // is picked.
+    auto src = std::max_element(leader_counts->begin(), leader_counts->end(), CompareLoad);
+    std::map<string, int> dest_tablet_idxs;
+    for (int j = 0; j < static_cast<int>(tablets.size()); j++) {
+      const TabletReplicas& replicas = tablets[j];
+      if (replicas.leader_uuid != src->first ||
+          ContainsKey(transferred_tablet_ids, replicas.tablet->tablet_id())) {
+        continue;
+      }
+      for (const string& uuid : replicas.voter_uuids) {
+        const int* count = FindOrNull(*leader_counts, uuid);
+        if (uuid != replicas.leader_uuid && count &&
+            src->second - *count > FLAGS_rebalancer_max_skew) {
+          dest_tablet_idxs.emplace(uuid, j);
+        }
+      }
+    }
+    if (dest_tablet_idxs.empty()) {
+      return;
+    }
+    const string& dest_uuid = PickLeastCostly(ts_descs, dest_tablet_idxs);
+    const TabletReplicas* best_replicas = &tablets[FindOrDie(dest_tablet_idxs, dest_uuid)];
+    int dest_count = FindOrDie(*leader_counts, dest_uuid);
+
+    LOG(INFO) << Substitute("Rebalancer: transferring leadership of tablet $0 from $1 "
+                            "($2 leaders) to $3 ($4 leaders)",
+                            best_replicas->tablet->tablet_id(), src->first, src->second,
+                            dest_uuid, dest_count);
+    catalog_manager_->SendLeaderElectionRequest(
+        best_replicas->tablet, dest_uuid,
+        MonoTime::Now() + MonoDelta::FromMilliseconds(FLAGS_master_ts_rpc_timeout_ms));
+    leader_transfers_started_->Increment();
+
+    src->second--;
+    (*leader_counts)[dest_uuid]++;
+    transferred_tablet_ids.insert(best_replicas->tablet->tablet_id());
+  }
+}
+
+void Rebalancer::SendChangeConfig(const ReplicaMove& move) {
+  Closure failed_cb = Bind(&Rebalancer::ChangeConfigFailed, Unretained(this),
+                           move.tablet->tablet_id(), move.state);
+  if (move.state == ReplicaMove::kAdding) {
+    catalog_manager_->SendChangeConfigRequest(move.tablet, consensus::ADD_SERVER,
+                                              move.dest_uuid, move.cas_config_opid_index,
+                                              move.deadline, failed_cb);
+  } else {
+    DCHECK_EQ(ReplicaMove::kRemoving, move.state);
+    catalog_manager_->SendChangeConfigRequest(move.tablet, consensus::REMOVE_SERVER,
+                                              move.src_uuid, move.cas_config_opid_index,
+                                              move.deadline, failed_cb);
+  }
+}
+
+void Rebalancer::ChangeConfigFailed(const string& tablet_id, ReplicaMove::State state) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  ReplicaMove* move = FindOrNull(moves_, tablet_id);
+  if (move && move->state == state) {
+    move->change_config_failed = true;
+  }
+}
+
+} // namespace master
+} // namespace kudu
@@ -0,0 +1,207 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_MASTER_REBALANCER_H
+#define KUDU_MASTER_REBALANCER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+
+class Counter;
+
+namespace master {
+
+class CatalogManager;
+class Master;
+class TabletInfo;
+class TSDescriptor;
+
+// Moves tablet replicas and tablet leadership between tablet servers so
+// that the live tablet servers host similar numbers of replicas and leaders.
+// Whether a server needs relief, and whether a move would help, is judged by
+// these counts. Among the servers a replica or leader could be moved to, the
+// one with the lowest weighted placement cost is chosen (see
+// ComputeReplicaPlacementCosts()), so that the resource usage the servers
+// heartbeat steers moves away from busy or nearly-full servers, as it does
+// the placement of new replicas.
+//
+// A replica is moved by adding the destination server to the tablet's Raft
+// config, waiting for the new replica to report itself running, and then
+// removing the source server from the config. A leader can't remove itself,
+// so if the source replica is the leader by then, its leadership is first
+// handed to the destination replica. Leadership is moved by asking a
+// follower with fewer leaders to run an election. The progress of a move is
+// followed through the committed configs which tablet servers report, so a
+// move survives failed RPCs; it is abandoned if it does not finish within
+// --rebalancer_move_timeout_ms, or as soon as adding the destination server
+// fails for good.
+//
+// The rebalancer is driven by the catalog manager's background task thread
+// while the master is the leader.
+//
+// This class is thread-safe.
+class Rebalancer {
+ public:
+  Rebalancer(CatalogManager* catalog_manager, Master* master);
+  ~Rebalancer();
+
+  // Advances the in-flight replica moves and, once every
+  // --rebalancer_interval_ms, plans and starts new replica moves and
+  // leader transfers.
+  //
+  // Must be called with the catalog manager's leader lock held for reading,
+  // while the master is the leader.
+  void Run();
+
+  // Forgets the in-flight replica moves. Called when the catalog manager's
+  // metadata is reloaded after a change of leadership.
+  void Reset();
+
+  // Notes that the replica of tablet 'tablet_id' on the tablet server with
+  // UUID 'ts_uuid' has reported itself running.
+  void ReplicaRunning(const std::string& tablet_id, const std::string& ts_uuid);
+
+ private:
+  // A replica move which is in flight.
+  struct ReplicaMove {
+    enum State {
+      // The ChangeConfig() adding the destination server has been sent.
+      kAdding,
+
+      // The destination server is in the config; waiting for its replica
+      // to report itself running.
+      kCopying,
+
+      // The ChangeConfig() removing the source server has been sent.
+      kRemoving,
+    };
+
+    scoped_refptr<TabletInfo> tablet;
+    std::string src_uuid;
+    std::string dest_uuid;
+    State state;
+
+    // Whether the destination replica has reported itself running.
+    bool dest_running;
+
+    // The opid index of the config the latest ChangeConfig() was based on.
+    int64_t cas_config_opid_index;
+
+    // Whether the latest ChangeConfig() task gave up without making its change.
+    bool change_config_failed;
+
+    // When the rebalancer last asked the destination replica to take over
+    // the leadership from the source replica, so that the source replica can
+    // be removed. Uninitialized if it never has.
+    MonoTime leader_transfer_time;
+
+    MonoTime deadline;
+  };
+
+  // A tablet whose replicas may be moved, along with its committed config.
+  struct TabletReplicas {
+    scoped_refptr<TabletInfo> tablet;
+    int64_t config_opid_index;
+    std::vector<std::string> voter_uuids;
+    std::string leader_uuid;
+  };
+
+  // The number of replicas and leaders hosted by each live tablet server,
+  // keyed by UUID.
+  typedef std::map<std::string, int> LoadMap;
+
+  // The descriptors of the live tablet servers, keyed by UUID.
+  typedef std::map<std::string, std::shared_ptr<TSDescriptor>> DescriptorMap;
+
+  // Advances each in-flight move according to its tablet's committed config.
+  void UpdateMoves();
+
+  // Plans and starts replica moves and leader transfers.
+  void PlanRound();
+
+  // Collects the live tablet servers into 'ts_descs', the tablets which may
+  // be rebalanced into 'tablets', and the replica and leader counts of the
+  // live tablet servers into 'replica_counts' and 'leader_counts'. A tablet
+  // may be rebalanced if it has no move in flight and its config has the
+  // table's replication factor of voters, all of them live. The counts
+  // assume the in-flight moves have finished.
+  void CollectLoad(DescriptorMap* ts_descs,
+                   std::vector<TabletReplicas>* tablets,
+                   LoadMap* replica_counts,
+                   LoadMap* leader_counts);
+
+  // Starts moves of replicas from the most loaded tablet servers to less
+  // loaded ones, until the replica counts are balanced or the number of
+  // in-flight moves reaches --rebalancer_max_concurrent_moves. The tablets
+  // whose replicas are moved are removed from 'tablets'.
+  void PlanReplicaMoves(const DescriptorMap& ts_descs,
+                        std::vector<TabletReplicas>* tablets,
+                        LoadMap* replica_counts);
+
+  // Transfers the leadership of tablets led by the tablet servers with the
+  // most leaders to followers with fewer leaders, until the leader counts
+  // are balanced or --rebalancer_max_leader_transfers transfers have started.
+  void PlanLeaderTransfers(const DescriptorMap& ts_descs,
+                           const std::vector<TabletReplicas>& tablets,
+                           LoadMap* leader_counts);
+
+  // Returns the UUID of the tablet server, among the keys of 'candidates',
+  // with the lowest weighted placement cost. 'candidates' must not be empty.
+  static const std::string& PickLeastCostly(const DescriptorMap& ts_descs,
+                                            const std::map<std::string, int>& candidates);
+
+  // Sends the ChangeConfig() request for the current state of 'move'.
+  void SendChangeConfig(const ReplicaMove& move);
+
+  // Notes that the ChangeConfig() task sent for tablet 'tablet_id' while its
+  // move was in state 'state' gave up. Runs on a reactor thread.
+  void ChangeConfigFailed(const std::string& tablet_id, ReplicaMove::State state);
+
+  CatalogManager* const catalog_manager_;
+  Master* const master_;
+
+  // Protects 'moves_'.
+  mutable simple_spinlock lock_;
+
+  // The in-flight replica moves, keyed by tablet ID.
+  std::unordered_map<std::string, ReplicaMove> moves_;
+
+  // The time at which new moves and transfers were last planned. Only
+  // accessed by Run().
+  MonoTime last_round_time_;
+
+  scoped_refptr<Counter> replica_moves_started_;
+  scoped_refptr<Counter> replica_moves_completed_;
+  scoped_refptr<Counter> replica_moves_failed_;
+  scoped_refptr<Counter> leader_transfers_started_;
+
+  DISALLOW_COPY_AND_ASSIGN(Rebalancer);
+};
+
+} // namespace master
+} // namespace kudu
+
+#endif
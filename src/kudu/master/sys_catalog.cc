@@ -22,7 +22,11 @@
 #include <glog/logging.h>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "kudu/common/partial_row.h"
 #include "kudu/common/partition.h"
@@ -49,8 +53,10 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/threadpool.h"
 
 DEFINE_double(sys_catalog_fail_during_write, 0.0,
@@ -70,8 +76,11 @@ using kudu::tablet::TabletPeer;
 using kudu::tablet::TabletStatusListener;
 using kudu::tserver::WriteRequestPB;
 using kudu::tserver::WriteResponsePB;
+using std::pair;
 using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -558,30 +567,36 @@ Status SysCatalogTable::VisitTabletFromRow(const RowBlockRow& row, TabletVisitor
     schema_.ExtractColumnFromRow<STRING>(row, schema_.find_column(kSysCatalogTableColId));
   const Slice *data =
     schema_.ExtractColumnFromRow<STRING>(row, schema_.find_column(kSysCatalogTableColMetadata));
-
   SysTabletsEntryPB metadata;
-  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(&metadata, data->data(), data->size()),
-                        "Unable to parse metadata field for tablet " + tablet_id->ToString());
+  RETURN_NOT_OK(ParseTabletEntry(*tablet_id, *data, &metadata));
+  RETURN_NOT_OK(visitor->VisitTablet(metadata.table_id(), tablet_id->ToString(), metadata));
+  return Status::OK();
+}
+
+Status SysCatalogTable::ParseTabletEntry(const Slice& tablet_id, const Slice& data,
+                                         SysTabletsEntryPB* metadata) {
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(metadata, data.data(), data.size()),
+                        "Unable to parse metadata field for tablet " + tablet_id.ToString());
 
   // Upgrade from the deprecated start/end-key fields to the 'partition' field.
-  if (!metadata.has_partition()) {
-    metadata.mutable_partition()->set_partition_key_start(
-        metadata.deprecated_start_key());
-    metadata.mutable_partition()->set_partition_key_end(
-        metadata.deprecated_end_key());
-    metadata.clear_deprecated_start_key();
-    metadata.clear_deprecated_end_key();
+  if (!metadata->has_partition()) {
+    metadata->mutable_partition()->set_partition_key_start(
+        metadata->deprecated_start_key());
+    metadata->mutable_partition()->set_partition_key_end(
+        metadata->deprecated_end_key());
+    metadata->clear_deprecated_start_key();
+    metadata->clear_deprecated_end_key();
   }
-
-  RETURN_NOT_OK(visitor->VisitTablet(metadata.table_id(), tablet_id->ToString(), metadata));
   return Status::OK();
 }
 
-Status SysCatalogTable::VisitTablets(TabletVisitor* visitor) {
+Status SysCatalogTable::VisitTablets(TabletVisitor* visitor, ThreadPool* pool) {
   TRACE_EVENT0("master", "SysCatalogTable::VisitTablets");
   const int8_t tablets_entry = TABLETS_ENTRY;
   const int type_col_idx = schema_.find_column(kSysCatalogTableColType);
   CHECK(type_col_idx != Schema::kColumnNotFound);
+  const int id_col_idx = schema_.find_column(kSysCatalogTableColId);
+  const int metadata_col_idx = schema_.find_column(kSysCatalogTableColMetadata);
 
   auto pred_tablets = ColumnPredicate::Equality(schema_.column(type_col_idx), &tablets_entry);
   ScanSpec spec;
@@ -591,17 +606,66 @@ Status SysCatalogTable::VisitTablets(TabletVisitor* visitor) {
   RETURN_NOT_OK(tablet_peer_->tablet()->NewRowIterator(schema_, &iter));
   RETURN_NOT_OK(iter->Init(&spec));
 
+  // The first error of the entries visited on 'pool'.
+  simple_spinlock pool_status_lock;
+  Status pool_status;
+
+  // The tasks reference the state above, so they must all be done before
+  // returning, including on error.
+  auto wait_for_pool = MakeScopedCleanup([&]() {
+    if (pool) {
+      pool->Wait();
+    }
+  });
+
   Arena arena(32 * 1024, 256 * 1024);
   RowBlock block(iter->schema(), 512, &arena);
   while (iter->HasNext()) {
     RETURN_NOT_OK(iter->NextBlock(&block));
+    if (!pool) {
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (!block.selection_vector()->IsRowSelected(i)) continue;
+
+        RETURN_NOT_OK(VisitTabletFromRow(block.row(i), visitor));
+      }
+      continue;
+    }
+
+    // The block is reused by the next call to NextBlock(), so its entries
+    // are copied out before being handed to the pool.
+    auto entries = std::make_shared<vector<pair<string, string>>>();
+    entries->reserve(block.nrows());
     for (size_t i = 0; i < block.nrows(); i++) {
       if (!block.selection_vector()->IsRowSelected(i)) continue;
 
-      RETURN_NOT_OK(VisitTabletFromRow(block.row(i), visitor));
+      const Slice* tablet_id = schema_.ExtractColumnFromRow<STRING>(block.row(i), id_col_idx);
+      const Slice* data = schema_.ExtractColumnFromRow<STRING>(block.row(i), metadata_col_idx);
+      entries->emplace_back(tablet_id->ToString(), data->ToString());
     }
+    RETURN_NOT_OK(pool->SubmitFunc([this, entries, visitor, &pool_status_lock, &pool_status]() {
+      Status s;
+      vector<TabletVisitor::TabletEntry> parsed(entries->size());
+      for (size_t i = 0; i < entries->size() && s.ok(); i++) {
+        const auto& e = (*entries)[i];
+        parsed[i].first = e.first;
+        s = ParseTabletEntry(e.first, e.second, &parsed[i].second);
+      }
+      if (s.ok()) {
+        s = visitor->VisitTabletBlock(parsed);
+      }
+      if (!s.ok()) {
+        std::lock_guard<simple_spinlock> l(pool_status_lock);
+        if (pool_status.ok()) {
+          pool_status = s;
+        }
+      }
+    }));
   }
-  return Status::OK();
+  if (pool) {
+    pool->Wait();
+  }
+  wait_for_pool.cancel();
+  return pool_status;
 }
 
 void SysCatalogTable::InitLocalRaftPeerPB() {
@@ -18,6 +18,7 @@
 #define KUDU_MASTER_SYS_CATALOG_H_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/consensus/metadata.pb.h"
@@ -29,6 +30,8 @@ namespace kudu {
 
 class Schema;
 class FsManager;
+class Slice;
+class ThreadPool;
 
 namespace tserver {
 class WriteRequestPB;
@@ -49,11 +52,26 @@ class TableVisitor {
                             const SysTablesEntryPB& metadata) = 0;
 };
 
+// When the tablets are visited on a thread pool, VisitTabletBlock() is called
+// concurrently and must be thread-safe.
 class TabletVisitor {
  public:
+  // A tablet's ID and its metadata.
+  typedef std::pair<std::string, SysTabletsEntryPB> TabletEntry;
+
   virtual Status VisitTablet(const std::string& table_id,
                              const std::string& tablet_id,
                              const SysTabletsEntryPB& metadata) = 0;
+
+  // Visits a block of tablets scanned together from the sys catalog, when
+  // the tablets are visited on a thread pool. The default visits them one at
+  // a time; visitors may override it to share work across the block.
+  virtual Status VisitTabletBlock(const std::vector<TabletEntry>& tablets) {
+    for (const auto& t : tablets) {
+      RETURN_NOT_OK(VisitTablet(t.second.table_id(), t.first, t.second));
+    }
+    return Status::OK();
+  }
 };
 
 // SysCatalogTable is a Kudu table that keeps track of table and
@@ -113,7 +131,13 @@ class SysCatalogTable {
   Status VisitTables(TableVisitor* visitor);
 
   // Scan of the tablet-related entries.
-  Status VisitTablets(TabletVisitor* visitor);
+  //
+  // If 'pool' is not null, the entries are read sequentially but parsed on
+  // the threads of 'pool', one block of entries per task, and each block is
+  // passed to TabletVisitor::VisitTabletBlock(). Returns once all of the
+  // entries have been visited; if any visit fails, the first error is
+  // returned.
+  Status VisitTablets(TabletVisitor* visitor, ThreadPool* pool = nullptr);
 
  private:
   FRIEND_TEST(MasterTest, TestMasterMetadataConsistentDespiteFailures);
@@ -170,6 +194,8 @@ class SysCatalogTable {
                         RowOperationsPB::Type op_type,
                         RowOperationsPB* ops) const;
   Status VisitTabletFromRow(const RowBlockRow& row, TabletVisitor* visitor);
+  Status ParseTabletEntry(const Slice& tablet_id, const Slice& data,
+                          SysTabletsEntryPB* metadata);
 
   // Initializes the RaftPeerPB for the local peer.
   // Crashes due to an invariant check if the rpc server is not running.
@@ -58,7 +58,8 @@ TSDescriptor::TSDescriptor(std::string perm_id)
       last_heartbeat_(MonoTime::Now()),
       recent_replica_creations_(0),
       last_replica_creations_decay_(MonoTime::Now()),
-      num_live_replicas_(0) {
+      num_live_replicas_(0),
+      resource_stats_(new TSResourceStatsPB) {
 }
 
 TSDescriptor::~TSDescriptor() {
@@ -182,6 +183,16 @@ double TSDescriptor::RecentReplicaCreations() {
   return recent_replica_creations_;
 }
 
+void TSDescriptor::set_resource_stats(const TSResourceStatsPB& stats) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  resource_stats_->CopyFrom(stats);
+}
+
+void TSDescriptor::GetResourceStats(TSResourceStatsPB* stats) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  stats->CopyFrom(*resource_stats_);
+}
+
 void TSDescriptor::GetRegistration(ServerRegistrationPB* reg) const {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(registration_) << "No registration";
@@ -47,6 +47,8 @@ class TabletServerAdminServiceProxy;
 
 namespace master {
 
+class TSResourceStatsPB;
+
 // Master-side view of a single tablet server.
 //
 // Tracks the last heartbeat, status, instance identifier, etc.
@@ -114,12 +116,20 @@ class TSDescriptor {
     return num_live_replicas_;
   }
 
+  // Set the resource usage stats from the last heartbeat.
+  void set_resource_stats(const TSResourceStatsPB& stats);
+
+  // Copy the resource usage stats from the last heartbeat into 'stats'.
+  // The stats are empty if the TS has not reported any.
+  void GetResourceStats(TSResourceStatsPB* stats) const;
+
   // Return a string form of this TS, suitable for printing.
   // Includes the UUID as well as last known host/port.
   std::string ToString() const;
 
  private:
   FRIEND_TEST(TestTSDescriptor, TestReplicaCreationsDecay);
+  FRIEND_TEST(TestTSDescriptor, TestReplicaPlacementCosts);
 
   explicit TSDescriptor(std::string perm_id);
 
@@ -144,6 +154,9 @@ class TSDescriptor {
   // The number of live replicas on this host, from the last heartbeat.
   int num_live_replicas_;
 
+  // The resource usage of this host, from the last heartbeat.
+  gscoped_ptr<TSResourceStatsPB> resource_stats_;
+
   gscoped_ptr<ServerRegistrationPB> registration_;
 
   std::shared_ptr<tserver::TabletServerAdminServiceProxy> ts_admin_proxy_;
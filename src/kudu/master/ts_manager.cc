@@ -34,7 +34,8 @@ using strings::Substitute;
 namespace kudu {
 namespace master {
 
-TSManager::TSManager() {
+TSManager::TSManager()
+    : registration_version_(0) {
 }
 
 TSManager::~TSManager() {
@@ -81,6 +82,7 @@ Status TSManager::RegisterTS(const NodeInstancePB& instance,
   } else {
     shared_ptr<TSDescriptor> found(FindOrDie(servers_by_id_, uuid));
     RETURN_NOT_OK(found->Register(instance, registration));
+    registration_version_++;
     LOG(INFO) << Substitute("Re-registered known tserver with Master: $0",
                             found->ToString());
     desc->swap(found);
@@ -113,6 +115,11 @@ int TSManager::GetCount() const {
   return servers_by_id_.size();
 }
 
+int64_t TSManager::registration_version() const {
+  shared_lock<rw_spinlock> l(lock_);
+  return registration_version_;
+}
+
 } // namespace master
 } // namespace kudu
 
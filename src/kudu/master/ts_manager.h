@@ -84,6 +84,11 @@ class TSManager {
   // Get the TS count.
   int GetCount() const;
 
+  // Returns a version which is bumped every time a known tablet server
+  // re-registers. Anything built from the servers' registrations, such as
+  // cached tablet locations, is stale once this changes.
+  int64_t registration_version() const;
+
  private:
   mutable rw_spinlock lock_;
 
@@ -91,6 +96,9 @@ class TSManager {
     std::string, std::shared_ptr<TSDescriptor> > TSDescriptorMap;
   TSDescriptorMap servers_by_id_;
 
+  // See registration_version(). Protected by lock_.
+  int64_t registration_version_;
+
   DISALLOW_COPY_AND_ASSIGN(TSManager);
 };
 
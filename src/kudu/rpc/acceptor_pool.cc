@@ -21,6 +21,7 @@
 #include <glog/logging.h>
 #include <inttypes.h>
 #include <iostream>
+#include <memory>
 #include <pthread.h>
 #include <stdint.h>
 #include <string>
@@ -29,6 +30,8 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/rpc/reactor.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
@@ -54,16 +57,26 @@ DEFINE_int32(rpc_acceptor_listen_backlog, 128,
              "new inbound connection requests.");
 TAG_FLAG(rpc_acceptor_listen_backlog, advanced);
 
+DEFINE_bool(rpc_reuseport_acceptors, false,
+            "Whether to accept RPC connections within the reactor threads, using "
+            "one SO_REUSEPORT listening socket per reactor, instead of with "
+            "dedicated acceptor threads. This lets the kernel spread bursts of new "
+            "connections across reactors. Only supported on Linux.");
+TAG_FLAG(rpc_reuseport_acceptors, experimental);
+
 namespace kudu {
 namespace rpc {
 
 AcceptorPool::AcceptorPool(Messenger* messenger, Socket* socket,
-                           Sockaddr bind_address)
+                           Sockaddr bind_address, bool reuse_port)
     : messenger_(messenger),
       socket_(socket->Release()),
       bind_address_(std::move(bind_address)),
+      reuse_port_(reuse_port),
       rpc_connections_accepted_(METRIC_rpc_connections_accepted.Instantiate(
           messenger->metric_entity())),
+      reactors_stopped_(std::make_shared<CountDownLatch>(
+          reuse_port ? messenger->reactors_.size() : 0)),
       closing_(false) {}
 
 AcceptorPool::~AcceptorPool() {
@@ -71,6 +84,14 @@ AcceptorPool::~AcceptorPool() {
 }
 
 Status AcceptorPool::Start(int num_threads) {
+  if (reuse_port_) {
+    Status s = StartReactorAcceptors();
+    if (!s.ok()) {
+      Shutdown();
+    }
+    return s;
+  }
+
   RETURN_NOT_OK(socket_.Listen(FLAGS_rpc_acceptor_listen_backlog));
 
   for (int i = 0; i < num_threads; i++) {
@@ -86,6 +107,24 @@ Status AcceptorPool::Start(int num_threads) {
   return Status::OK();
 }
 
+Status AcceptorPool::StartReactorAcceptors() {
+  // The pool's own socket is only kept bound, to reserve the address; it
+  // never listens, so the kernel only balances connections across the
+  // reactors' sockets.
+  Sockaddr bound_addr;
+  RETURN_NOT_OK(socket_.GetSocketAddress(&bound_addr));
+  for (Reactor* reactor : messenger_->reactors_) {
+    std::unique_ptr<Socket> sock(new Socket);
+    RETURN_NOT_OK(sock->Init(Socket::FLAG_NONBLOCKING));
+    RETURN_NOT_OK(sock->SetReuseAddr(true));
+    RETURN_NOT_OK(sock->SetReusePort(true));
+    RETURN_NOT_OK(sock->Bind(bound_addr));
+    RETURN_NOT_OK(sock->Listen(FLAGS_rpc_acceptor_listen_backlog));
+    reactor->StartAccepting(this, std::move(sock), rpc_connections_accepted_);
+  }
+  return Status::OK();
+}
+
 void AcceptorPool::Shutdown() {
   if (Acquire_CompareAndSwap(&closing_, false, true) != false) {
     VLOG(2) << "Acceptor Pool on " << bind_address_.ToString()
@@ -93,6 +132,16 @@ void AcceptorPool::Shutdown() {
     return;
   }
 
+  if (reuse_port_) {
+    // This doesn't wait for the reactors to close their sockets: Shutdown()
+    // may be called with the messenger lock held, or from a reactor thread.
+    // See WaitForShutdown().
+    for (Reactor* reactor : messenger_->reactors_) {
+      reactor->StopAccepting(this, reactors_stopped_);
+    }
+    return;
+  }
+
 #if defined(__linux__)
   // Closing the socket will break us out of accept() if we're in it, and
   // prevent future accepts.
@@ -114,6 +163,11 @@ void AcceptorPool::Shutdown() {
   threads_.clear();
 }
 
+void AcceptorPool::WaitForShutdown() {
+  DCHECK(Acquire_Load(&closing_)) << "Shutdown() must be called first";
+  reactors_stopped_->Wait();
+}
+
 Sockaddr AcceptorPool::bind_address() const {
   return bind_address_;
 }
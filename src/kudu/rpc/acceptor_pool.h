@@ -18,6 +18,7 @@
 #ifndef KUDU_RPC_ACCEPTOR_POOL_H
 #define KUDU_RPC_ACCEPTOR_POOL_H
 
+#include <memory>
 #include <vector>
 
 #include "kudu/gutil/atomicops.h"
@@ -28,6 +29,7 @@
 
 namespace kudu {
 
+class CountDownLatch;
 class Counter;
 class Socket;
 
@@ -38,18 +40,37 @@ class Messenger;
 // A pool of threads calling accept() to create new connections.
 // Acceptor pool threads terminate when they notice that the messenger has been
 // shut down, if Shutdown() is called, or if the pool object is destructed.
+//
+// If 'reuse_port' is set, the pool instead opens one SO_REUSEPORT listening
+// socket per reactor of the messenger, and each reactor accepts connections
+// on its own socket from within its event loop. The kernel then spreads new
+// connections across the reactors without any hand-off between threads.
 class AcceptorPool {
  public:
   // Create a new acceptor pool.  Calls socket::Release to take ownership of the
   // socket.
-  // 'socket' must be already bound, but should not yet be listening.
-  AcceptorPool(Messenger *messenger, Socket *socket, Sockaddr bind_address);
+  // 'socket' must be already bound, but should not yet be listening. If
+  // 'reuse_port' is set, it must have been bound with SO_REUSEPORT.
+  AcceptorPool(Messenger *messenger, Socket *socket, Sockaddr bind_address,
+               bool reuse_port = false);
   ~AcceptorPool();
 
-  // Start listening and accepting connections.
+  // Start listening and accepting connections. 'num_threads' is ignored if
+  // the pool accepts on the messenger's reactors.
   Status Start(int num_threads);
+
+  // Stop accepting connections. If the pool accepts on the messenger's
+  // reactors, this only asks them to close their listening sockets, so that
+  // it may be called with the messenger lock held or from a reactor thread;
+  // use WaitForShutdown() to wait for them.
   void Shutdown();
 
+  // Wait until every reactor has closed its listening socket after
+  // Shutdown(), or has dropped the request because it is itself shutting
+  // down. Returns immediately for a pool with its own acceptor threads, which
+  // Shutdown() joins. Must not be called from a reactor thread.
+  void WaitForShutdown();
+
   // Return the address that the pool is bound to. If the port is specified as
   // 0, then this will always return port 0.
   Sockaddr bind_address() const;
@@ -62,13 +83,21 @@ class AcceptorPool {
  private:
   void RunThread();
 
+  // Open a listening socket per reactor and start accepting on each.
+  Status StartReactorAcceptors();
+
   Messenger *messenger_;
   Socket socket_;
   Sockaddr bind_address_;
+  const bool reuse_port_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
 
   scoped_refptr<Counter> rpc_connections_accepted_;
 
+  // Counted down by each reactor once it stops accepting for this pool.
+  // Shared with the reactor tasks, which may outlive the pool.
+  const std::shared_ptr<CountDownLatch> reactors_stopped_;
+
   Atomic32 closing_;
 
   DISALLOW_COPY_AND_ASSIGN(AcceptorPool);
@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+
+#include "kudu/rpc/admission_controller.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+namespace rpc {
+
+class AdmissionControllerTest : public KuduTest {
+ public:
+  AdmissionControllerTest()
+      : controller_(MonoDelta::FromMilliseconds(10), MonoDelta::FromMilliseconds(100)),
+        now_(MonoTime::Now()) {
+  }
+
+ protected:
+  // Advance the fake clock and record a dequeued call with the given sojourn time.
+  bool Dequeue(int advance_ms, int sojourn_ms) {
+    now_ += MonoDelta::FromMilliseconds(advance_ms);
+    return controller_.RecordDequeueAndCheckShed(now_, MonoDelta::FromMilliseconds(sojourn_ms));
+  }
+
+  AdmissionController controller_;
+  MonoTime now_;
+};
+
+// Short bursts of queueing above the target shouldn't cause any calls to be shed.
+TEST_F(AdmissionControllerTest, TestBurstsAreAbsorbed) {
+  for (int i = 0; i < 100; i++) {
+    // Within each interval, most calls wait for a long time, but at least one
+    // is dequeued under the target, so there is no standing queue.
+    ASSERT_FALSE(Dequeue(10, i % 5 == 0 ? 1 : 50));
+  }
+  ASSERT_FALSE(controller_.overloaded());
+}
+
+TEST_F(AdmissionControllerTest, TestStandingQueueIsShed) {
+  // A full interval in which every call waits for longer than the target.
+  ASSERT_FALSE(Dequeue(0, 15));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_FALSE(Dequeue(10, 15));
+  }
+  ASSERT_FALSE(controller_.overloaded());
+
+  // The next call starts a new interval, which puts the controller in the
+  // overloaded state. Calls that waited for more than twice the target are shed,
+  // while those that waited less are still handled.
+  ASSERT_TRUE(Dequeue(10, 25));
+  ASSERT_TRUE(controller_.overloaded());
+  ASSERT_FALSE(Dequeue(1, 15));
+  ASSERT_TRUE(Dequeue(1, 50));
+
+  // Once a full interval has a call dequeued under the target, the controller
+  // leaves the overloaded state.
+  ASSERT_FALSE(Dequeue(10, 5));
+  ASSERT_TRUE(Dequeue(10, 50));
+  ASSERT_FALSE(Dequeue(100, 50));
+  ASSERT_FALSE(controller_.overloaded());
+  ASSERT_EQ(100, controller_.retry_after().ToMilliseconds());
+}
+
+} // namespace rpc
+} // namespace kudu
@@ -0,0 +1,65 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/admission_controller.h"
+
+#include <mutex>
+
+#include <glog/logging.h>
+
+namespace kudu {
+namespace rpc {
+
+AdmissionController::AdmissionController(const MonoDelta& target, const MonoDelta& interval)
+    : target_(target),
+      interval_(interval),
+      overloaded_(false) {
+  CHECK(target_.Initialized());
+  CHECK(interval_.Initialized());
+}
+
+bool AdmissionController::RecordDequeueAndCheckShed(const MonoTime& now,
+                                                    const MonoDelta& sojourn) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!interval_end_.Initialized() || now > interval_end_) {
+    // Close out the previous interval. The first call dequeued in each
+    // interval starts the minimum afresh.
+    if (interval_end_.Initialized()) {
+      bool was_overloaded = overloaded_;
+      overloaded_ = min_sojourn_ > target_;
+      if (overloaded_ != was_overloaded) {
+        LOG(INFO) << "Service queue " << (overloaded_ ? "entered" : "left")
+                  << " overloaded state: minimum queue time over the last interval was "
+                  << min_sojourn_.ToString() << "s (target " << target_.ToString() << "s)";
+      }
+    }
+    min_sojourn_ = sojourn;
+    interval_end_ = now + interval_;
+  } else if (sojourn < min_sojourn_) {
+    min_sojourn_ = sojourn;
+  }
+
+  return overloaded_ && sojourn.ToNanoseconds() > 2 * target_.ToNanoseconds();
+}
+
+bool AdmissionController::overloaded() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return overloaded_;
+}
+
+} // namespace rpc
+} // namespace kudu
@@ -0,0 +1,79 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_RPC_ADMISSION_CONTROLLER_H
+#define KUDU_RPC_ADMISSION_CONTROLLER_H
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace rpc {
+
+// Adaptive admission control for a service queue, based on the CoDel
+// ("controlled delay") algorithm as adapted for RPC servers.
+//
+// Rather than reacting to the queue length, the controller tracks the time
+// calls spend waiting in the queue (their "sojourn time"). If the minimum
+// sojourn time observed over an interval exceeds the target, then the queue has
+// a standing backlog which the service threads are not draining, and the
+// controller considers the service to be overloaded. While overloaded, calls
+// which have waited for longer than twice the target are shed rather than
+// handled: handling them would only keep the backlog standing, and their
+// clients are better off backing off and retrying. The controller leaves the
+// overloaded state once an interval passes in which some call was dequeued
+// within the target.
+//
+// This class is thread-safe.
+class AdmissionController {
+ public:
+  AdmissionController(const MonoDelta& target, const MonoDelta& interval);
+
+  // Record that a call was dequeued at 'now' after waiting for 'sojourn'.
+  // Returns true if the call should be shed.
+  bool RecordDequeueAndCheckShed(const MonoTime& now, const MonoDelta& sojourn);
+
+  // Whether the service is currently considered overloaded.
+  bool overloaded() const;
+
+  // The time clients are asked to wait before retrying a shed call.
+  MonoDelta retry_after() const {
+    return interval_;
+  }
+
+ private:
+  const MonoDelta target_;
+  const MonoDelta interval_;
+
+  mutable simple_spinlock lock_;
+
+  // The end of the current measurement interval.
+  MonoTime interval_end_;
+
+  // The minimum sojourn time observed in the current interval.
+  MonoDelta min_sojourn_;
+
+  // Whether the minimum sojourn time in the last full interval exceeded the target.
+  bool overloaded_;
+
+  DISALLOW_COPY_AND_ASSIGN(AdmissionController);
+};
+
+} // namespace rpc
+} // namespace kudu
+
+#endif // KUDU_RPC_ADMISSION_CONTROLLER_H
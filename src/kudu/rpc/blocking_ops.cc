@@ -80,28 +80,15 @@ Status SendFramedMessageBlocking(Socket* sock, const MessageLite& header, const
   return Status::OK();
 }
 
-Status ReceiveFramedMessageBlocking(Socket* sock, faststring* recv_buf,
-    MessageLite* header, Slice* param_buf, const MonoTime& deadline) {
-  DCHECK(sock != nullptr);
-  DCHECK(recv_buf != nullptr);
-  DCHECK(header != nullptr);
-  DCHECK(param_buf != nullptr);
-
-  RETURN_NOT_OK(EnsureBlockingMode(sock));
-
-  // Read the message prefix, which specifies the length of the payload.
-  recv_buf->clear();
-  recv_buf->resize(kMsgLengthPrefixLength);
-  size_t recvd = 0;
-  RETURN_NOT_OK(sock->BlockingRecv(recv_buf->data(), kMsgLengthPrefixLength, &recvd, deadline));
-  uint32_t payload_len = NetworkByteOrder::Load32(recv_buf->data());
+Status ParseMessageLengthPrefix(const uint8_t* prefix, uint32_t* payload_len) {
+  *payload_len = NetworkByteOrder::Load32(prefix);
 
   // Verify that the payload size isn't out of bounds.
   // This can happen because of network corruption, or a naughty client.
-  if (PREDICT_FALSE(payload_len > FLAGS_rpc_max_message_size)) {
+  if (PREDICT_FALSE(*payload_len > FLAGS_rpc_max_message_size)) {
     // A common user mistake is to try to speak the Kudu RPC protocol to an
     // HTTP endpoint, or vice versa.
-    if (memcmp(recv_buf->data(), kHTTPHeader, strlen(kHTTPHeader)) == 0) {
+    if (memcmp(prefix, kHTTPHeader, strlen(kHTTPHeader)) == 0) {
       return Status::IOError(
           "received invalid RPC message which appears to be an HTTP response. "
           "Verify that you have specified a valid RPC port and not an HTTP port.");
@@ -111,8 +98,27 @@ Status ReceiveFramedMessageBlocking(Socket* sock, faststring* recv_buf,
         strings::Substitute(
             "received invalid message of size $0 which exceeds"
             " the rpc_max_message_size of $1 bytes",
-            payload_len, FLAGS_rpc_max_message_size));
+            *payload_len, FLAGS_rpc_max_message_size));
   }
+  return Status::OK();
+}
+
+Status ReceiveFramedMessageBlocking(Socket* sock, faststring* recv_buf,
+    MessageLite* header, Slice* param_buf, const MonoTime& deadline) {
+  DCHECK(sock != nullptr);
+  DCHECK(recv_buf != nullptr);
+  DCHECK(header != nullptr);
+  DCHECK(param_buf != nullptr);
+
+  RETURN_NOT_OK(EnsureBlockingMode(sock));
+
+  // Read the message prefix, which specifies the length of the payload.
+  recv_buf->clear();
+  recv_buf->resize(kMsgLengthPrefixLength);
+  size_t recvd = 0;
+  RETURN_NOT_OK(sock->BlockingRecv(recv_buf->data(), kMsgLengthPrefixLength, &recvd, deadline));
+  uint32_t payload_len;
+  RETURN_NOT_OK(ParseMessageLengthPrefix(recv_buf->data(), &payload_len));
 
   // Read the message payload.
   recvd = 0;
@@ -18,6 +18,8 @@
 #ifndef KUDU_RPC_BLOCKING_OPS_H
 #define KUDU_RPC_BLOCKING_OPS_H
 
+#include <stdint.h>
+
 #include <set>
 #include <string>
 
@@ -48,6 +50,11 @@ Status EnsureBlockingMode(const Socket* sock);
 Status SendFramedMessageBlocking(Socket* sock, const google::protobuf::MessageLite& header,
     const google::protobuf::MessageLite& msg, const MonoTime& deadline);
 
+// Decode the length prefix at the start of a message frame into
+// 'payload_len', and check that the payload isn't out of bounds. 'prefix'
+// must hold kMsgLengthPrefixLength bytes.
+Status ParseMessageLengthPrefix(const uint8_t* prefix, uint32_t* payload_len);
+
 // Receive a full message frame from the server.
 // recv_buf: buffer to use for reading the data from the socket.
 // header: Request or Response header protobuf.
@@ -18,6 +18,7 @@
 #include "kudu/rpc/connection.h"
 
 #include <stdint.h>
+#include <strings.h>
 
 #include <algorithm>
 #include <iostream>
@@ -41,6 +42,7 @@
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
@@ -57,6 +59,30 @@ using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
+DEFINE_string(rpc_compression_codec, "none",
+              "Codec with which to compress the bodies of outbound RPC requests and "
+              "responses, including sidecars, on connections to peers which support it. "
+              "One of 'none', 'lz4', 'snappy' or 'zlib'. Compression saves bandwidth on "
+              "constrained links at the cost of CPU on both ends.");
+TAG_FLAG(rpc_compression_codec, experimental);
+
+DEFINE_int32(rpc_compression_min_bytes, 32 * 1024,
+             "Outbound RPC message bodies smaller than this are sent uncompressed, even "
+             "if --rpc_compression_codec is set.");
+TAG_FLAG(rpc_compression_min_bytes, experimental);
+TAG_FLAG(rpc_compression_min_bytes, runtime);
+
+static bool ValidateCompressionCodec(const char* flagname, const std::string& value) {
+  if (strcasecmp(value.c_str(), "none") != 0 &&
+      kudu::GetCompressionCodecType(value) == kudu::NO_COMPRESSION) {
+    LOG(ERROR) << "Invalid value for " << flagname << ": " << value;
+    return false;
+  }
+  return true;
+}
+static bool dummy = google::RegisterFlagValidator(
+    &FLAGS_rpc_compression_codec, &ValidateCompressionCodec);
+
 namespace kudu {
 namespace rpc {
 
@@ -70,11 +96,13 @@ Connection::Connection(ReactorThread *reactor_thread,
     : reactor_thread_(reactor_thread),
       remote_(remote),
       socket_(std::move(socket)),
+      outbound_connection_idx_(0),
       direction_(direction),
       last_activity_time_(MonoTime::Now()),
       is_epoll_registered_(false),
       next_call_id_(1),
-      negotiation_complete_(false) {
+      negotiation_complete_(false),
+      body_compression_codec_(nullptr) {
 }
 
 Status Connection::SetNonBlocking(bool enabled) {
@@ -290,9 +318,12 @@ void Connection::QueueOutboundCall(const shared_ptr<OutboundCall> &call) {
   int32_t call_id = GetNextCallId();
   call->set_call_id(call_id);
 
-  // Serialize the actual bytes to be put on the wire.
+  // Serialize the actual bytes to be put on the wire. Calls queued while
+  // negotiation is still in progress are never compressed, since it isn't yet
+  // known whether the server supports it.
   slices_tmp_.clear();
-  Status s = call->SerializeTo(&slices_tmp_);
+  const CompressionCodec* codec = GetBodyCompressionCodec(call->request_size());
+  Status s = call->SerializeTo(codec, &slices_tmp_);
   if (PREDICT_FALSE(!s.ok())) {
     call->SetFailed(s);
     return;
@@ -373,12 +404,15 @@ struct ResponseTransferCallbacks : public TransferCallbacks {
   }
 
   virtual void NotifyTransferFinished() OVERRIDE {
+    call_->RecordResponseSent();
+    conn_->rpcz_store()->AddCall(call_.get());
     delete this;
   }
 
   virtual void NotifyTransferAborted(const Status &status) OVERRIDE {
     LOG(WARNING) << "Connection torn down before " <<
       call_->ToString() << " could send its response";
+    conn_->rpcz_store()->AddCall(call_.get());
     delete this;
   }
 
@@ -456,7 +490,7 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
 
   while (true) {
     if (!inbound_) {
-      inbound_.reset(new InboundTransfer());
+      inbound_.reset(new InboundTransfer(reactor_thread_->inbound_buffer_pool()));
     }
     Status status = inbound_->ReceiveBuffer(*socket_);
     if (PREDICT_FALSE(!status.ok())) {
@@ -504,6 +538,9 @@ void Connection::HandleIncomingCall(gscoped_ptr<InboundTransfer> transfer) {
     // "unsynchronized"
     return;
   }
+  if (call->header().has_body_compression()) {
+    reactor_thread_->num_compressed_bodies_received_++;
+  }
 
   if (!InsertIfNotPresent(&calls_being_handled_, call->call_id(), call.get())) {
     LOG(WARNING) << ToString() << ": received call ID " << call->call_id() <<
@@ -521,6 +558,9 @@ void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
   DCHECK(reactor_thread_->IsCurrentThread());
   gscoped_ptr<CallResponse> resp(new CallResponse);
   CHECK_OK(resp->ParseFrom(std::move(transfer)));
+  if (resp->body_compressed()) {
+    reactor_thread_->num_compressed_bodies_received_++;
+  }
 
   CallAwaitingResponse *car_ptr =
     EraseKeyReturnValuePtr(&awaiting_response_, resp->call_id());
@@ -539,6 +579,10 @@ void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
     return;
   }
 
+  // Record the call's phase latencies before its callback runs, since the
+  // callback may tear down the messenger.
+  car->call->RecordResponseReceived(resp->receive_start_time());
+  reactor_thread_->reactor()->messenger()->RecordOutboundCallTiming(car->call->timing());
   car->call->SetResponse(std::move(resp));
 }
 
@@ -662,6 +706,18 @@ void Connection::CompleteNegotiation(const Status& negotiation_status) {
 void Connection::MarkNegotiationComplete() {
   DCHECK(reactor_thread_->IsCurrentThread());
   negotiation_complete_ = true;
+  if (ContainsKey(remote_features_, BODY_COMPRESSION)) {
+    CHECK_OK(GetCompressionCodec(GetCompressionCodecType(FLAGS_rpc_compression_codec),
+                                 &body_compression_codec_));
+  }
+}
+
+const CompressionCodec* Connection::GetBodyCompressionCodec(size_t body_size) const {
+  if (body_compression_codec_ == nullptr ||
+      body_size < FLAGS_rpc_compression_min_bytes) {
+    return nullptr;
+  }
+  return body_compression_codec_;
 }
 
 Status Connection::DumpPB(const DumpRunningRpcsRequestPB& req,
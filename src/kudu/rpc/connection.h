@@ -42,6 +42,8 @@
 #include "kudu/util/status.h"
 
 namespace kudu {
+
+class CompressionCodec;
 namespace rpc {
 
 class DumpRunningRpcsRequestPB;
@@ -130,6 +132,19 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Get the user credentials which will be used to log in.
   const UserCredentials &user_credentials() const { return user_credentials_; }
 
+  // For client connections, the index of this connection among those to the
+  // same remote with the same credentials. See ConnectionId::idx().
+  void set_outbound_connection_idx(int idx) { outbound_connection_idx_ = idx; }
+  int outbound_connection_idx() const { return outbound_connection_idx_; }
+
+  // Returns the codec with which an outbound message body (main message plus
+  // sidecars) of 'body_size' bytes should be compressed, or nullptr if it
+  // should be sent as is. Bodies are only compressed once negotiation has
+  // established that the remote end supports it.
+  //
+  // On client connections, must be called on the reactor thread.
+  const CompressionCodec* GetBodyCompressionCodec(size_t body_size) const;
+
   RpczStore* rpcz_store();
 
   // libev callback when data is available to read.
@@ -236,6 +251,9 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // The credentials of the user operating on this connection (if a client user).
   UserCredentials user_credentials_;
 
+  // See outbound_connection_idx().
+  int outbound_connection_idx_;
+
   // whether we are client or server
   Direction direction_;
 
@@ -286,6 +304,10 @@ class Connection : public RefCountedThreadSafe<Connection> {
 
   // Whether we completed connection negotiation.
   bool negotiation_complete_;
+
+  // The codec to compress outbound message bodies with, if any.
+  // Set when negotiation completes. See GetBodyCompressionCodec().
+  const CompressionCodec* body_compression_codec_;
 };
 
 } // namespace rpc
@@ -28,8 +28,10 @@ const char* const kSaslProtoName = "kudu";
 
 // The server supports the TLS flag if there is a TLS certificate available.
 // The flag is added during negotiation if this is the case.
-set<RpcFeatureFlag> kSupportedServerRpcFeatureFlags = { APPLICATION_FEATURE_FLAGS };
-set<RpcFeatureFlag> kSupportedClientRpcFeatureFlags = { APPLICATION_FEATURE_FLAGS, TLS };
+set<RpcFeatureFlag> kSupportedServerRpcFeatureFlags = { APPLICATION_FEATURE_FLAGS,
+                                                        BODY_COMPRESSION };
+set<RpcFeatureFlag> kSupportedClientRpcFeatureFlags = { APPLICATION_FEATURE_FLAGS, TLS,
+                                                        BODY_COMPRESSION };
 
 } // namespace rpc
 } // namespace kudu
@@ -0,0 +1,78 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/inbound_buffer_pool.h"
+
+#include <mutex>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/stl_util.h"
+
+using std::unique_ptr;
+
+namespace kudu {
+namespace rpc {
+
+InboundBufferPool::InboundBufferPool(int max_buffers, int max_buffer_size)
+    : max_buffers_(max_buffers),
+      max_buffer_size_(max_buffer_size),
+      buffers_allocated_(0),
+      buffers_reused_(0) {
+  CHECK_GE(max_buffers_, 0);
+  free_buffers_.reserve(max_buffers_);
+}
+
+InboundBufferPool::~InboundBufferPool() {
+  STLDeleteElements(&free_buffers_);
+}
+
+unique_ptr<faststring> InboundBufferPool::Acquire(int size) {
+  unique_ptr<faststring> buf;
+  if (size <= max_buffer_size_) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!free_buffers_.empty()) {
+      buf.reset(free_buffers_.back());
+      free_buffers_.pop_back();
+    }
+  }
+
+  if (buf) {
+    buffers_reused_.Increment();
+    DCHECK_EQ(buf->size(), 0);
+  } else {
+    buffers_allocated_.Increment();
+    buf.reset(new faststring());
+  }
+  buf->reserve(size);
+  return buf;
+}
+
+void InboundBufferPool::Release(unique_ptr<faststring> buf) {
+  if (buf->capacity() > max_buffer_size_) {
+    return;
+  }
+  buf->clear();
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (free_buffers_.size() < max_buffers_) {
+    free_buffers_.push_back(buf.release());
+  }
+}
+
+} // namespace rpc
+} // namespace kudu
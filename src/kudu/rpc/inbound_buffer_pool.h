@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_RPC_INBOUND_BUFFER_POOL_H
+#define KUDU_RPC_INBOUND_BUFFER_POOL_H
+
+#include <memory>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+namespace rpc {
+
+// A pool of buffers into which inbound RPC frames are received.
+//
+// Each reactor thread owns a pool, from which the InboundTransfers of its
+// connections take the buffers that frames are read into. This saves a
+// malloc/free pair (and the associated page faults for larger frames) for
+// every call and every response.
+//
+// A buffer is handed back to the pool when its transfer is destroyed, which
+// may happen on any thread (e.g. the service thread which responded to the
+// call), so the pool is thread-safe. It is also reference-counted, since
+// transfers may outlive the reactor which created them.
+//
+// Only buffers up to a maximum capacity are retained, so that occasional large
+// frames do not pin large amounts of memory.
+class InboundBufferPool : public RefCountedThreadSafe<InboundBufferPool> {
+ public:
+  // Create a pool which retains up to 'max_buffers' buffers, each with a
+  // capacity of at most 'max_buffer_size' bytes.
+  InboundBufferPool(int max_buffers, int max_buffer_size);
+
+  // Return an empty buffer with a capacity of at least 'size' bytes.
+  std::unique_ptr<faststring> Acquire(int size);
+
+  // Hand a buffer previously returned by Acquire() back to the pool.
+  void Release(std::unique_ptr<faststring> buf);
+
+  // The number of times that Acquire() had to allocate a new buffer.
+  int64_t buffers_allocated() const {
+    return buffers_allocated_.Load();
+  }
+
+  // The number of times that Acquire() reused a pooled buffer.
+  int64_t buffers_reused() const {
+    return buffers_reused_.Load();
+  }
+
+ private:
+  friend class RefCountedThreadSafe<InboundBufferPool>;
+  ~InboundBufferPool();
+
+  const int max_buffers_;
+  const int max_buffer_size_;
+
+  simple_spinlock lock_;
+
+  // Buffers available for reuse, used in LIFO order to keep caches warm.
+  std::vector<faststring*> free_buffers_;
+
+  AtomicInt<int64_t> buffers_allocated_;
+  AtomicInt<int64_t> buffers_reused_;
+
+  DISALLOW_COPY_AND_ASSIGN(InboundBufferPool);
+};
+
+} // namespace rpc
+} // namespace kudu
+
+#endif // KUDU_RPC_INBOUND_BUFFER_POOL_H
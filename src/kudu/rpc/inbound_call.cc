@@ -27,6 +27,7 @@
 #include "kudu/rpc/rpcz_store.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/service_if.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/trace.h"
@@ -42,11 +43,61 @@ using strings::Substitute;
 namespace kudu {
 namespace rpc {
 
+const char* RpcPriorityClassToString(RpcPriorityClass priority_class) {
+  switch (priority_class) {
+    case RPC_PRIORITY_HIGH: return "high";
+    case RPC_PRIORITY_NORMAL: return "normal";
+    case RPC_PRIORITY_LOW: return "low";
+    default: break;
+  }
+  LOG(DFATAL) << "Unknown priority class: " << priority_class;
+  return "unknown";
+}
+
+namespace {
+// Returns the time between 'start' and 'end', or an uninitialized MonoDelta
+// if either is unset.
+MonoDelta PhaseDuration(const MonoTime& start, const MonoTime& end) {
+  if (!start.Initialized() || !end.Initialized()) {
+    return MonoDelta();
+  }
+  return end - start;
+}
+
+void IncrementIfInitialized(const scoped_refptr<Histogram>& hist, const MonoDelta& d) {
+  if (hist && d.Initialized()) {
+    hist->Increment(d.ToMicroseconds());
+  }
+}
+} // anonymous namespace
+
+MonoDelta InboundCallTiming::ReadDuration() const {
+  return PhaseDuration(time_read_started, time_received);
+}
+
+MonoDelta InboundCallTiming::QueueDuration() const {
+  return PhaseDuration(time_received, time_handled);
+}
+
+MonoDelta InboundCallTiming::HandlerDuration() const {
+  return PhaseDuration(time_handled, time_completed);
+}
+
+MonoDelta InboundCallTiming::SerializationDuration() const {
+  return PhaseDuration(time_completed, time_serialized);
+}
+
+MonoDelta InboundCallTiming::WriteDuration() const {
+  return PhaseDuration(time_serialized, time_sent);
+}
+
 InboundCall::InboundCall(Connection* conn)
   : conn_(conn),
     sidecars_deleter_(&sidecars_),
     trace_(new Trace),
-    method_info_(nullptr) {
+    method_info_(nullptr),
+    priority_class_(RPC_PRIORITY_NORMAL),
+    tenant_weight_(1) {
   RecordCallReceived();
 }
 
@@ -55,7 +106,14 @@ InboundCall::~InboundCall() {}
 Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   TRACE_EVENT_FLOW_BEGIN0("rpc", "InboundCall", this);
   TRACE_EVENT0("rpc", "InboundCall::ParseFrom");
+  timing_.time_read_started = transfer->start_time();
   RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &serialized_request_));
+  if (header_.has_body_compression()) {
+    RETURN_NOT_OK(serialization::DecompressMessageBody(
+        header_.body_compression(), header_.uncompressed_body_size(), serialized_request_,
+        &uncompressed_request_));
+    serialized_request_ = Slice(uncompressed_request_);
+  }
 
   // Adopt the service/method info from the header as soon as it's available.
   if (PREDICT_FALSE(!header_.has_remote_method())) {
@@ -99,6 +157,19 @@ void InboundCall::RespondFailure(ErrorStatusPB::RpcErrorCodePB error_code,
   Respond(err, false);
 }
 
+void InboundCall::RespondServerTooBusy(const Status& status,
+                                       const MonoDelta& retry_after) {
+  TRACE_EVENT0("rpc", "InboundCall::RespondServerTooBusy");
+  ErrorStatusPB err;
+  err.set_message(status.ToString());
+  err.set_code(ErrorStatusPB::ERROR_SERVER_TOO_BUSY);
+  if (retry_after.Initialized() && retry_after.ToMilliseconds() > 0) {
+    err.set_retry_after_ms(retry_after.ToMilliseconds());
+  }
+
+  Respond(err, false);
+}
+
 void InboundCall::RespondApplicationError(int error_ext_id, const std::string& message,
                                           const MessageLite& app_error_pb) {
   ErrorStatusPB err;
@@ -123,13 +194,15 @@ void InboundCall::ApplicationErrorToPB(int error_ext_id, const std::string& mess
 void InboundCall::Respond(const MessageLite& response,
                           bool is_success) {
   TRACE_EVENT_FLOW_END0("rpc", "InboundCall", this);
+  RecordHandlingCompleted();
   SerializeResponseBuffer(response, is_success);
+  timing_.time_serialized = MonoTime::Now();
 
   TRACE_EVENT_ASYNC_END1("rpc", "InboundCall", this,
                          "method", remote_method_.method_name());
   TRACE_TO(trace_, "Queueing $0 response", is_success ? "success" : "failure");
-  RecordHandlingCompleted();
-  conn_->rpcz_store()->AddCall(this);
+  // The call is added to the rpcz store once the response has been sent (or
+  // failed to send), so that the samples include the time spent writing it.
   conn_->QueueResponseForCall(gscoped_ptr<InboundCall>(this));
 }
 
@@ -160,6 +233,33 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
   serialization::SerializeMessage(response, &response_msg_buf_,
                                   additional_size, true);
   int main_msg_size = additional_size + response_msg_buf_.size();
+
+  // Compress the response protobuf and its sidecars as one block, if the
+  // client supports it and the result is actually smaller.
+  compressed_response_buf_.clear();
+  const CompressionCodec* codec = conn_->GetBodyCompressionCodec(main_msg_size);
+  if (codec) {
+    int prefix_len = response_msg_buf_.size() - protobuf_msg_size;
+    vector<Slice> body;
+    body.reserve(1 + sidecars_.size());
+    body.emplace_back(response_msg_buf_.data() + prefix_len, protobuf_msg_size);
+    for (RpcSidecar* car : sidecars_) {
+      body.push_back(car->AsSlice());
+    }
+    uint32_t uncompressed_size;
+    Status s = serialization::CompressMessageBody(*codec, body, &compressed_response_buf_,
+                                                  &uncompressed_size);
+    if (s.ok() && compressed_response_buf_.size() < static_cast<size_t>(main_msg_size)) {
+      resp_hdr.set_body_compression(codec->type());
+      resp_hdr.set_uncompressed_body_size(uncompressed_size);
+      main_msg_size = compressed_response_buf_.size();
+    } else {
+      LOG_IF(WARNING, !s.ok()) << "Unable to compress response for " << ToString()
+                               << ": " << s.ToString();
+      compressed_response_buf_.clear();
+    }
+  }
+
   serialization::SerializeHeader(resp_hdr, main_msg_size,
                                  &response_hdr_buf_);
 }
@@ -168,6 +268,11 @@ void InboundCall::SerializeResponseTo(vector<Slice>* slices) const {
   TRACE_EVENT0("rpc", "InboundCall::SerializeResponseTo");
   CHECK_GT(response_hdr_buf_.size(), 0);
   CHECK_GT(response_msg_buf_.size(), 0);
+  if (!compressed_response_buf_.empty()) {
+    slices->push_back(Slice(response_hdr_buf_));
+    slices->push_back(Slice(compressed_response_buf_));
+    return;
+  }
   slices->reserve(slices->size() + 2 + sidecars_.size());
   slices->push_back(Slice(response_hdr_buf_));
   slices->push_back(Slice(response_msg_buf_));
@@ -259,6 +364,22 @@ void InboundCall::RecordHandlingCompleted() {
   }
 }
 
+void InboundCall::RecordResponseSent() {
+  DCHECK(!timing_.time_sent.Initialized());  // Protect against multiple calls.
+  timing_.time_sent = MonoTime::Now();
+
+  // As with the handler latency, calls that were never handled are not
+  // counted.
+  if (!method_info_ || !timing_.time_handled.Initialized()) {
+    return;
+  }
+  IncrementIfInitialized(method_info_->read_latency_histogram, timing_.ReadDuration());
+  IncrementIfInitialized(method_info_->queue_latency_histogram, timing_.QueueDuration());
+  IncrementIfInitialized(method_info_->serialization_latency_histogram,
+                         timing_.SerializationDuration());
+  IncrementIfInitialized(method_info_->write_latency_histogram, timing_.WriteDuration());
+}
+
 bool InboundCall::ClientTimedOut() const {
   if (!header_.has_timeout_millis() || header_.timeout_millis() == 0) {
     return false;
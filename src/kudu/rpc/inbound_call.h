@@ -19,6 +19,7 @@
 
 #include <glog/logging.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
@@ -54,14 +55,40 @@ struct RpcMethodInfo;
 class RpcSidecar;
 class UserCredentials;
 
+// The scheduling class of an inbound call. When the service queue backs up,
+// calls in higher-priority classes are given a larger share of the service
+// threads. See LifoServiceQueue for details.
+enum RpcPriorityClass {
+  RPC_PRIORITY_HIGH = 0,
+  RPC_PRIORITY_NORMAL = 1,
+  RPC_PRIORITY_LOW = 2,
+  RPC_PRIORITY_NUM_CLASSES = 3
+};
+
+const char* RpcPriorityClassToString(RpcPriorityClass priority_class);
+
 struct InboundCallTiming {
-  MonoTime time_received;   // Time the call was first accepted.
-  MonoTime time_handled;    // Time the call handler was kicked off.
-  MonoTime time_completed;  // Time the call handler completed.
+  MonoTime time_read_started;  // Time the first bytes of the call were read.
+  MonoTime time_received;      // Time the call was first accepted.
+  MonoTime time_handled;       // Time the call handler was kicked off.
+  MonoTime time_completed;     // Time the call handler completed.
+  MonoTime time_serialized;    // Time the response was serialized.
+  MonoTime time_sent;          // Time the last byte of the response was written.
 
   MonoDelta TotalDuration() const {
     return time_completed - time_received;
   }
+
+  // The durations of the phases of the call: reading the request off the
+  // socket, waiting in the service queue, running the handler, serializing
+  // the response, and writing it to the socket. A phase which the call never
+  // went through (e.g. a call rejected before being handled) has an
+  // uninitialized duration.
+  MonoDelta ReadDuration() const;
+  MonoDelta QueueDuration() const;
+  MonoDelta HandlerDuration() const;
+  MonoDelta SerializationDuration() const;
+  MonoDelta WriteDuration() const;
 };
 
 // Inbound call on server
@@ -108,6 +135,14 @@ class InboundCall {
   void RespondFailure(ErrorStatusPB::RpcErrorCodePB error_code,
                       const Status &status);
 
+  // Like RespondFailure() with ERROR_SERVER_TOO_BUSY, but also suggests that
+  // the client wait for at least 'retry_after' before retrying the call. If
+  // 'retry_after' is not positive, no suggestion is made.
+  //
+  // This method deletes the InboundCall object, so no further calls may be
+  // made after this one.
+  void RespondServerTooBusy(const Status& status, const MonoDelta& retry_after);
+
   void RespondUnsupportedFeature(const std::vector<uint32_t>& unsupported_features);
 
   void RespondApplicationError(int error_ext_id, const std::string& message,
@@ -159,6 +194,27 @@ class InboundCall {
     return method_info_.get();
   }
 
+  // The scheduling class and tenant of this call. These are assigned by the
+  // ServicePool before the call is put on the service queue, and default to
+  // RPC_PRIORITY_NORMAL with an empty tenant and a weight of 1.
+  RpcPriorityClass priority_class() const {
+    return priority_class_;
+  }
+  const std::string& tenant() const {
+    return tenant_;
+  }
+  int tenant_weight() const {
+    return tenant_weight_;
+  }
+  void set_scheduling_info(RpcPriorityClass priority_class,
+                           std::string tenant,
+                           int tenant_weight) {
+    DCHECK_GT(tenant_weight, 0);
+    priority_class_ = priority_class;
+    tenant_ = std::move(tenant);
+    tenant_weight_ = tenant_weight;
+  }
+
   // When this InboundCall was received (instantiated).
   // Should only be called once on a given instance.
   // Not thread-safe. Should only be called by the current "owner" thread.
@@ -170,6 +226,11 @@ class InboundCall {
   // Not thread-safe. Should only be called by the current "owner" thread.
   void RecordHandlingStarted(scoped_refptr<Histogram> incoming_queue_time);
 
+  // When the last byte of the response was written to the socket. Records
+  // the duration of each phase of the call in the method's histograms.
+  // Should only be called once on a given instance, by the reactor thread.
+  void RecordResponseSent();
+
   // Return true if the deadline set by the client has already elapsed.
   // In this case, the server may stop processing the call, since the
   // call response will be ignored anyway.
@@ -213,9 +274,13 @@ class InboundCall {
   RequestHeader header_;
 
   // The serialized bytes of the request param protobuf. Set by ParseFrom().
-  // This references memory held by 'transfer_'.
+  // This references memory held by 'transfer_', or by 'uncompressed_request_'
+  // if the request was compressed.
   Slice serialized_request_;
 
+  // The decompressed request, if it was sent compressed.
+  faststring uncompressed_request_;
+
   // The transfer that produced the call.
   // This is kept around because it retains the memory referred to
   // by 'serialized_request_' above.
@@ -225,6 +290,10 @@ class InboundCall {
   faststring response_hdr_buf_;
   faststring response_msg_buf_;
 
+  // The compressed response body (main message and sidecars), if the
+  // response is sent compressed. Set by SerializeResponseBuffer().
+  faststring compressed_response_buf_;
+
   // Vector of additional sidecars that are tacked on to the call's response
   // after serialization of the protobuf. See rpc/rpc_sidecar.h for more info.
   std::vector<RpcSidecar*> sidecars_;
@@ -245,6 +314,11 @@ class InboundCall {
   // per-method info such as tracing.
   scoped_refptr<RpcMethodInfo> method_info_;
 
+  // Scheduling information used by the service queue. See set_scheduling_info().
+  RpcPriorityClass priority_class_;
+  std::string tenant_;
+  int tenant_weight_;
+
   DISALLOW_COPY_AND_ASSIGN(InboundCall);
 };
 
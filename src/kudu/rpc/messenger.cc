@@ -28,6 +28,7 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
@@ -36,6 +37,7 @@
 #include "kudu/rpc/acceptor_pool.h"
 #include "kudu/rpc/connection.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/reactor.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_service.h"
@@ -55,8 +57,11 @@
 
 using std::string;
 using std::shared_ptr;
+using std::vector;
 using strings::Substitute;
 
+DECLARE_bool(rpc_reuseport_acceptors);
+
 DEFINE_string(rpc_ssl_server_certificate, "", "Path to the SSL certificate to be used for the RPC "
     "layer.");
 DEFINE_string(rpc_ssl_private_key, "",
@@ -70,10 +75,28 @@ DEFINE_int32(rpc_default_keepalive_time_ms, 65000,
              "If an RPC connection from a client is idle for this amount of time, the server "
              "will disconnect the client.");
 
+DEFINE_int32(rpc_num_connections_per_server, 1,
+             "The number of connections an RPC client opens to each remote server for a "
+             "given user. Outbound calls are spread across the connections, which are in "
+             "turn spread across reactor threads, so that a busy client is not limited to "
+             "a single reactor thread and TCP stream per server.");
+
 TAG_FLAG(rpc_ssl_server_certificate, experimental);
 TAG_FLAG(rpc_ssl_private_key, experimental);
 TAG_FLAG(rpc_ssl_certificate_authority, experimental);
 TAG_FLAG(rpc_default_keepalive_time_ms, advanced);
+TAG_FLAG(rpc_num_connections_per_server, advanced);
+
+static bool ValidateNumConnectionsPerServer(const char* flagname, int32_t value) {
+  if (value < 1) {
+    LOG(ERROR) << "Invalid value for " << flagname << ": " << value
+               << " (must be at least 1)";
+    return false;
+  }
+  return true;
+}
+static bool dummy = google::RegisterFlagValidator(
+    &FLAGS_rpc_num_connections_per_server, &ValidateNumConnectionsPerServer);
 
 DEFINE_bool(server_require_kerberos, false,
             "Whether to force all inbound RPC connections to authenticate "
@@ -83,6 +106,31 @@ DEFINE_bool(server_require_kerberos, false,
 // it's a useful stop-gap.
 TAG_FLAG(server_require_kerberos, experimental);
 
+METRIC_DEFINE_histogram(server, rpc_outbound_queue_time,
+                        "RPC Outbound Queue Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds outbound RPC calls spend between being "
+                        "created and starting to be written to the socket",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, rpc_outbound_send_time,
+                        "RPC Outbound Send Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds spent writing outbound RPC requests "
+                        "to the socket",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, rpc_outbound_wait_time,
+                        "RPC Outbound Wait Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds between an outbound RPC request being "
+                        "sent and the first bytes of its response arriving",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(server, rpc_outbound_response_read_time,
+                        "RPC Outbound Response Read Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds spent reading responses to outbound "
+                        "RPC requests off the socket",
+                        60000000LU, 2);
+
 namespace kudu {
 namespace rpc {
 
@@ -96,6 +144,7 @@ MessengerBuilder::MessengerBuilder(std::string name)
       num_reactors_(4),
       min_negotiation_threads_(0),
       max_negotiation_threads_(4),
+      num_connections_per_server_(FLAGS_rpc_num_connections_per_server),
       coarse_timer_granularity_(MonoDelta::FromMilliseconds(100)) {}
 
 MessengerBuilder& MessengerBuilder::set_connection_keepalive_time(const MonoDelta &keepalive) {
@@ -118,6 +167,12 @@ MessengerBuilder& MessengerBuilder::set_max_negotiation_threads(int max_negotiat
   return *this;
 }
 
+MessengerBuilder& MessengerBuilder::set_num_connections_per_server(int num_connections) {
+  CHECK_GE(num_connections, 1);
+  num_connections_per_server_ = num_connections;
+  return *this;
+}
+
 MessengerBuilder& MessengerBuilder::set_coarse_timer_granularity(const MonoDelta &granularity) {
   coarse_timer_granularity_ = granularity;
   return *this;
@@ -196,13 +251,25 @@ Status Messenger::AddAcceptorPool(const Sockaddr &accept_addr,
                           "GSSAPI/Kerberos not properly configured");
   }
 
+  bool reuse_port = false;
+#if defined(__linux__)
+  reuse_port = FLAGS_rpc_reuseport_acceptors;
+#else
+  LOG_IF(WARNING, FLAGS_rpc_reuseport_acceptors)
+      << "--rpc_reuseport_acceptors is only supported on Linux; "
+      << "accepting connections with acceptor threads instead";
+#endif
+
   Socket sock;
   RETURN_NOT_OK(sock.Init(0));
   RETURN_NOT_OK(sock.SetReuseAddr(true));
+  if (reuse_port) {
+    RETURN_NOT_OK(sock.SetReusePort(true));
+  }
   RETURN_NOT_OK(sock.Bind(accept_addr));
   Sockaddr remote;
   RETURN_NOT_OK(sock.GetSocketAddress(&remote));
-  shared_ptr<AcceptorPool> acceptor_pool(new AcceptorPool(this, &sock, remote));
+  shared_ptr<AcceptorPool> acceptor_pool(new AcceptorPool(this, &sock, remote, reuse_port));
 
   std::lock_guard<percpu_rwlock> guard(lock_);
   acceptor_pools_.push_back(acceptor_pool);
@@ -240,7 +307,7 @@ Status Messenger::UnregisterService(const string& service_name) {
 }
 
 void Messenger::QueueOutboundCall(const shared_ptr<OutboundCall> &call) {
-  Reactor *reactor = RemoteToReactor(call->conn_id().remote());
+  Reactor *reactor = RemoteToReactor(call->conn_id().remote(), call->conn_id().idx());
   reactor->QueueOutboundCall(call);
 }
 
@@ -270,9 +337,17 @@ void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote
 Messenger::Messenger(const MessengerBuilder &bld)
   : name_(bld.name_),
     closing_(false),
+    num_connections_per_server_(bld.num_connections_per_server_),
     rpcz_store_(new RpczStore()),
     metric_entity_(bld.metric_entity_),
     retain_self_(this) {
+  if (metric_entity_) {
+    outbound_queue_time_ = METRIC_rpc_outbound_queue_time.Instantiate(metric_entity_);
+    outbound_send_time_ = METRIC_rpc_outbound_send_time.Instantiate(metric_entity_);
+    outbound_wait_time_ = METRIC_rpc_outbound_wait_time.Instantiate(metric_entity_);
+    outbound_response_read_time_ =
+        METRIC_rpc_outbound_response_read_time.Instantiate(metric_entity_);
+  }
   for (int i = 0; i < bld.num_reactors_; i++) {
     reactors_.push_back(new Reactor(retain_self_, i, bld));
   }
@@ -288,9 +363,30 @@ Messenger::~Messenger() {
   STLDeleteElements(&reactors_);
 }
 
-Reactor* Messenger::RemoteToReactor(const Sockaddr &remote) {
+void Messenger::RecordOutboundCallTiming(const OutboundCallTiming& timing) {
+  if (!metric_entity_) {
+    return;
+  }
+  const struct {
+    Histogram* hist;
+    MonoDelta duration;
+  } phases[] = {
+    { outbound_queue_time_.get(), timing.QueueDuration() },
+    { outbound_send_time_.get(), timing.SendDuration() },
+    { outbound_wait_time_.get(), timing.WaitDuration() },
+    { outbound_response_read_time_.get(), timing.ResponseReadDuration() },
+  };
+  for (const auto& p : phases) {
+    if (p.duration.Initialized()) {
+      p.hist->Increment(p.duration.ToMicroseconds());
+    }
+  }
+}
+
+Reactor* Messenger::RemoteToReactor(const Sockaddr &remote, uint32_t conn_idx) {
   uint32_t hashCode = remote.HashCode();
-  int reactor_idx = hashCode % reactors_.size();
+  // Consecutive connections to the same remote land on consecutive reactors.
+  int reactor_idx = (hashCode + conn_idx) % reactors_.size();
   // This is just a static partitioning; we could get a lot
   // fancier with assigning Sockaddrs to Reactors.
   return reactors_[reactor_idx];
@@ -326,6 +422,34 @@ Status Messenger::DumpRunningRpcs(const DumpRunningRpcsRequestPB& req,
   return Status::OK();
 }
 
+Status Messenger::GetReactorMetrics(ReactorMetrics* metrics) {
+  vector<ReactorMetrics> per_reactor;
+  RETURN_NOT_OK(GetPerReactorMetrics(&per_reactor));
+  *metrics = ReactorMetrics();
+  for (const ReactorMetrics& reactor_metrics : per_reactor) {
+    metrics->num_client_connections_ += reactor_metrics.num_client_connections_;
+    metrics->num_server_connections_ += reactor_metrics.num_server_connections_;
+    metrics->num_inbound_buffers_allocated_ += reactor_metrics.num_inbound_buffers_allocated_;
+    metrics->num_inbound_buffers_reused_ += reactor_metrics.num_inbound_buffers_reused_;
+    metrics->num_kernel_tls_connections_ += reactor_metrics.num_kernel_tls_connections_;
+    metrics->num_connections_accepted_ += reactor_metrics.num_connections_accepted_;
+    metrics->num_reactor_negotiations_ += reactor_metrics.num_reactor_negotiations_;
+    metrics->num_compressed_bodies_received_ += reactor_metrics.num_compressed_bodies_received_;
+  }
+  return Status::OK();
+}
+
+Status Messenger::GetPerReactorMetrics(vector<ReactorMetrics>* metrics) {
+  metrics->clear();
+  shared_lock<rw_spinlock> guard(lock_.get_lock());
+  for (Reactor* reactor : reactors_) {
+    ReactorMetrics reactor_metrics;
+    RETURN_NOT_OK(reactor->GetMetrics(&reactor_metrics));
+    metrics->push_back(reactor_metrics);
+  }
+  return Status::OK();
+}
+
 void Messenger::ScheduleOnReactor(const boost::function<void(const Status&)>& func,
                                   MonoDelta when) {
   DCHECK(!reactors_.empty());
@@ -53,8 +53,10 @@ class DumpRunningRpcsResponsePB;
 class InboundCall;
 class Messenger;
 class OutboundCall;
+struct OutboundCallTiming;
 class Reactor;
 class ReactorThread;
+struct ReactorMetrics;
 class RpcService;
 class RpczStore;
 
@@ -94,6 +96,10 @@ class MessengerBuilder {
   // to handle the blocking connection-negotiation step.
   MessengerBuilder &set_max_negotiation_threads(int max_negotiation_threads);
 
+  // Set the number of connections opened to each remote server (for a given
+  // set of user credentials). Defaults to --rpc_num_connections_per_server.
+  MessengerBuilder &set_num_connections_per_server(int num_connections);
+
   // Set the granularity with which connections are checked for keepalive.
   MessengerBuilder &set_coarse_timer_granularity(const MonoDelta &granularity);
 
@@ -108,6 +114,7 @@ class MessengerBuilder {
   int num_reactors_;
   int min_negotiation_threads_;
   int max_negotiation_threads_;
+  int num_connections_per_server_;
   MonoDelta coarse_timer_granularity_;
   scoped_refptr<MetricEntity> metric_entity_;
 };
@@ -124,6 +131,7 @@ class MessengerBuilder {
 // See rpc-test.cc and rpc-bench.cc for example usages.
 class Messenger {
  public:
+  friend class AcceptorPool;
   friend class MessengerBuilder;
   friend class Proxy;
   friend class Reactor;
@@ -178,6 +186,12 @@ class Messenger {
   Status DumpRunningRpcs(const DumpRunningRpcsRequestPB& req,
                          DumpRunningRpcsResponsePB* resp);
 
+  // Collect the metrics of all reactors, summed together.
+  Status GetReactorMetrics(ReactorMetrics* metrics);
+
+  // Collect the metrics of each reactor, in reactor order.
+  Status GetPerReactorMetrics(std::vector<ReactorMetrics>* metrics);
+
   // Run 'func' on a reactor thread after 'when' time elapses.
   //
   // The status argument conveys whether 'func' was run correctly (i.e.
@@ -193,6 +207,8 @@ class Messenger {
 
   int num_reactors() const { return reactors_.size(); }
 
+  int num_connections_per_server() const { return num_connections_per_server_; }
+
   std::string name() const {
     return name_;
   }
@@ -206,14 +222,20 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity() const { return metric_entity_.get(); }
 
+  // Record the phase latencies of a completed outbound call into the
+  // messenger's metrics. A no-op if the messenger has no metric entity.
+  void RecordOutboundCallTiming(const OutboundCallTiming& timing);
+
   const scoped_refptr<RpcService> rpc_service(const std::string& service_name) const;
 
  private:
   FRIEND_TEST(TestRpc, TestConnectionKeepalive);
+  FRIEND_TEST(TestRpc, TestMultipleConnectionsPerServer);
 
   explicit Messenger(const MessengerBuilder &bld);
 
-  Reactor* RemoteToReactor(const Sockaddr &remote);
+  // Return the reactor responsible for the 'conn_idx'-th connection to 'remote'.
+  Reactor* RemoteToReactor(const Sockaddr &remote, uint32_t conn_idx = 0);
   Status Init();
   void RunTimeoutThread();
   void UpdateCurTime();
@@ -231,6 +253,8 @@ class Messenger {
 
   bool server_tls_enabled_;
 
+  const int num_connections_per_server_;
+
   // Pools which are listening on behalf of this messenger.
   // Note that the user may have called Shutdown() on one of these
   // pools, so even though we retain the reference, it may no longer
@@ -250,6 +274,12 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity_;
 
+  // Outbound call phase histograms. Null if metric_entity_ is not set.
+  scoped_refptr<Histogram> outbound_queue_time_;
+  scoped_refptr<Histogram> outbound_send_time_;
+  scoped_refptr<Histogram> outbound_wait_time_;
+  scoped_refptr<Histogram> outbound_response_read_time_;
+
   // The ownership of the Messenger object is somewhat subtle. The pointer graph
   // looks like this:
   //
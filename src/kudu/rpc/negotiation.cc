@@ -21,6 +21,7 @@
 #include <poll.h>
 
 #include <string>
+#include <utility>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -169,6 +170,28 @@ static Status DoClientNegotiation(Connection* conn, MonoTime deadline) {
   return Status::OK();
 }
 
+// Configure a server negotiation for 'conn' from the messenger's settings.
+static Status ConfigureServerNegotiation(Connection* conn, const MonoTime& deadline,
+                                         ServerNegotiation* server_negotiation) {
+  if (FLAGS_server_require_kerberos) {
+    RETURN_NOT_OK(server_negotiation->EnableGSSAPI());
+  } else {
+    RETURN_NOT_OK(server_negotiation->EnablePlain());
+  }
+  if (conn->reactor_thread()->reactor()->messenger()->server_tls_enabled()) {
+    server_negotiation->EnableTls(&conn->reactor_thread()->reactor()->messenger()->tls_context());
+  }
+  server_negotiation->set_deadline(deadline);
+  return Status::OK();
+}
+
+// Transfer the negotiated socket and state back to the connection.
+static void AdoptServerNegotiation(Connection* conn, ServerNegotiation* server_negotiation) {
+  conn->adopt_socket(server_negotiation->release_socket());
+  conn->set_remote_features(server_negotiation->take_client_features());
+  conn->mutable_user_credentials()->set_real_user(server_negotiation->authenticated_user());
+}
+
 // Perform server negotiation. We don't LOG() anything, we leave that to our caller.
 static Status DoServerNegotiation(Connection* conn, const MonoTime& deadline) {
   if (FLAGS_rpc_negotiation_inject_delay_ms > 0) {
@@ -179,38 +202,18 @@ static Status DoServerNegotiation(Connection* conn, const MonoTime& deadline) {
 
   // Create a new ServerNegotiation to handle the synchronous negotiation.
   ServerNegotiation server_negotiation(conn->release_socket());
-  if (FLAGS_server_require_kerberos) {
-    RETURN_NOT_OK(server_negotiation.EnableGSSAPI());
-  } else {
-    RETURN_NOT_OK(server_negotiation.EnablePlain());
-  }
-  if (conn->reactor_thread()->reactor()->messenger()->server_tls_enabled()) {
-    server_negotiation.EnableTls(&conn->reactor_thread()->reactor()->messenger()->tls_context());
-  }
-  server_negotiation.set_deadline(deadline);
-
-  RETURN_NOT_OK(server_negotiation.socket()->SetNonBlocking(false));
-
+  RETURN_NOT_OK(ConfigureServerNegotiation(conn, deadline, &server_negotiation));
 
   RETURN_NOT_OK(server_negotiation.Negotiate());
   RETURN_NOT_OK(DisableSocketTimeouts(server_negotiation.socket()));
 
-  // Transfer the negotiated socket and state back to the connection.
-  conn->adopt_socket(server_negotiation.release_socket());
-  conn->set_remote_features(server_negotiation.take_client_features());
-  conn->mutable_user_credentials()->set_real_user(server_negotiation.authenticated_user());
-
+  AdoptServerNegotiation(conn, &server_negotiation);
   return Status::OK();
 }
 
-void Negotiation::RunNegotiation(const scoped_refptr<Connection>& conn, MonoTime deadline) {
-  Status s;
-  if (conn->direction() == Connection::SERVER) {
-    s = DoServerNegotiation(conn.get(), deadline);
-  } else {
-    s = DoClientNegotiation(conn.get(), deadline);
-  }
-
+// Log the outcome of negotiating 'conn', and return the status to complete
+// the connection with.
+static Status FinishNegotiation(Connection* conn, Status s) {
   if (PREDICT_FALSE(!s.ok())) {
     string msg = Substitute("$0 connection negotiation failed: $1",
                             conn->direction() == Connection::SERVER ? "Server" : "Client",
@@ -235,9 +238,95 @@ void Negotiation::RunNegotiation(const scoped_refptr<Connection>& conn, MonoTime
   if (conn->direction() == Connection::SERVER && s.IsNotAuthorized()) {
     LOG(WARNING) << "Unauthorized connection attempt: " << s.message().ToString();
   }
-  conn->CompleteNegotiation(s);
+  return s;
 }
 
+void Negotiation::RunNegotiation(const scoped_refptr<Connection>& conn, MonoTime deadline) {
+  Status s;
+  if (conn->direction() == Connection::SERVER) {
+    s = DoServerNegotiation(conn.get(), deadline);
+  } else {
+    s = DoClientNegotiation(conn.get(), deadline);
+  }
+  conn->CompleteNegotiation(FinishNegotiation(conn.get(), std::move(s)));
+}
+
+bool Negotiation::CanNegotiateOnReactor() {
+  return !FLAGS_server_require_kerberos && FLAGS_rpc_negotiation_inject_delay_ms <= 0;
+}
+
+ReactorNegotiation::ReactorNegotiation(scoped_refptr<Connection> conn, MonoTime deadline)
+    : conn_(std::move(conn)),
+      deadline_(deadline),
+      trace_(new Trace()) {
+}
+
+ReactorNegotiation::~ReactorNegotiation() {
+  io_.stop();
+}
+
+void ReactorNegotiation::Start(ev::loop_ref loop) {
+  DCHECK(conn_->reactor_thread()->IsCurrentThread());
+  ADOPT_TRACE(trace_.get());
+  TRACE("Negotiating $0 on the reactor", conn_->ToString());
+  negotiation_.reset(new ServerNegotiation(conn_->release_socket()));
+  Status s = ConfigureServerNegotiation(conn_.get(), deadline_, negotiation_.get());
+  if (PREDICT_FALSE(!s.ok())) {
+    Finish(std::move(s)); // Will delete 'this'.
+    return;
+  }
+  io_.set(loop);
+  io_.set<ReactorNegotiation, &ReactorNegotiation::IoHandler>(this);
+  Continue();
+}
+
+void ReactorNegotiation::Abort(const Status& status) {
+  DCHECK(conn_->reactor_thread()->IsCurrentThread());
+  Finish(status); // Will delete 'this'.
+}
+
+void ReactorNegotiation::IoHandler(ev::io& /*watcher*/, int revents) {
+  if (PREDICT_FALSE(revents & EV_ERROR)) {
+    Finish(Status::NetworkError("negotiation socket error")); // Will delete 'this'.
+    return;
+  }
+  Continue();
+}
+
+void ReactorNegotiation::Continue() {
+  Status s;
+  {
+    ADOPT_TRACE(trace_.get());
+    s = negotiation_->ContinueNegotiation();
+  }
+  if (!s.IsIncomplete()) {
+    Finish(std::move(s)); // Will delete 'this'.
+    return;
+  }
+
+  // Wait for whichever direction negotiation is blocked on. A watcher's
+  // events can only be changed while it is stopped.
+  int events = negotiation_->wants_write() ? ev::WRITE : ev::READ;
+  if (!io_.is_active() || io_.events != events) {
+    io_.stop();
+    io_.set(negotiation_->socket()->GetFd(), events);
+    io_.start();
+  }
+}
+
+void ReactorNegotiation::Finish(Status status) {
+  io_.stop();
+  if (status.ok()) {
+    AdoptServerNegotiation(conn_.get(), negotiation_.get());
+  } else if (negotiation_ && negotiation_->socket()) {
+    // Give the socket back so the connection closes it when it's destroyed.
+    conn_->adopt_socket(negotiation_->release_socket());
+  }
+
+  ADOPT_TRACE(trace_.get());
+  status = FinishNegotiation(conn_.get(), std::move(status));
+  conn_->reactor_thread()->CompleteReactorNegotiation(this, status);
+}
 
 } // namespace rpc
 } // namespace kudu
@@ -17,24 +17,85 @@
 #ifndef KUDU_RPC_NEGOTIATION_H
 #define KUDU_RPC_NEGOTIATION_H
 
+#include <memory>
+
+#include <ev++.h>
+
+#include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
+class Trace;
+
 namespace rpc {
 
 class Connection;
+class ServerNegotiation;
 
 class Negotiation {
  public:
 
   // Perform negotiation for a connection (either server or client)
   static void RunNegotiation(const scoped_refptr<Connection>& conn, MonoTime deadline);
+
+  // Whether inbound connections can be negotiated on their reactor thread
+  // with a ReactorNegotiation. Kerberos authentication may block on the
+  // keytab and the replay cache, so it is always done on the negotiation
+  // pool instead, as are negotiations with an injected delay.
+  static bool CanNegotiateOnReactor();
+
  private:
   DISALLOW_IMPLICIT_CONSTRUCTORS(Negotiation);
 };
 
+// Negotiates an inbound connection on its reactor thread without blocking.
+// The reactor watches the connection's socket, and resumes negotiation
+// whenever the client has sent more or there is room to send, so a reactor
+// negotiates any number of connections at once rather than tying up a
+// negotiation pool thread for each while it waits on the network.
+//
+// All methods must be called on the connection's reactor thread.
+class ReactorNegotiation {
+ public:
+  ReactorNegotiation(scoped_refptr<Connection> conn, MonoTime deadline);
+  ~ReactorNegotiation();
+
+  // Start negotiating, watching the socket on 'loop'. When negotiation
+  // finishes, the result is handed to the connection's reactor thread with
+  // ReactorThread::CompleteReactorNegotiation(), which destroys this object.
+  // That may happen before Start() returns.
+  void Start(ev::loop_ref loop);
+
+  // Fail negotiation with 'status', for example because the deadline has
+  // passed. Destroys this object, as above.
+  void Abort(const Status& status);
+
+  Connection* conn() const { return conn_.get(); }
+  MonoTime deadline() const { return deadline_; }
+
+ private:
+  // libev callback for when the socket is ready.
+  void IoHandler(ev::io& watcher, int revents);
+
+  // Make as much progress as the socket allows, then either wait for the
+  // socket again or finish.
+  void Continue();
+
+  // Hand the negotiated socket, or the failure, back to the connection.
+  void Finish(Status status);
+
+  const scoped_refptr<Connection> conn_;
+  const MonoTime deadline_;
+  std::unique_ptr<ServerNegotiation> negotiation_;
+  scoped_refptr<Trace> trace_;
+  ev::io io_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReactorNegotiation);
+};
+
 } // namespace rpc
 } // namespace kudu
 #endif // KUDU_RPC_NEGOTIATION_H
@@ -31,6 +31,7 @@
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/kernel_stack_watchdog.h"
 
@@ -52,6 +53,33 @@ using strings::Substitute;
 
 static const double kMicrosPerSecond = 1000000.0;
 
+///
+/// OutboundCallTiming
+///
+
+static MonoDelta PhaseDuration(const MonoTime& start, const MonoTime& end) {
+  if (!start.Initialized() || !end.Initialized()) {
+    return MonoDelta();
+  }
+  return end - start;
+}
+
+MonoDelta OutboundCallTiming::QueueDuration() const {
+  return PhaseDuration(time_created, time_send_started);
+}
+
+MonoDelta OutboundCallTiming::SendDuration() const {
+  return PhaseDuration(time_send_started, time_sent);
+}
+
+MonoDelta OutboundCallTiming::WaitDuration() const {
+  return PhaseDuration(time_sent, time_response_started);
+}
+
+MonoDelta OutboundCallTiming::ResponseReadDuration() const {
+  return PhaseDuration(time_response_started, time_response_received);
+}
+
 ///
 /// OutboundCall
 ///
@@ -71,7 +99,7 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
            << (controller->timeout().Initialized() ? controller->timeout().ToString() : "none");
   header_.set_call_id(kInvalidCallId);
   remote_method.ToPB(header_.mutable_remote_method());
-  start_time_ = MonoTime::Now();
+  timing_.time_created = MonoTime::Now();
 
   if (!controller_->required_server_features().empty()) {
     required_rpc_features_.insert(RpcFeatureFlag::APPLICATION_FEATURE_FLAGS);
@@ -87,7 +115,7 @@ OutboundCall::~OutboundCall() {
   DVLOG(4) << "OutboundCall " << this << " destroyed with state_: " << StateName(state_);
 }
 
-Status OutboundCall::SerializeTo(vector<Slice>* slices) {
+Status OutboundCall::SerializeTo(const CompressionCodec* codec, vector<Slice>* slices) {
   size_t param_len = request_buf_.size();
   if (PREDICT_FALSE(param_len == 0)) {
     return Status::InvalidArgument("Must call SetRequestParam() before SerializeTo()");
@@ -102,16 +130,32 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
     header_.add_required_feature_flags(feature);
   }
 
-  serialization::SerializeHeader(header_, param_len, &header_buf_);
+  Slice body(request_buf_);
+  if (codec) {
+    // Compress the request protobuf, leaving out its length prefix.
+    int prefix_len = param_len - request_pb_size_;
+    uint32_t uncompressed_size;
+    RETURN_NOT_OK(serialization::CompressMessageBody(
+        *codec, { Slice(request_buf_.data() + prefix_len, request_pb_size_) },
+        &compressed_request_buf_, &uncompressed_size));
+    if (compressed_request_buf_.size() < param_len) {
+      header_.set_body_compression(codec->type());
+      header_.set_uncompressed_body_size(uncompressed_size);
+      body = Slice(compressed_request_buf_);
+    }
+  }
+
+  serialization::SerializeHeader(header_, body.size(), &header_buf_);
 
   // Return the concatenated packet.
   slices->push_back(Slice(header_buf_));
-  slices->push_back(Slice(request_buf_));
+  slices->push_back(body);
   return Status::OK();
 }
 
 void OutboundCall::SetRequestParam(const Message& message) {
   serialization::SerializeMessage(message, &request_buf_);
+  request_pb_size_ = message.GetCachedSize();
 }
 
 Status OutboundCall::status() const {
@@ -208,6 +252,17 @@ void OutboundCall::CallCallback() {
   }
 }
 
+void OutboundCall::RecordResponseReceived(const MonoTime& read_started) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  timing_.time_response_started = read_started;
+  timing_.time_response_received = MonoTime::Now();
+}
+
+OutboundCallTiming OutboundCall::timing() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return timing_;
+}
+
 void OutboundCall::SetResponse(gscoped_ptr<CallResponse> resp) {
   call_response_ = std::move(resp);
   Slice r(call_response_->serialized_response());
@@ -241,11 +296,17 @@ void OutboundCall::SetQueued() {
 }
 
 void OutboundCall::SetSending() {
-  set_state(SENDING);
+  std::lock_guard<simple_spinlock> l(lock_);
+  timing_.time_send_started = MonoTime::Now();
+  set_state_unlocked(SENDING);
 }
 
 void OutboundCall::SetSent() {
-  set_state(SENT);
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    timing_.time_sent = MonoTime::Now();
+    set_state_unlocked(SENT);
+  }
 
   // This method is called in the reactor thread, so free the header buf,
   // which was also allocated from this thread. tcmalloc's thread caching
@@ -324,7 +385,7 @@ void OutboundCall::DumpPB(const DumpRunningRpcsRequestPB& req,
   std::lock_guard<simple_spinlock> l(lock_);
   resp->mutable_header()->CopyFrom(header_);
   resp->set_micros_elapsed(
-      (MonoTime::Now() - start_time_).ToMicroseconds());
+      (MonoTime::Now() - timing_.time_created).ToMicroseconds());
 
   switch (state_) {
     case READY:
@@ -392,13 +453,14 @@ bool UserCredentials::Equals(const UserCredentials& other) const {
 /// ConnectionId
 ///
 
-ConnectionId::ConnectionId() {}
+ConnectionId::ConnectionId() : idx_(0) {}
 
 ConnectionId::ConnectionId(const ConnectionId& other) {
   DoCopyFrom(other);
 }
 
-ConnectionId::ConnectionId(const Sockaddr& remote, const UserCredentials& user_credentials) {
+ConnectionId::ConnectionId(const Sockaddr& remote, const UserCredentials& user_credentials)
+    : idx_(0) {
   remote_ = remote;
   user_credentials_.CopyFrom(user_credentials);
 }
@@ -417,26 +479,30 @@ void ConnectionId::CopyFrom(const ConnectionId& other) {
 
 string ConnectionId::ToString() const {
   // Does not print the password.
-  return StringPrintf("{remote=%s, user_credentials=%s}",
+  return StringPrintf("{remote=%s, user_credentials=%s, idx=%d}",
       remote_.ToString().c_str(),
-      user_credentials_.ToString().c_str());
+      user_credentials_.ToString().c_str(),
+      idx_);
 }
 
 void ConnectionId::DoCopyFrom(const ConnectionId& other) {
   remote_ = other.remote_;
   user_credentials_.CopyFrom(other.user_credentials_);
+  idx_ = other.idx_;
 }
 
 size_t ConnectionId::HashCode() const {
   size_t seed = 0;
   boost::hash_combine(seed, remote_.HashCode());
   boost::hash_combine(seed, user_credentials_.HashCode());
+  boost::hash_combine(seed, idx_);
   return seed;
 }
 
 bool ConnectionId::Equals(const ConnectionId& other) const {
   return (remote() == other.remote()
-       && user_credentials().Equals(other.user_credentials()));
+       && user_credentials().Equals(other.user_credentials())
+       && idx() == other.idx());
 }
 
 size_t ConnectionIdHash::operator() (const ConnectionId& conn_id) const {
@@ -470,6 +536,12 @@ Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   Slice entire_message;
   RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_,
                                             &entire_message));
+  if (header_.has_body_compression()) {
+    RETURN_NOT_OK(serialization::DecompressMessageBody(
+        header_.body_compression(), header_.uncompressed_body_size(), entire_message,
+        &uncompressed_body_));
+    entire_message = Slice(uncompressed_body_);
+  }
 
   // Use information from header to extract the payload slices.
   int last = header_.sidecar_offsets_size() - 1;
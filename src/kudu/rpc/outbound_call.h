@@ -30,6 +30,7 @@
 #include "kudu/rpc/remote_method.h"
 #include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
@@ -43,6 +44,9 @@ class Message;
 } // namespace google
 
 namespace kudu {
+
+class CompressionCodec;
+
 namespace rpc {
 
 class CallResponse;
@@ -52,6 +56,23 @@ class InboundTransfer;
 class RpcCallInProgressPB;
 class RpcController;
 
+// Timestamps of the phases an outbound call goes through. Any of these may
+// be uninitialized if the call did not (yet) reach the corresponding phase.
+struct OutboundCallTiming {
+  MonoTime time_created;           // Time the call was first initiated.
+  MonoTime time_send_started;      // Time the first bytes were written to the socket.
+  MonoTime time_sent;              // Time the request was fully written.
+  MonoTime time_response_started;  // Time the first bytes of the response arrived.
+  MonoTime time_response_received; // Time the response was fully read.
+
+  // Durations of the individual phases. Uninitialized if either end of the
+  // phase has not been recorded.
+  MonoDelta QueueDuration() const;
+  MonoDelta SendDuration() const;
+  MonoDelta WaitDuration() const;
+  MonoDelta ResponseReadDuration() const;
+};
+
 // Client-side user credentials, such as a user's username & password.
 // In the future, we will add Kerberos credentials.
 //
@@ -104,6 +125,11 @@ class ConnectionId {
   const UserCredentials& user_credentials() const { return user_credentials_; }
   UserCredentials* mutable_user_credentials() { return &user_credentials_; }
 
+  // Which of the connections to the same remote, with the same credentials,
+  // this refers to. See MessengerBuilder::set_num_connections_per_server().
+  void set_idx(int idx) { idx_ = idx; }
+  int idx() const { return idx_; }
+
   // Copy state from another object to this one.
   void CopyFrom(const ConnectionId& other);
 
@@ -117,6 +143,7 @@ class ConnectionId {
   // Remember to update HashCode() and Equals() when new fields are added.
   Sockaddr remote_;
   UserCredentials user_credentials_;
+  int idx_;
 
   // Implementation of CopyFrom that can be shared with copy constructor.
   void DoCopyFrom(const ConnectionId& other);
@@ -167,7 +194,14 @@ class OutboundCall {
 
   // Serialize the call for the wire. Requires that SetRequestParam()
   // is called first. This is called from the Reactor thread.
-  Status SerializeTo(std::vector<Slice>* slices);
+  //
+  // If 'codec' is not null, the request body is compressed with it, unless
+  // that would not make it any smaller.
+  Status SerializeTo(const CompressionCodec* codec, std::vector<Slice>* slices);
+
+  // The size of the serialized request body. Requires that SetRequestParam()
+  // is called first.
+  size_t request_size() const { return request_buf_.size(); }
 
   // Callback after the call has been put on the outbound connection queue.
   void SetQueued();
@@ -197,6 +231,14 @@ class OutboundCall {
   // Fill in the call response.
   void SetResponse(gscoped_ptr<CallResponse> resp);
 
+  // Record that the response to this call has been read from the socket,
+  // having started arriving at 'read_started'. Called from the reactor
+  // thread, before SetResponse().
+  void RecordResponseReceived(const MonoTime& read_started);
+
+  // Return a copy of the phase timestamps recorded so far.
+  OutboundCallTiming timing() const;
+
   const std::set<RpcFeatureFlag>& required_rpc_features() const {
     return required_rpc_features_;
   }
@@ -253,8 +295,8 @@ class OutboundCall {
   // return current status
   Status status() const;
 
-  // Time when the call was first initiatied.
-  MonoTime start_time_;
+  // Phase timestamps. Protected by lock_.
+  OutboundCallTiming timing_;
 
   // Return the error protobuf, if a remote error occurred.
   // This will only be non-NULL if status().IsRemoteError().
@@ -293,6 +335,13 @@ class OutboundCall {
   faststring header_buf_;
   faststring request_buf_;
 
+  // The size of the request protobuf within request_buf_, which also holds
+  // its length prefix.
+  int request_pb_size_ = 0;
+
+  // The compressed request body, if compression was used.
+  faststring compressed_request_buf_;
+
   // Once a response has been received for this call, contains that response.
   // Otherwise NULL.
   gscoped_ptr<CallResponse> call_response_;
@@ -328,6 +377,12 @@ class CallResponse {
     return header_.call_id();
   }
 
+  // Return true if the response body arrived compressed.
+  bool body_compressed() const {
+    DCHECK(parsed_);
+    return header_.has_body_compression();
+  }
+
   // Return the serialized response data. This is just the response "body" --
   // either a serialized ErrorStatusPB, or the serialized user response protobuf.
   const Slice &serialized_response() const {
@@ -335,6 +390,12 @@ class CallResponse {
     return serialized_response_;
   }
 
+  // Return the time the first bytes of this response arrived on the socket.
+  MonoTime receive_start_time() const {
+    DCHECK(parsed_);
+    return transfer_->start_time();
+  }
+
   // See RpcController::GetSidecar()
   Status GetSidecar(int idx, Slice* sidecar) const;
 
@@ -356,6 +417,10 @@ class CallResponse {
   // and sidecar_slices_ refer into its data.
   gscoped_ptr<InboundTransfer> transfer_;
 
+  // If the response body was compressed, the decompressed body, which
+  // serialized_response_ and sidecar_slices_ refer into instead.
+  faststring uncompressed_body_;
+
   DISALLOW_COPY_AND_ASSIGN(CallResponse);
 };
 
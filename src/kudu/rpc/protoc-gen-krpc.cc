@@ -467,6 +467,27 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
           "  kudu::MetricUnit::kMicroseconds,\n"
           "  \"Microseconds spent handling $rpc_full_name$() RPC requests\",\n"
           "  60000000LU, 2);\n"
+          "METRIC_DEFINE_histogram(server, read_latency_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC Read Time\",\n"
+          "  kudu::MetricUnit::kMicroseconds,\n"
+          "  \"Microseconds spent reading $rpc_full_name$() RPC requests off the socket\",\n"
+          "  60000000LU, 2);\n"
+          "METRIC_DEFINE_histogram(server, queue_latency_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC Queue Time\",\n"
+          "  kudu::MetricUnit::kMicroseconds,\n"
+          "  \"Microseconds $rpc_full_name$() RPC requests spent in the service queue\",\n"
+          "  60000000LU, 2);\n"
+          "METRIC_DEFINE_histogram(server, serialization_latency_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC Response Serialization Time\",\n"
+          "  kudu::MetricUnit::kMicroseconds,\n"
+          "  \"Microseconds spent serializing responses to $rpc_full_name$() RPC requests\",\n"
+          "  60000000LU, 2);\n"
+          "METRIC_DEFINE_histogram(server, write_latency_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC Write Time\",\n"
+          "  kudu::MetricUnit::kMicroseconds,\n"
+          "  \"Microseconds spent writing responses to $rpc_full_name$() RPC requests to the \"\n"
+          "  \"socket, including time waiting behind other responses\",\n"
+          "  60000000LU, 2);\n"
           "\n");
         subs->Pop();
       }
@@ -514,6 +535,14 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
               "    mi->track_result = $track_result$;\n"
               "    mi->handler_latency_histogram =\n"
               "        METRIC_handler_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->read_latency_histogram =\n"
+              "        METRIC_read_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->queue_latency_histogram =\n"
+              "        METRIC_queue_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->serialization_latency_histogram =\n"
+              "        METRIC_serialization_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->write_latency_histogram =\n"
+              "        METRIC_write_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
               "    mi->func = [this](const Message* req, Message* resp, RpcContext* ctx) {\n"
               "      this->$rpc_name$(static_cast<const $request$*>(req),\n"
               "                       static_cast<$response$*>(resp),\n"
@@ -51,7 +51,8 @@ Proxy::Proxy(const std::shared_ptr<Messenger>& messenger,
              const Sockaddr& remote, string service_name)
     : service_name_(std::move(service_name)),
       messenger_(messenger),
-      is_started_(false) {
+      is_started_(false),
+      num_calls_(0) {
   CHECK(messenger != nullptr);
   DCHECK(!service_name_.empty()) << "Proxy service name must not be blank";
 
@@ -79,7 +80,17 @@ void Proxy::AsyncRequest(const string& method,
   CHECK(controller->call_.get() == nullptr) << "Controller should be reset";
   base::subtle::NoBarrier_Store(&is_started_, true);
   RemoteMethod remote_method(service_name_, method);
-  OutboundCall* call = new OutboundCall(conn_id_, remote_method, response, controller, callback);
+  OutboundCall* call;
+  int num_connections = messenger_->num_connections_per_server();
+  if (num_connections > 1) {
+    // Round-robin this proxy's calls across the connections to the remote.
+    uint32_t n = base::subtle::NoBarrier_AtomicIncrement(&num_calls_, 1);
+    ConnectionId conn_id(conn_id_);
+    conn_id.set_idx(n % num_connections);
+    call = new OutboundCall(conn_id, remote_method, response, controller, callback);
+  } else {
+    call = new OutboundCall(conn_id_, remote_method, response, controller, callback);
+  }
   controller->call_.reset(call);
   call->SetRequestParam(req);
 
@@ -112,6 +112,10 @@ class Proxy {
   ConnectionId conn_id_;
   mutable Atomic32 is_started_;
 
+  // Incremented for each call, to spread calls across the messenger's
+  // connections to the remote.
+  mutable Atomic32 num_calls_;
+
   DISALLOW_COPY_AND_ASSIGN(Proxy);
 };
 
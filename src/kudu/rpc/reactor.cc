@@ -24,8 +24,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <boost/intrusive/list.hpp>
 #include <ev++.h>
@@ -41,10 +43,13 @@
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/server_negotiation.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/security/tls_socket.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/sanitizer_scopes.h"
 #include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/status.h"
@@ -64,6 +69,7 @@ static const int kDefaultLibEvFlags = ev::AUTO;
 
 using std::string;
 using std::shared_ptr;
+using std::vector;
 
 // TODO(KUDU-1580). This timeout has been bumped from 3 seconds up to
 // 15 seconds to workaround a bug. We should drop it back down when
@@ -73,6 +79,18 @@ DEFINE_int64(rpc_negotiation_timeout_ms, 15000,
 TAG_FLAG(rpc_negotiation_timeout_ms, advanced);
 TAG_FLAG(rpc_negotiation_timeout_ms, runtime);
 
+DEFINE_int32(rpc_inbound_buffer_pool_size, 64,
+             "Number of buffers for receiving RPC frames which each reactor "
+             "thread retains for reuse. If 0, a buffer is allocated for every "
+             "received frame.");
+TAG_FLAG(rpc_inbound_buffer_pool_size, advanced);
+
+DEFINE_int32(rpc_inbound_buffer_pool_max_buffer_size, 64 * 1024,
+             "Maximum size in bytes of the buffers for receiving RPC frames which "
+             "are retained for reuse. Larger frames are received into buffers "
+             "which are freed once the frame has been processed.");
+TAG_FLAG(rpc_inbound_buffer_pool_max_buffer_size, advanced);
+
 namespace kudu {
 namespace rpc {
 
@@ -91,7 +109,15 @@ ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder& bld)
     last_unused_tcp_scan_(cur_time_),
     reactor_(reactor),
     connection_keepalive_time_(bld.connection_keepalive_time_),
-    coarse_timer_granularity_(bld.coarse_timer_granularity_) {
+    coarse_timer_granularity_(bld.coarse_timer_granularity_),
+    inbound_buffer_pool_(FLAGS_rpc_inbound_buffer_pool_size > 0 ?
+                         new InboundBufferPool(FLAGS_rpc_inbound_buffer_pool_size,
+                                               FLAGS_rpc_inbound_buffer_pool_max_buffer_size) :
+                         nullptr),
+    num_kernel_tls_connections_(0),
+    num_connections_accepted_(0),
+    num_reactor_negotiations_(0),
+    num_compressed_bodies_received_(0) {
 }
 
 Status ReactorThread::Init() {
@@ -135,6 +161,10 @@ void ReactorThread::ShutdownInternal() {
     client_conns_.erase(c);
   }
 
+  // Abandon any negotiations in progress, closing their sockets. Their
+  // connections are torn down below.
+  negotiations_.clear();
+
   // Tear down any inbound TCP connections.
   VLOG(1) << name() << ": tearing down inbound TCP connections...";
   for (const scoped_refptr<Connection>& conn : server_conns_) {
@@ -143,6 +173,9 @@ void ReactorThread::ShutdownInternal() {
   }
   server_conns_.clear();
 
+  // Stop accepting new connections.
+  acceptors_.clear();
+
   // Abort any scheduled tasks.
   //
   // These won't be found in the ReactorThread's list of pending tasks
@@ -163,6 +196,17 @@ Status ReactorThread::GetMetrics(ReactorMetrics *metrics) {
   DCHECK(IsCurrentThread());
   metrics->num_client_connections_ = client_conns_.size();
   metrics->num_server_connections_ = server_conns_.size();
+  if (inbound_buffer_pool_) {
+    metrics->num_inbound_buffers_allocated_ = inbound_buffer_pool_->buffers_allocated();
+    metrics->num_inbound_buffers_reused_ = inbound_buffer_pool_->buffers_reused();
+  } else {
+    metrics->num_inbound_buffers_allocated_ = 0;
+    metrics->num_inbound_buffers_reused_ = 0;
+  }
+  metrics->num_kernel_tls_connections_ = num_kernel_tls_connections_;
+  metrics->num_connections_accepted_ = num_connections_accepted_;
+  metrics->num_reactor_negotiations_ = num_reactor_negotiations_;
+  metrics->num_compressed_bodies_received_ = num_compressed_bodies_received_;
   return Status::OK();
 }
 
@@ -222,6 +266,45 @@ void ReactorThread::RegisterConnection(scoped_refptr<Connection> conn) {
   server_conns_.emplace_back(std::move(conn));
 }
 
+void ReactorThread::RegisterAcceptedConnection(scoped_refptr<Connection> conn) {
+  DCHECK(IsCurrentThread());
+  num_connections_accepted_++;
+  if (!Negotiation::CanNegotiateOnReactor()) {
+    RegisterConnection(std::move(conn));
+    return;
+  }
+
+  MonoTime deadline = MonoTime::Now() +
+      MonoDelta::FromMilliseconds(FLAGS_rpc_negotiation_timeout_ms);
+
+  // The negotiation may complete, and destroy the connection if it fails,
+  // before Start() returns, so the connection must already be tracked.
+  server_conns_.push_back(conn);
+  ReactorNegotiation* negotiation = new ReactorNegotiation(conn, deadline);
+  negotiations_.emplace(conn.get(), std::unique_ptr<ReactorNegotiation>(negotiation));
+  num_reactor_negotiations_++;
+  negotiation->Start(loop_);
+}
+
+void ReactorThread::StartAccepting(AcceptorPool* pool, std::unique_ptr<Socket> socket,
+                                   scoped_refptr<Counter> connections_accepted) {
+  DCHECK(IsCurrentThread());
+  VLOG(1) << name() << ": accepting connections on socket " << socket->GetFd();
+  std::unique_ptr<ReactorAcceptor> acceptor(new ReactorAcceptor(
+      this, pool, std::move(socket), std::move(connections_accepted)));
+  acceptor->Start(loop_);
+  acceptors_.emplace_back(std::move(acceptor));
+}
+
+void ReactorThread::StopAccepting(AcceptorPool* pool) {
+  DCHECK(IsCurrentThread());
+  acceptors_.erase(std::remove_if(acceptors_.begin(), acceptors_.end(),
+                                  [pool](const std::unique_ptr<ReactorAcceptor>& a) {
+                                    return a->pool() == pool;
+                                  }),
+                   acceptors_.end());
+}
+
 void ReactorThread::AssignOutboundCall(const shared_ptr<OutboundCall>& call) {
   DCHECK(IsCurrentThread());
   scoped_refptr<Connection> conn;
@@ -253,6 +336,18 @@ void ReactorThread::TimerHandler(ev::timer& /*watcher*/, int revents) {
   cur_time_ = now;
 
   ScanIdleConnections();
+
+  // Time out negotiations which have run past their deadline. Aborting a
+  // negotiation removes it from the map, so collect them first.
+  vector<ReactorNegotiation*> expired;
+  for (const auto& entry : negotiations_) {
+    if (entry.second->deadline() < now) {
+      expired.push_back(entry.second.get());
+    }
+  }
+  for (ReactorNegotiation* negotiation : expired) {
+    negotiation->Abort(Status::TimedOut("timed out negotiating on the reactor"));
+  }
 }
 
 void ReactorThread::RegisterTimeout(ev::timer *watcher) {
@@ -345,6 +440,7 @@ Status ReactorThread::FindOrStartConnection(const ConnectionId& conn_id,
   // Register the new connection in our map.
   *conn = new Connection(this, conn_id.remote(), std::move(new_socket), Connection::CLIENT);
   (*conn)->set_user_credentials(conn_id.user_credentials());
+  (*conn)->set_outbound_connection_idx(conn_id.idx());
 
   // Kick off blocking client connection negotiation.
   Status s = StartConnectionNegotiation(*conn);
@@ -392,10 +488,23 @@ void ReactorThread::CompleteConnectionNegotiation(const scoped_refptr<Connection
     return;
   }
 
+  auto* tls_socket = dynamic_cast<security::TlsSocket*>(conn->socket());
+  if (tls_socket && tls_socket->kernel_tls_send()) {
+    num_kernel_tls_connections_++;
+  }
+
   conn->MarkNegotiationComplete();
   conn->EpollRegister(loop_);
 }
 
+void ReactorThread::CompleteReactorNegotiation(ReactorNegotiation* negotiation,
+                                               const Status& status) {
+  DCHECK(IsCurrentThread());
+  scoped_refptr<Connection> conn(negotiation->conn());
+  negotiations_.erase(conn.get());
+  CompleteConnectionNegotiation(conn, status);
+}
+
 Status ReactorThread::CreateClientSocket(Socket *sock) {
   Status ret = sock->Init(Socket::FLAG_NONBLOCKING);
   if (ret.ok()) {
@@ -436,6 +545,7 @@ void ReactorThread::DestroyConnection(Connection *conn,
   // Unlink connection from lists.
   if (conn->direction() == Connection::CLIENT) {
     ConnectionId conn_id(conn->remote(), conn->user_credentials());
+    conn_id.set_idx(conn->outbound_connection_idx());
     auto it = client_conns_.find(conn_id);
     CHECK(it != client_conns_.end()) << "Couldn't find connection " << conn->ToString();
     client_conns_.erase(it);
@@ -490,6 +600,64 @@ void DelayedTask::TimerHandler(ev::timer& watcher, int revents) {
   }
 }
 
+ReactorAcceptor::ReactorAcceptor(ReactorThread* thread, AcceptorPool* pool,
+                                 std::unique_ptr<Socket> socket,
+                                 scoped_refptr<Counter> connections_accepted)
+    : thread_(thread),
+      pool_(pool),
+      socket_(std::move(socket)),
+      connections_accepted_(std::move(connections_accepted)) {
+}
+
+ReactorAcceptor::~ReactorAcceptor() {
+  io_.stop();
+}
+
+void ReactorAcceptor::Start(ev::loop_ref loop) {
+  DCHECK(thread_->IsCurrentThread());
+  io_.set(loop);
+  io_.set(socket_->GetFd(), ev::READ);
+  io_.set<ReactorAcceptor, &ReactorAcceptor::AcceptHandler>(this);
+  io_.start();
+}
+
+void ReactorAcceptor::AcceptHandler(ev::io& /*watcher*/, int revents) {
+  DCHECK(thread_->IsCurrentThread());
+  if (PREDICT_FALSE(revents & EV_ERROR)) {
+    LOG(WARNING) << thread_->name() << ": error on listening socket " << socket_->GetFd();
+    return;
+  }
+
+  // Accept a bounded number of connections per wakeup, so that a burst of
+  // new connections doesn't starve the reactor's established ones. Any
+  // remaining connections are accepted on the next loop iteration.
+  static const int kMaxAcceptsPerWakeup = 64;
+  for (int i = 0; i < kMaxAcceptsPerWakeup; i++) {
+    Socket new_sock;
+    Sockaddr remote;
+    Status s = socket_->Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
+    if (!s.ok()) {
+      if (!Socket::IsTemporarySocketError(s.posix_code())) {
+        KLOG_EVERY_N_SECS(WARNING, 1) << thread_->name() << ": accept failed: "
+                                      << s.ToString() << THROTTLE_MSG;
+      }
+      return;
+    }
+    s = new_sock.SetNoDelay(true);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 1) << "Acceptor with remote = " << remote.ToString()
+          << " failed to set TCP_NODELAY on a newly accepted socket: "
+          << s.ToString() << THROTTLE_MSG;
+      continue;
+    }
+    connections_accepted_->Increment();
+    VLOG(3) << thread_->name() << ": new inbound connection to " << remote.ToString();
+    std::unique_ptr<Socket> conn_sock(new Socket(new_sock.Release()));
+    thread_->RegisterAcceptedConnection(
+        new Connection(thread_, remote, std::move(conn_sock), Connection::SERVER));
+  }
+}
+
 Reactor::Reactor(const shared_ptr<Messenger>& messenger,
                  int index, const MessengerBuilder& bld)
   : messenger_(messenger),
@@ -611,6 +779,65 @@ void Reactor::RegisterInboundSocket(Socket *socket, const Sockaddr& remote) {
   ScheduleReactorTask(task);
 }
 
+class StartAcceptingTask : public ReactorTask {
+ public:
+  StartAcceptingTask(AcceptorPool* pool, std::unique_ptr<Socket> socket,
+                     scoped_refptr<Counter> connections_accepted)
+      : pool_(pool),
+        socket_(std::move(socket)),
+        connections_accepted_(std::move(connections_accepted)) {
+  }
+
+  void Run(ReactorThread* reactor) override {
+    reactor->StartAccepting(pool_, std::move(socket_), std::move(connections_accepted_));
+    delete this;
+  }
+
+  void Abort(const Status& /*status*/) override {
+    // The listening socket is closed along with the task.
+    delete this;
+  }
+
+ private:
+  AcceptorPool* pool_;
+  std::unique_ptr<Socket> socket_;
+  scoped_refptr<Counter> connections_accepted_;
+};
+
+void Reactor::StartAccepting(AcceptorPool* pool, std::unique_ptr<Socket> socket,
+                             scoped_refptr<Counter> connections_accepted) {
+  ScheduleReactorTask(new StartAcceptingTask(pool, std::move(socket),
+                                             std::move(connections_accepted)));
+}
+
+class StopAcceptingTask : public ReactorTask {
+ public:
+  StopAcceptingTask(AcceptorPool* pool, shared_ptr<CountDownLatch> stopped)
+      : pool_(pool),
+        stopped_(std::move(stopped)) {
+  }
+
+  void Run(ReactorThread* reactor) override {
+    reactor->StopAccepting(pool_);
+    stopped_->CountDown();
+    delete this;
+  }
+
+  void Abort(const Status& /*status*/) override {
+    // The reactor closes all of its listening sockets when it shuts down.
+    stopped_->CountDown();
+    delete this;
+  }
+
+ private:
+  AcceptorPool* pool_;
+  const shared_ptr<CountDownLatch> stopped_;
+};
+
+void Reactor::StopAccepting(AcceptorPool* pool, shared_ptr<CountDownLatch> stopped) {
+  ScheduleReactorTask(new StopAcceptingTask(pool, std::move(stopped)));
+}
+
 // Task which runs in the reactor thread to assign an outbound call
 // to a connection.
 class AssignOutboundCallTask : public ReactorTask {
@@ -24,6 +24,8 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/function.hpp>
 #include <boost/intrusive/list.hpp>
@@ -31,6 +33,7 @@
 
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/connection.h"
+#include "kudu/rpc/inbound_buffer_pool.h"
 #include "kudu/rpc/transfer.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/locks.h"
@@ -40,17 +43,22 @@
 
 namespace kudu {
 
+class CountDownLatch;
+class Counter;
 class Socket;
 
 namespace rpc {
 
 typedef std::list<scoped_refptr<Connection>> conn_list_t;
 
+class AcceptorPool;
 class DumpRunningRpcsRequestPB;
 class DumpRunningRpcsResponsePB;
 class Messenger;
 class MessengerBuilder;
 class Reactor;
+class ReactorNegotiation;
+class ReactorThread;
 
 // Simple metrics information from within a reactor.
 struct ReactorMetrics {
@@ -58,6 +66,22 @@ struct ReactorMetrics {
   int32_t num_client_connections_;
   // Number of server RPC connections currently connected.
   int32_t num_server_connections_;
+  // Number of inbound frame buffers which had to be allocated.
+  int64_t num_inbound_buffers_allocated_;
+  // Number of inbound frame buffers which were reused from the pool.
+  int64_t num_inbound_buffers_reused_;
+  // Number of TLS connections, since the reactor started, whose outbound
+  // records were encrypted by the kernel. See --tls_kernel_offload.
+  int64_t num_kernel_tls_connections_;
+  // Number of connections, since the reactor started, accepted from the
+  // reactor's own listening sockets. See --rpc_reuseport_acceptors.
+  int64_t num_connections_accepted_;
+  // Number of connections, since the reactor started, negotiated on the
+  // reactor thread rather than on the negotiation pool.
+  int64_t num_reactor_negotiations_;
+  // Number of inbound calls and call responses, since the reactor started,
+  // whose bodies arrived compressed. See --rpc_compression_codec.
+  int64_t num_compressed_bodies_received_;
 };
 
 // A task which can be enqueued to run on the reactor thread.
@@ -116,6 +140,38 @@ class DelayedTask : public ReactorTask {
   ev::timer timer_;
 };
 
+// Accepts connections on a listening socket from within a reactor thread,
+// registering them directly with that reactor. Used by acceptor pools which
+// shard their listening sockets across reactors with SO_REUSEPORT.
+//
+// All methods must be called from the owning reactor thread.
+class ReactorAcceptor {
+ public:
+  ReactorAcceptor(ReactorThread* thread, AcceptorPool* pool,
+                  std::unique_ptr<Socket> socket,
+                  scoped_refptr<Counter> connections_accepted);
+  ~ReactorAcceptor();
+
+  // Start watching the listening socket on 'loop'.
+  void Start(ev::loop_ref loop);
+
+  // The pool this acceptor belongs to. Only used to identify the acceptor;
+  // the pool may already have been destroyed.
+  AcceptorPool* pool() const { return pool_; }
+
+ private:
+  // libev callback for when the listening socket has pending connections.
+  void AcceptHandler(ev::io& watcher, int revents);
+
+  ReactorThread* const thread_;
+  AcceptorPool* const pool_;
+  const std::unique_ptr<Socket> socket_;
+  const scoped_refptr<Counter> connections_accepted_;
+  ev::io io_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReactorAcceptor);
+};
+
 // A ReactorThread is a libev event handler thread which manages I/O
 // on a list of sockets.
 //
@@ -179,13 +235,26 @@ class ReactorThread {
   void CompleteConnectionNegotiation(const scoped_refptr<Connection>& conn,
                                      const Status& status);
 
+  // Transition back from a negotiation run by 'negotiation' on this thread,
+  // destroying 'negotiation'.
+  // Must be called from the reactor thread.
+  void CompleteReactorNegotiation(ReactorNegotiation* negotiation, const Status& status);
+
   // Collect metrics.
   // Must be called from the reactor thread.
   Status GetMetrics(ReactorMetrics *metrics);
 
+  // The pool of buffers for frames received by this reactor's connections.
+  const scoped_refptr<InboundBufferPool>& inbound_buffer_pool() const {
+    return inbound_buffer_pool_;
+  }
+
  private:
   friend class AssignOutboundCallTask;
+  friend class ReactorAcceptor;
   friend class RegisterConnectionTask;
+  friend class StartAcceptingTask;
+  friend class StopAcceptingTask;
   friend class DelayedTask;
 
   // Run the main event loop of the reactor.
@@ -224,6 +293,17 @@ class ReactorThread {
   // Register a new connection.
   void RegisterConnection(scoped_refptr<Connection> conn);
 
+  // Register a new connection accepted by one of this reactor's acceptors,
+  // negotiating it on this thread when possible.
+  void RegisterAcceptedConnection(scoped_refptr<Connection> conn);
+
+  // Start accepting connections on the listening 'socket' on behalf of 'pool'.
+  void StartAccepting(AcceptorPool* pool, std::unique_ptr<Socket> socket,
+                      scoped_refptr<Counter> connections_accepted);
+
+  // Stop accepting connections on behalf of 'pool', closing its sockets.
+  void StopAccepting(AcceptorPool* pool);
+
   // Actually perform shutdown of the thread, tearing down any connections,
   // etc. This is called from within the thread.
   void ShutdownInternal();
@@ -257,6 +337,12 @@ class ReactorThread {
   // List of current connections coming into the server.
   conn_list_t server_conns_;
 
+  // Listening sockets this reactor accepts connections on, if any.
+  std::vector<std::unique_ptr<ReactorAcceptor>> acceptors_;
+
+  // Server connections being negotiated on this thread, keyed by connection.
+  std::unordered_map<Connection*, std::unique_ptr<ReactorNegotiation>> negotiations_;
+
   Reactor *reactor_;
 
   // If a connection has been idle for this much time, it is torn down.
@@ -264,6 +350,21 @@ class ReactorThread {
 
   // Scan for idle connections on this granularity.
   const MonoDelta coarse_timer_granularity_;
+
+  // Buffers for frames received by this reactor's connections.
+  const scoped_refptr<InboundBufferPool> inbound_buffer_pool_;
+
+  // See ReactorMetrics::num_kernel_tls_connections_.
+  int64_t num_kernel_tls_connections_;
+
+  // See ReactorMetrics::num_connections_accepted_.
+  int64_t num_connections_accepted_;
+
+  // See ReactorMetrics::num_reactor_negotiations_.
+  int64_t num_reactor_negotiations_;
+
+  // See ReactorMetrics::num_compressed_bodies_received_.
+  int64_t num_compressed_bodies_received_;
 };
 
 // A Reactor manages a ReactorThread
@@ -293,6 +394,17 @@ class Reactor {
   // If the reactor is already shut down, takes care of closing the socket.
   void RegisterInboundSocket(Socket *socket, const Sockaddr &remote);
 
+  // Start accepting connections on the listening 'socket' within the reactor
+  // thread, on behalf of 'pool'. If the reactor is already shut down, the
+  // socket is closed.
+  void StartAccepting(AcceptorPool* pool, std::unique_ptr<Socket> socket,
+                      scoped_refptr<Counter> connections_accepted);
+
+  // Asynchronously stop accepting connections on behalf of 'pool', and count
+  // down 'stopped' once the listening sockets are closed, or if the reactor
+  // is shutting down.
+  void StopAccepting(AcceptorPool* pool, std::shared_ptr<CountDownLatch> stopped);
+
   // Queue a new call to be sent. If the reactor is already shut down, marks
   // the call as failed.
   void QueueOutboundCall(const std::shared_ptr<OutboundCall> &call);
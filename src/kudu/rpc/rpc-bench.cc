@@ -15,20 +15,32 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <fstream>
 #include <functional>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <utility>
 
 #include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/reactor.h"
+#include "kudu/rpc/remote_method.h"
 #include "kudu/rpc/rpc-test-base.h"
 #include "kudu/rpc/rtest.proxy.h"
 #include "kudu/util/countdown_latch.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/test_util.h"
 
 using std::bind;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::thread;
@@ -53,14 +65,212 @@ DEFINE_int32(server_reactors, 4,
 
 DEFINE_int32(run_seconds, 1, "Seconds to run the test");
 
+DEFINE_int32(max_connections_per_server, 4,
+             "For the connection scaling benchmark, the largest number of connections "
+             "per server to try. The benchmark runs a single client messenger with this "
+             "many reactors, using 1, 2, 4, ... connections up to this number.");
+
+DEFINE_int32(storm_connections, 200,
+             "For the connection storm benchmark, the number of clients which all "
+             "connect to the server at once.");
+
+DEFINE_string(payload_sizes, "0,1024,65536,1048576",
+              "For the payload size benchmark, a comma-separated list of request and "
+              "response body sizes in bytes to sweep through.");
+
+DEFINE_string(sidecar_sizes, "1024,65536,1048576,4194304",
+              "For the sidecar benchmark, a comma-separated list of sizes in bytes of "
+              "each of the two sidecars returned with every response.");
+
+DEFINE_string(results_file, "",
+              "If set, append the results of each benchmark run to this file, as one "
+              "JSON object per line.");
+
+DEFINE_double(min_reqs_per_sec, 0,
+              "If positive, fail any benchmark run whose throughput is lower than "
+              "this many requests per second.");
+
+DEFINE_int64(max_p99_latency_us, 0,
+             "If positive, fail any benchmark run whose 99th percentile call latency "
+             "is higher than this many microseconds.");
+
+DECLARE_int32(rpc_num_connections_per_server);
+DECLARE_bool(rpc_reuseport_acceptors);
+DECLARE_bool(tls_kernel_offload);
+
+METRIC_DEFINE_histogram(server, rpc_bench_negotiation_queue_time,
+                        "Negotiation Queue Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds connections accepted by the benchmark "
+                        "server wait for a negotiation thread",
+                        60000000LU, 2);
+
 namespace kudu {
 namespace rpc {
 
-class RpcBench : public RpcTestBase {
+// How the benchmark's connections are secured.
+enum class Encryption {
+  // Plaintext.
+  NONE,
+  // TLS, with OpenSSL encrypting in userspace.
+  TLS,
+  // TLS, with outbound records encrypted by the kernel where supported.
+  KERNEL_TLS
+};
+
+static const char* EncryptionToString(Encryption e) {
+  switch (e) {
+    case Encryption::NONE: return "none";
+    case Encryption::TLS: return "TLS";
+    case Encryption::KERNEL_TLS: return "kernel TLS";
+  }
+  LOG(FATAL) << "unknown encryption mode";
+  return nullptr;
+}
+
+// The kind of call a benchmark makes.
+enum class CallType {
+  // A small Add() call.
+  ADD,
+  // An Echo() call, with the payload in both the request and response bodies.
+  ECHO,
+  // A SendTwoStrings() call, with the payload in each of two response sidecars.
+  SIDECARS
+};
+
+static const char* CallTypeToString(CallType t) {
+  switch (t) {
+    case CallType::ADD: return "add";
+    case CallType::ECHO: return "echo";
+    case CallType::SIDECARS: return "sidecars";
+  }
+  LOG(FATAL) << "unknown call type";
+  return nullptr;
+}
+
+// The name of the CalculatorService method which a call type calls.
+static const char* CallTypeToMethodName(CallType t) {
+  switch (t) {
+    case CallType::ADD: return "Add";
+    case CallType::ECHO: return "Echo";
+    case CallType::SIDECARS: return "SendTwoStrings";
+  }
+  LOG(FATAL) << "unknown call type";
+  return nullptr;
+}
+
+struct Workload {
+  CallType type;
+  int64_t payload_bytes;
+};
+
+// Parse a comma-separated list of sizes from a flag.
+static vector<int64_t> ParseSizes(const string& flag_value) {
+  vector<int64_t> sizes;
+  for (const string& s : strings::Split(flag_value, ",", strings::SkipEmpty())) {
+    int64_t size;
+    CHECK(safe_strto64(s, &size) && size >= 0) << "invalid size: " << s;
+    sizes.push_back(size);
+  }
+  return sizes;
+}
+
+// The request and response of one outstanding call of a workload.
+class BenchCall {
+ public:
+  BenchCall(const Workload& workload, int seed)
+      : type_(workload.type),
+        payload_bytes_(workload.payload_bytes) {
+    switch (type_) {
+      case CallType::ADD:
+        add_req_.set_x(seed);
+        add_req_.set_y(seed);
+        break;
+      case CallType::ECHO:
+        echo_req_.set_data(string(payload_bytes_, 'x'));
+        break;
+      case CallType::SIDECARS:
+        sidecars_req_.set_random_seed(seed);
+        sidecars_req_.set_size1(payload_bytes_);
+        sidecars_req_.set_size2(payload_bytes_);
+        break;
+    }
+  }
+
+  void SendAsync(CalculatorServiceProxy* proxy, RpcController* controller,
+                 const ResponseCallback& callback) {
+    switch (type_) {
+      case CallType::ADD:
+        proxy->AddAsync(add_req_, &add_resp_, controller, callback);
+        break;
+      case CallType::ECHO:
+        proxy->EchoAsync(echo_req_, &echo_resp_, controller, callback);
+        break;
+      case CallType::SIDECARS:
+        proxy->SendTwoStringsAsync(sidecars_req_, &sidecars_resp_, controller, callback);
+        break;
+    }
+  }
+
+  Status SendSync(CalculatorServiceProxy* proxy, RpcController* controller) {
+    switch (type_) {
+      case CallType::ADD:
+        return proxy->Add(add_req_, &add_resp_, controller);
+      case CallType::ECHO:
+        return proxy->Echo(echo_req_, &echo_resp_, controller);
+      case CallType::SIDECARS:
+        return proxy->SendTwoStrings(sidecars_req_, &sidecars_resp_, controller);
+    }
+    LOG(FATAL) << "unknown call type";
+    return Status::OK();
+  }
+
+  // Check the response to a call which succeeded.
+  void Verify(const RpcController& controller) const {
+    switch (type_) {
+      case CallType::ADD:
+        CHECK_EQ(add_req_.x() + add_req_.y(), add_resp_.result());
+        break;
+      case CallType::ECHO:
+        CHECK_EQ(payload_bytes_, static_cast<int64_t>(echo_resp_.data().size()));
+        break;
+      case CallType::SIDECARS: {
+        Slice sidecar;
+        CHECK_OK(controller.GetSidecar(sidecars_resp_.sidecar1(), &sidecar));
+        CHECK_EQ(payload_bytes_, static_cast<int64_t>(sidecar.size()));
+        CHECK_OK(controller.GetSidecar(sidecars_resp_.sidecar2(), &sidecar));
+        CHECK_EQ(payload_bytes_, static_cast<int64_t>(sidecar.size()));
+        break;
+      }
+    }
+  }
+
+  // The number of payload bytes transferred by one call.
+  static int64_t PayloadBytesPerCall(const Workload& workload) {
+    // Echo sends the payload in both directions, and SendTwoStrings returns
+    // it twice.
+    return workload.type == CallType::ADD ? 0 : workload.payload_bytes * 2;
+  }
+
+ private:
+  const CallType type_;
+  const int64_t payload_bytes_;
+
+  AddRequestPB add_req_;
+  AddResponsePB add_resp_;
+  EchoRequestPB echo_req_;
+  EchoResponsePB echo_resp_;
+  SendTwoStringsRequestPB sidecars_req_;
+  SendTwoStringsResponsePB sidecars_resp_;
+};
+
+class RpcBench : public RpcTestBase,
+                 public ::testing::WithParamInterface<Encryption> {
  public:
   RpcBench()
       : should_run_(true),
-        stop_(0)
+        stop_(0),
+        workload_({ CallType::ADD, 0 })
   {}
 
   void SetUp() override {
@@ -69,32 +279,152 @@ class RpcBench : public RpcTestBase {
     n_worker_threads_ = FLAGS_worker_threads;
     n_server_reactor_threads_ = FLAGS_server_reactors;
 
-    // Set up server.
-    StartTestServerWithGeneratedCode(&server_addr_);
+    // Set up server. Once the server has TLS configured, client messengers
+    // built afterwards pick up the same settings.
+    FLAGS_tls_kernel_offload = GetParam() == Encryption::KERNEL_TLS;
+    StartTestServerWithGeneratedCode(&server_addr_, GetParam() != Encryption::NONE);
   }
 
-  void SummarizePerf(CpuTimes elapsed, int total_reqs, bool sync) {
+  // Shut down the server and start a new one, picking up any changes to the
+  // flags which are read when it starts.
+  void RestartServer() {
+    server_messenger_->UnregisterService(service_name_);
+    service_pool_->Shutdown();
+    server_messenger_->Shutdown();
+    StartTestServerWithGeneratedCode(&server_addr_, GetParam() != Encryption::NONE);
+  }
+
+  // Run the async workload with calls spread across 'messengers', and
+  // summarize its performance.
+  void RunAsyncBenchmark(const vector<shared_ptr<Messenger>>& messengers);
+
+  // Reset the call latency histogram before a run.
+  void ResetLatencies() {
+    latency_us_.reset(new HdrHistogram(60000000LU, 2));
+  }
+
+  void SummarizePerf(const string& scenario, CpuTimes elapsed, int total_reqs, bool sync) {
     float reqs_per_second = static_cast<float>(total_reqs / elapsed.wall_seconds());
     float user_cpu_micros_per_req = static_cast<float>(elapsed.user / 1000.0 / total_reqs);
     float sys_cpu_micros_per_req = static_cast<float>(elapsed.system / 1000.0 / total_reqs);
     float csw_per_req = static_cast<float>(elapsed.context_switches) / total_reqs;
+    double mb_per_second = BenchCall::PayloadBytesPerCall(workload_) * reqs_per_second /
+        (1024.0 * 1024.0);
 
-    LOG(INFO) << "Mode:            " << (sync ? "Sync" : "Async");
+    LOG(INFO) << "Scenario:         " << scenario;
+    LOG(INFO) << "Mode:             " << (sync ? "Sync" : "Async");
     if (sync) {
       LOG(INFO) << "Client threads:   " << FLAGS_client_threads;
     } else {
       LOG(INFO) << "Client reactors:  " << FLAGS_client_threads;
       LOG(INFO) << "Call concurrency: " << FLAGS_async_call_concurrency;
     }
+    LOG(INFO) << "Conns per server: " << FLAGS_rpc_num_connections_per_server;
+    LOG(INFO) << "Encryption:       " << EncryptionToString(GetParam());
+    LOG(INFO) << "Call type:        " << CallTypeToString(workload_.type);
+    LOG(INFO) << "Payload bytes:    " << workload_.payload_bytes;
 
     LOG(INFO) << "Worker threads:   " << FLAGS_worker_threads;
     LOG(INFO) << "Server reactors:  " << FLAGS_server_reactors;
     LOG(INFO) << "----------------------------------";
     LOG(INFO) << "Reqs/sec:         " << reqs_per_second;
+    if (workload_.type != CallType::ADD) {
+      LOG(INFO) << "Payload MB/sec:   " << mb_per_second;
+    }
     LOG(INFO) << "User CPU per req: " << user_cpu_micros_per_req << "us";
     LOG(INFO) << "Sys CPU per req:  " << sys_cpu_micros_per_req << "us";
     LOG(INFO) << "Ctx Sw. per req:  " << csw_per_req;
+    LogLatencies();
+
+    // Report how often the server had to allocate buffers and protobuf
+    // messages, rather than reusing pooled ones.
+    ReactorMetrics metrics;
+    CHECK_OK(server_messenger_->GetReactorMetrics(&metrics));
+    RpcMethodInfo* mi = service_pool_->LookupMethod(
+        RemoteMethod(CalculatorServiceIf::static_service_name(),
+                     CallTypeToMethodName(workload_.type)));
+    CHECK(mi);
+    LOG(INFO) << "----------------------------------";
+    LOG(INFO) << "Inbound buffers allocated: " << metrics.num_inbound_buffers_allocated_;
+    LOG(INFO) << "Inbound buffers reused:    " << metrics.num_inbound_buffers_reused_;
+    LOG(INFO) << "Request PBs allocated:     " << mi->req_pool.messages_allocated();
+    LOG(INFO) << "Request PBs reused:        " << mi->req_pool.messages_reused();
+    LOG(INFO) << "Response PBs allocated:    " << mi->resp_pool.messages_allocated();
+    LOG(INFO) << "Response PBs reused:       " << mi->resp_pool.messages_reused();
+
+    RecordResult(scenario, sync, reqs_per_second, mb_per_second, {
+        { "user_cpu_us_per_req", user_cpu_micros_per_req },
+        { "sys_cpu_us_per_req", sys_cpu_micros_per_req },
+        { "ctx_switches_per_req", csw_per_req } });
+  }
+
+  void LogLatencies() const {
+    LOG(INFO) << "Latency p50:      " << latency_us_->ValueAtPercentile(50) << "us";
+    LOG(INFO) << "Latency p95:      " << latency_us_->ValueAtPercentile(95) << "us";
+    LOG(INFO) << "Latency p99:      " << latency_us_->ValueAtPercentile(99) << "us";
+    LOG(INFO) << "Latency p99.9:    " << latency_us_->ValueAtPercentile(99.9) << "us";
+    LOG(INFO) << "Latency max:      " << latency_us_->MaxValue() << "us";
+  }
 
+  // Append the result of a run to --results_file, if set, and check it
+  // against the regression thresholds.
+  void RecordResult(const string& scenario, bool sync, double reqs_per_second,
+                    double mb_per_second, const vector<pair<string, double>>& extra) {
+    if (!FLAGS_results_file.empty()) {
+      std::ostringstream out;
+      JsonWriter jw(&out, JsonWriter::COMPACT);
+      jw.StartObject();
+      jw.String("scenario");
+      jw.String(scenario);
+      jw.String("encryption");
+      jw.String(EncryptionToString(GetParam()));
+      jw.String("mode");
+      jw.String(sync ? "sync" : "async");
+      jw.String("call_type");
+      jw.String(CallTypeToString(workload_.type));
+      jw.String("payload_bytes");
+      jw.Int64(workload_.payload_bytes);
+      jw.String("client_threads");
+      jw.Int64(FLAGS_client_threads);
+      jw.String("async_call_concurrency");
+      jw.Int64(FLAGS_async_call_concurrency);
+      jw.String("connections_per_server");
+      jw.Int64(FLAGS_rpc_num_connections_per_server);
+      jw.String("worker_threads");
+      jw.Int64(FLAGS_worker_threads);
+      jw.String("server_reactors");
+      jw.Int64(FLAGS_server_reactors);
+      jw.String("reqs_per_sec");
+      jw.Double(reqs_per_second);
+      jw.String("payload_mb_per_sec");
+      jw.Double(mb_per_second);
+      for (const auto& e : extra) {
+        jw.String(e.first);
+        jw.Double(e.second);
+      }
+      jw.String("latency_us");
+      jw.StartObject();
+      for (double p : { 50.0, 95.0, 99.0, 99.9 }) {
+        jw.String(strings::Substitute("p$0", p));
+        jw.Int64(latency_us_->ValueAtPercentile(p));
+      }
+      jw.String("max");
+      jw.Int64(latency_us_->MaxValue());
+      jw.EndObject();
+      jw.EndObject();
+
+      std::ofstream f(FLAGS_results_file, std::ios::app);
+      f << out.str() << std::endl;
+      CHECK(f.good()) << "unable to write results to " << FLAGS_results_file;
+    }
+
+    if (FLAGS_min_reqs_per_sec > 0) {
+      EXPECT_GE(reqs_per_second, FLAGS_min_reqs_per_sec) << scenario;
+    }
+    if (FLAGS_max_p99_latency_us > 0) {
+      EXPECT_LE(static_cast<int64_t>(latency_us_->ValueAtPercentile(99)),
+                FLAGS_max_p99_latency_us) << scenario;
+    }
   }
 
  protected:
@@ -104,8 +434,19 @@ class RpcBench : public RpcTestBase {
   Sockaddr server_addr_;
   Atomic32 should_run_;
   CountDownLatch stop_;
+
+  // The calls the clients make.
+  Workload workload_;
+
+  // Latencies of the calls made during the current run, in microseconds.
+  unique_ptr<HdrHistogram> latency_us_;
 };
 
+INSTANTIATE_TEST_CASE_P(Encryption, RpcBench,
+                        testing::Values(Encryption::NONE,
+                                        Encryption::TLS,
+                                        Encryption::KERNEL_TLS));
+
 class ClientThread {
  public:
   explicit ClientThread(RpcBench *bench)
@@ -126,15 +467,14 @@ class ClientThread {
 
     CalculatorServiceProxy p(client_messenger, bench_->server_addr_);
 
-    AddRequestPB req;
-    AddResponsePB resp;
+    BenchCall call(bench_->workload_, request_count_);
     while (Acquire_Load(&bench_->should_run_)) {
-      req.set_x(request_count_);
-      req.set_y(request_count_);
       RpcController controller;
       controller.set_timeout(MonoDelta::FromSeconds(10));
-      CHECK_OK(p.Add(req, &resp, &controller));
-      CHECK_EQ(req.x() + req.y(), resp.result());
+      MonoTime start = MonoTime::Now();
+      CHECK_OK(call.SendSync(&p, &controller));
+      bench_->latency_us_->Increment((MonoTime::Now() - start).ToMicroseconds());
+      call.Verify(controller);
       request_count_++;
     }
   }
@@ -146,7 +486,8 @@ class ClientThread {
 
 
 // Test making successful RPC calls.
-TEST_F(RpcBench, BenchmarkCalls) {
+TEST_P(RpcBench, BenchmarkCalls) {
+  ResetLatencies();
   Stopwatch sw(Stopwatch::ALL_THREADS);
   sw.start();
 
@@ -167,15 +508,16 @@ TEST_F(RpcBench, BenchmarkCalls) {
   }
   sw.stop();
 
-  SummarizePerf(sw.elapsed(), total_reqs, true);
+  SummarizePerf("calls", sw.elapsed(), total_reqs, true);
 }
 
 class ClientAsyncWorkload {
  public:
-  ClientAsyncWorkload(RpcBench *bench, shared_ptr<Messenger> messenger)
+  ClientAsyncWorkload(RpcBench *bench, shared_ptr<Messenger> messenger, int seed)
     : bench_(bench),
       messenger_(messenger),
-      request_count_(0) {
+      request_count_(0),
+      call_(bench->workload_, seed) {
     controller_.set_timeout(MonoDelta::FromSeconds(10));
     proxy_.reset(new CalculatorServiceProxy(messenger_, bench_->server_addr_));
   }
@@ -183,20 +525,18 @@ class ClientAsyncWorkload {
   void CallOneRpc() {
     if (request_count_ > 0) {
       CHECK_OK(controller_.status());
-      CHECK_EQ(req_.x() + req_.y(), resp_.result());
+      bench_->latency_us_->Increment((MonoTime::Now() - start_).ToMicroseconds());
+      call_.Verify(controller_);
     }
     if (!Acquire_Load(&bench_->should_run_)) {
       bench_->stop_.CountDown();
       return;
     }
     controller_.Reset();
-    req_.set_x(request_count_);
-    req_.set_y(request_count_);
     request_count_++;
-    proxy_->AddAsync(req_,
-                     &resp_,
-                     &controller_,
-                     bind(&ClientAsyncWorkload::CallOneRpc, this));
+    start_ = MonoTime::Now();
+    call_.SendAsync(proxy_.get(), &controller_,
+                    bind(&ClientAsyncWorkload::CallOneRpc, this));
   }
 
   void Start() {
@@ -208,25 +548,21 @@ class ClientAsyncWorkload {
   unique_ptr<CalculatorServiceProxy> proxy_;
   uint32_t request_count_;
   RpcController controller_;
-  AddRequestPB req_;
-  AddResponsePB resp_;
+  BenchCall call_;
+  MonoTime start_;
 };
 
-TEST_F(RpcBench, BenchmarkCallsAsync) {
-  int threads = FLAGS_client_threads;
+void RpcBench::RunAsyncBenchmark(const vector<shared_ptr<Messenger>>& messengers) {
   int concurrency = FLAGS_async_call_concurrency;
 
-  vector<shared_ptr<Messenger>> messengers;
-  for (int i = 0; i < threads; i++) {
-    messengers.push_back(CreateMessenger("Client"));
-  }
-
   vector<unique_ptr<ClientAsyncWorkload>> workloads;
   for (int i = 0; i < concurrency; i++) {
     workloads.emplace_back(
-        new ClientAsyncWorkload(this, messengers[i % threads]));
+        new ClientAsyncWorkload(this, messengers[i % messengers.size()], i));
   }
 
+  ResetLatencies();
+  Release_Store(&should_run_, true);
   stop_.Reset(concurrency);
 
   Stopwatch sw(Stopwatch::ALL_THREADS);
@@ -247,9 +583,141 @@ TEST_F(RpcBench, BenchmarkCallsAsync) {
     total_reqs += workloads[i]->request_count_;
   }
 
-  SummarizePerf(sw.elapsed(), total_reqs, false);
+  SummarizePerf(strings::Substitute("async_$0", CallTypeToString(workload_.type)),
+                sw.elapsed(), total_reqs, false);
+}
+
+TEST_P(RpcBench, BenchmarkCallsAsync) {
+  vector<shared_ptr<Messenger>> messengers;
+  for (int i = 0; i < FLAGS_client_threads; i++) {
+    messengers.push_back(CreateMessenger("Client"));
+  }
+  RunAsyncBenchmark(messengers);
+}
+
+// Measure how the throughput of a single client messenger scales with the
+// number of connections it opens to the server.
+TEST_P(RpcBench, BenchmarkConnectionScaling) {
+  for (int n = 1; n <= FLAGS_max_connections_per_server; n *= 2) {
+    FLAGS_rpc_num_connections_per_server = n;
+    RunAsyncBenchmark({ CreateMessenger("Client", FLAGS_max_connections_per_server) });
+  }
+}
+
+// Measure throughput and latency as the size of the request and response
+// bodies grows.
+TEST_P(RpcBench, BenchmarkPayloadSizes) {
+  vector<shared_ptr<Messenger>> messengers;
+  for (int i = 0; i < FLAGS_client_threads; i++) {
+    messengers.push_back(CreateMessenger("Client"));
+  }
+  for (int64_t size : ParseSizes(FLAGS_payload_sizes)) {
+    workload_ = { CallType::ECHO, size };
+    RunAsyncBenchmark(messengers);
+  }
+}
+
+// Measure throughput and latency of calls whose responses carry large
+// sidecars, as scan responses do.
+TEST_P(RpcBench, BenchmarkSidecars) {
+  vector<shared_ptr<Messenger>> messengers;
+  for (int i = 0; i < FLAGS_client_threads; i++) {
+    messengers.push_back(CreateMessenger("Client"));
+  }
+  for (int64_t size : ParseSizes(FLAGS_sidecar_sizes)) {
+    workload_ = { CallType::SIDECARS, size };
+    RunAsyncBenchmark(messengers);
+  }
+}
+
+// A client in the connection storm benchmark: one messenger, and so one
+// connection, making a single call.
+struct StormClient {
+  shared_ptr<Messenger> messenger;
+  unique_ptr<CalculatorServiceProxy> proxy;
+  RpcController controller;
+  AddRequestPB req;
+  AddResponsePB resp;
+  MonoTime start;
+};
+
+// Measure how long it takes the server to accept, negotiate and serve a
+// first call on many connections arriving at once, as happens when a fleet
+// of clients reconnects after a failover.
+//
+// Each run compares accepting on acceptor threads with accepting on the
+// reactors (--rpc_reuseport_acceptors), each against a freshly started
+// server. In both modes connections are negotiated on the server's
+// negotiation pool, so the time they spend queued for a negotiation thread
+// is reported separately: what remains of the difference between the two
+// modes is due to the accept path.
+TEST_P(RpcBench, BenchmarkConnectionStorm) {
+  const int kNumClients = FLAGS_storm_connections;
+  for (bool reuseport : { false, true }) {
+    FLAGS_rpc_reuseport_acceptors = reuseport;
+    RestartServer();
+
+    MetricRegistry registry;
+    scoped_refptr<MetricEntity> entity =
+        METRIC_ENTITY_server.Instantiate(&registry, "connection_storm");
+    scoped_refptr<Histogram> negotiation_queue_time =
+        METRIC_rpc_bench_negotiation_queue_time.Instantiate(entity);
+    server_messenger_->negotiation_pool()->SetQueueTimeMicrosHistogram(
+        negotiation_queue_time);
+
+    vector<unique_ptr<StormClient>> clients;
+    for (int i = 0; i < kNumClients; i++) {
+      unique_ptr<StormClient> c(new StormClient);
+      c->messenger = CreateMessenger("Client");
+      c->proxy.reset(new CalculatorServiceProxy(c->messenger, server_addr_));
+      c->controller.set_timeout(MonoDelta::FromSeconds(60));
+      c->req.set_x(i);
+      c->req.set_y(i);
+      clients.emplace_back(std::move(c));
+    }
+
+    ResetLatencies();
+    CountDownLatch done(kNumClients);
+    MonoTime start = MonoTime::Now();
+    for (auto& c : clients) {
+      StormClient* client = c.get();
+      client->start = MonoTime::Now();
+      client->proxy->AddAsync(client->req, &client->resp, &client->controller,
+                              [this, client, &done]() {
+                                CHECK_OK(client->controller.status());
+                                latency_us_->Increment(
+                                    (MonoTime::Now() - client->start).ToMicroseconds());
+                                done.CountDown();
+                              });
+    }
+    done.Wait();
+    MonoDelta elapsed = MonoTime::Now() - start;
+
+    LOG(INFO) << "Scenario:         connection_storm";
+    LOG(INFO) << "Connections:      " << kNumClients;
+    LOG(INFO) << "Reuseport accept: " << (reuseport ? "yes" : "no");
+    LOG(INFO) << "Encryption:       " << EncryptionToString(GetParam());
+    LOG(INFO) << "Server reactors:  " << FLAGS_server_reactors;
+    LOG(INFO) << "----------------------------------";
+    LOG(INFO) << "Total time:       " << elapsed.ToMilliseconds() << "ms";
+    LogLatencies();
+    LOG(INFO) << "Negotiation wait: mean "
+              << negotiation_queue_time->MeanValueForTests() << "us, max "
+              << negotiation_queue_time->MaxValueForTests() << "us";
+
+    RecordResult("connection_storm", false, kNumClients / elapsed.ToSeconds(), 0, {
+        { "connections", kNumClients },
+        { "reuseport_acceptors", reuseport ? 1 : 0 },
+        { "total_ms", elapsed.ToMilliseconds() },
+        { "negotiation_wait_mean_us", negotiation_queue_time->MeanValueForTests() },
+        { "negotiation_wait_max_us", negotiation_queue_time->MaxValueForTests() } });
+
+    // Shut the clients down before the server they're connected to.
+    for (auto& c : clients) {
+      c->messenger->Shutdown();
+    }
+  }
 }
 
 } // namespace rpc
 } // namespace kudu
-
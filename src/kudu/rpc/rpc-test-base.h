@@ -118,6 +118,19 @@ class GenericCalculatorService : public ServiceIf {
   std::string service_name() const override { return kFullServiceName; }
   static std::string static_service_name() { return kFullServiceName; }
 
+  // Fill 'buf' with 'size' bytes of sidecar data for SendTwoStrings: random
+  // bytes from 'r', or a repeating pattern if 'compressible' is set.
+  static void FillSidecar(size_t size, bool compressible, Random* r, faststring* buf) {
+    buf->resize(size);
+    if (!compressible) {
+      RandomString(buf->data(), size, r);
+      return;
+    }
+    for (size_t i = 0; i < size; i++) {
+      (*buf)[i] = 'a' + i % 26;
+    }
+  }
+
  private:
   void DoAdd(InboundCall *incoming) {
     Slice param(incoming->serialized_request());
@@ -142,11 +155,8 @@ class GenericCalculatorService : public ServiceIf {
     gscoped_ptr<faststring> second(new faststring);
 
     Random r(req.random_seed());
-    first->resize(req.size1());
-    RandomString(first->data(), req.size1(), &r);
-
-    second->resize(req.size2());
-    RandomString(second->data(), req.size2(), &r);
+    FillSidecar(req.size1(), req.compressible(), &r, first.get());
+    FillSidecar(req.size2(), req.compressible(), &r, second.get());
 
     SendTwoStringsResponsePB resp;
     int idx1, idx2;
@@ -228,6 +238,26 @@ class CalculatorService : public CalculatorServiceIf {
     context->RespondSuccess();
   }
 
+  // Unlike GenericCalculatorService, this fills the sidecars with a single
+  // repeated byte rather than random data, so that benchmarks measure the
+  // cost of transferring them rather than of generating them.
+  void SendTwoStrings(const SendTwoStringsRequestPB* req,
+                      SendTwoStringsResponsePB* resp,
+                      RpcContext* context) override {
+    int idx1, idx2;
+    for (auto size_and_idx : { std::make_pair(req->size1(), &idx1),
+                               std::make_pair(req->size2(), &idx2) }) {
+      gscoped_ptr<faststring> data(new faststring);
+      data->resize(size_and_idx.first);
+      memset(data->data(), req->random_seed() & 0xff, size_and_idx.first);
+      CHECK_OK(context->AddRpcSidecar(
+          make_gscoped_ptr(new RpcSidecar(std::move(data))), size_and_idx.second));
+    }
+    resp->set_sidecar1(idx1);
+    resp->set_sidecar2(idx2);
+    context->RespondSuccess();
+  }
+
   void WhoAmI(const WhoAmIRequestPB* /*req*/,
               WhoAmIResponsePB* resp,
               RpcContext* context) override {
@@ -404,13 +434,14 @@ class RpcTestBase : public KuduTest {
     return Status::OK();
   }
 
-  void DoTestSidecar(const Proxy &p, int size1, int size2) {
+  void DoTestSidecar(const Proxy &p, int size1, int size2, bool compressible = false) {
     const uint32_t kSeed = 12345;
 
     SendTwoStringsRequestPB req;
     req.set_size1(size1);
     req.set_size2(size2);
     req.set_random_seed(kSeed);
+    req.set_compressible(compressible);
 
     SendTwoStringsResponsePB resp;
     RpcController controller;
@@ -424,12 +455,10 @@ class RpcTestBase : public KuduTest {
     Random rng(kSeed);
     faststring expected;
 
-    expected.resize(size1);
-    RandomString(expected.data(), size1, &rng);
+    GenericCalculatorService::FillSidecar(size1, compressible, &rng, &expected);
     CHECK_EQ(0, first.compare(Slice(expected)));
 
-    expected.resize(size2);
-    RandomString(expected.data(), size2, &rng);
+    GenericCalculatorService::FillSidecar(size2, compressible, &rng, &expected);
     CHECK_EQ(0, second.compare(Slice(expected)));
   }
 
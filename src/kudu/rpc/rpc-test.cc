@@ -32,13 +32,27 @@
 #include "kudu/rpc/serialization.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/test_util.h"
 
 METRIC_DECLARE_histogram(handler_latency_kudu_rpc_test_CalculatorService_Sleep);
+METRIC_DECLARE_histogram(read_latency_kudu_rpc_test_CalculatorService_Echo);
+METRIC_DECLARE_histogram(queue_latency_kudu_rpc_test_CalculatorService_Echo);
+METRIC_DECLARE_histogram(serialization_latency_kudu_rpc_test_CalculatorService_Echo);
+METRIC_DECLARE_histogram(write_latency_kudu_rpc_test_CalculatorService_Echo);
+METRIC_DECLARE_histogram(rpc_outbound_queue_time);
+METRIC_DECLARE_histogram(rpc_outbound_send_time);
+METRIC_DECLARE_histogram(rpc_outbound_wait_time);
+METRIC_DECLARE_histogram(rpc_outbound_response_read_time);
 METRIC_DECLARE_histogram(rpc_incoming_queue_time);
 
 DECLARE_int32(rpc_negotiation_inject_delay_ms);
+DECLARE_int32(rpc_num_connections_per_server);
+DECLARE_bool(tls_kernel_offload);
+DECLARE_int32(rpc_compression_min_bytes);
+DECLARE_string(rpc_compression_codec);
+DECLARE_bool(rpc_reuseport_acceptors);
 
 using std::shared_ptr;
 using std::string;
@@ -94,6 +108,78 @@ TEST_P(TestRpc, TestAcceptorPoolStartStop) {
   }
 }
 
+#if defined(__linux__)
+// Test accepting connections within the server's reactors, each listening on
+// its own SO_REUSEPORT socket.
+TEST_P(TestRpc, TestReusePortAcceptors) {
+  // Enough connections that the kernel all but certainly hashes them to more
+  // than one reactor's socket.
+  const int kNumClients = 32;
+  FLAGS_rpc_reuseport_acceptors = true;
+  n_server_reactor_threads_ = 4;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+  ASSERT_NE(0, server_addr.port());
+
+  vector<shared_ptr<Messenger>> client_messengers;
+  for (int i = 0; i < kNumClients; i++) {
+    shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+    Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+    client_messengers.emplace_back(std::move(client_messenger));
+  }
+
+  ReactorMetrics metrics;
+  ASSERT_OK(server_messenger_->GetReactorMetrics(&metrics));
+  ASSERT_EQ(kNumClients, metrics.num_server_connections_);
+  ASSERT_EQ(kNumClients, metrics.num_connections_accepted_);
+  // The reactors also negotiated the connections themselves.
+  ASSERT_EQ(kNumClients, metrics.num_reactor_negotiations_);
+
+  // The accepts should be spread across the reactors, not funneled through one.
+  vector<ReactorMetrics> per_reactor;
+  ASSERT_OK(server_messenger_->GetPerReactorMetrics(&per_reactor));
+  ASSERT_EQ(n_server_reactor_threads_, static_cast<int>(per_reactor.size()));
+  int reactors_accepting = 0;
+  for (const ReactorMetrics& m : per_reactor) {
+    if (m.num_connections_accepted_ > 0) {
+      reactors_accepting++;
+    }
+  }
+  ASSERT_GT(reactors_accepting, 1);
+}
+
+// Test that once an acceptor pool accepting on the reactors is shut down and
+// waited for, the port no longer accepts connections.
+TEST_P(TestRpc, TestReusePortAcceptorsShutdown) {
+  FLAGS_rpc_reuseport_acceptors = true;
+  shared_ptr<Messenger> messenger(CreateMessenger("TestReusePortAcceptorsShutdown", 4,
+                                                  GetParam()));
+  shared_ptr<AcceptorPool> pool;
+  ASSERT_OK(messenger->AddAcceptorPool(Sockaddr(), &pool));
+  Sockaddr bound_addr;
+  ASSERT_OK(pool->GetBoundAddress(&bound_addr));
+  ASSERT_OK(pool->Start(0));
+
+  // The reactors start listening asynchronously.
+  AssertEventually([&]() {
+    Socket sock;
+    ASSERT_OK(sock.Init(0));
+    ASSERT_OK(sock.Connect(bound_addr));
+  });
+
+  pool->Shutdown();
+  pool->WaitForShutdown();
+  Socket sock;
+  ASSERT_OK(sock.Init(0));
+  Status s = sock.Connect(bound_addr);
+  ASSERT_TRUE(s.IsNetworkError()) << s.ToString();
+  messenger->Shutdown();
+}
+#endif
+
 TEST_F(TestRpc, TestConnHeaderValidation) {
   MessengerBuilder mb("TestRpc.TestConnHeaderValidation");
   const int conn_hdr_len = kMagicNumberLength + kHeaderFlagsLength;
@@ -122,6 +208,114 @@ TEST_P(TestRpc, TestCall) {
   }
 }
 
+// Test making calls over TLS connections whose outbound records are encrypted
+// by the kernel, and that the peer can decrypt what the kernel sends. On hosts
+// without kTLS support the connections fall back to OpenSSL, and only the calls
+// are checked.
+TEST_F(TestRpc, TestCallWithKernelTls) {
+  FLAGS_tls_kernel_offload = true;
+
+  Sockaddr server_addr;
+  StartTestServer(&server_addr, true);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, true));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+  // Large sidecars span many TLS records and go through Writev().
+  DoTestSidecar(p, 1024 * 1024, 3 * 1024 * 1024);
+
+  // The kernel lists the "tls" upper layer protocol once its module is loaded,
+  // which offloading a connection does on demand.
+  faststring ulps;
+  Status s = ReadFileToString(env_, "/proc/sys/net/ipv4/tcp_available_ulp", &ulps);
+  if (!s.ok() || ulps.ToString().find("tls") == string::npos) {
+    LOG(INFO) << "Not checking that kernel TLS was used: the kernel does not support it";
+    return;
+  }
+  for (const auto& messenger : { server_messenger_, client_messenger }) {
+    ReactorMetrics metrics;
+    ASSERT_OK(messenger->GetReactorMetrics(&metrics));
+    ASSERT_GT(metrics.num_kernel_tls_connections_, 0) << messenger->name();
+  }
+}
+
+// Test that large request and response bodies survive being compressed with
+// each of the supported codecs.
+TEST_P(TestRpc, TestCompressedCalls) {
+  FLAGS_rpc_compression_min_bytes = 1024;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServerWithGeneratedCode(&server_addr, enable_ssl);
+
+  string data;
+  for (int i = 0; data.size() < 1024 * 1024; i++) {
+    strings::SubstituteAndAppend(&data, "row $0;", i);
+  }
+  for (const char* codec : { "lz4", "snappy", "zlib" }) {
+    SCOPED_TRACE(codec);
+    // The codec is picked up when a connection finishes negotiating, so
+    // a new client messenger is needed for each.
+    FLAGS_rpc_compression_codec = codec;
+    shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+    CalculatorServiceProxy p(client_messenger, server_addr);
+
+    EchoRequestPB req;
+    req.set_data(data);
+    EchoResponsePB resp;
+    RpcController controller;
+    controller.set_timeout(MonoDelta::FromSeconds(10));
+    // Requests queued before the connection finishes negotiating aren't
+    // compressed, so establish it with a small call first.
+    {
+      EchoRequestPB small_req;
+      small_req.set_data("x");
+      EchoResponsePB small_resp;
+      RpcController small_controller;
+      ASSERT_OK(p.Echo(small_req, &small_resp, &small_controller));
+    }
+
+    ReactorMetrics server_before;
+    ASSERT_OK(server_messenger_->GetReactorMetrics(&server_before));
+    ASSERT_OK(p.Echo(req, &resp, &controller));
+    ASSERT_EQ(data, resp.data());
+
+    // Both the request and the response should have gone out compressed.
+    ReactorMetrics metrics;
+    ASSERT_OK(server_messenger_->GetReactorMetrics(&metrics));
+    ASSERT_EQ(server_before.num_compressed_bodies_received_ + 1,
+              metrics.num_compressed_bodies_received_);
+    ASSERT_OK(client_messenger->GetReactorMetrics(&metrics));
+    ASSERT_EQ(1, metrics.num_compressed_bodies_received_);
+  }
+}
+
+// Test that responses with sidecars are intact with compression enabled, both
+// when the sidecars compress and when they hold random data, which has to fall
+// back to being sent as is.
+TEST_P(TestRpc, TestCompressedSidecars) {
+  FLAGS_rpc_compression_min_bytes = 1024;
+  FLAGS_rpc_compression_codec = "lz4";
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  DoTestSidecar(p, 123, 456);
+  DoTestSidecar(p, 1024 * 1024, 3 * 1024 * 1024);
+  ReactorMetrics metrics;
+  ASSERT_OK(client_messenger->GetReactorMetrics(&metrics));
+  ASSERT_EQ(0, metrics.num_compressed_bodies_received_);
+
+  DoTestSidecar(p, 1024 * 1024, 3 * 1024 * 1024, true);
+  ASSERT_OK(client_messenger->GetReactorMetrics(&metrics));
+  ASSERT_EQ(1, metrics.num_compressed_bodies_received_);
+}
+
 // Test that connecting to an invalid server properly throws an error.
 TEST_P(TestRpc, TestCallToBadServer) {
   shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, GetParam()));
@@ -205,6 +399,60 @@ TEST_P(TestRpc, TestHighFDs) {
   ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
 }
 
+// Test that the buffers that frames are received into are reused across calls.
+TEST_P(TestRpc, TestInboundBuffersArePooled) {
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  const int kNumCalls = 10;
+  for (int i = 0; i < kNumCalls; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+
+  // Each call is a request frame received by the server and a response frame
+  // received by the client. Since the calls are made one at a time, buffers
+  // should be handed back to the pool in time to be reused by later calls.
+  for (const auto& messenger : { server_messenger_, client_messenger }) {
+    ReactorMetrics metrics;
+    ASSERT_OK(messenger->GetReactorMetrics(&metrics));
+    ASSERT_EQ(kNumCalls,
+              metrics.num_inbound_buffers_allocated_ + metrics.num_inbound_buffers_reused_);
+    ASSERT_GT(metrics.num_inbound_buffers_reused_, 0);
+  }
+}
+
+// Test that calls from a proxy are spread across the configured number of
+// connections to the server, on different reactor threads.
+TEST_P(TestRpc, TestMultipleConnectionsPerServer) {
+  const int kNumConnections = 3;
+  FLAGS_rpc_num_connections_per_server = kNumConnections;
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+  shared_ptr<Messenger> client_messenger(
+      CreateMessenger("Client", kNumConnections, enable_ssl));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  for (int i = 0; i < kNumConnections * 2; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+
+  ReactorMetrics metrics;
+  ASSERT_OK(client_messenger->GetReactorMetrics(&metrics));
+  ASSERT_EQ(kNumConnections, metrics.num_client_connections_);
+  ASSERT_OK(server_messenger_->GetReactorMetrics(&metrics));
+  ASSERT_EQ(kNumConnections, metrics.num_server_connections_);
+
+  // Each connection should be handled by a different client reactor.
+  for (int i = 0; i < kNumConnections; i++) {
+    ASSERT_OK(client_messenger->reactors_[i]->GetMetrics(&metrics));
+    ASSERT_EQ(1, metrics.num_client_connections_);
+  }
+}
+
 // Test that connections are kept alive between calls.
 TEST_P(TestRpc, TestConnectionKeepalive) {
   // Only run one reactor per messenger, so we can grab the metrics from that
@@ -505,6 +753,55 @@ TEST_P(TestRpc, TestRpcHandlerLatencyMetric) {
   ASSERT_TRUE(FindOrDie(metric_map, &METRIC_rpc_incoming_queue_time));
 }
 
+// Test that the time spent in each phase of a call is recorded, on both the
+// server and the client side.
+TEST_P(TestRpc, TestRpcPhaseLatencyMetrics) {
+  const int kNumCalls = 5;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServerWithGeneratedCode(&server_addr, enable_ssl);
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  CalculatorServiceProxy p(client_messenger, server_addr);
+
+  EchoRequestPB req;
+  req.set_data(string(1024 * 1024, 'x'));
+  for (int i = 0; i < kNumCalls; i++) {
+    EchoResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(p.Echo(req, &resp, &controller));
+  }
+
+  auto get_histogram = [](const shared_ptr<Messenger>& messenger,
+                          const MetricPrototype* prototype) {
+    return down_cast<Histogram*>(FindOrDie(
+        messenger->metric_entity()->UnsafeMetricsMapForTests(), prototype).get());
+  };
+
+  // The server records the time spent writing a response once it's been
+  // written, which may be just after the client has received it.
+  for (const MetricPrototype* prototype :
+           vector<const MetricPrototype*>({
+               &METRIC_read_latency_kudu_rpc_test_CalculatorService_Echo,
+               &METRIC_queue_latency_kudu_rpc_test_CalculatorService_Echo,
+               &METRIC_serialization_latency_kudu_rpc_test_CalculatorService_Echo,
+               &METRIC_write_latency_kudu_rpc_test_CalculatorService_Echo })) {
+    SCOPED_TRACE(prototype->name());
+    AssertEventually([&]() {
+      ASSERT_EQ(kNumCalls, get_histogram(server_messenger_, prototype)->TotalCount());
+    });
+  }
+  for (const MetricPrototype* prototype :
+           vector<const MetricPrototype*>({
+               &METRIC_rpc_outbound_queue_time,
+               &METRIC_rpc_outbound_send_time,
+               &METRIC_rpc_outbound_wait_time,
+               &METRIC_rpc_outbound_response_read_time })) {
+    SCOPED_TRACE(prototype->name());
+    ASSERT_EQ(kNumCalls, get_histogram(client_messenger, prototype)->TotalCount());
+  }
+}
+
 static void DestroyMessengerCallback(shared_ptr<Messenger>* messenger,
                                      CountDownLatch* latch) {
   messenger->reset();
@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/rpc.h"
 
+#include <algorithm>
 #include <boost/bind.hpp>
 #include <string>
 
@@ -61,6 +62,10 @@ void RpcRetrier::DelayedRetry(Rpc* rpc, const Status& why_status) {
   // If the delay causes us to miss our deadline, RetryCb will fail the
   // RPC on our behalf.
   int num_ms = ++attempt_num_ + ((rand() % 5));
+
+  // If the server asked us to back off for longer, honor that. The controller
+  // still holds the failed call's response at this point.
+  num_ms = std::max<int64_t>(num_ms, controller_.server_retry_after().ToMilliseconds());
   messenger_->ScheduleOnReactor(boost::bind(&RpcRetrier::DelayedRetryCb,
                                             this,
                                             rpc, _1),
@@ -42,7 +42,9 @@ RpcContext::RpcContext(InboundCall *call,
   : call_(CHECK_NOTNULL(call)),
     request_pb_(request_pb),
     response_pb_(response_pb),
-    result_tracker_(result_tracker) {
+    result_tracker_(result_tracker),
+    method_info_(call->method_info()),
+    request_size_(call->serialized_request().size()) {
   VLOG(4) << call_->remote_method().service_name() << ": Received RPC request for "
           << call_->ToString() << ":" << std::endl << SecureDebugString(*request_pb_);
   TRACE_EVENT_ASYNC_BEGIN2("rpc_call", "RPC", this,
@@ -51,6 +53,14 @@ RpcContext::RpcContext(InboundCall *call,
 }
 
 RpcContext::~RpcContext() {
+  if (method_info_) {
+    method_info_->req_pool.Recycle(
+        const_cast<google::protobuf::Message*>(request_pb_.release()), request_size_);
+    // The response may never have been serialized, so its cached size can't
+    // be relied upon.
+    int64_t response_size = response_pb_->ByteSize();
+    method_info_->resp_pool.Recycle(response_pb_.release(), response_size);
+  }
 }
 
 void RpcContext::RespondSuccess() {
@@ -161,6 +171,14 @@ MonoTime RpcContext::GetClientDeadline() const {
   return call_->GetClientDeadline();
 }
 
+MonoDelta RpcContext::GetTimeInQueue() const {
+  const InboundCallTiming& timing = call_->timing();
+  if (!timing.time_handled.Initialized()) {
+    return MonoDelta::FromNanoseconds(0);
+  }
+  return timing.time_handled - timing.time_received;
+}
+
 Trace* RpcContext::trace() {
   return call_->trace();
 }
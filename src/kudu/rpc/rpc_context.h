@@ -174,6 +174,10 @@ class RpcContext {
   // If the client did not specify a deadline, returns MonoTime::Max().
   MonoTime GetClientDeadline() const;
 
+  // Return the time this call waited in the service queue before its
+  // handler was started.
+  MonoDelta GetTimeInQueue() const;
+
   // Whether the results of this RPC are tracked with a ResultTracker.
   // If this returns true, both result_tracker() and request_id() should return non-null results.
   bool AreResultsTracked() const { return result_tracker_.get() != nullptr; }
@@ -197,9 +201,17 @@ class RpcContext {
  private:
   friend class ResultTracker;
   InboundCall* const call_;
-  const gscoped_ptr<const google::protobuf::Message> request_pb_;
-  const gscoped_ptr<google::protobuf::Message> response_pb_;
+  gscoped_ptr<const google::protobuf::Message> request_pb_;
+  gscoped_ptr<google::protobuf::Message> response_pb_;
   scoped_refptr<ResultTracker> result_tracker_;
+
+  // The method being called, whose message pools the request and response
+  // are handed back to when this context is destroyed.
+  const scoped_refptr<RpcMethodInfo> method_info_;
+
+  // The size of the serialized request, which bounds the memory that the
+  // request message holds on to once it is cleared for reuse.
+  const int64_t request_size_;
 };
 
 } // namespace rpc
@@ -76,6 +76,16 @@ const ErrorStatusPB* RpcController::error_response() const {
   return nullptr;
 }
 
+MonoDelta RpcController::server_retry_after() const {
+  const ErrorStatusPB* err = error_response();
+  if (err &&
+      err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY &&
+      err->has_retry_after_ms()) {
+    return MonoDelta::FromMilliseconds(err->retry_after_ms());
+  }
+  return MonoDelta::FromMilliseconds(0);
+}
+
 Status RpcController::GetSidecar(int idx, Slice* sidecar) const {
   return call_->call_response_->GetSidecar(idx, sidecar);
 }
@@ -84,6 +84,11 @@ class RpcController {
   // The returned pointer is only valid as long as the controller object.
   const ErrorStatusPB* error_response() const;
 
+  // If the call failed with ERROR_SERVER_TOO_BUSY and the server suggested how
+  // long to wait before retrying, returns that duration. Otherwise, returns a
+  // zero duration.
+  MonoDelta server_retry_after() const;
+
   // Set the timeout for the call to be made with this RPC controller.
   //
   // The configured timeout applies to the entire time period between
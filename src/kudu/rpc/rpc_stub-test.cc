@@ -577,30 +577,34 @@ TEST_F(RpcStubTest, TestDumpSampledCalls) {
     sleep.latch.Wait();
   }
 
-  // Dump the sampled RPCs and expect to see the calls
-  // above.
-
-  DumpRpczStoreResponsePB sampled_rpcs;
-  server_messenger_->rpcz_store()->DumpPB(DumpRpczStoreRequestPB(), &sampled_rpcs);
-  EXPECT_EQ(sampled_rpcs.methods_size(), 1);
-  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
-                      "    metrics {\n"
-                      "      key: \"test_sleep_us\"\n"
-                      "      value: 150000\n"
-                      "    }\n");
-  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
-                      "    metrics {\n"
-                      "      key: \"test_sleep_us\"\n"
-                      "      value: 1500000\n"
-                      "    }\n");
-  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
-                      "    metrics {\n"
-                      "      child_path: \"test_child\"\n"
-                      "      key: \"related_trace_metric\"\n"
-                      "      value: 1\n"
-                      "    }");
-  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "SleepRequestPB");
-  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "duration_ms");
+  // Dump the sampled RPCs and expect to see the calls above. Calls are
+  // only sampled once their responses have been written, which may happen
+  // after the client has already received them.
+  AssertEventually([&]() {
+    DumpRpczStoreResponsePB sampled_rpcs;
+    server_messenger_->rpcz_store()->DumpPB(DumpRpczStoreRequestPB(), &sampled_rpcs);
+    ASSERT_EQ(sampled_rpcs.methods_size(), 1);
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
+                        "    metrics {\n"
+                        "      key: \"test_sleep_us\"\n"
+                        "      value: 150000\n"
+                        "    }\n");
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
+                        "    metrics {\n"
+                        "      key: \"test_sleep_us\"\n"
+                        "      value: 1500000\n"
+                        "    }\n");
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
+                        "    metrics {\n"
+                        "      child_path: \"test_child\"\n"
+                        "      key: \"related_trace_metric\"\n"
+                        "      value: 1\n"
+                        "    }");
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "SleepRequestPB");
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "duration_ms");
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "handler_micros");
+    ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "write_micros");
+  });
 }
 
 namespace {
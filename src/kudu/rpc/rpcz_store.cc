@@ -31,7 +31,9 @@
 #include "kudu/rpc/service_if.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
 
@@ -41,6 +43,7 @@ TAG_FLAG(rpc_dump_all_traces, advanced);
 TAG_FLAG(rpc_dump_all_traces, runtime);
 
 using std::pair;
+using std::string;
 using std::vector;
 using std::unique_ptr;
 
@@ -82,6 +85,7 @@ class MethodSampler {
     RequestHeader header;
     scoped_refptr<Trace> trace;
     int duration_ms;
+    InboundCallTiming timing;
   };
 
   // A sample, including the particular time at which it was
@@ -139,7 +143,7 @@ void MethodSampler::SampleCall(InboundCall* call) {
   MicrosecondsInt64 now = GetMonoTimeMicros();
   int64_t us_since_trace = now - bucket->last_sample_time.Load();
   if (us_since_trace > kSampleIntervalMs * 1000) {
-    Sample new_sample = {call->header(), call->trace(), duration_ms};
+    Sample new_sample = {call->header(), call->trace(), duration_ms, call->timing()};
     {
       std::unique_lock<simple_spinlock> lock(bucket->sample_lock, std::try_to_lock);
       // If another thread is already taking a sample, it's not worth waiting.
@@ -187,11 +191,39 @@ void MethodSampler::GetSamplePBs(RpczMethodPB* method_pb) {
 
     GetTraceMetrics(*bucket.sample.trace.get(), "", sample_pb);
     sample_pb->set_duration_ms(bucket.sample.duration_ms);
+
+    const InboundCallTiming& timing = bucket.sample.timing;
+    if (timing.ReadDuration().Initialized()) {
+      sample_pb->set_read_micros(timing.ReadDuration().ToMicroseconds());
+    }
+    if (timing.QueueDuration().Initialized()) {
+      sample_pb->set_queue_micros(timing.QueueDuration().ToMicroseconds());
+    }
+    if (timing.HandlerDuration().Initialized()) {
+      sample_pb->set_handler_micros(timing.HandlerDuration().ToMicroseconds());
+    }
+    if (timing.SerializationDuration().Initialized()) {
+      sample_pb->set_serialization_micros(timing.SerializationDuration().ToMicroseconds());
+    }
+    if (timing.WriteDuration().Initialized()) {
+      sample_pb->set_write_micros(timing.WriteDuration().ToMicroseconds());
+    }
   }
 }
 
-RpczStore::RpczStore() {}
-RpczStore::~RpczStore() {}
+RpczStore::RpczStore() {
+  // Bound the queue so that a flood of slow calls can't pile up traces in
+  // memory; past that, their logging is dropped.
+  CHECK_OK(ThreadPoolBuilder("rpcz-log")
+              .set_min_threads(0)
+              .set_max_threads(1)
+              .set_max_queue_size(1000)
+              .Build(&log_pool_));
+}
+
+RpczStore::~RpczStore() {
+  log_pool_->Shutdown();
+}
 
 void RpczStore::AddCall(InboundCall* call) {
   LogTrace(call);
@@ -223,30 +255,67 @@ void RpczStore::DumpPB(const DumpRpczStoreRequestPB& req,
   }
 }
 
-void RpczStore::LogTrace(InboundCall* call) {
-  int duration_ms = call->timing().TotalDuration().ToMilliseconds();
+namespace {
+// How a completed call's trace is to be logged.
+enum class TraceLogMode {
+  // The call likely timed out on the client: log the whole trace as a WARNING.
+  kTimedOut,
+  // --rpc_dump_all_traces is set: log the whole trace.
+  kDumpAll,
+  // The call was slow: log the trace's metrics.
+  kSlow,
+};
 
-  if (call->header_.has_timeout_millis() && call->header_.timeout_millis() > 0) {
-    double log_threshold = call->header_.timeout_millis() * 0.75f;
-    if (duration_ms > log_threshold) {
-      // TODO: consider pushing this onto another thread since it may be slow.
-      // The traces may also be too large to fit in a log message.
-      LOG(WARNING) << call->ToString() << " took " << duration_ms << "ms (client timeout "
-                   << call->header_.timeout_millis() << ").";
-      std::string s = call->trace()->DumpToString();
+void DoLogTrace(TraceLogMode mode, const string& call_str, int duration_ms,
+                uint32_t timeout_ms, const scoped_refptr<Trace>& trace) {
+  switch (mode) {
+    case TraceLogMode::kTimedOut: {
+      // The traces may be too large to fit in a log message.
+      LOG(WARNING) << call_str << " took " << duration_ms << "ms (client timeout "
+                   << timeout_ms << ").";
+      string s = trace->DumpToString();
       if (!s.empty()) {
         LOG(WARNING) << "Trace:\n" << s;
       }
-      return;
+      break;
     }
+    case TraceLogMode::kDumpAll:
+      LOG(INFO) << call_str << " took " << duration_ms << "ms. Trace:";
+      trace->Dump(&LOG(INFO), true);
+      break;
+    case TraceLogMode::kSlow:
+      LOG(INFO) << call_str << " took " << duration_ms << "ms. "
+                << "Request Metrics: " << trace->MetricsAsJSON();
+      break;
   }
+}
+} // anonymous namespace
 
-  if (PREDICT_FALSE(FLAGS_rpc_dump_all_traces)) {
-    LOG(INFO) << call->ToString() << " took " << duration_ms << "ms. Trace:";
-    call->trace()->Dump(&LOG(INFO), true);
+void RpczStore::LogTrace(InboundCall* call) {
+  int duration_ms = call->timing().TotalDuration().ToMilliseconds();
+  uint32_t timeout_ms = 0;
+
+  TraceLogMode mode;
+  if (call->header_.has_timeout_millis() && call->header_.timeout_millis() > 0 &&
+      duration_ms > call->header_.timeout_millis() * 0.75f) {
+    mode = TraceLogMode::kTimedOut;
+    timeout_ms = call->header_.timeout_millis();
+  } else if (PREDICT_FALSE(FLAGS_rpc_dump_all_traces)) {
+    mode = TraceLogMode::kDumpAll;
   } else if (duration_ms > 1000) {
-    LOG(INFO) << call->ToString() << " took " << duration_ms << "ms. "
-              << "Request Metrics: " << call->trace()->MetricsAsJSON();
+    mode = TraceLogMode::kSlow;
+  } else {
+    return;
+  }
+
+  string call_str = call->ToString();
+  scoped_refptr<Trace> trace(call->trace());
+  Status s = log_pool_->SubmitFunc([=]() {
+      DoLogTrace(mode, call_str, duration_ms, timeout_ms, trace);
+    });
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 1) << "Not logging trace of " << call_str << " which took "
+                                  << duration_ms << "ms: " << s.ToString() << THROTTLE_MSG;
   }
 }
 
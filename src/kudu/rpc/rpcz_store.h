@@ -16,6 +16,7 @@
 // under the License.
 #pragma once
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 
 #include <memory>
@@ -24,6 +25,9 @@
 #include "kudu/util/locks.h"
 
 namespace kudu {
+
+class ThreadPool;
+
 namespace rpc {
 
 class DumpRpczStoreRequestPB;
@@ -60,8 +64,14 @@ class RpczStore {
   // client likely timed out. This is based on the client-provided timeout
   // value.
   // Also can be configured to log _all_ RPC traces for help debugging.
+  //
+  // Calls are added from the reactor threads, so this only decides whether
+  // to log; dumping the trace and logging happen on 'log_pool_'.
   void LogTrace(InboundCall* call);
 
+  // Single thread on which traces are dumped and logged.
+  gscoped_ptr<ThreadPool> log_pool_;
+
   percpu_rwlock samplers_lock_;
 
   // Protected by samplers_lock_.
@@ -25,6 +25,7 @@
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/slice.h"
@@ -35,6 +36,7 @@ DECLARE_int32(rpc_max_message_size);
 using google::protobuf::MessageLite;
 using google::protobuf::io::CodedInputStream;
 using google::protobuf::io::CodedOutputStream;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -153,6 +155,52 @@ Status ParseMessage(const Slice& buf,
   return Status::OK();
 }
 
+Status CompressMessageBody(const CompressionCodec& codec,
+                           const vector<Slice>& body,
+                           faststring* compressed_buf,
+                           uint32_t* uncompressed_size) {
+  size_t body_size = 0;
+  for (const Slice& s : body) {
+    body_size += s.size();
+  }
+
+  // Compress after the largest possible length prefix, then move the data
+  // down if the actual prefix turns out to be shorter.
+  size_t max_compressed_len = codec.MaxCompressedLength(body_size);
+  int max_prefix_len = CodedOutputStream::VarintSize32(max_compressed_len);
+  compressed_buf->resize(max_prefix_len + max_compressed_len);
+  size_t compressed_len;
+  RETURN_NOT_OK(codec.Compress(body, compressed_buf->data() + max_prefix_len, &compressed_len));
+
+  int prefix_len = CodedOutputStream::VarintSize32(compressed_len);
+  if (prefix_len != max_prefix_len) {
+    memmove(compressed_buf->data() + prefix_len, compressed_buf->data() + max_prefix_len,
+            compressed_len);
+  }
+  CodedOutputStream::WriteVarint32ToArray(compressed_len, compressed_buf->data());
+  compressed_buf->resize(prefix_len + compressed_len);
+  *uncompressed_size = body_size;
+  return Status::OK();
+}
+
+Status DecompressMessageBody(CompressionType type,
+                             uint32_t uncompressed_size,
+                             const Slice& compressed,
+                             faststring* uncompressed_buf) {
+  if (PREDICT_FALSE(uncompressed_size > FLAGS_rpc_max_message_size)) {
+    return Status::Corruption(Substitute(
+        "Invalid packet: uncompressed body of $0 bytes exceeds the maximum "
+        "message size of $1 bytes", uncompressed_size, FLAGS_rpc_max_message_size));
+  }
+  const CompressionCodec* codec;
+  RETURN_NOT_OK(GetCompressionCodec(type, &codec));
+  if (PREDICT_FALSE(codec == nullptr)) {
+    return Status::Corruption("Invalid packet: no codec set for compressed body");
+  }
+  uncompressed_buf->resize(uncompressed_size);
+  return codec->Uncompress(compressed, uncompressed_buf->data(), uncompressed_size);
+}
+
 void SerializeConnHeader(uint8_t* buf) {
   memcpy(reinterpret_cast<char *>(buf), kMagicNumber, kMagicNumberLength);
   buf += kMagicNumberLength;
@@ -21,6 +21,10 @@
 #include <inttypes.h>
 #include <string.h>
 
+#include <vector>
+
+#include "kudu/util/compression/compression.pb.h"
+
 namespace google {
 namespace protobuf {
 class MessageLite;
@@ -29,6 +33,7 @@ class MessageLite;
 
 namespace kudu {
 
+class CompressionCodec;
 class Status;
 class faststring;
 class Slice;
@@ -74,6 +79,28 @@ Status ParseMessage(const Slice& buf,
                     google::protobuf::MessageLite* parsed_header,
                     Slice* parsed_main_message);
 
+// Compress the concatenation of 'body' (a serialized main message and any
+// sidecars, without the main message's length prefix) as a single block.
+// In:  'codec' to compress with,
+//      'body' slices to compress.
+// Out: 'compressed_buf' populated with the varint length prefix and the
+//        compressed bytes, ready to be sent in place of the main message.
+//      'uncompressed_size' set to the total size of 'body'.
+Status CompressMessageBody(const CompressionCodec& codec,
+                           const std::vector<Slice>& body,
+                           faststring* compressed_buf,
+                           uint32_t* uncompressed_size);
+
+// Decompress a main message compressed by CompressMessageBody().
+// In:  'type' and 'uncompressed_size' as recorded in the message header,
+//      'compressed' main message, as returned by ParseMessage().
+// Out: 'uncompressed_buf' populated with the original main message and
+//        sidecars.
+Status DecompressMessageBody(CompressionType type,
+                             uint32_t uncompressed_size,
+                             const Slice& compressed,
+                             faststring* uncompressed_buf);
+
 // Serialize the RPC connection header (magic number + flags).
 // buf must have 7 bytes available (kMagicNumberLength + kHeaderFlagsLength).
 void SerializeConnHeader(uint8_t* buf);
@@ -17,6 +17,9 @@
 
 #include "kudu/rpc/server_negotiation.h"
 
+#include <poll.h>
+
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <set>
@@ -34,11 +37,13 @@
 #include "kudu/rpc/serialization.h"
 #include "kudu/security/tls_context.h"
 #include "kudu/security/tls_handshake.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/trace.h"
 
+using google::protobuf::MessageLite;
 using std::set;
 using std::string;
 using std::unique_ptr;
@@ -68,7 +73,8 @@ ServerNegotiation::ServerNegotiation(unique_ptr<Socket> socket)
       helper_(SaslHelper::SERVER),
       tls_context_(nullptr),
       negotiated_mech_(SaslMechanism::INVALID),
-      deadline_(MonoTime::Max()) {
+      deadline_(MonoTime::Max()),
+      step_(Step::kConnectionHeader) {
   callbacks_.push_back(SaslBuildCallback(SASL_CB_GETOPT,
       reinterpret_cast<int (*)()>(&ServerNegotiationGetoptCb), this));
   callbacks_.push_back(SaslBuildCallback(SASL_CB_SERVER_USERDB_CHECKPASS,
@@ -115,59 +121,218 @@ void ServerNegotiation::set_deadline(const MonoTime& deadline) {
 
 Status ServerNegotiation::Negotiate() {
   TRACE("Beginning negotiation");
+  RETURN_NOT_OK(socket_->SetNonBlocking(true));
+  while (true) {
+    if (PREDICT_FALSE(MonoTime::Now() >= deadline_)) {
+      return Status::TimedOut("timed out negotiating with the client");
+    }
+    Status s = ContinueNegotiation();
+    if (!s.IsIncomplete()) {
+      return s;
+    }
+    RETURN_NOT_OK(WaitForSocket());
+  }
+}
 
-  // Ensure we can use blocking calls on the socket during negotiation.
-  RETURN_NOT_OK(EnsureBlockingMode(socket_.get()));
-
-  faststring recv_buf;
+Status ServerNegotiation::ContinueNegotiation() {
+  while (true) {
+    RETURN_NOT_OK(FlushSendBuffer());
+    if (!send_buf_.empty()) {
+      return Status::Incomplete("waiting to send to the client");
+    }
 
-  // Step 1: Read the connection header.
-  RETURN_NOT_OK(ValidateConnectionHeader(&recv_buf));
+    switch (step_) {
+      case Step::kDone:
+        return Status::OK();
+      case Step::kTlsFinish:
+        // The last handshake message has been sent in the clear, so the
+        // socket can now be switched over to TLS.
+        RETURN_NOT_OK(tls_handshake_.Finish(&socket_));
+        RETURN_NOT_OK(InitSaslServer());
+        step_ = Step::kSaslInitiate;
+        continue;
+      default:
+        break;
+    }
 
-  { // Step 2: Receive and respond to the NEGOTIATE step message.
-    NegotiatePB request;
-    RETURN_NOT_OK(RecvNegotiatePB(&request, &recv_buf));
-    RETURN_NOT_OK(HandleNegotiate(request));
+    bool complete;
+    RETURN_NOT_OK(RecvNonBlocking(&complete));
+    if (!complete) {
+      return Status::Incomplete("waiting for the client");
+    }
+    RETURN_NOT_OK(HandleMessage());
+    recv_buf_.clear();
   }
+}
 
-  // Step 3: if both ends support TLS, do a TLS handshake.
-  // TODO(dan): allow the server to require TLS.
-  if (tls_context_ && ContainsKey(client_features_, TLS)) {
-    RETURN_NOT_OK(tls_context_->InitiateHandshake(security::TlsHandshakeType::SERVER,
-                                                  &tls_handshake_));
-    while (true) {
+Status ServerNegotiation::HandleMessage() {
+  switch (step_) {
+    case Step::kConnectionHeader:
+      // Step 1: Read the connection header.
+      RETURN_NOT_OK(ValidateConnectionHeader());
+      step_ = Step::kNegotiate;
+      return Status::OK();
+
+    case Step::kNegotiate: {
+      // Step 2: Receive and respond to the NEGOTIATE step message.
       NegotiatePB request;
-      RETURN_NOT_OK(RecvNegotiatePB(&request, &recv_buf));
+      RETURN_NOT_OK(ParseNegotiatePB(&request));
+      RETURN_NOT_OK(HandleNegotiate(request));
+
+      // Step 3: if both ends support TLS, do a TLS handshake.
+      // TODO(dan): allow the server to require TLS.
+      if (tls_context_ && ContainsKey(client_features_, TLS)) {
+        RETURN_NOT_OK(tls_context_->InitiateHandshake(security::TlsHandshakeType::SERVER,
+                                                      &tls_handshake_));
+        step_ = Step::kTlsHandshake;
+      } else {
+        RETURN_NOT_OK(InitSaslServer());
+        step_ = Step::kSaslInitiate;
+      }
+      return Status::OK();
+    }
+
+    case Step::kTlsHandshake: {
+      NegotiatePB request;
+      RETURN_NOT_OK(ParseNegotiatePB(&request));
       Status s = HandleTlsHandshake(request);
-      if (s.ok()) break;
-      if (!s.IsIncomplete()) return s;
+      if (s.ok()) {
+        step_ = Step::kTlsFinish;
+      } else if (!s.IsIncomplete()) {
+        return s;
+      }
+      return Status::OK();
     }
+
+    case Step::kSaslInitiate:
+    case Step::kSaslResponse: {
+      // Step 4: SASL negotiation.
+      NegotiatePB request;
+      RETURN_NOT_OK(ParseNegotiatePB(&request));
+      Status s = step_ == Step::kSaslInitiate ? HandleSaslInitiate(request)
+                                              : HandleSaslResponse(request);
+      if (s.IsIncomplete()) {
+        step_ = Step::kSaslResponse;
+        return Status::OK();
+      }
+      RETURN_NOT_OK(s);
+
+      const char* username = nullptr;
+      int rc = sasl_getprop(sasl_conn_.get(), SASL_USERNAME,
+                            reinterpret_cast<const void**>(&username));
+      // We expect that SASL_USERNAME will always get set.
+      CHECK(rc == SASL_OK && username != nullptr) << "No username on authenticated connection";
+      authenticated_user_ = username;
+      step_ = Step::kConnectionContext;
+      return Status::OK();
+    }
+
+    case Step::kConnectionContext:
+      // Step 5: Receive connection context.
+      RETURN_NOT_OK(ParseConnectionContext());
+      step_ = Step::kDone;
+      TRACE("Negotiation successful");
+      return Status::OK();
+
+    case Step::kTlsFinish:
+    case Step::kDone:
+      break;
   }
+  LOG(FATAL) << "unexpected negotiation step";
+  return Status::OK();
+}
 
-  // Step 4: SASL negotiation.
-  RETURN_NOT_OK(InitSaslServer());
-  {
-    NegotiatePB request;
-    RETURN_NOT_OK(RecvNegotiatePB(&request, &recv_buf));
-    Status s = HandleSaslInitiate(request);
+Status ServerNegotiation::RecvNonBlocking(bool* complete) {
+  *complete = false;
+  while (true) {
+    size_t needed;
+    if (step_ == Step::kConnectionHeader) {
+      needed = kMagicNumberLength + kHeaderFlagsLength;
+    } else if (recv_buf_.size() < kMsgLengthPrefixLength) {
+      needed = kMsgLengthPrefixLength;
+    } else {
+      uint32_t payload_len;
+      RETURN_NOT_OK(ParseMessageLengthPrefix(recv_buf_.data(), &payload_len));
+      needed = kMsgLengthPrefixLength + payload_len;
+    }
+    if (recv_buf_.size() == needed) {
+      *complete = true;
+      return Status::OK();
+    }
 
-    while (s.IsIncomplete()) {
-      RETURN_NOT_OK(RecvNegotiatePB(&request, &recv_buf));
-      s = HandleSaslResponse(request);
+    size_t received = recv_buf_.size();
+    recv_buf_.resize(needed);
+    int32_t nread = 0;
+    Status s = socket_->Recv(recv_buf_.data() + received, needed - received, &nread);
+    recv_buf_.resize(received + nread);
+    if (!s.ok()) {
+      if (Socket::IsTemporarySocketError(s.posix_code())) {
+        return Status::OK();
+      }
+      return s;
+    }
+    if (nread == 0) {
+      // A TLS socket reports that it has nothing to read this way.
+      return Status::OK();
     }
-    RETURN_NOT_OK(s);
   }
-  const char* username = nullptr;
-  int rc = sasl_getprop(sasl_conn_.get(), SASL_USERNAME,
-                        reinterpret_cast<const void**>(&username));
-  // We expect that SASL_USERNAME will always get set.
-  CHECK(rc == SASL_OK && username != nullptr) << "No username on authenticated connection";
-  authenticated_user_ = username;
+}
 
-  // Step 5: Receive connection context.
-  RETURN_NOT_OK(RecvConnectionContext(&recv_buf));
+Status ServerNegotiation::WaitForSocket() {
+  struct pollfd poll_fd;
+  poll_fd.fd = socket_->GetFd();
+  poll_fd.events = wants_write() ? POLLOUT : POLLIN;
+  poll_fd.revents = 0;
+  while (true) {
+    MonoDelta remaining = deadline_ - MonoTime::Now();
+    if (PREDICT_FALSE(remaining.ToNanoseconds() <= 0)) {
+      return Status::TimedOut("timed out negotiating with the client");
+    }
+    int timeout_ms = static_cast<int>(std::min<int64_t>(remaining.ToMilliseconds() + 1,
+                                                        std::numeric_limits<int>::max()));
+    int ready = poll(&poll_fd, 1, timeout_ms);
+    if (ready > 0) {
+      return Status::OK();
+    }
+    if (ready < 0) {
+      int err = errno;
+      if (err != EINTR) {
+        return Status::NetworkError("error from poll() during negotiation",
+                                    ErrnoToString(err), err);
+      }
+    }
+  }
+}
+
+Status ServerNegotiation::SendFramedMessage(const MessageLite& header, const MessageLite& msg) {
+  DCHECK(header.IsInitialized()) << "header protobuf must be initialized";
+  DCHECK(msg.IsInitialized()) << "msg protobuf must be initialized";
+  faststring param_buf;
+  serialization::SerializeMessage(msg, &param_buf);
+  faststring header_buf;
+  serialization::SerializeHeader(header, param_buf.size(), &header_buf);
+  send_buf_.append(reinterpret_cast<const char*>(header_buf.data()), header_buf.size());
+  send_buf_.append(reinterpret_cast<const char*>(param_buf.data()), param_buf.size());
+  return FlushSendBuffer();
+}
 
-  TRACE("Negotiation successful");
+Status ServerNegotiation::FlushSendBuffer() {
+  while (!send_buf_.empty()) {
+    int32_t nwritten = 0;
+    Status s = socket_->Write(reinterpret_cast<const uint8_t*>(send_buf_.data()),
+                              send_buf_.size(), &nwritten);
+    if (!s.ok()) {
+      if (Socket::IsTemporarySocketError(s.posix_code())) {
+        return Status::OK();
+      }
+      return s;
+    }
+    if (nwritten == 0) {
+      // A TLS socket reports that its send buffer is full this way.
+      return Status::OK();
+    }
+    send_buf_.erase(0, nwritten);
+  }
   return Status::OK();
 }
 
@@ -215,10 +380,10 @@ Status ServerNegotiation::PreflightCheckGSSAPI() {
   return Status::RuntimeError(err_msg);
 }
 
-Status ServerNegotiation::RecvNegotiatePB(NegotiatePB* msg, faststring* recv_buf) {
+Status ServerNegotiation::ParseNegotiatePB(NegotiatePB* msg) {
   RequestHeader header;
   Slice param_buf;
-  RETURN_NOT_OK(ReceiveFramedMessageBlocking(socket(), recv_buf, &header, &param_buf, deadline_));
+  RETURN_NOT_OK(serialization::ParseMessage(Slice(recv_buf_), &header, &param_buf));
   Status s = helper_.CheckNegotiateCallId(header.call_id());
   if (!s.ok()) {
     RETURN_NOT_OK(SendError(ErrorStatusPB::FATAL_INVALID_RPC_HEADER, s));
@@ -244,7 +409,7 @@ Status ServerNegotiation::SendNegotiatePB(const NegotiatePB& msg) {
   DCHECK(msg.has_step()) << "message must have a step";
 
   TRACE("Sending $0 NegotiatePB response", NegotiatePB::NegotiateStep_Name(msg.step()));
-  return SendFramedMessageBlocking(socket(), header, msg, deadline_);
+  return SendFramedMessage(header, msg);
 }
 
 Status ServerNegotiation::SendError(ErrorStatusPB::RpcErrorCodePB code, const Status& err) {
@@ -261,20 +426,14 @@ Status ServerNegotiation::SendError(ErrorStatusPB::RpcErrorCodePB code, const St
   msg.set_message(err.ToString());
 
   TRACE("Sending RPC error: $0", ErrorStatusPB::RpcErrorCodePB_Name(code));
-  RETURN_NOT_OK(SendFramedMessageBlocking(socket(), header, msg, deadline_));
+  RETURN_NOT_OK(SendFramedMessage(header, msg));
 
   return Status::OK();
 }
 
-Status ServerNegotiation::ValidateConnectionHeader(faststring* recv_buf) {
-  TRACE("Waiting for connection header");
-  size_t num_read;
-  const size_t conn_header_len = kMagicNumberLength + kHeaderFlagsLength;
-  recv_buf->resize(conn_header_len);
-  RETURN_NOT_OK(socket_->BlockingRecv(recv_buf->data(), conn_header_len, &num_read, deadline_));
-  DCHECK_EQ(conn_header_len, num_read);
-
-  RETURN_NOT_OK(serialization::ValidateConnHeader(*recv_buf));
+Status ServerNegotiation::ValidateConnectionHeader() {
+  DCHECK_EQ(kMagicNumberLength + kHeaderFlagsLength, recv_buf_.size());
+  RETURN_NOT_OK(serialization::ValidateConnHeader(Slice(recv_buf_)));
   TRACE("Connection header received");
   return Status::OK();
 }
@@ -386,11 +545,9 @@ Status ServerNegotiation::HandleTlsHandshake(const NegotiatePB& request) {
 
   // Regardless of whether this is the final handshake roundtrip (in which case
   // Continue would have returned OK), we still need to return a response.
+  // The socket is switched over to TLS once it has been sent.
   RETURN_NOT_OK(SendTlsHandshake(std::move(token)));
-  RETURN_NOT_OK(s);
-
-  // TLS handshake is finished.
-  return tls_handshake_.Finish(&socket_);
+  return s;
 }
 
 Status ServerNegotiation::SendTlsHandshake(string tls_token) {
@@ -505,11 +662,10 @@ Status ServerNegotiation::SendSaslSuccess(const char* token, unsigned tlen) {
   return Status::OK();
 }
 
-Status ServerNegotiation::RecvConnectionContext(faststring* recv_buf) {
-  TRACE("Waiting for connection context");
+Status ServerNegotiation::ParseConnectionContext() {
   RequestHeader header;
   Slice param_buf;
-  RETURN_NOT_OK(ReceiveFramedMessageBlocking(socket(), recv_buf, &header, &param_buf, deadline_));
+  RETURN_NOT_OK(serialization::ParseMessage(Slice(recv_buf_), &header, &param_buf));
   DCHECK(header.IsInitialized());
 
   if (header.call_id() != kConnectionContextCallId) {
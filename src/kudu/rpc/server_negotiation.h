@@ -29,6 +29,7 @@
 #include "kudu/rpc/sasl_common.h"
 #include "kudu/rpc/sasl_helper.h"
 #include "kudu/security/tls_handshake.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/status.h"
@@ -112,11 +113,27 @@ class ServerNegotiation {
 
   // Negotiate with the remote client. Should only be called once per
   // ServerNegotiation and socket instance, after all options have been set.
+  // Blocks until negotiation completes or the deadline passes. Leaves the
+  // socket in non-blocking mode.
   //
   // Returns OK on success, otherwise may return NotAuthorized, NotSupported, or
   // another non-OK status.
   Status Negotiate() WARN_UNUSED_RESULT;
 
+  // Negotiate with the remote client without blocking, for callers which wait
+  // for the socket themselves, such as a reactor thread. Makes as much
+  // progress as the socket allows and returns Status::Incomplete if it has to
+  // wait: call it again once the socket is writable if wants_write(), or
+  // readable otherwise. The socket must be in non-blocking mode, and the
+  // caller is responsible for enforcing the deadline.
+  //
+  // Returns OK once negotiation succeeds, or the same errors as Negotiate().
+  Status ContinueNegotiation() WARN_UNUSED_RESULT;
+
+  // Whether ContinueNegotiation() is waiting for room in the socket's send
+  // buffer, rather than for data from the client.
+  bool wants_write() const { return !send_buf_.empty(); }
+
   // SASL callback for plugin options, supported mechanisms, etc.
   // Returns SASL_FAIL if the option is not handled, which does not fail the handshake.
   int GetOptionCb(const char* plugin_name, const char* option,
@@ -131,10 +148,46 @@ class ServerNegotiation {
   static Status PreflightCheckGSSAPI() WARN_UNUSED_RESULT;
 
  private:
-
-  // Parse a negotiate request from the client, deserializing it into 'msg'.
+  // The steps of negotiation, in the order they happen. In each step but
+  // kTlsFinish the server waits for a message from the client.
+  enum class Step {
+    kConnectionHeader,
+    kNegotiate,
+    kTlsHandshake,
+    // Waits for the last TLS handshake message to be sent before switching
+    // the socket over to TLS.
+    kTlsFinish,
+    kSaslInitiate,
+    kSaslResponse,
+    kConnectionContext,
+    kDone,
+  };
+
+  // Read from the socket, without blocking, until 'recv_buf_' holds what the
+  // current step waits for: the connection header, or a framed message. Never
+  // reads past it, since the client may send its first call right after the
+  // connection context. Sets 'complete' if 'recv_buf_' is complete.
+  Status RecvNonBlocking(bool* complete) WARN_UNUSED_RESULT;
+
+  // Act on the complete message in 'recv_buf_' for the current step, and
+  // move on to the next step.
+  Status HandleMessage() WARN_UNUSED_RESULT;
+
+  // Wait until the socket is ready for ContinueNegotiation() to make
+  // progress, or the deadline passes.
+  Status WaitForSocket() WARN_UNUSED_RESULT;
+
+  // Queue a framed message for sending, and send as much of the queue as the
+  // socket will take without blocking.
+  Status SendFramedMessage(const google::protobuf::MessageLite& header,
+                           const google::protobuf::MessageLite& msg) WARN_UNUSED_RESULT;
+
+  // Send as much of 'send_buf_' as the socket will take without blocking.
+  Status FlushSendBuffer() WARN_UNUSED_RESULT;
+
+  // Parse the negotiate request from the client in 'recv_buf_' into 'msg'.
   // If the request is malformed, sends an error message to the client.
-  Status RecvNegotiatePB(NegotiatePB* msg, faststring* recv_buf) WARN_UNUSED_RESULT;
+  Status ParseNegotiatePB(NegotiatePB* msg) WARN_UNUSED_RESULT;
 
   // Encode and send the specified negotiate response message to the server.
   Status SendNegotiatePB(const NegotiatePB& msg) WARN_UNUSED_RESULT;
@@ -143,8 +196,8 @@ class ServerNegotiation {
   // Calls Status.ToString() for the embedded error message.
   Status SendError(ErrorStatusPB::RpcErrorCodePB code, const Status& err) WARN_UNUSED_RESULT;
 
-  // Parse and validate connection header.
-  Status ValidateConnectionHeader(faststring* recv_buf) WARN_UNUSED_RESULT;
+  // Validate the connection header in 'recv_buf_'.
+  Status ValidateConnectionHeader() WARN_UNUSED_RESULT;
 
   // Initialize the SASL server negotiation instance.
   Status InitSaslServer() WARN_UNUSED_RESULT;
@@ -155,7 +208,9 @@ class ServerNegotiation {
   // Send a NEGOTIATE response to the client with the list of available mechanisms.
   Status SendNegotiate(const std::set<std::string>& server_mechs) WARN_UNUSED_RESULT;
 
-  // Handle a TLS_HANDSHAKE request message from the server.
+  // Handle a TLS_HANDSHAKE request message from the server. Returns
+  // Status::Incomplete if the handshake needs another round trip; once it
+  // returns OK, the socket may be switched over to TLS.
   Status HandleTlsHandshake(const NegotiatePB& request) WARN_UNUSED_RESULT;
 
   // Send a TLS_HANDSHAKE response message to the server with the provided token.
@@ -175,8 +230,8 @@ class ServerNegotiation {
   // Send a SASL_SUCCESS response to the client with an token (typically empty).
   Status SendSaslSuccess(const char* token, unsigned tlen) WARN_UNUSED_RESULT;
 
-  // Receive and validate the ConnectionContextPB.
-  Status RecvConnectionContext(faststring* recv_buf) WARN_UNUSED_RESULT;
+  // Validate the ConnectionContextPB in 'recv_buf_'.
+  Status ParseConnectionContext() WARN_UNUSED_RESULT;
 
   // The socket to the remote client.
   std::unique_ptr<Socket> socket_;
@@ -202,6 +257,15 @@ class ServerNegotiation {
 
   // Negotiation timeout deadline.
   MonoTime deadline_;
+
+  // The step negotiation is at.
+  Step step_;
+
+  // What has been received of the message the current step waits for.
+  faststring recv_buf_;
+
+  // Messages to the client which haven't been written to the socket yet.
+  std::string send_buf_;
 };
 
 } // namespace rpc
@@ -18,9 +18,11 @@
 #include "kudu/rpc/service_if.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <google/protobuf/descriptor.pb.h>
 
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 
 #include "kudu/rpc/connection.h"
@@ -35,6 +37,17 @@
 DEFINE_bool(enable_exactly_once, true, "Whether to enable exactly once semantics.");
 TAG_FLAG(enable_exactly_once, hidden);
 
+DEFINE_int32(rpc_message_pool_size, 8,
+             "Number of request and response protobuf messages that each RPC "
+             "method retains for reuse across calls. If 0, messages are "
+             "allocated and freed for each call.");
+TAG_FLAG(rpc_message_pool_size, advanced);
+
+DEFINE_int32(rpc_message_pool_max_message_size, 16 * 1024,
+             "Maximum serialized size in bytes of a request or response "
+             "protobuf message which is retained for reuse across calls.");
+TAG_FLAG(rpc_message_pool_max_message_size, advanced);
+
 using google::protobuf::Message;
 using std::string;
 using std::unique_ptr;
@@ -43,6 +56,47 @@ using strings::Substitute;
 namespace kudu {
 namespace rpc {
 
+RpcMessagePool::RpcMessagePool()
+    : messages_allocated_(0),
+      messages_reused_(0) {
+}
+
+RpcMessagePool::~RpcMessagePool() {
+  STLDeleteElements(&free_messages_);
+}
+
+Message* RpcMessagePool::New(const Message& prototype) {
+  Message* msg = nullptr;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!free_messages_.empty()) {
+      msg = free_messages_.back();
+      free_messages_.pop_back();
+    }
+  }
+  if (msg) {
+    DCHECK_EQ(msg->GetDescriptor(), prototype.GetDescriptor());
+    messages_reused_.Increment();
+    return msg;
+  }
+  messages_allocated_.Increment();
+  return prototype.New();
+}
+
+void RpcMessagePool::Recycle(Message* msg, int64_t serialized_size) {
+  unique_ptr<Message> to_delete(msg);
+  if (FLAGS_rpc_message_pool_size <= 0 ||
+      serialized_size > FLAGS_rpc_message_pool_max_message_size) {
+    return;
+  }
+  msg->Clear();
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (free_messages_.size() < FLAGS_rpc_message_pool_size) {
+    free_messages_.push_back(to_delete.release());
+  }
+}
+
 ServiceIf::~ServiceIf() {
 }
 
@@ -93,11 +147,11 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
     RespondBadMethod(call);
     return;
   }
-  unique_ptr<Message> req(method_info->req_prototype->New());
+  unique_ptr<Message> req(method_info->req_pool.New(*method_info->req_prototype));
   if (PREDICT_FALSE(!ParseParam(call, req.get()))) {
     return;
   }
-  Message* resp = method_info->resp_prototype->New();
+  Message* resp = method_info->resp_pool.New(*method_info->resp_prototype);
 
   bool track_result = call->header().has_request_id()
                       && method_info->track_result
@@ -19,9 +19,12 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/rpc/result_tracker.h"
@@ -43,6 +46,50 @@ class RemoteMethod;
 class RpcContext;
 class ServiceIf;
 
+// A bounded, thread-safe free list of protobuf messages of a single type, used
+// to recycle the request and response messages of an RPC method.
+//
+// Clearing a protobuf message retains the memory of its strings, repeated
+// fields and sub-messages, so parsing into (or filling in) a recycled message
+// usually doesn't allocate at all. This gives most of the benefit of arena
+// allocation, which isn't available in the version of protobuf we use.
+//
+// Messages whose memory footprint is too large are not retained, so that
+// occasional large requests do not pin large amounts of memory.
+class RpcMessagePool {
+ public:
+  RpcMessagePool();
+  ~RpcMessagePool();
+
+  // Return an empty message of the same type as 'prototype'. The caller takes
+  // ownership, and may either delete it or hand it back with Recycle().
+  google::protobuf::Message* New(const google::protobuf::Message& prototype);
+
+  // Hand back a message previously returned by New(), taking ownership of it.
+  // 'serialized_size' is the size of the message on the wire. It stands in
+  // for the message's memory footprint, which is costly to measure.
+  void Recycle(google::protobuf::Message* msg, int64_t serialized_size);
+
+  // The number of times New() had to allocate a new message.
+  int64_t messages_allocated() const {
+    return messages_allocated_.Load();
+  }
+
+  // The number of times New() reused a recycled message.
+  int64_t messages_reused() const {
+    return messages_reused_.Load();
+  }
+
+ private:
+  simple_spinlock lock_;
+  std::vector<google::protobuf::Message*> free_messages_;
+
+  AtomicInt<int64_t> messages_allocated_;
+  AtomicInt<int64_t> messages_reused_;
+
+  DISALLOW_COPY_AND_ASSIGN(RpcMessagePool);
+};
+
 // Generated services define an instance of this class for each
 // method that they implement. The generic server code implemented
 // by GeneratedServiceIf look up the RpcMethodInfo in order to handle
@@ -54,8 +101,20 @@ struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
   std::unique_ptr<google::protobuf::Message> req_prototype;
   std::unique_ptr<google::protobuf::Message> resp_prototype;
 
+  // Pools of request and response messages, which are recycled across calls
+  // rather than allocated and freed for each call.
+  RpcMessagePool req_pool;
+  RpcMessagePool resp_pool;
+
   scoped_refptr<Histogram> handler_latency_histogram;
 
+  // Histograms of the time calls to this method spend in the other phases of
+  // their handling. See InboundCallTiming.
+  scoped_refptr<Histogram> read_latency_histogram;
+  scoped_refptr<Histogram> queue_latency_histogram;
+  scoped_refptr<Histogram> serialization_latency_histogram;
+  scoped_refptr<Histogram> write_latency_histogram;
+
   // Whether we should track this method's result, using ResultTracker.
   bool track_result;
 
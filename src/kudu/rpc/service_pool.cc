@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/service_pool.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
@@ -28,7 +29,11 @@
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
@@ -36,8 +41,84 @@
 #include "kudu/util/trace.h"
 
 using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
 using strings::Substitute;
 
+DEFINE_string(rpc_high_priority_methods,
+              "kudu.consensus.ConsensusService.RequestConsensusVote",
+              "Comma-separated list of fully-qualified RPC methods (e.g. "
+              "'kudu.tserver.TabletServerService.Write') whose calls are "
+              "scheduled in the high priority class of their service queue.");
+TAG_FLAG(rpc_high_priority_methods, experimental);
+
+DEFINE_string(rpc_low_priority_methods, "",
+              "Comma-separated list of fully-qualified RPC methods whose calls "
+              "are scheduled in the low priority class of their service queue. "
+              "Every call of a listed method is demoted, so listing "
+              "'kudu.tserver.TabletServerService.Scan' slows the first batch of "
+              "short, latency-sensitive scans as much as long-running ones.");
+TAG_FLAG(rpc_low_priority_methods, experimental);
+
+DEFINE_string(rpc_low_priority_users, "",
+              "Comma-separated list of users whose calls are scheduled in the "
+              "low priority class of their service queue, unless the method "
+              "is listed in --rpc_high_priority_methods.");
+TAG_FLAG(rpc_low_priority_users, experimental);
+
+DEFINE_string(rpc_user_queue_weights, "",
+              "Comma-separated list of 'user:weight' pairs. When a service queue "
+              "backs up, the calls of each user within a priority class are "
+              "served in proportion to the user's weight. Users which are not "
+              "listed have a weight of 1.");
+TAG_FLAG(rpc_user_queue_weights, experimental);
+
+DEFINE_int32(rpc_high_priority_weight, 4,
+             "Relative share of service threads given to high priority calls "
+             "when the service queue backs up.");
+TAG_FLAG(rpc_high_priority_weight, experimental);
+
+DEFINE_int32(rpc_normal_priority_weight, 2,
+             "Relative share of service threads given to normal priority calls "
+             "when the service queue backs up.");
+TAG_FLAG(rpc_normal_priority_weight, experimental);
+
+DEFINE_int32(rpc_low_priority_weight, 1,
+             "Relative share of service threads given to low priority calls "
+             "when the service queue backs up.");
+TAG_FLAG(rpc_low_priority_weight, experimental);
+
+DEFINE_int32(rpc_queue_target_latency_ms, 0,
+             "Target time for calls to wait in a service queue. If the minimum "
+             "time calls wait over an interval of --rpc_queue_latency_interval_ms "
+             "exceeds this target, the service is considered overloaded and calls "
+             "which waited for more than twice the target are rejected, asking the "
+             "client to back off. If 0, calls are only rejected when the queue is "
+             "full.");
+TAG_FLAG(rpc_queue_target_latency_ms, experimental);
+
+DEFINE_int32(rpc_queue_latency_interval_ms, 100,
+             "Interval over which service queue wait times are measured for "
+             "adaptive admission control. Also used as the backoff suggested to "
+             "clients whose calls are rejected. See --rpc_queue_target_latency_ms.");
+TAG_FLAG(rpc_queue_latency_interval_ms, experimental);
+
+static bool ValidatePriorityWeight(const char* flagname, int32_t value) {
+  if (value <= 0) {
+    LOG(ERROR) << flagname << " must be positive.";
+    return false;
+  }
+  return true;
+}
+static bool dummy_high = google::RegisterFlagValidator(
+    &FLAGS_rpc_high_priority_weight, &ValidatePriorityWeight);
+static bool dummy_normal = google::RegisterFlagValidator(
+    &FLAGS_rpc_normal_priority_weight, &ValidatePriorityWeight);
+static bool dummy_low = google::RegisterFlagValidator(
+    &FLAGS_rpc_low_priority_weight, &ValidatePriorityWeight);
+
 METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         "RPC Queue Time",
                         kudu::MetricUnit::kMicroseconds,
@@ -56,18 +137,88 @@ METRIC_DEFINE_counter(server, rpcs_queue_overflow,
                       "Number of RPCs dropped because the service queue "
                       "was full.");
 
+METRIC_DEFINE_counter(server, rpcs_shed_due_to_queue_latency,
+                      "RPCs Shed Due To Queue Latency",
+                      kudu::MetricUnit::kRequests,
+                      "Number of RPCs rejected because the service was overloaded: "
+                      "calls had persistently been waiting in the service queue "
+                      "for longer than the target queue latency.");
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_high_priority,
+                        "RPC Queue Time (High Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming high priority RPC requests "
+                        "spend in the worker queue",
+                        60000000LU, 3);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_normal_priority,
+                        "RPC Queue Time (Normal Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming normal priority RPC requests "
+                        "spend in the worker queue",
+                        60000000LU, 3);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_low_priority,
+                        "RPC Queue Time (Low Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming low priority RPC requests "
+                        "spend in the worker queue",
+                        60000000LU, 3);
+
 namespace kudu {
 namespace rpc {
 
+namespace {
+
+unordered_set<string> ParseNameList(const string& list) {
+  vector<string> names = strings::Split(list, ",", strings::SkipWhitespace());
+  return unordered_set<string>(names.begin(), names.end());
+}
+
+unordered_map<string, int> ParseUserWeights(const string& list) {
+  unordered_map<string, int> weights;
+  for (const string& entry : strings::Split(list, ",", strings::SkipWhitespace())) {
+    std::pair<string, string> p = strings::Split(entry, strings::delimiter::Limit(":", 1));
+    int32_t weight;
+    if (p.first.empty() || !safe_strto32(p.second, &weight) || weight <= 0) {
+      LOG(WARNING) << "Ignoring invalid entry '" << entry
+                   << "' in --rpc_user_queue_weights";
+      continue;
+    }
+    weights[p.first] = weight;
+  }
+  return weights;
+}
+
+} // anonymous namespace
+
 ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
   : service_(std::move(service)),
-    service_queue_(service_queue_length),
+    service_queue_(service_queue_length, { FLAGS_rpc_high_priority_weight,
+                                           FLAGS_rpc_normal_priority_weight,
+                                           FLAGS_rpc_low_priority_weight }),
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
+    rpcs_shed_(METRIC_rpcs_shed_due_to_queue_latency.Instantiate(entity)),
+    high_priority_methods_(ParseNameList(FLAGS_rpc_high_priority_methods)),
+    low_priority_methods_(ParseNameList(FLAGS_rpc_low_priority_methods)),
+    low_priority_users_(ParseNameList(FLAGS_rpc_low_priority_users)),
+    user_weights_(ParseUserWeights(FLAGS_rpc_user_queue_weights)),
     closing_(false) {
+  class_queue_time_[RPC_PRIORITY_HIGH] =
+      METRIC_rpc_incoming_queue_time_high_priority.Instantiate(entity);
+  class_queue_time_[RPC_PRIORITY_NORMAL] =
+      METRIC_rpc_incoming_queue_time_normal_priority.Instantiate(entity);
+  class_queue_time_[RPC_PRIORITY_LOW] =
+      METRIC_rpc_incoming_queue_time_low_priority.Instantiate(entity);
+  if (FLAGS_rpc_queue_target_latency_ms > 0) {
+    admission_controller_.reset(new AdmissionController(
+        MonoDelta::FromMilliseconds(FLAGS_rpc_queue_target_latency_ms),
+        MonoDelta::FromMilliseconds(FLAGS_rpc_queue_latency_interval_ms)));
+  }
 }
 
 ServicePool::~ServicePool() {
@@ -115,12 +266,32 @@ void ServicePool::RejectTooBusy(InboundCall* c) {
                  service_queue_.max_size());
   rpcs_queue_overflow_->Increment();
   KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
-  c->RespondFailure(ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
-                    Status::ServiceUnavailable(err_msg));
+  c->RespondServerTooBusy(Status::ServiceUnavailable(err_msg), TooBusyRetryAfter());
   DLOG(INFO) << err_msg << " Contents of service queue:\n"
              << service_queue_.ToString();
 }
 
+void ServicePool::RejectOverloaded(InboundCall* c) {
+  string err_msg =
+      Substitute("$0 request on $1 from $2 dropped due to backpressure. "
+                 "The service is overloaded; the call waited in the queue for $3ms.",
+                 c->remote_method().method_name(),
+                 service_->service_name(),
+                 c->remote_address().ToString(),
+                 (c->timing().time_handled - c->timing().time_received).ToMilliseconds());
+  rpcs_shed_->Increment();
+  KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
+  c->RespondServerTooBusy(Status::ServiceUnavailable(err_msg),
+                          admission_controller_->retry_after());
+}
+
+MonoDelta ServicePool::TooBusyRetryAfter() const {
+  if (admission_controller_ && admission_controller_->overloaded()) {
+    return admission_controller_->retry_after();
+  }
+  return MonoDelta();
+}
+
 RpcMethodInfo* ServicePool::LookupMethod(const RemoteMethod& method) {
   return service_->LookupMethod(method);
 }
@@ -140,7 +311,9 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
     return Status::NotSupported("call requires unsupported application feature flags");
   }
 
-  TRACE_TO(c->trace(), "Inserting onto call queue");
+  AssignSchedulingInfo(c);
+  TRACE_TO(c->trace(), "Inserting onto call queue ($0 priority)",
+           RpcPriorityClassToString(c->priority_class()));
 
   // Queue message on service queue
   boost::optional<InboundCall*> evicted;
@@ -172,6 +345,23 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   return status;
 }
 
+void ServicePool::AssignSchedulingInfo(InboundCall* c) const {
+  const string& user = c->user_credentials().real_user();
+  RpcPriorityClass priority_class = RPC_PRIORITY_NORMAL;
+  if (!high_priority_methods_.empty() || !low_priority_methods_.empty()) {
+    string method = c->remote_method().ToString();
+    if (ContainsKey(high_priority_methods_, method)) {
+      priority_class = RPC_PRIORITY_HIGH;
+    } else if (ContainsKey(low_priority_methods_, method)) {
+      priority_class = RPC_PRIORITY_LOW;
+    }
+  }
+  if (priority_class == RPC_PRIORITY_NORMAL && ContainsKey(low_priority_users_, user)) {
+    priority_class = RPC_PRIORITY_LOW;
+  }
+  c->set_scheduling_info(priority_class, user, FindWithDefault(user_weights_, user, 1));
+}
+
 void ServicePool::RunThread() {
   while (true) {
     std::unique_ptr<InboundCall> incoming;
@@ -181,8 +371,17 @@ void ServicePool::RunThread() {
     }
 
     incoming->RecordHandlingStarted(incoming_queue_time_);
+    class_queue_time_[incoming->priority_class()]->Increment(
+        (incoming->timing().time_handled - incoming->timing().time_received).ToMicroseconds());
     ADOPT_TRACE(incoming->trace());
 
+    bool shed = false;
+    if (admission_controller_) {
+      const InboundCallTiming& timing = incoming->timing();
+      shed = admission_controller_->RecordDequeueAndCheckShed(
+          timing.time_handled, timing.time_handled - timing.time_received);
+    }
+
     if (PREDICT_FALSE(incoming->ClientTimedOut())) {
       TRACE_TO(incoming->trace(), "Skipping call since client already timed out");
       rpcs_timed_out_in_queue_->Increment();
@@ -199,6 +398,12 @@ void ServicePool::RunThread() {
       continue;
     }
 
+    if (PREDICT_FALSE(shed)) {
+      TRACE_TO(incoming->trace(), "Shedding call since the service is overloaded");
+      RejectOverloaded(incoming.release());
+      continue;
+    }
+
     TRACE_TO(incoming->trace(), "Handling call");
 
     // Release the InboundCall pointer -- when the call is responded to,
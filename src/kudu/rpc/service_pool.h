@@ -19,11 +19,14 @@
 #define KUDU_SERVICE_POOL_H
 
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/admission_controller.h"
 #include "kudu/rpc/rpc_service.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/util/mutex.h"
@@ -73,11 +76,28 @@ class ServicePool : public RpcService {
     return rpcs_queue_overflow_.get();
   }
 
+  const Counter* RpcsShedMetricForTests() const {
+    return rpcs_shed_.get();
+  }
+
+  const Histogram* IncomingQueueTimeMetricForTests(RpcPriorityClass priority_class) const {
+    return class_queue_time_[priority_class].get();
+  }
+
   const std::string service_name() const;
 
  private:
   void RunThread();
   void RejectTooBusy(InboundCall* c);
+  void RejectOverloaded(InboundCall* c);
+
+  // Suggested client backoff for calls rejected as too busy, or an
+  // uninitialized MonoDelta if there is no suggestion.
+  MonoDelta TooBusyRetryAfter() const;
+
+  // Assign the priority class and tenant of 'c', based on its method and the
+  // user that sent it.
+  void AssignSchedulingInfo(InboundCall* c) const;
 
   gscoped_ptr<ServiceIf> service_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
@@ -85,6 +105,20 @@ class ServicePool : public RpcService {
   scoped_refptr<Histogram> incoming_queue_time_;
   scoped_refptr<Counter> rpcs_timed_out_in_queue_;
   scoped_refptr<Counter> rpcs_queue_overflow_;
+  scoped_refptr<Counter> rpcs_shed_;
+
+  // Sheds calls when the queue has a standing backlog. nullptr if adaptive
+  // admission control is disabled.
+  gscoped_ptr<AdmissionController> admission_controller_;
+
+  // Queue time histograms, indexed by RpcPriorityClass.
+  scoped_refptr<Histogram> class_queue_time_[RPC_PRIORITY_NUM_CLASSES];
+
+  // Scheduling configuration, parsed from flags at construction time.
+  const std::unordered_set<std::string> high_priority_methods_;
+  const std::unordered_set<std::string> low_priority_methods_;
+  const std::unordered_set<std::string> low_priority_users_;
+  const std::unordered_map<std::string, int> user_weights_;
 
   mutable Mutex shutdown_lock_;
   bool closing_;
@@ -140,5 +140,130 @@ TEST(TestServiceQueue, LifoServiceQueuePerf) {
   LOG(INFO) << "Avg idle workers:     " << total_idle_workers / static_cast<double>(total_sample);
 }
 
+static InboundCall* NewCall(RpcPriorityClass priority_class,
+                            const string& tenant,
+                            int tenant_weight = 1) {
+  InboundCall* call = new InboundCall(nullptr);
+  call->set_scheduling_info(priority_class, tenant, tenant_weight);
+  return call;
+}
+
+static void PutOrDie(LifoServiceQueue* queue, InboundCall* call) {
+  boost::optional<InboundCall*> evicted;
+  ASSERT_EQ(QUEUE_SUCCESS, queue->Put(call, &evicted));
+  ASSERT_EQ(boost::none, evicted);
+}
+
+// Shut down 'queue' and drain it from a separate consumer thread, returning
+// the calls in the order in which they were dequeued.
+static vector<unique_ptr<InboundCall>> ShutdownAndDrain(LifoServiceQueue* queue) {
+  queue->Shutdown();
+  vector<unique_ptr<InboundCall>> calls;
+  std::thread consumer([&]() {
+      unique_ptr<InboundCall> call;
+      while (queue->BlockingGet(&call)) {
+        calls.emplace_back(std::move(call));
+      }
+    });
+  consumer.join();
+  return calls;
+}
+
+TEST(TestServiceQueue, TestPriorityClassesAreWeighted) {
+  LifoServiceQueue queue(100, { 4, 2, 1 });
+  for (int i = 0; i < 10; i++) {
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_LOW, "")));
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_NORMAL, "")));
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_HIGH, "")));
+  }
+  ASSERT_EQ(30, queue.estimated_queue_length());
+
+  vector<unique_ptr<InboundCall>> calls = ShutdownAndDrain(&queue);
+  ASSERT_EQ(30, calls.size());
+
+  // Every run of 7 calls served while all classes are backlogged should be
+  // split 4:2:1 between the classes.
+  for (int round = 0; round < 2; round++) {
+    int counts[RPC_PRIORITY_NUM_CLASSES] = { 0, 0, 0 };
+    for (int i = round * 7; i < (round + 1) * 7; i++) {
+      counts[calls[i]->priority_class()]++;
+    }
+    EXPECT_EQ(4, counts[RPC_PRIORITY_HIGH]);
+    EXPECT_EQ(2, counts[RPC_PRIORITY_NORMAL]);
+    EXPECT_EQ(1, counts[RPC_PRIORITY_LOW]);
+  }
+}
+
+TEST(TestServiceQueue, TestTenantsShareFairly) {
+  LifoServiceQueue queue(100);
+  for (int i = 0; i < 20; i++) {
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_NORMAL, "heavy")));
+  }
+  for (int i = 0; i < 2; i++) {
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_NORMAL, "light")));
+  }
+  for (int i = 0; i < 20; i++) {
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_NORMAL, "weighted", 3)));
+  }
+
+  vector<unique_ptr<InboundCall>> calls = ShutdownAndDrain(&queue);
+  ASSERT_EQ(42, calls.size());
+
+  // Even though 'light' queued its calls after 'heavy', it should not have
+  // to wait for the heavy tenant's backlog to drain.
+  int light_seen = 0;
+  for (int i = 0; i < 8; i++) {
+    if (calls[i]->tenant() == "light") light_seen++;
+  }
+  EXPECT_EQ(2, light_seen);
+
+  // Once 'light' is done, 'weighted' should get three times the share of 'heavy'.
+  int weighted_seen = 0;
+  for (int i = 8; i < 28; i++) {
+    if (calls[i]->tenant() == "weighted") weighted_seen++;
+  }
+  EXPECT_EQ(15, weighted_seen);
+}
+
+TEST(TestServiceQueue, TestEviction) {
+  LifoServiceQueue queue(4);
+  for (int i = 0; i < 3; i++) {
+    NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_NORMAL, "heavy")));
+  }
+  NO_FATALS(PutOrDie(&queue, NewCall(RPC_PRIORITY_NORMAL, "light")));
+
+  // A call from the tenant with the smaller backlog bumps a call from the
+  // tenant with the largest one.
+  boost::optional<InboundCall*> evicted;
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(NewCall(RPC_PRIORITY_NORMAL, "light"), &evicted));
+  ASSERT_NE(boost::none, evicted);
+  ASSERT_EQ("heavy", (*evicted)->tenant());
+  delete *evicted;
+
+  // A low-priority call can't bump any higher-priority call.
+  evicted = boost::none;
+  unique_ptr<InboundCall> low(NewCall(RPC_PRIORITY_LOW, "light"));
+  ASSERT_EQ(QUEUE_FULL, queue.Put(low.get(), &evicted));
+  ASSERT_EQ(boost::none, evicted);
+
+  // A high-priority call bumps a normal-priority call, even from a tenant with
+  // no other queued calls.
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(NewCall(RPC_PRIORITY_HIGH, "heavy"), &evicted));
+  ASSERT_NE(boost::none, evicted);
+  ASSERT_EQ(RPC_PRIORITY_NORMAL, (*evicted)->priority_class());
+  delete *evicted;
+
+  // The last call in a tenant's own queue is rejected rather than bumping an
+  // earlier call of the same tenant.
+  evicted = boost::none;
+  unique_ptr<InboundCall> normal(NewCall(RPC_PRIORITY_NORMAL, "heavy"));
+  ASSERT_EQ(QUEUE_FULL, queue.Put(normal.get(), &evicted));
+  ASSERT_EQ(boost::none, evicted);
+
+  vector<unique_ptr<InboundCall>> calls = ShutdownAndDrain(&queue);
+  ASSERT_EQ(4, calls.size());
+  ASSERT_EQ(RPC_PRIORITY_HIGH, calls[0]->priority_class());
+}
+
 } // namespace rpc
 } // namespace kudu
@@ -17,23 +17,46 @@
 
 #include "kudu/rpc/service_queue.h"
 
+#include <algorithm>
 #include <mutex>
+#include <vector>
 
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/logging.h"
 
+using std::vector;
+using strings::Substitute;
+
 namespace kudu {
 namespace rpc {
 
 __thread LifoServiceQueue::ConsumerState* LifoServiceQueue::tl_consumer_ = nullptr;
 
+namespace {
+// By default, each priority class gets twice the share of the next lower one.
+const vector<int> kDefaultClassWeights = { 4, 2, 1 };
+} // anonymous namespace
+
 LifoServiceQueue::LifoServiceQueue(int max_size)
+    : LifoServiceQueue(max_size, kDefaultClassWeights) {
+}
+
+LifoServiceQueue::LifoServiceQueue(int max_size, const vector<int>& class_weights)
    : shutdown_(false),
-     max_queue_size_(max_size) {
+     max_queue_size_(max_size),
+     vtime_(0),
+     queue_size_(0) {
   CHECK_GT(max_queue_size_, 0);
+  CHECK_EQ(class_weights.size(), RPC_PRIORITY_NUM_CLASSES);
+  for (int i = 0; i < RPC_PRIORITY_NUM_CLASSES; i++) {
+    CHECK_GT(class_weights[i], 0);
+    classes_[i].weight = class_weights[i];
+  }
 }
 
 LifoServiceQueue::~LifoServiceQueue() {
-  DCHECK(queue_.empty())
+  DCHECK_EQ(queue_size_, 0)
       << "ServiceQueue holds bare pointers at destruction time";
 }
 
@@ -48,10 +71,8 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
   while (true) {
     {
       std::lock_guard<simple_spinlock> l(lock_);
-      if (!queue_.empty()) {
-        auto it = queue_.begin();
-        out->reset(*it);
-        queue_.erase(it);
+      if (queue_size_ > 0) {
+        out->reset(DequeueLocked());
         return true;
       }
       if (PREDICT_FALSE(shutdown_)) {
@@ -77,10 +98,10 @@ QueueStatus LifoServiceQueue::Put(InboundCall* call,
     return QUEUE_SHUTDOWN;
   }
 
-  DCHECK(!(waiting_consumers_.size() > 0 && queue_.size() > 0));
+  DCHECK(!(waiting_consumers_.size() > 0 && queue_size_ > 0));
 
   // fast path
-  if (queue_.empty() && waiting_consumers_.size() > 0) {
+  if (queue_size_ == 0 && waiting_consumers_.size() > 0) {
     auto consumer = waiting_consumers_[waiting_consumers_.size() - 1];
     waiting_consumers_.pop_back();
     // Notify condition var(and wake up consumer thread) takes time,
@@ -90,23 +111,129 @@ QueueStatus LifoServiceQueue::Put(InboundCall* call,
     return QUEUE_SUCCESS;
   }
 
-  if (PREDICT_FALSE(queue_.size() >= max_queue_size_)) {
+  if (PREDICT_FALSE(queue_size_ >= max_queue_size_)) {
     // eviction
-    DCHECK_EQ(queue_.size(), max_queue_size_);
-    auto it = queue_.end();
-    --it;
-    if (DeadlineLess(*it, call)) {
+    DCHECK_EQ(queue_size_, max_queue_size_);
+    InboundCall* victim = EvictForLocked(call);
+    if (victim == nullptr) {
       return QUEUE_FULL;
     }
-
-    *evicted = *it;
-    queue_.erase(it);
+    *evicted = victim;
   }
 
-  queue_.insert(call);
+  EnqueueLocked(call);
   return QUEUE_SUCCESS;
 }
 
+void LifoServiceQueue::EnqueueLocked(InboundCall* call) {
+  ClassQueue* cq = &classes_[call->priority_class()];
+  if (cq->size == 0) {
+    cq->pass = std::max(cq->pass, vtime_);
+  }
+  auto it = cq->tenants.find(call->tenant());
+  if (it == cq->tenants.end()) {
+    it = cq->tenants.emplace(call->tenant(), TenantQueue()).first;
+    it->second.pass = cq->vtime;
+    it->second.weight = call->tenant_weight();
+  }
+  it->second.calls.insert(call);
+  cq->size++;
+  queue_size_++;
+}
+
+InboundCall* LifoServiceQueue::DequeueLocked() {
+  DCHECK_GT(queue_size_, 0);
+
+  // Pick the class with the lowest pass. Classes are ordered from highest to
+  // lowest priority, so ties go to the higher-priority class.
+  ClassQueue* cq = nullptr;
+  for (auto& c : classes_) {
+    if (c.size > 0 && (cq == nullptr || c.pass < cq->pass)) {
+      cq = &c;
+    }
+  }
+  DCHECK(cq != nullptr);
+
+  // Within the class, pick the tenant with the lowest pass.
+  auto tenant = cq->tenants.end();
+  for (auto it = cq->tenants.begin(); it != cq->tenants.end(); ++it) {
+    if (tenant == cq->tenants.end() || it->second.pass < tenant->second.pass) {
+      tenant = it;
+    }
+  }
+  DCHECK(tenant != cq->tenants.end());
+  TenantQueue* tq = &tenant->second;
+
+  auto call_it = tq->calls.begin();
+  InboundCall* call = *call_it;
+  tq->calls.erase(call_it);
+
+  vtime_ = cq->pass;
+  cq->pass += kStride / cq->weight;
+  cq->vtime = tq->pass;
+  tq->pass += kStride / tq->weight;
+  if (tq->calls.empty()) {
+    cq->tenants.erase(tenant);
+  }
+  cq->size--;
+  queue_size_--;
+  return call;
+}
+
+InboundCall* LifoServiceQueue::EvictForLocked(const InboundCall* call) {
+  for (int c = RPC_PRIORITY_NUM_CLASSES - 1; c >= call->priority_class(); c--) {
+    ClassQueue* cq = &classes_[c];
+    if (cq->size == 0) {
+      continue;
+    }
+
+    // Shed load from the tenant with the largest backlog, counting 'call'
+    // toward its own tenant's backlog if it belongs to this class.
+    TenantQueue* victim = nullptr;
+    size_t victim_backlog = 0;
+    bool victim_is_caller = false;
+    if (c == call->priority_class()) {
+      victim = FindOrNull(cq->tenants, call->tenant());
+      victim_backlog = (victim ? victim->calls.size() : 0) + 1;
+      victim_is_caller = true;
+    }
+    for (auto& e : cq->tenants) {
+      if (e.second.calls.size() > victim_backlog) {
+        victim = &e.second;
+        victim_backlog = e.second.calls.size();
+        victim_is_caller = false;
+      }
+    }
+
+    if (victim == nullptr) {
+      // The caller's tenant has the largest backlog but nothing is queued
+      // for it yet.
+      DCHECK(victim_is_caller);
+      return nullptr;
+    }
+
+    // Within the tenant, evict the call with the farthest deadline, unless
+    // that is 'call' itself.
+    auto it = victim->calls.end();
+    --it;
+    if (victim_is_caller && DeadlineLess(*it, call)) {
+      return nullptr;
+    }
+
+    InboundCall* ret = *it;
+    victim->calls.erase(it);
+    if (victim->calls.empty()) {
+      cq->tenants.erase(ret->tenant());
+    }
+    cq->size--;
+    queue_size_--;
+    return ret;
+  }
+
+  // Every queued call has a higher priority than 'call'.
+  return nullptr;
+}
+
 void LifoServiceQueue::Shutdown() {
   std::lock_guard<simple_spinlock> l(lock_);
   shutdown_ = true;
@@ -120,7 +247,7 @@ void LifoServiceQueue::Shutdown() {
 
 bool LifoServiceQueue::empty() const {
   std::lock_guard<simple_spinlock> l(lock_);
-  return queue_.empty();
+  return queue_size_ == 0;
 }
 
 int LifoServiceQueue::max_size() const {
@@ -131,9 +258,14 @@ std::string LifoServiceQueue::ToString() const {
   std::string ret;
 
   std::lock_guard<simple_spinlock> l(lock_);
-  for (const auto* t : queue_) {
-    ret.append(t->ToString());
-    ret.append("\n");
+  for (int c = 0; c < RPC_PRIORITY_NUM_CLASSES; c++) {
+    for (const auto& e : classes_[c].tenants) {
+      for (const auto* t : e.second.calls) {
+        ret.append(Substitute("[$0 priority, tenant '$1'] $2\n",
+                              RpcPriorityClassToString(static_cast<RpcPriorityClass>(c)),
+                              e.first, t->ToString()));
+      }
+    }
   }
   return ret;
 }
@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/rpc/inbound_call.h"
@@ -38,14 +39,27 @@ enum QueueStatus {
 };
 
 // Blocking queue used for passing inbound RPC calls to the service handler pool.
-// Calls are dequeued in 'earliest-deadline first' order. The queue also maintains a
-// bounded number of calls. If the queue overflows, then calls with deadlines farthest
-// in the future are evicted.
+// The queue maintains a bounded number of calls.
+//
+// Queued calls are scheduled in three levels:
+// - Each call carries a priority class (see RpcPriorityClass). Classes are
+//   served in proportion to their configured weights using stride scheduling,
+//   so that a backlog of low-priority calls (e.g. scan continuations) cannot
+//   starve high-priority ones, while low-priority calls still make progress.
+// - Within a class, calls are grouped by tenant (the authenticated user that
+//   sent them), and tenants are served in proportion to their weights. This
+//   prevents a single heavy client from monopolizing the service threads.
+// - Within a tenant, calls are dequeued in 'earliest-deadline first' order.
+//
+// If the queue overflows, a call is evicted from the lowest-priority class
+// which is no higher than the incoming call's class, choosing the tenant with
+// the largest backlog and, within that tenant, the call whose deadline is
+// farthest in the future.
 //
 // When calls do not provide deadlines, the RPC layer considers their deadline to
 // be infinitely in the future. This means that any call that does have a deadline
-// can evict any call that does not have a deadline. This incentivizes clients to
-// provide accurate deadlines for their calls.
+// can evict any call from the same tenant that does not have a deadline. This
+// incentivizes clients to provide accurate deadlines for their calls.
 //
 // In order to improve concurrent throughput, this class uses a LIFO design:
 // Each consumer thread has its own lock and condition variable. If a
@@ -60,15 +74,21 @@ enum QueueStatus {
 //   without going to sleep, and also keeps CPU cache and allocator caches hot.
 // - in the common case that there are enough workers to fully service the incoming
 //   work rate, the queue implementation itself is never used. Thus, we can
-//   have a priority queue without paying extra for it in the common case.
+//   have a scheduling queue without paying extra for it in the common case.
 //
 // NOTE: because of the use of thread-local consumer records, once a consumer
 // thread accesses one LifoServiceQueue, it becomes "bound" to that queue and
 // must never access any other instance.
 class LifoServiceQueue {
  public:
+  // Construct a queue in which all priority classes have the default weights.
   explicit LifoServiceQueue(int max_size);
 
+  // Construct a queue with the given relative weight for each priority class.
+  // 'class_weights' must have RPC_PRIORITY_NUM_CLASSES positive entries,
+  // indexed by RpcPriorityClass.
+  LifoServiceQueue(int max_size, const std::vector<int>& class_weights);
+
   ~LifoServiceQueue();
 
   // Get an element from the queue.  Returns false if we were shut down prior to
@@ -78,8 +98,8 @@ class LifoServiceQueue {
   // Add a new call to the queue.
   // Returns:
   // - QUEUE_SHUTDOWN if Shutdown() has already been called.
-  // - QUEUE_FULL if the queue is full and 'call' has a later deadline than any
-  //   RPC already in the queue.
+  // - QUEUE_FULL if the queue is full and no queued call may be evicted in
+  //   favor of 'call'.
   // - QUEUE_SUCCESS if 'call' was enqueued.
   //
   // In the case of a 'QUEUE_SUCCESS' response, the new element may have bumped
@@ -103,11 +123,7 @@ class LifoServiceQueue {
   // Return an estimate of the current queue length.
   int estimated_queue_length() const {
     ANNOTATE_IGNORE_READS_BEGIN();
-    // The C++ standard says that std::multiset::size must be constant time,
-    // so this method won't try to traverse any actual nodes of the underlying
-    // RB tree. Investigation of the libstdcxx implementation confirms that
-    // size() is a simple field access of the _Rb_tree structure.
-    int ret = queue_.size();
+    int ret = queue_size_;
     ANNOTATE_IGNORE_READS_END();
     return ret;
   }
@@ -143,6 +159,48 @@ class LifoServiceQueue {
     }
   };
 
+  // The calls queued on behalf of a single tenant within a priority class.
+  struct TenantQueue {
+    std::multiset<InboundCall*, DeadlineLessStruct> calls;
+
+    // Stride scheduling state: the tenant with the lowest 'pass' within a class
+    // is served next, after which its 'pass' advances by kStride / weight.
+    uint64_t pass = 0;
+    int weight = 1;
+  };
+
+  // The calls queued within a single priority class.
+  struct ClassQueue {
+    // Only tenants which currently have queued calls are present.
+    std::unordered_map<std::string, TenantQueue> tenants;
+
+    // Stride scheduling state across classes, as for TenantQueue.
+    uint64_t pass = 0;
+    int weight = 1;
+
+    // The 'pass' of the tenant most recently served from this class. Tenants
+    // which become active start from here, so that they cannot bank credit
+    // while idle.
+    uint64_t vtime = 0;
+
+    // The total number of calls queued in this class.
+    int size = 0;
+  };
+
+  // The stride used for the scheduling state above. Weights are expected to
+  // be much smaller than this.
+  static const uint64_t kStride = 1 << 20;
+
+  // Add 'call' to the appropriate class and tenant queue.
+  void EnqueueLocked(InboundCall* call);
+
+  // Remove and return the next call to be served. The queue must not be empty.
+  InboundCall* DequeueLocked();
+
+  // Remove and return a queued call to make room for 'call', or return nullptr
+  // if 'call' itself should be rejected.
+  InboundCall* EvictForLocked(const InboundCall* call);
+
   // The thread-local record corresponding to a single consumer thread.
   // Threads push this record onto the waiting_consumers_ stack when
   // they are awaiting work. Producers pop the top waiting consumer and
@@ -199,9 +257,16 @@ class LifoServiceQueue {
   // Stack of consumer threads which are currently waiting for work.
   std::vector<ConsumerState*> waiting_consumers_;
 
-  // The actual queue. Work is only added to the queue when there were no
-  // consumers available for a "direct hand-off".
-  std::multiset<InboundCall*, DeadlineLessStruct> queue_;
+  // The actual queue, indexed by RpcPriorityClass. Work is only added to the
+  // queue when there were no consumers available for a "direct hand-off".
+  ClassQueue classes_[RPC_PRIORITY_NUM_CLASSES];
+
+  // The 'pass' of the class most recently served. Classes which become active
+  // start from here.
+  uint64_t vtime_;
+
+  // The total number of calls in 'classes_'.
+  int queue_size_;
 
   // The total set of consumers who have ever accessed this queue.
   std::vector<std::unique_ptr<ConsumerState>> consumers_;
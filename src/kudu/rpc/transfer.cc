@@ -69,11 +69,22 @@ TransferCallbacks::~TransferCallbacks()
 {}
 
 InboundTransfer::InboundTransfer()
-  : total_length_(kMsgLengthPrefixLength),
+  : InboundTransfer(nullptr) {
+}
+
+InboundTransfer::InboundTransfer(scoped_refptr<InboundBufferPool> pool)
+  : pool_(std::move(pool)),
+    total_length_(kMsgLengthPrefixLength),
     cur_offset_(0) {
   buf_.resize(kMsgLengthPrefixLength);
 }
 
+InboundTransfer::~InboundTransfer() {
+  if (pooled_buf_) {
+    pool_->Release(std::move(pooled_buf_));
+  }
+}
+
 Status InboundTransfer::ReceiveBuffer(Socket &socket) {
   if (cur_offset_ < kMsgLengthPrefixLength) {
     // receive int32 length prefix
@@ -85,6 +96,9 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
       return Status::OK();
     }
     DCHECK_GE(nread, 0);
+    if (cur_offset_ == 0) {
+      start_time_ = MonoTime::Now();
+    }
     cur_offset_ += nread;
     if (cur_offset_ < kMsgLengthPrefixLength) {
       // If we still don't have the full length prefix, we can't continue
@@ -107,7 +121,13 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
       return Status::NetworkError(Substitute("RPC frame had invalid length of $0",
                                              total_length_));
     }
-    buf_.resize(total_length_);
+    if (pool_) {
+      // Copy the length prefix into a buffer from the pool which is big
+      // enough for the whole frame.
+      pooled_buf_ = pool_->Acquire(total_length_);
+      pooled_buf_->append(buf_.data(), kMsgLengthPrefixLength);
+    }
+    frame_buf()->resize(total_length_);
 
     // Fall through to receive the message body, which is likely to be already
     // available on the socket.
@@ -116,7 +136,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
   // receive message body
   int32_t nread;
   int32_t rem = total_length_ - cur_offset_;
-  Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+  Status status = socket.Recv(&(*frame_buf())[cur_offset_], rem, &nread);
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
   cur_offset_ += nread;
 
@@ -20,12 +20,16 @@
 
 #include <boost/intrusive/list.hpp>
 #include <gflags/gflags.h>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
 #include <vector>
 
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/rpc/inbound_buffer_pool.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 
@@ -57,6 +61,12 @@ class InboundTransfer {
 
   InboundTransfer();
 
+  // Create a transfer whose frame buffer is taken from 'pool', and handed back
+  // to it when the transfer is destroyed.
+  explicit InboundTransfer(scoped_refptr<InboundBufferPool> pool);
+
+  ~InboundTransfer();
+
   // read from the socket into our buffer
   Status ReceiveBuffer(Socket &socket);
 
@@ -67,22 +77,41 @@ class InboundTransfer {
   bool TransferFinished() const;
 
   Slice data() const {
-    return Slice(buf_);
+    return pooled_buf_ ? Slice(*pooled_buf_) : Slice(buf_);
   }
 
   // Return a string indicating the status of this transfer (number of bytes received, etc)
   // suitable for logging.
   std::string StatusAsString() const;
 
+  // The time at which the first bytes of the transfer were received.
+  const MonoTime& start_time() const { return start_time_; }
+
  private:
 
   Status ProcessInboundHeader();
 
+  // The buffer that the frame is being received into.
+  faststring* frame_buf() {
+    return pooled_buf_ ? pooled_buf_.get() : &buf_;
+  }
+
+  // The pool from which frame buffers are taken, or nullptr if they are not pooled.
+  scoped_refptr<InboundBufferPool> pool_;
+
+  // Holds the length prefix, and the whole frame if there is no pool.
   faststring buf_;
 
+  // Once the length prefix has been received, holds the whole frame if there
+  // is a pool.
+  std::unique_ptr<faststring> pooled_buf_;
+
   int32_t total_length_;
   int32_t cur_offset_;
 
+  // See start_time().
+  MonoTime start_time_;
+
   DISALLOW_COPY_AND_ASSIGN(InboundTransfer);
 };
 
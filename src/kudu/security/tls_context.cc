@@ -19,6 +19,7 @@
 
 #include <string>
 
+#include <gflags/gflags.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
@@ -27,6 +28,8 @@
 #include "kudu/security/tls_handshake.h"
 #include "kudu/util/status.h"
 
+DECLARE_bool(tls_kernel_offload);
+
 using strings::Substitute;
 using std::string;
 
@@ -69,6 +72,14 @@ Status TlsContext::Init() {
                       SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 |
                       SSL_OP_NO_COMPRESSION);
 
+#ifdef SSL_OP_NO_TLSv1_3
+  // The kernel can only take over encryption from TLS 1.2 connections, so
+  // don't let connections negotiate TLS 1.3 when offload is requested.
+  if (FLAGS_tls_kernel_offload) {
+    SSL_CTX_set_options(ctx_.get(), SSL_OP_NO_TLSv1_3);
+  }
+#endif
+
   // TODO(PKI): is it possible to disable client-side renegotiation? it seems there
   // have been various CVEs related to this feature that we don't need.
   // TODO(PKI): set desired cipher suites?
@@ -20,12 +20,14 @@
 #include <memory>
 #include <string>
 
+#include <gflags/gflags.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 
 #include "kudu/security/tls_socket.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
@@ -34,6 +36,15 @@
 #include "kudu/security/x509_check_host.h"
 #endif // OPENSSL_VERSION_NUMBER
 
+DEFINE_bool(tls_kernel_offload, false,
+            "Whether to hand encryption of outbound TLS records over to the kernel "
+            "(Linux kTLS) once a connection's handshake is complete. Only TLS 1.2 "
+            "connections using an AES-GCM cipher can be offloaded, so enabling this "
+            "also keeps connections from negotiating TLS 1.3. Connections which can't "
+            "be offloaded, or hosts whose kernel lacks kTLS support, keep encrypting "
+            "in OpenSSL.");
+TAG_FLAG(tls_kernel_offload, experimental);
+
 using std::string;
 using std::unique_ptr;
 
@@ -187,7 +198,16 @@ Status TlsHandshake::Finish(unique_ptr<Socket>* socket) {
   }
 
   // Transfer the SSL instance to the socket.
-  socket->reset(new TlsSocket(fd, std::move(ssl_)));
+  unique_ptr<TlsSocket> tls_socket(new TlsSocket(fd, std::move(ssl_)));
+
+  if (FLAGS_tls_kernel_offload) {
+    Status s = tls_socket->EnableKernelTlsSend();
+    if (!s.ok()) {
+      LOG_FIRST_N(INFO, 1) << "Unable to offload TLS encryption to the kernel, "
+                           << "falling back to OpenSSL: " << s.ToString();
+    }
+  }
+  socket->reset(tls_socket.release());
 
   return Status::OK();
 }
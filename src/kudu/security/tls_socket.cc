@@ -17,15 +17,112 @@
 
 #include "kudu/security/tls_socket.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/crypto.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/ssl.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
 
 #include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
 #include "kudu/security/openssl_util.h"
+#include "kudu/util/errno.h"
+
+using std::string;
+using strings::Substitute;
 
 namespace kudu {
 namespace security {
 
+namespace {
+
+#if defined(__linux__)
+// Definitions from the kernel's <linux/tls.h>, which older build environments
+// may lack. They are part of the kernel's stable ABI.
+constexpr int kTcpUlp = 31;           // TCP_ULP
+constexpr int kSolTls = 282;          // SOL_TLS
+constexpr int kTlsTx = 1;             // TLS_TX
+constexpr uint16_t kTls12Version = 0x0303;
+constexpr uint16_t kTlsCipherAesGcm128 = 51;
+constexpr uint16_t kTlsCipherAesGcm256 = 52;
+constexpr int kTlsGcmSaltSize = 4;
+constexpr int kTlsGcmIvSize = 8;
+constexpr int kTlsRecSeqSize = 8;
+
+// Layout of struct tls12_crypto_info_aes_gcm_{128,256}.
+template<int kKeySize>
+struct KernelTlsCryptoInfo {
+  uint16_t version;
+  uint16_t cipher_type;
+  uint8_t iv[kTlsGcmIvSize];
+  uint8_t key[kKeySize];
+  uint8_t salt[kTlsGcmSaltSize];
+  uint8_t rec_seq[kTlsRecSeqSize];
+};
+
+// The TLS 1.2 pseudo-random function (RFC 5246, section 5), used to expand
+// the master secret into the connection's key block.
+Status Tls12Prf(const EVP_MD* md, const uint8_t* secret, int secret_len,
+                const string& label_and_seed, uint8_t* out, int out_len) {
+  // A(1) = HMAC(secret, seed), A(i) = HMAC(secret, A(i-1)).
+  uint8_t a[EVP_MAX_MD_SIZE];
+  unsigned int a_len;
+  OPENSSL_RET_IF_NULL(HMAC(md, secret, secret_len,
+                           reinterpret_cast<const uint8_t*>(label_and_seed.data()),
+                           label_and_seed.size(), a, &a_len),
+                      "failed to compute TLS PRF");
+  int pos = 0;
+  while (pos < out_len) {
+    // Output block i is HMAC(secret, A(i) + seed).
+    string input(reinterpret_cast<const char*>(a), a_len);
+    input.append(label_and_seed);
+    uint8_t block[EVP_MAX_MD_SIZE];
+    unsigned int block_len;
+    OPENSSL_RET_IF_NULL(HMAC(md, secret, secret_len,
+                             reinterpret_cast<const uint8_t*>(input.data()), input.size(),
+                             block, &block_len),
+                        "failed to compute TLS PRF");
+    int n = std::min<int>(out_len - pos, block_len);
+    memcpy(out + pos, block, n);
+    pos += n;
+    OPENSSL_cleanse(block, sizeof(block));
+
+    uint8_t next_a[EVP_MAX_MD_SIZE];
+    OPENSSL_RET_IF_NULL(HMAC(md, secret, secret_len, a, a_len, next_a, &a_len),
+                        "failed to compute TLS PRF");
+    memcpy(a, next_a, a_len);
+  }
+  OPENSSL_cleanse(a, sizeof(a));
+  return Status::OK();
+}
+
+// Configures kernel encryption of the records sent on 'fd' with 'info'.
+template<int kKeySize>
+Status SetKernelTlsTx(int fd, const KernelTlsCryptoInfo<kKeySize>& info) {
+  if (setsockopt(fd, SOL_TCP, kTcpUlp, "tls", sizeof("tls")) != 0) {
+    int err = errno;
+    return Status::NotSupported("unable to enable the kernel TLS ULP", ErrnoToString(err), err);
+  }
+  // If this fails, the ULP stays attached but, with no keys configured,
+  // passes data through untouched, so OpenSSL can carry on as before.
+  if (setsockopt(fd, kSolTls, kTlsTx, &info, sizeof(info)) != 0) {
+    int err = errno;
+    return Status::NotSupported("unable to configure kernel TLS", ErrnoToString(err), err);
+  }
+  return Status::OK();
+}
+#endif // defined(__linux__)
+
+} // anonymous namespace
+
 TlsSocket::TlsSocket(int fd, c_unique_ptr<SSL> ssl)
     : Socket(fd),
       ssl_(std::move(ssl)) {
@@ -46,6 +143,10 @@ Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
     return Status::OK();
   }
 
+  if (kernel_tls_send_) {
+    return Socket::Write(buf, amt, nwritten);
+  }
+
   ERR_clear_error();
   errno = 0;
   int32_t bytes_written = SSL_write(ssl_.get(), buf, amt);
@@ -64,6 +165,11 @@ Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
 
 Status TlsSocket::Writev(const struct ::iovec *iov, int iov_len, int32_t *nwritten) {
   CHECK(ssl_);
+  if (kernel_tls_send_) {
+    // The kernel splits the data into records itself, so there's no need to
+    // write (and encrypt) each slice separately.
+    return Socket::Writev(iov, iov_len, nwritten);
+  }
   ERR_clear_error();
   int32_t total_written = 0;
   // Allows packets to be aggresively be accumulated before sending.
@@ -112,13 +218,17 @@ Status TlsSocket::Close() {
 
   // Start the TLS shutdown processes. We don't care about waiting for the
   // response, since the underlying socket will not be reused.
-  int32_t ret = SSL_shutdown(ssl_.get());
+  //
+  // If the kernel is encrypting outbound records, OpenSSL's view of the
+  // write sequence is stale and any alert it sent would be garbage to the
+  // peer, so the connection is simply closed.
   Status ssl_shutdown;
-  if (ret >= 0) {
-    ssl_shutdown = Status::OK();
-  } else {
-    auto error_code = SSL_get_error(ssl_.get(), ret);
-    ssl_shutdown = Status::NetworkError("TlsSocket::Close", GetSSLErrorDescription(error_code));
+  if (!kernel_tls_send_) {
+    int32_t ret = SSL_shutdown(ssl_.get());
+    if (ret < 0) {
+      auto error_code = SSL_get_error(ssl_.get(), ret);
+      ssl_shutdown = Status::NetworkError("TlsSocket::Close", GetSSLErrorDescription(error_code));
+    }
   }
 
   ssl_.reset();
@@ -129,5 +239,101 @@ Status TlsSocket::Close() {
   return ssl_shutdown;
 }
 
+Status TlsSocket::EnableKernelTlsSend() {
+  CHECK(ssl_);
+  DCHECK(!kernel_tls_send_);
+#if defined(__linux__)
+  SSL* ssl = ssl_.get();
+  if (SSL_version(ssl) != TLS1_2_VERSION) {
+    return Status::NotSupported("kernel TLS requires TLS 1.2");
+  }
+
+  // The kernel supports AES-GCM only. The PRF hash follows from the suite.
+  const char* cipher_name = SSL_CIPHER_get_name(SSL_get_current_cipher(ssl));
+  const EVP_MD* prf_md;
+  int key_size;
+  if (HasSuffixString(cipher_name, "AES128-GCM-SHA256")) {
+    prf_md = EVP_sha256();
+    key_size = 16;
+  } else if (HasSuffixString(cipher_name, "AES256-GCM-SHA384")) {
+    prf_md = EVP_sha384();
+    key_size = 32;
+  } else {
+    return Status::NotSupported(Substitute("cipher $0 can not be offloaded to the kernel",
+                                           cipher_name));
+  }
+
+  uint8_t master_key[SSL_MAX_MASTER_KEY_LENGTH];
+  int master_key_len;
+  uint8_t client_random[SSL3_RANDOM_SIZE];
+  uint8_t server_random[SSL3_RANDOM_SIZE];
+  bool is_server;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  const SSL_SESSION* session = SSL_get_session(ssl);
+  master_key_len = session->master_key_length;
+  memcpy(master_key, session->master_key, master_key_len);
+  memcpy(client_random, ssl->s3->client_random, SSL3_RANDOM_SIZE);
+  memcpy(server_random, ssl->s3->server_random, SSL3_RANDOM_SIZE);
+  is_server = ssl->server;
+#else
+  master_key_len = SSL_SESSION_get_master_key(SSL_get_session(ssl), master_key,
+                                              sizeof(master_key));
+  SSL_get_client_random(ssl, client_random, sizeof(client_random));
+  SSL_get_server_random(ssl, server_random, sizeof(server_random));
+  is_server = SSL_is_server(ssl);
+#endif
+
+  // For AEAD suites the key block is: client write key, server write key,
+  // client write IV, server write IV (RFC 5246 section 6.3, RFC 5288).
+  string seed("key expansion");
+  seed.append(reinterpret_cast<const char*>(server_random), SSL3_RANDOM_SIZE);
+  seed.append(reinterpret_cast<const char*>(client_random), SSL3_RANDOM_SIZE);
+  uint8_t key_block[2 * 32 + 2 * kTlsGcmSaltSize];
+  int key_block_len = 2 * key_size + 2 * kTlsGcmSaltSize;
+  Status s = Tls12Prf(prf_md, master_key, master_key_len, seed, key_block, key_block_len);
+  OPENSSL_cleanse(master_key, sizeof(master_key));
+  if (!s.ok()) {
+    OPENSSL_cleanse(key_block, sizeof(key_block));
+    return s;
+  }
+  const uint8_t* write_key = key_block + (is_server ? key_size : 0);
+  const uint8_t* write_salt = key_block + 2 * key_size + (is_server ? kTlsGcmSaltSize : 0);
+
+  // Nothing but the Finished message has been sent under the negotiated keys,
+  // so the next record has sequence number 1. The explicit part of the GCM
+  // nonce only has to be unique, so it starts out as the sequence number.
+  uint8_t rec_seq[kTlsRecSeqSize] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+  if (key_size == 16) {
+    KernelTlsCryptoInfo<16> info;
+    info.version = kTls12Version;
+    info.cipher_type = kTlsCipherAesGcm128;
+    memcpy(info.key, write_key, key_size);
+    memcpy(info.salt, write_salt, kTlsGcmSaltSize);
+    memcpy(info.iv, rec_seq, kTlsGcmIvSize);
+    memcpy(info.rec_seq, rec_seq, kTlsRecSeqSize);
+    s = SetKernelTlsTx(fd_, info);
+    OPENSSL_cleanse(&info, sizeof(info));
+  } else {
+    KernelTlsCryptoInfo<32> info;
+    info.version = kTls12Version;
+    info.cipher_type = kTlsCipherAesGcm256;
+    memcpy(info.key, write_key, key_size);
+    memcpy(info.salt, write_salt, kTlsGcmSaltSize);
+    memcpy(info.iv, rec_seq, kTlsGcmIvSize);
+    memcpy(info.rec_seq, rec_seq, kTlsRecSeqSize);
+    s = SetKernelTlsTx(fd_, info);
+    OPENSSL_cleanse(&info, sizeof(info));
+  }
+  OPENSSL_cleanse(key_block, sizeof(key_block));
+  RETURN_NOT_OK(s);
+
+  kernel_tls_send_ = true;
+  return Status::OK();
+#else
+  return Status::NotSupported("kernel TLS is only supported on Linux");
+#endif // defined(__linux__)
+}
+
 } // namespace security
 } // namespace kudu
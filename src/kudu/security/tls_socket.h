@@ -40,14 +40,31 @@ class TlsSocket : public Socket {
 
   Status Close() override;
 
+  // Returns true if outbound records on this socket are encrypted by the
+  // kernel rather than by OpenSSL. See EnableKernelTlsSend().
+  bool kernel_tls_send() const { return kernel_tls_send_; }
+
  private:
 
   friend class TlsHandshake;
 
   TlsSocket(int fd, c_unique_ptr<SSL> ssl);
 
+  // Hands encryption of outbound records over to the kernel (Linux kTLS), so
+  // that writes go straight from the caller's buffers to the socket without
+  // an encryption copy in userspace. Only TLS 1.2 AES-GCM connections can be
+  // offloaded. Inbound records are still decrypted by OpenSSL.
+  //
+  // Must be called right after the handshake, before any application data
+  // has been written. If this fails, the socket is left unchanged and keeps
+  // using OpenSSL for encryption.
+  Status EnableKernelTlsSend();
+
   // Owned SSL handle.
   c_unique_ptr<SSL> ssl_;
+
+  // See kernel_tls_send().
+  bool kernel_tls_send_ = false;
 };
 
 } // namespace security
@@ -170,6 +170,11 @@ void RpcServer::Shutdown() {
   for (const shared_ptr<AcceptorPool>& pool : acceptor_pools_) {
     pool->Shutdown();
   }
+  // Make sure the port is no longer accepting connections by the time we
+  // return, even if the reactors were doing the accepting.
+  for (const shared_ptr<AcceptorPool>& pool : acceptor_pools_) {
+    pool->WaitForShutdown();
+  }
   acceptor_pools_.clear();
 
   if (messenger_) {
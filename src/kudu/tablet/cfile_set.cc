@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -26,6 +27,8 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/row.h"
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
@@ -45,6 +48,8 @@ using cfile::ReaderOptions;
 using cfile::DefaultColumnValueIterator;
 using fs::ReadableBlock;
 using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////////
@@ -194,6 +199,59 @@ Status CFileSet::GetBounds(string* min_encoded_key,
   return Status::OK();
 }
 
+Status CFileSet::SampleKeys(int num_samples, vector<string>* encoded_keys) const {
+  DCHECK_GT(num_samples, 0);
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (num_rows == 0) {
+    return Status::OK();
+  }
+
+  // The ad-hoc index of composite keys has no positional index, so it can't
+  // be seeked to an ordinal. Instead, the key columns (whose CFiles always
+  // have one) are each read at the ordinal, and the key is encoded from the
+  // resulting row.
+  const Schema& schema = tablet_schema();
+  const Schema key_schema = schema.CreateKeyProjection();
+  vector<unique_ptr<CFileIterator>> key_col_iters;
+  for (size_t i = 0; i < key_schema.num_key_columns(); i++) {
+    CFileIterator* iter;
+    RETURN_NOT_OK(NewColumnIterator(schema.column_id(i), CFileReader::CACHE_BLOCK, &iter));
+    key_col_iters.emplace_back(iter);
+  }
+
+  Arena arena(1024, 1024 * 1024);
+  faststring row_buf;
+  row_buf.resize(key_schema.byte_size());
+  ContiguousRow row(&key_schema, row_buf.data());
+  SelectionVector sel(1);
+  faststring buf;
+
+  // Pick the ordinals which split the rowset into 'num_samples + 1' pieces
+  // of roughly equal row count.
+  for (int i = 1; i <= num_samples; i++) {
+    rowid_t ordinal = static_cast<uint64_t>(num_rows) * i / (num_samples + 1);
+    size_t n = 1;
+    for (size_t j = 0; j < key_col_iters.size() && n > 0; j++) {
+      ColumnBlock cb(key_schema.column(j).type_info(), nullptr,
+                     row.mutable_cell_ptr(j), 1, &arena);
+      ColumnMaterializationContext ctx(j, nullptr, &cb, &sel);
+      RETURN_NOT_OK(key_col_iters[j]->SeekToOrdinal(ordinal));
+      RETURN_NOT_OK(key_col_iters[j]->CopyNextValues(&n, &ctx));
+    }
+    if (n == 0) {
+      break;
+    }
+    key_schema.EncodeComparableKey(row, &buf);
+    arena.Reset();
+    if (!encoded_keys->empty() && Slice(encoded_keys->back()) == Slice(buf)) {
+      continue;
+    }
+    encoded_keys->emplace_back(buf.ToString());
+  }
+  return Status::OK();
+}
+
 uint64_t CFileSet::EstimateOnDiskSize() const {
   uint64_t ret = 0;
   for (const ReaderMap::value_type& e : readers_by_col_id_) {
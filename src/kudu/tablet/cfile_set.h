@@ -67,6 +67,10 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const;
 
+  // See RowSet::SampleKeys. The keys are read from the key columns at
+  // evenly-spaced row ordinals.
+  Status SampleKeys(int num_samples, std::vector<std::string>* encoded_keys) const;
+
   uint64_t EstimateOnDiskSize() const;
 
   // Determine the index of the given row key.
@@ -660,6 +660,13 @@ Status DiskRowSet::GetBounds(std::string* min_encoded_key,
   return base_data_->GetBounds(min_encoded_key, max_encoded_key);
 }
 
+Status DiskRowSet::SampleKeys(int num_samples,
+                              std::vector<std::string>* encoded_keys) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->SampleKeys(num_samples, encoded_keys);
+}
+
 uint64_t DiskRowSet::EstimateBaseDataDiskSize() const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
@@ -328,6 +328,10 @@ class DiskRowSet : public RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  // See RowSet::SampleKeys(...)
+  virtual Status SampleKeys(int num_samples,
+                            std::vector<std::string>* encoded_keys) const OVERRIDE;
+
   // Estimate the number of bytes on-disk for the base data.
   uint64_t EstimateBaseDataDiskSize() const;
 
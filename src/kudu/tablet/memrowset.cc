@@ -306,6 +306,12 @@ Status MemRowSet::GetBounds(string *min_encoded_key,
   return Status::NotSupported("");
 }
 
+Status MemRowSet::SampleKeys(int num_samples,
+                             vector<string>* encoded_keys) const {
+  // The rowset is still mutable, and isn't sorted by row ordinal.
+  return Status::OK();
+}
+
 // Virtual interface allows two possible row projector implementations
 class MemRowSet::Iterator::MRSRowProjector {
  public:
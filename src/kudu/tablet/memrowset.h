@@ -233,6 +233,9 @@ class MemRowSet : public RowSet,
   virtual Status GetBounds(std::string *min_encoded_key,
                            std::string *max_encoded_key) const OVERRIDE;
 
+  virtual Status SampleKeys(int num_samples,
+                            std::vector<std::string>* encoded_keys) const OVERRIDE;
+
   uint64_t EstimateOnDiskSize() const OVERRIDE {
     return 0;
   }
@@ -63,6 +63,11 @@ class MockRowSet : public RowSet {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
   }
+  virtual Status SampleKeys(int num_samples,
+                            std::vector<std::string>* encoded_keys) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
   virtual std::string ToString() const OVERRIDE {
     LOG(FATAL) << "Unimplemented";
     return "";
@@ -163,6 +168,11 @@ class MockMemRowSet : public MockRowSet {
     return Status::NotSupported("");
   }
 
+  virtual Status SampleKeys(int num_samples,
+                            std::vector<std::string>* encoded_keys) const OVERRIDE {
+    return Status::OK();
+  }
+
  private:
   const std::string first_key_;
   const std::string last_key_;
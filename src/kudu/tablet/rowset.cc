@@ -207,6 +207,13 @@ Status DuplicatingRowSet::GetBounds(string* min_encoded_key,
   return Status::OK();
 }
 
+Status DuplicatingRowSet::SampleKeys(int num_samples,
+                                     vector<string>* encoded_keys) const {
+  // The rowset is short-lived, and its data will be sampled from the
+  // output rowsets once the flush or compaction completes.
+  return Status::OK();
+}
+
 uint64_t DuplicatingRowSet::EstimateOnDiskSize() const {
   // The actual value of this doesn't matter, since it won't be selected
   // for compaction.
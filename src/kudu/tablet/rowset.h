@@ -107,6 +107,16 @@ class RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const = 0;
 
+  // Sample up to 'num_samples' encoded keys which are spread evenly by row
+  // ordinal across this RowSet, appending them to 'encoded_keys' in
+  // ascending order. The samples are approximate: they may include keys of
+  // rows which have since been deleted.
+  //
+  // Rowsets which can't be sampled, because they are still mutable (eg
+  // MemRowSet) or short-lived (eg DuplicatingRowSet), append no keys.
+  virtual Status SampleKeys(int num_samples,
+                            std::vector<std::string>* encoded_keys) const = 0;
+
   // Return a displayable string for this rowset.
   virtual string ToString() const = 0;
 
@@ -276,6 +286,9 @@ class DuplicatingRowSet : public RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  virtual Status SampleKeys(int num_samples,
+                            std::vector<std::string>* encoded_keys) const OVERRIDE;
+
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
   string ToString() const OVERRIDE;
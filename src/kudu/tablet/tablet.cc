@@ -145,6 +145,7 @@ using kudu::consensus::OpId;
 using kudu::consensus::MaximumOpId;
 using kudu::log::LogAnchorRegistry;
 using kudu::server::HybridClock;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -1535,6 +1536,57 @@ size_t Tablet::EstimateOnDiskSize() const {
   return ret;
 }
 
+Status Tablet::SplitKeyRange(uint64_t target_chunk_size_bytes,
+                             vector<string>* split_keys) const {
+  CHECK_GT(target_chunk_size_bytes, 0);
+  split_keys->clear();
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  if (!comps) {
+    return Status::IllegalState("Tablet is not open");
+  }
+
+  // Sample each rowset proportionally to its size, so that every sample
+  // stands for about the same number of bytes regardless of which rowset
+  // it came from. Sampling several keys per chunk keeps the error in the
+  // resulting chunk sizes small.
+  const int kSamplesPerChunk = 4;
+  const int kMaxSamplesPerRowSet = 1000;
+  vector<pair<string, uint64_t>> samples;
+  for (const shared_ptr<RowSet> &rowset : comps->rowsets->all_rowsets()) {
+    uint64_t size = rowset->EstimateOnDiskSize();
+    if (size == 0) continue;
+    int num_samples = std::min<uint64_t>(
+        std::max<uint64_t>(size * kSamplesPerChunk / target_chunk_size_bytes, 1),
+        kMaxSamplesPerRowSet);
+    vector<string> keys;
+    RETURN_NOT_OK_PREPEND(rowset->SampleKeys(num_samples, &keys),
+                          Substitute("Unable to sample keys from $0", rowset->ToString()));
+    if (keys.empty()) continue;
+    // The samples cut the rowset into 'keys.size() + 1' pieces; attribute to
+    // each sample the piece which precedes it.
+    uint64_t bytes_per_sample = size / (keys.size() + 1);
+    for (string& key : keys) {
+      samples.emplace_back(std::move(key), bytes_per_sample);
+    }
+  }
+
+  // Walk the samples in key order, cutting a new chunk every time the
+  // accumulated size reaches the target.
+  std::sort(samples.begin(), samples.end());
+  uint64_t chunk_bytes = 0;
+  for (const auto& sample : samples) {
+    chunk_bytes += sample.second;
+    if (chunk_bytes < target_chunk_size_bytes) continue;
+    if (split_keys->empty() || split_keys->back() != sample.first) {
+      split_keys->push_back(sample.first);
+    }
+    chunk_bytes = 0;
+  }
+  return Status::OK();
+}
+
 size_t Tablet::DeltaMemStoresSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
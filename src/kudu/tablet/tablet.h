@@ -237,6 +237,17 @@ class Tablet {
   // Estimate the total on-disk size of this tablet, in bytes.
   size_t EstimateOnDiskSize() const;
 
+  // Compute encoded primary keys which split the tablet's key space into
+  // contiguous ranges of roughly 'target_chunk_size_bytes' of on-disk data
+  // each. The keys are returned in ascending order in 'split_keys', and
+  // are empty if the tablet is smaller than the target.
+  //
+  // The split keys are estimated from keys sampled out of each DiskRowSet's
+  // key index, weighted by the rowset's on-disk size. Data in the MemRowSet
+  // and in rowsets being flushed or compacted is not taken into account.
+  Status SplitKeyRange(uint64_t target_chunk_size_bytes,
+                       std::vector<std::string>* split_keys) const;
+
   // Get the total size of all the DMS
   size_t DeltaMemStoresSize() const;
 
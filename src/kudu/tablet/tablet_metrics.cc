@@ -55,6 +55,11 @@ METRIC_DEFINE_counter(tablet, scanner_bytes_returned, "Scanner Bytes Returned",
                       "is measured after predicates are applied and the data is decoded "
                       "for consumption by clients, and thus is not "
                       "a reflection of the amount of work being done by scanners.");
+METRIC_DEFINE_counter(tablet, scanner_readahead_batches_returned,
+                      "Scanner Read-Ahead Batches Returned",
+                      kudu::MetricUnit::kUnits,
+                      "Number of scan batches returned to clients which had been "
+                      "read ahead of the client's request for them.");
 
 
 METRIC_DEFINE_counter(tablet, scanner_rows_scanned, "Scanner Rows Scanned",
@@ -230,6 +235,7 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(scanner_rows_returned),
     MINIT(scanner_cells_returned),
     MINIT(scanner_bytes_returned),
+    MINIT(scanner_readahead_batches_returned),
     MINIT(scanner_rows_scanned),
     MINIT(scanner_cells_scanned_from_disk),
     MINIT(scanner_bytes_scanned_from_disk),
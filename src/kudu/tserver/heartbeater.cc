@@ -17,6 +17,7 @@
 
 #include "kudu/tserver/heartbeater.h"
 
+#include <algorithm>
 #include <boost/optional.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -25,6 +26,7 @@
 #include <vector>
 
 #include "kudu/common/wire_protocol.h"
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.h"
@@ -32,10 +34,16 @@
 #include "kudu/master/master.proxy.h"
 #include "kudu/security/server_cert_manager.h"
 #include "kudu/server/webserver.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/tablet_server_options.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
@@ -119,6 +127,7 @@ class Heartbeater::Thread {
   Status DoHeartbeat();
   Status SetupRegistration(ServerRegistrationPB* reg);
   void SetupCommonField(master::TSToMasterCommonPB* common);
+  void SetupResourceStats(master::TSResourceStatsPB* stats);
   bool IsCurrentThread() const;
 
   // The host and port of the master that this thread will heartbeat to.
@@ -179,6 +188,13 @@ class Heartbeater::Thread {
   // the thread detects that the master has been elected leader.
   bool send_full_tablet_report_;
 
+  // The numbers of rows written and scanned by the server's tablets, and the
+  // time they were counted, as of the previous heartbeat. Used to compute the
+  // throughput sent in the resource stats.
+  int64_t last_rows_written_;
+  int64_t last_rows_scanned_;
+  MonoTime last_resource_stats_time_;
+
   DISALLOW_COPY_AND_ASSIGN(Thread);
 };
 
@@ -278,7 +294,9 @@ Heartbeater::Thread::Thread(const HostPort& master_address, TabletServer* server
     cond_(&mutex_),
     should_run_(false),
     heartbeat_asap_(true),
-    send_full_tablet_report_(false) {
+    send_full_tablet_report_(false),
+    last_rows_written_(0),
+    last_rows_scanned_(0) {
 }
 
 Status Heartbeater::Thread::ConnectToMaster() {
@@ -394,6 +412,7 @@ Status Heartbeater::Thread::DoHeartbeat() {
     GenerateIncrementalTabletReport(req.mutable_tablet_report());
   }
   req.set_num_live_tablets(server_->tablet_manager()->GetNumLiveTablets());
+  SetupResourceStats(req.mutable_resource_stats());
 
   RpcController rpc;
   rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_heartbeat_rpc_timeout_ms));
@@ -427,6 +446,13 @@ Status Heartbeater::Thread::DoHeartbeat() {
   }
 
   MarkTabletReportAcknowledged(req.tablet_report());
+
+  // The master skips tablets it failed to handle; report them again.
+  for (const auto& tablet : last_hb_response_.tablet_report().tablets()) {
+    if (tablet.has_error()) {
+      MarkTabletDirty(tablet.tablet_id(), "master failed to handle its report");
+    }
+  }
   return Status::OK();
 }
 
@@ -486,6 +512,65 @@ void Heartbeater::Thread::RunThread() {
   }
 }
 
+void Heartbeater::Thread::SetupResourceStats(master::TSResourceStatsPB* stats) {
+  FsManager* fs_manager = server_->fs_manager();
+  vector<string> data_dirs = fs_manager->GetDataRootDirs();
+  stats->set_num_data_dirs(data_dirs.size());
+  int64_t free_bytes = 0;
+  for (const string& dir : data_dirs) {
+    int64_t dir_free_bytes;
+    Status s = fs_manager->env()->GetBytesFree(dir, &dir_free_bytes);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to determine free space in " << dir
+                                     << ": " << s.ToString() << THROTTLE_MSG;
+      free_bytes = -1;
+      break;
+    }
+    free_bytes += dir_free_bytes;
+  }
+  if (free_bytes >= 0) {
+    stats->set_data_dirs_free_bytes(free_bytes);
+  }
+
+  int64_t rows_written = 0;
+  int64_t rows_scanned = 0;
+  vector<scoped_refptr<tablet::TabletPeer>> peers;
+  server_->tablet_manager()->GetTabletPeers(&peers);
+  for (const auto& peer : peers) {
+    shared_ptr<tablet::Tablet> tablet = peer->shared_tablet();
+    if (!tablet || !tablet->metrics()) {
+      continue;
+    }
+    const tablet::TabletMetrics* metrics = tablet->metrics();
+    rows_written += metrics->rows_inserted->value() +
+                    metrics->rows_upserted->value() +
+                    metrics->rows_updated->value() +
+                    metrics->rows_deleted->value();
+    rows_scanned += metrics->scanner_rows_scanned->value();
+  }
+  MonoTime now = MonoTime::Now();
+  if (last_resource_stats_time_.Initialized()) {
+    double elapsed_secs = (now - last_resource_stats_time_).ToSeconds();
+    if (elapsed_secs > 0) {
+      // The totals drop when tablets are removed from the server, in which
+      // case the server is reported idle until the next heartbeat.
+      stats->set_write_rows_per_sec(
+          std::max<int64_t>(rows_written - last_rows_written_, 0) / elapsed_secs);
+      stats->set_scan_rows_per_sec(
+          std::max<int64_t>(rows_scanned - last_rows_scanned_, 0) / elapsed_secs);
+    }
+  }
+  last_rows_written_ = rows_written;
+  last_rows_scanned_ = rows_scanned;
+  last_resource_stats_time_ = now;
+
+  shared_ptr<MemTracker> root_tracker = MemTracker::GetRootTracker();
+  if (root_tracker->has_limit() && root_tracker->limit() > 0) {
+    stats->set_memory_pressure(static_cast<double>(root_tracker->consumption()) /
+                               root_tracker->limit());
+  }
+}
+
 bool Heartbeater::Thread::IsCurrentThread() const {
   return thread_.get() == kudu::Thread::current_thread();
 }
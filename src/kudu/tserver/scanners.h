@@ -17,6 +17,7 @@
 #ifndef KUDU_TSERVER_SCANNERS_H
 #define KUDU_TSERVER_SCANNERS_H
 
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -25,17 +26,22 @@
 #include <vector>
 
 #include "kudu/common/iterator_stats.h"
+#include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/rw_mutex.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
@@ -43,7 +49,6 @@ class MetricEntity;
 class RowwiseIterator;
 class ScanSpec;
 class Schema;
-class Status;
 class Thread;
 
 struct IteratorStats;
@@ -164,6 +169,24 @@ class ScopedUnregisterScanner {
   bool cancelled_;
 };
 
+// A batch of scan results produced ahead of the client's request for it.
+// See ScanRequestPB.readahead_batches.
+struct ReadaheadBatch {
+  RowwiseRowBlockPB data;
+  gscoped_ptr<faststring> rows_data;
+  gscoped_ptr<faststring> indirect_data;
+  std::string last_primary_key;
+
+  // Charges the batch's buffers to the tablet's memory tracker until the
+  // batch is returned to the client or the scanner is destroyed.
+  std::unique_ptr<ScopedTrackedConsumption> mem_consumption;
+
+  // The result of producing the batch. If the iterator failed part way
+  // through, the failure is returned to the client in place of the rows.
+  Status status;
+  TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+};
+
 // An open scanner on the server side.
 class Scanner {
  public:
@@ -272,6 +295,19 @@ class Scanner {
     already_reported_stats_ = stats;
   }
 
+  // Serializes use of the iterator between the RPC handlers serving this
+  // scanner and any read-ahead in progress on its behalf. Must be held while
+  // calling iter()->NextBlock() or accessing readahead_queue().
+  std::mutex* scan_lock() {
+    return &scan_lock_;
+  }
+
+  // Batches which have been read ahead and not yet returned to the client,
+  // in scan order. Requires that scan_lock() is held.
+  std::deque<std::unique_ptr<ReadaheadBatch>>* readahead_queue() {
+    return &readahead_queue_;
+  }
+
  private:
   friend class ScannerManager;
 
@@ -305,6 +341,10 @@ class Scanner {
   // as the scanner proceeds.
   IteratorStats already_reported_stats_;
 
+  // See scan_lock() and readahead_queue().
+  std::mutex scan_lock_;
+  std::deque<std::unique_ptr<ReadaheadBatch>> readahead_queue_;
+
   // The spec used by 'iter_'
   gscoped_ptr<ScanSpec> spec_;
 
@@ -1732,6 +1732,56 @@ TEST_F(TabletServerTest, TestScan_InvalidScanSeqId) {
   }
 }
 
+// Test that a scanner which asks for read-ahead has batches buffered for it
+// between requests, and that those batches are returned in order.
+TEST_F(TabletServerTest, TestScan_Readahead) {
+  const int kNumRows = 1000;
+  const int kReadaheadBatches = 3;
+  InsertTestRowsDirect(0, kNumRows);
+
+  // Make each batch a single block of 10 rows.
+  FLAGS_scanner_batch_size_rows = 10;
+
+  ScanResponsePB resp;
+  ASSERT_NO_FATAL_FAILURE(OpenScannerWithAllColumns(&resp));
+  string scanner_id = resp.scanner_id();
+  SharedScanner scanner;
+  ASSERT_TRUE(mini_server_->server()->scanner_manager()->LookupScanner(scanner_id, &scanner));
+
+  ScanRequestPB req;
+  RpcController rpc;
+  req.set_scanner_id(scanner_id);
+  req.set_batch_size_bytes(1);
+  req.set_readahead_batches(kReadaheadBatches);
+  vector<string> results;
+  uint32_t call_seq_id = 1;
+  do {
+    rpc.Reset();
+    req.set_call_seq_id(call_seq_id++);
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    StringifyRowsFromResponse(schema_, rpc, resp, &results);
+
+    // After the first response the server should fill up the scanner's
+    // read-ahead buffer.
+    if (call_seq_id == 2) {
+      AssertEventually([&]() {
+        std::lock_guard<std::mutex> l(*scanner->scan_lock());
+        ASSERT_EQ(kReadaheadBatches, scanner->readahead_queue()->size());
+      });
+    }
+  } while (resp.has_more_results());
+
+  ASSERT_EQ(kNumRows, results.size());
+  KuduPartialRow row(&schema_);
+  for (int i = 0; i < kNumRows; i++) {
+    BuildTestRow(i, &row);
+    ASSERT_EQ("(" + row.ToString() + ")", results[i]);
+  }
+}
+
 // Regression test for KUDU-1789: when ScannerKeepAlive is called on a non-existent
 // scanner, it should properly respond with an error.
 TEST_F(TabletServerTest, TestScan_KeepAliveExpiredScanner) {
@@ -20,7 +20,9 @@
 #include <algorithm>
 #include <boost/optional.hpp>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/iterator.h"
@@ -87,6 +89,19 @@ DEFINE_int32(scanner_max_wait_ms, 1000,
              "longer.");
 TAG_FLAG(scanner_max_wait_ms, advanced);
 
+DEFINE_int32(scanner_max_readahead_batches, 4,
+             "The maximum number of batches of scan results the server reads ahead "
+             "of a client's continuation requests, for clients which ask for read-ahead. "
+             "Set to 0 to disable scan read-ahead.");
+TAG_FLAG(scanner_max_readahead_batches, advanced);
+TAG_FLAG(scanner_max_readahead_batches, runtime);
+
+DEFINE_int32(scanner_readahead_threads, 4,
+             "The number of threads which read scan batches ahead of clients' "
+             "continuation requests. At most as many further read-ahead requests "
+             "may be queued; beyond that, read-ahead is skipped.");
+TAG_FLAG(scanner_readahead_threads, advanced);
+
 // Fault injection flags.
 DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "If set, the scanner will pause the specified number of milliesconds "
@@ -511,6 +526,10 @@ static size_t GetMaxBatchSizeBytesHint(const ScanRequestPB* req) {
 TabletServiceImpl::TabletServiceImpl(TabletServer* server)
   : TabletServerServiceIf(server->metric_entity(), server->result_tracker()),
     server_(server) {
+  CHECK_OK(ThreadPoolBuilder("scan-readahead")
+           .set_max_threads(FLAGS_scanner_readahead_threads)
+           .set_max_queue_size(FLAGS_scanner_readahead_threads)
+           .Build(&readahead_pool_));
 }
 
 void TabletServiceImpl::Ping(const PingRequestPB* req,
@@ -1055,6 +1074,8 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
 
   bool has_more_results = false;
+  string scanner_id;
+  unique_ptr<ReadaheadBatch> readahead_batch;
   TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
   if (req->has_new_scan_request()) {
     const NewScanRequestPB& scan_pb = req->new_scan_request();
@@ -1063,7 +1084,6 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
                                    &tablet_peer)) {
       return;
     }
-    string scanner_id;
     Timestamp scan_timestamp;
     Status s = HandleNewScanRequest(tablet_peer.get(), req, context,
                                     &collector, &scanner_id, &scan_timestamp, &has_more_results,
@@ -1081,7 +1101,9 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
       resp->set_snap_timestamp(scan_timestamp.ToUint64());
     }
   } else if (req->has_scanner_id()) {
-    Status s = HandleContinueScanRequest(req, &collector, &has_more_results, &error_code);
+    scanner_id = req->scanner_id();
+    Status s = HandleContinueScanRequest(req, &collector, &readahead_batch, &has_more_results,
+                                         &error_code);
     if (PREDICT_FALSE(!s.ok())) {
       SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
       return;
@@ -1093,8 +1115,24 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   }
   resp->set_has_more_results(has_more_results);
 
-  DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
-  if (collector.BlocksProcessed() > 0) {
+  bool has_data = false;
+  string last_primary_key;
+  if (readahead_batch) {
+    // The batch was scanned ahead of this request: send it as if it had
+    // just been collected.
+    data.Swap(&readahead_batch->data);
+    rows_data.swap(readahead_batch->rows_data);
+    indirect_data.swap(readahead_batch->indirect_data);
+    last_primary_key.swap(readahead_batch->last_primary_key);
+    has_data = true;
+  } else {
+    DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
+    if (collector.BlocksProcessed() > 0) {
+      last_primary_key = collector.last_primary_key().ToString();
+      has_data = true;
+    }
+  }
+  if (has_data) {
     resp->mutable_data()->CopyFrom(data);
 
     // Add sidecar data to context and record the returned indices.
@@ -1114,14 +1152,31 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
     // Set the last row found by the collector.
     // We could have an empty batch if all the remaining rows are filtered by the predicate,
     // in which case do not set the last row.
-    const faststring& last = collector.last_primary_key();
-    if (last.length() > 0) {
-      resp->set_last_primary_key(last.ToString());
+    if (!last_primary_key.empty()) {
+      resp->set_last_primary_key(last_primary_key);
     }
   }
   resp->set_propagated_timestamp(server_->clock()->Now().ToUint64());
+  resp->set_queue_time_us(context->GetTimeInQueue().ToMicroseconds());
   SetResourceMetrics(resp->mutable_resource_metrics(), context);
+
+  uint32_t readahead_batches = 0;
+  if (has_more_results && FLAGS_scanner_max_readahead_batches > 0) {
+    readahead_batches = std::min(req->readahead_batches(),
+                                 implicit_cast<uint32_t>(FLAGS_scanner_max_readahead_batches));
+  }
   context->RespondSuccess();
+
+  // 'req' and 'resp' are no longer valid once the response has been sent.
+  // Scan the next batches while the client is busy receiving this one.
+  if (readahead_batches > 0) {
+    Status s = readahead_pool_->SubmitClosure(
+        Bind(&TabletServiceImpl::ReadAheadScan, Unretained(this),
+             scanner_id, batch_size_bytes, readahead_batches));
+    if (PREDICT_FALSE(!s.ok())) {
+      VLOG(2) << "Skipping read-ahead for scanner " << scanner_id << ": " << s.ToString();
+    }
+  }
 }
 
 void TabletServiceImpl::ListTablets(const ListTabletsRequestPB* req,
@@ -1192,7 +1247,8 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
     const ContinueChecksumRequestPB& continue_req = req->continue_request();
     collector.set_agg_checksum(continue_req.previous_checksum());
     scan_req.set_scanner_id(continue_req.scanner_id());
-    Status s = HandleContinueScanRequest(&scan_req, &collector, &has_more, &error_code);
+    Status s = HandleContinueScanRequest(&scan_req, &collector, nullptr, &has_more,
+                                         &error_code);
     if (PREDICT_FALSE(!s.ok())) {
       SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
       return;
@@ -1210,11 +1266,53 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  if (PREDICT_FALSE(req->target_chunk_size_bytes() == 0)) {
+    context->RespondFailure(Status::InvalidArgument(
+                            "target_chunk_size_bytes must be greater than zero"));
+    return;
+  }
+
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<string> split_keys;
+  s = tablet->SplitKeyRange(req->target_chunk_size_bytes(), &split_keys);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  for (string& key : split_keys) {
+    resp->add_split_keys()->swap(key);
+  }
+  context->RespondSuccess();
+}
+
 bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
-  return feature == TabletServerFeatures::COLUMN_PREDICATES;
+  switch (feature) {
+    case TabletServerFeatures::COLUMN_PREDICATES:
+    case TabletServerFeatures::SPLIT_KEY_RANGE:
+      return true;
+    default:
+      return false;
+  }
 }
 
 void TabletServiceImpl::Shutdown() {
+  readahead_pool_->Shutdown();
 }
 
 // Extract a void* pointer suitable for use in a ColumnRangePredicate from the
@@ -1602,8 +1700,8 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     // and call the second half directly
     ScanRequestPB continue_req(*req);
     continue_req.set_scanner_id(scanner->id());
-    RETURN_NOT_OK(HandleContinueScanRequest(&continue_req, result_collector, has_more_results,
-                                            error_code));
+    RETURN_NOT_OK(HandleContinueScanRequest(&continue_req, result_collector, nullptr,
+                                            has_more_results, error_code));
   } else {
     // Increment the scanner call sequence ID. HandleContinueScanRequest handles
     // this in the non-empty scan case.
@@ -1613,10 +1711,12 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
 }
 
 // Continue an existing scan request.
-Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
-                                                    ScanResultCollector* result_collector,
-                                                    bool* has_more_results,
-                                                    TabletServerErrorPB::Code* error_code) {
+Status TabletServiceImpl::HandleContinueScanRequest(
+    const ScanRequestPB* req,
+    ScanResultCollector* result_collector,
+    unique_ptr<ReadaheadBatch>* readahead_batch,
+    bool* has_more_results,
+    TabletServerErrorPB::Code* error_code) {
   DCHECK(req->has_scanner_id());
   TRACE_EVENT1("tserver", "TabletServiceImpl::HandleContinueScanRequest",
                "scanner_id", req->scanner_id());
@@ -1656,6 +1756,43 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   scanner->IncrementCallSeqId();
   scanner->UpdateAccessTime();
 
+  std::lock_guard<std::mutex> l(*scanner->scan_lock());
+  auto* readahead_queue = scanner->readahead_queue();
+  DCHECK(readahead_batch || readahead_queue->empty());
+  if (readahead_batch && !readahead_queue->empty()) {
+    TRACE("Returning batch read ahead by scanner $0", scanner->id());
+    unique_ptr<ReadaheadBatch> batch = std::move(readahead_queue->front());
+    readahead_queue->pop_front();
+    if (PREDICT_FALSE(!batch->status.ok())) {
+      *error_code = batch->error_code;
+      return batch->status;
+    }
+    shared_ptr<Tablet> tablet = scanner->tablet_peer()->shared_tablet();
+    if (tablet) {
+      tablet->metrics()->scanner_readahead_batches_returned->Increment();
+    }
+    *readahead_batch = std::move(batch);
+  } else {
+    RETURN_NOT_OK(CollectScanBatch(scanner.get(), batch_size_bytes, result_collector,
+                                   error_code));
+  }
+
+  scanner->UpdateAccessTime();
+  *has_more_results = !req->close_scanner() &&
+      (!readahead_queue->empty() || scanner->iter()->HasNext());
+  if (*has_more_results) {
+    unreg_scanner.Cancel();
+  } else {
+    VLOG(2) << "Scanner " << scanner->id() << " complete: removing...";
+  }
+
+  return Status::OK();
+}
+
+Status TabletServiceImpl::CollectScanBatch(Scanner* scanner,
+                                           size_t batch_size_bytes,
+                                           ScanResultCollector* result_collector,
+                                           TabletServerErrorPB::Code* error_code) {
   RowwiseIterator* iter = scanner->iter();
 
   // TODO: could size the RowBlock based on the user's requested batch size?
@@ -1678,8 +1815,8 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
 
     Status s = iter->NextBlock(&block);
     if (PREDICT_FALSE(!s.ok())) {
-      LOG(WARNING) << "Copying rows from internal iterator for request "
-                   << SecureShortDebugString(*req);
+      LOG(WARNING) << "Copying rows from internal iterator for scanner " << scanner->id()
+                   << ": " << s.ToString();
       *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
       return s;
     }
@@ -1757,17 +1894,65 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
         delta_stats.bytes_read_from_disk);
   }
 
-  scanner->UpdateAccessTime();
-  *has_more_results = !req->close_scanner() && iter->HasNext();
-  if (*has_more_results) {
-    unreg_scanner.Cancel();
-  } else {
-    VLOG(2) << "Scanner " << scanner->id() << " complete: removing...";
-  }
-
   return Status::OK();
 }
 
+void TabletServiceImpl::ReadAheadScan(const string& scanner_id,
+                                      size_t batch_size_bytes,
+                                      uint32_t num_batches) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::ReadAheadScan",
+               "scanner_id", scanner_id);
+  while (true) {
+    // Look the scanner up again for every batch, so that we stop reading
+    // ahead once the scanner has been closed or has expired.
+    SharedScanner scanner;
+    if (!server_->scanner_manager()->LookupScanner(scanner_id, &scanner)) {
+      return;
+    }
+
+    // The lock is released between batches so that a continuation request
+    // arriving in the meantime only waits for the batch in progress.
+    std::lock_guard<std::mutex> l(*scanner->scan_lock());
+    auto* readahead_queue = scanner->readahead_queue();
+    if (readahead_queue->size() >= num_batches || !scanner->iter()->HasNext()) {
+      return;
+    }
+
+    // Buffered batches are charged to the tablet's memory tracker. Stop
+    // reading ahead rather than push the tablet or the process over its limit.
+    shared_ptr<Tablet> tablet = scanner->tablet_peer()->shared_tablet();
+    if (!tablet) {
+      return;
+    }
+    const shared_ptr<MemTracker>& mem_tracker = tablet->mem_tracker();
+    int64_t buffer_size = batch_size_bytes * 11 / 10;
+    if (mem_tracker->SpareCapacity() < 2 * buffer_size) {
+      TRACE("Memory limit reached, not reading ahead for scanner $0", scanner_id);
+      return;
+    }
+
+    unique_ptr<ReadaheadBatch> batch(new ReadaheadBatch);
+    batch->mem_consumption.reset(new ScopedTrackedConsumption(mem_tracker, 2 * buffer_size));
+    batch->rows_data.reset(new faststring(buffer_size));
+    batch->indirect_data.reset(new faststring(buffer_size));
+    ScanResultCopier collector(&batch->data, batch->rows_data.get(), batch->indirect_data.get());
+    batch->status = CollectScanBatch(scanner.get(), batch_size_bytes, &collector,
+                                     &batch->error_code);
+    if (batch->status.ok() && collector.BlocksProcessed() == 0) {
+      // Every remaining row was filtered out or deleted.
+      return;
+    }
+    batch->last_primary_key = collector.last_primary_key().ToString();
+    batch->mem_consumption->Reset(batch->rows_data->capacity() +
+                                  batch->indirect_data->capacity());
+    bool failed = !batch->status.ok();
+    readahead_queue->push_back(std::move(batch));
+    if (failed) {
+      return;
+    }
+  }
+}
+
 namespace {
 // Helper to clamp a client deadline for a scan to the max supported by the server.
 MonoTime ClampScanDeadlineForWait(const MonoTime& deadline, bool* was_clamped) {
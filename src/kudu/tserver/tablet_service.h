@@ -22,9 +22,11 @@
 #include <vector>
 
 #include "kudu/consensus/consensus.service.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tserver_admin.service.h"
 #include "kudu/tserver/tserver_service.service.h"
+#include "kudu/util/threadpool.h"
 
 namespace kudu {
 class RowwiseIterator;
@@ -41,8 +43,10 @@ class TransactionState;
 namespace tserver {
 
 class ScanResultCollector;
+class Scanner;
 class TabletPeerLookupIf;
 class TabletServer;
+struct ReadaheadBatch;
 
 class TabletServiceImpl : public TabletServerServiceIf {
  public:
@@ -71,6 +75,10 @@ class TabletServiceImpl : public TabletServerServiceIf {
                         ChecksumResponsePB* resp,
                         rpc::RpcContext* context) OVERRIDE;
 
+  virtual void SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                             SplitKeyRangeResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
   bool SupportsFeature(uint32_t feature) const override;
 
   virtual void Shutdown() OVERRIDE;
@@ -85,11 +93,30 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               bool* has_more_results,
                               TabletServerErrorPB::Code* error_code);
 
+  // Continue an existing scan. If 'readahead_batch' is non-NULL and the
+  // scanner has a batch which was read ahead, that batch is moved into
+  // 'readahead_batch' instead of scanning into 'result_collector'.
   Status HandleContinueScanRequest(const ScanRequestPB* req,
                                    ScanResultCollector* result_collector,
+                                   std::unique_ptr<ReadaheadBatch>* readahead_batch,
                                    bool* has_more_results,
                                    TabletServerErrorPB::Code* error_code);
 
+  // Scan the next batch from 'scanner' into 'result_collector', stopping once
+  // the batch reaches 'batch_size_bytes' or the time budget runs out, and
+  // update the tablet's scan metrics. The scanner's scan_lock() must be held.
+  Status CollectScanBatch(Scanner* scanner,
+                          size_t batch_size_bytes,
+                          ScanResultCollector* result_collector,
+                          TabletServerErrorPB::Code* error_code);
+
+  // Read ahead up to 'num_batches' batches for the scanner with the given
+  // ID, buffering them with the scanner. Runs on 'readahead_pool_' once the
+  // response to a scan request has been sent.
+  void ReadAheadScan(const std::string& scanner_id,
+                     size_t batch_size_bytes,
+                     uint32_t num_batches);
+
   Status HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                               const rpc::RpcContext* rpc_context,
                               const Schema& projection,
@@ -98,6 +125,11 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               Timestamp* snap_timestamp);
 
   TabletServer* server_;
+
+  // Pool on which scans are read ahead, so that read-ahead does not hold
+  // RPC service threads. Its queue is bounded: read-ahead which cannot be
+  // queued is skipped, and the client's next request scans as usual.
+  gscoped_ptr<ThreadPool> readahead_pool_;
 };
 
 class TabletServiceAdminImpl : public TabletServerAdminServiceIf {
@@ -132,6 +132,14 @@ class SnappyCodec : public CompressionCodec {
   Status Uncompress(const Slice& compressed,
                     uint8_t *uncompressed,
                     size_t uncompressed_length) const OVERRIDE {
+    // The input may be corrupt, so make sure it can't overrun the output
+    // buffer.
+    size_t actual_length;
+    if (!snappy::GetUncompressedLength(reinterpret_cast<const char *>(compressed.data()),
+                                       compressed.size(), &actual_length) ||
+        actual_length != uncompressed_length) {
+      return Status::Corruption("unable to uncompress the buffer: unexpected length");
+    }
     bool success = snappy::RawUncompress(reinterpret_cast<const char *>(compressed.data()),
                                          compressed.size(), reinterpret_cast<char *>(uncompressed));
     return success ? Status::OK() : Status::Corruption("unable to uncompress the buffer");
@@ -175,9 +183,11 @@ class Lz4Codec : public CompressionCodec {
   Status Uncompress(const Slice& compressed,
                     uint8_t *uncompressed,
                     size_t uncompressed_length) const OVERRIDE {
-    int n = LZ4_decompress_fast(reinterpret_cast<const char *>(compressed.data()),
-                                reinterpret_cast<char *>(uncompressed), uncompressed_length);
-    if (n != compressed.size()) {
+    // Use the bounds-checked decoder: the input may be corrupt.
+    int n = LZ4_decompress_safe(reinterpret_cast<const char *>(compressed.data()),
+                                reinterpret_cast<char *>(uncompressed),
+                                compressed.size(), uncompressed_length);
+    if (n != uncompressed_length) {
       return Status::Corruption(
         StringPrintf("unable to uncompress the buffer. error near %d, buffer", -n),
                      KUDU_REDACT(compressed.ToDebugString(100)));
@@ -226,9 +236,13 @@ class ZlibCodec : public CompressionCodec {
 
   Status Uncompress(const Slice& compressed,
                     uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
-    int err = ::uncompress(uncompressed, &uncompressed_length,
+    size_t actual_length = uncompressed_length;
+    int err = ::uncompress(uncompressed, &actual_length,
                            compressed.data(), compressed.size());
-    return err == Z_OK ? Status::OK() : Status::Corruption("unable to uncompress the buffer");
+    if (err != Z_OK || actual_length != uncompressed_length) {
+      return Status::Corruption("unable to uncompress the buffer");
+    }
+    return Status::OK();
   }
 
   size_t MaxCompressedLength(size_t source_bytes) const OVERRIDE {
@@ -83,6 +83,12 @@ class Socket {
   // Sets SO_REUSEADDR to 'flag'. Should be used prior to Bind().
   Status SetReuseAddr(bool flag);
 
+  // Sets SO_REUSEPORT to 'flag'. Should be used prior to Bind(). On Linux,
+  // incoming connections are balanced across all listening sockets bound to
+  // the same address with this flag. Returns NotSupported on platforms
+  // without SO_REUSEPORT.
+  Status SetReusePort(bool flag);
+
   // Convenience method to invoke the common sequence:
   // 1) SetReuseAddr(true)
   // 2) Bind()